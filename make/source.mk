@@ -127,6 +127,9 @@ COMMON_SRC = \
             blackbox/blackbox.c \
             blackbox/blackbox_encoding.c \
             blackbox/blackbox_io.c \
+            blackbox/blackbox_compress.c \
+            blackbox/blackbox_ring.c \
+            blackbox/blackbox_stream.c \
             cms/cms.c \
             cms/cms_menu_blackbox.c \
             cms/cms_menu_builtin.c \
@@ -28,9 +28,11 @@
 #ifdef USE_BLACKBOX
 
 #include "blackbox.h"
+#include "blackbox_compress.h"
 #include "blackbox_encoding.h"
 #include "blackbox_fielddefs.h"
 #include "blackbox_io.h"
+#include "blackbox_stream.h"
 
 #include "build/build_config.h"
 #include "build/debug.h"
@@ -86,13 +88,20 @@
 #define DEFAULT_BLACKBOX_DEVICE     BLACKBOX_DEVICE_SERIAL
 #endif
 
-PG_REGISTER_WITH_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig, PG_BLACKBOX_CONFIG, 1);
+PG_REGISTER_WITH_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig, PG_BLACKBOX_CONFIG, 5);
 
 PG_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig,
     .p_ratio = 32,
     .device = DEFAULT_BLACKBOX_DEVICE,
     .record_acc = 1,
-    .mode = BLACKBOX_MODE_NORMAL
+    .mode = BLACKBOX_MODE_NORMAL,
+    .gyro_predictor = BLACKBOX_PREDICTOR_AVERAGE,
+    .motor_predictor = BLACKBOX_PREDICTOR_AVERAGE,
+    .compression = BLACKBOX_COMPRESSION_NONE,
+    .pid_ratio = 1,
+    .rc_ratio = 1,
+    .trigger_pre_ms = 2000,
+    .trigger_post_ms = 2000
 );
 
 #define BLACKBOX_SHUTDOWN_TIMEOUT_MILLIS 200
@@ -102,6 +111,7 @@ PG_RESET_TEMPLATE(blackboxConfig_t, blackboxConfig,
 #define PREDICT(x) CONCAT(FLIGHT_LOG_FIELD_PREDICTOR_, x)
 #define ENCODING(x) CONCAT(FLIGHT_LOG_FIELD_ENCODING_, x)
 #define CONDITION(x) CONCAT(FLIGHT_LOG_FIELD_CONDITION_, x)
+#define GROUP(x) CONCAT(FLIGHT_LOG_FIELD_GROUP_, x)
 #define UNSIGNED FLIGHT_LOG_FIELD_UNSIGNED
 #define SIGNED FLIGHT_LOG_FIELD_SIGNED
 
@@ -129,6 +139,7 @@ typedef struct blackboxFieldDefinition_s {
 } blackboxFieldDefinition_t;
 
 #define BLACKBOX_DELTA_FIELD_HEADER_COUNT       ARRAYLEN(blackboxFieldHeaderNames)
+#define BLACKBOX_P_PREDICTOR_HEADER_INDEX       4
 #define BLACKBOX_SIMPLE_FIELD_HEADER_COUNT      (BLACKBOX_DELTA_FIELD_HEADER_COUNT - 2)
 #define BLACKBOX_CONDITIONAL_FIELD_HEADER_COUNT (BLACKBOX_DELTA_FIELD_HEADER_COUNT - 2)
 
@@ -161,6 +172,7 @@ typedef struct blackboxDeltaFieldDefinition_s {
     uint8_t Ppredict;
     uint8_t Pencode;
     uint8_t condition; // Decide whether this field should appear in the log
+    uint8_t group; // FlightLogFieldGroup, MAIN unless given
 } blackboxDeltaFieldDefinition_t;
 
 /**
@@ -168,36 +180,39 @@ typedef struct blackboxDeltaFieldDefinition_s {
  * written into the flight log header so the log can be properly interpreted (but these definitions don't actually cause
  * the encoding to happen, we have to encode the flight log ourselves in write{Inter|Intra}frame() in a way that matches
  * the encoding we've promised here).
+ *
+ * Fields of a GROUP() other than MAIN move to frames of their own when the config logs that group at a lower rate,
+ * see writeFieldGroupFrames().
  */
 static const blackboxDeltaFieldDefinition_t blackboxMainFields[] = {
     /* loopIteration doesn't appear in P frames since it always increments */
     {"loopIteration",-1, UNSIGNED, .Ipredict = PREDICT(0),     .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(INC),           .Pencode = FLIGHT_LOG_FIELD_ENCODING_NULL, CONDITION(ALWAYS)},
     /* Time advances pretty steadily so the P-frame prediction is a straight line */
     {"time",       -1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(STRAIGHT_LINE), .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"axisP",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"axisP",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"axisP",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"axisP",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisP",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisP",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
     /* I terms get special packed encoding in P frames: */
-    {"axisI",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS)},
-    {"axisI",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS)},
-    {"axisI",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS)},
-    {"axisD",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_0)},
-    {"axisD",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_1)},
-    {"axisD",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_2)},
-    {"axisF",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"axisF",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
-    {"axisF",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
+    {"axisI",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisI",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisI",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG2_3S32), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisD",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_0), GROUP(PID)},
+    {"axisD",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_1), GROUP(PID)},
+    {"axisD",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(NONZERO_PID_D_2), GROUP(PID)},
+    {"axisF",       0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisF",       1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
+    {"axisF",       2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS), GROUP(PID)},
     /* rcCommands are encoded together as a group in P-frames: */
-    {"rcCommand",   0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"rcCommand",   1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"rcCommand",   2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"rcCommand",   3, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
+    {"rcCommand",   0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"rcCommand",   1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"rcCommand",   2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"rcCommand",   3, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
 
     // setpoint - define 4 fields like rcCommand to use the same encoding. setpoint[4] contains the mixer throttle
-    {"setpoint",    0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"setpoint",    1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"setpoint",    2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
-    {"setpoint",    3, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS)},
+    {"setpoint",    0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"setpoint",    1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"setpoint",    2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
+    {"setpoint",    3, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_4S16), CONDITION(ALWAYS), GROUP(RC)},
 
     {"vbatLatest",    -1, UNSIGNED, .Ipredict = PREDICT(VBATREF),  .Iencode = ENCODING(NEG_14BIT),   .Ppredict = PREDICT(PREVIOUS),  .Pencode = ENCODING(TAG8_8SVB), FLIGHT_LOG_FIELD_CONDITION_VBAT},
     {"amperageLatest",-1, SIGNED,   .Ipredict = PREDICT(0),        .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(PREVIOUS),  .Pencode = ENCODING(TAG8_8SVB), FLIGHT_LOG_FIELD_CONDITION_AMPERAGE_ADC},
@@ -215,7 +230,10 @@ static const blackboxDeltaFieldDefinition_t blackboxMainFields[] = {
 #endif
     {"rssi",       -1, UNSIGNED, .Ipredict = PREDICT(0),       .Iencode = ENCODING(UNSIGNED_VB), .Ppredict = PREDICT(PREVIOUS),      .Pencode = ENCODING(TAG8_8SVB), FLIGHT_LOG_FIELD_CONDITION_RSSI},
 
-    /* Gyros and accelerometers base their P-predictions on the average of the previous 2 frames to reduce noise impact */
+    /*
+     * Gyros and accelerometers base their P-predictions on the average of the previous 2 frames to reduce noise impact.
+     * The P predictor of gyroADC and motor is the one picked by the config, see blackboxMainFieldPPredictor().
+     */
     {"gyroADC",     0, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
     {"gyroADC",     1, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
     {"gyroADC",     2, SIGNED,   .Ipredict = PREDICT(0),       .Iencode = ENCODING(SIGNED_VB),   .Ppredict = PREDICT(AVERAGE_2),     .Pencode = ENCODING(SIGNED_VB), CONDITION(ALWAYS)},
@@ -276,6 +294,7 @@ typedef enum BlackboxState {
     BLACKBOX_STATE_PREPARE_LOG_FILE,
     BLACKBOX_STATE_SEND_HEADER,
     BLACKBOX_STATE_SEND_MAIN_FIELD_HEADER,
+    BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER,
     BLACKBOX_STATE_SEND_GPS_H_HEADER,
     BLACKBOX_STATE_SEND_GPS_G_HEADER,
     BLACKBOX_STATE_SEND_SLOW_HEADER,
@@ -345,6 +364,7 @@ static uint32_t blackboxLastFlightModeFlags = 0; // New event tracking of flight
 
 static struct {
     uint32_t headerIndex;
+    uint8_t group; // FlightLogFieldGroup whose definitions are being sent
 
     /* Since these fields are used during different blackbox states (never simultaneously) we can
      * overlap them to save on RAM
@@ -383,14 +403,31 @@ static uint16_t vbatReference;
 static blackboxGpsState_t gpsHistory;
 static blackboxSlowState_t slowHistory;
 
-// Keep a history of length 2, plus a buffer for MW to store the new values into
-static blackboxMainState_t blackboxHistoryRing[3];
+// Keep a history of length 3, plus a buffer for MW to store the new values into
+static blackboxMainState_t blackboxHistoryRing[4];
+
+// These point into blackboxHistoryRing, use them to know where to store history of a given age (0, 1, 2 or 3 generations old)
+static blackboxMainState_t* blackboxHistory[4];
 
-// These point into blackboxHistoryRing, use them to know where to store history of a given age (0, 1 or 2 generations old)
-static blackboxMainState_t* blackboxHistory[3];
+// P-frames since the last frame of each field group that is written in frames of its own, see writeFieldGroupFrames()
+static uint8_t blackboxFieldGroupFrameIndex[FLIGHT_LOG_FIELD_GROUP_COUNT];
+// Only the fields of those groups are used, as the previous state of their inter frames
+static blackboxMainState_t blackboxFieldGroupHistory;
+
+// P-frame predictors of the field groups the config picks them for, fixed while logging since the header advertises them
+static uint8_t blackboxGyroPPredictor;
+static uint8_t blackboxMotor0PPredictor;
+static uint8_t blackboxMotorPPredictor;
 
 static bool blackboxModeActivationConditionPresent = false;
 
+#ifdef USE_BLACKBOX_CAPTURE
+// In BLACKBOX_MODE_TRIGGERED the frames are committed to the device until this time after the last trigger
+static timeUs_t blackboxCaptureLiveUntilUs;
+// Committed bytes the device still had to take when the shutdown timeout was last restarted
+static uint32_t blackboxCaptureShutdownPending;
+#endif
+
 /**
  * Return true if it is safe to edit the Blackbox configuration.
  */
@@ -404,6 +441,33 @@ static bool blackboxIsOnlyLoggingIntraframes(void)
     return blackboxConfig()->p_ratio == 0;
 }
 
+// P-frames per frame of the group, 1 for the groups that are written in the main frames
+STATIC_UNIT_TESTED uint8_t blackboxFieldGroupRatio(FlightLogFieldGroup group)
+{
+    switch (group) {
+    case FLIGHT_LOG_FIELD_GROUP_PID:
+        return blackboxConfig()->pid_ratio;
+    case FLIGHT_LOG_FIELD_GROUP_RC:
+        return blackboxConfig()->rc_ratio;
+    default:
+        return 1;
+    }
+}
+
+static bool blackboxFieldGroupHasOwnFrames(FlightLogFieldGroup group)
+{
+    // Groups are only split off when there are P-frames to skip
+    return blackboxFieldGroupRatio(group) > 1 && !blackboxIsOnlyLoggingIntraframes();
+}
+
+// The group a main field is written with, MAIN for the I and P frames
+STATIC_UNIT_TESTED FlightLogFieldGroup blackboxMainFieldGroup(int fieldIndex)
+{
+    const FlightLogFieldGroup group = blackboxMainFields[fieldIndex].group;
+
+    return blackboxFieldGroupHasOwnFrames(group) ? group : FLIGHT_LOG_FIELD_GROUP_MAIN;
+}
+
 static bool testBlackboxConditionUncached(FlightLogFieldCondition condition)
 {
     switch (condition) {
@@ -509,14 +573,33 @@ static void blackboxSetState(BlackboxState newState)
         xmitState.headerIndex = 0;
         xmitState.u.fieldIndex = -1;
         break;
+    case BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER:
+        // Move on to the next group that is written in frames of its own
+        if (blackboxState != BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER) {
+            xmitState.group = FLIGHT_LOG_FIELD_GROUP_MAIN;
+        }
+        do {
+            xmitState.group++;
+        } while (xmitState.group < FLIGHT_LOG_FIELD_GROUP_COUNT && !blackboxFieldGroupHasOwnFrames(xmitState.group));
+        xmitState.headerIndex = 0;
+        xmitState.u.fieldIndex = -1;
+        break;
     case BLACKBOX_STATE_SEND_SYSINFO:
         xmitState.headerIndex = 0;
         break;
     case BLACKBOX_STATE_RUNNING:
         blackboxSlowFrameIterationTimer = blackboxSInterval; //Force a slow frame to be written on the first iteration
+#ifdef USE_BLACKBOX_CAPTURE
+        if (blackboxConfig()->mode == BLACKBOX_MODE_TRIGGERED) {
+            blackboxCaptureStart();
+        }
+#endif
         break;
     case BLACKBOX_STATE_SHUTTING_DOWN:
         xmitState.u.startTime = millis();
+#ifdef USE_BLACKBOX_CAPTURE
+        blackboxCaptureShutdownPending = blackboxCapturePending();
+#endif
         break;
     default:
         ;
@@ -524,38 +607,162 @@ static void blackboxSetState(BlackboxState newState)
     blackboxState = newState;
 }
 
-static void writeIntraframe(void)
+/*
+ * Write the fields of the PID group, as in an intra frame when last is NULL and as deltas from last otherwise.
+ */
+static void writePidFields(blackboxMainState_t *current, blackboxMainState_t *last)
 {
-    blackboxMainState_t *blackboxCurrent = blackboxHistory[0];
+    if (!last) {
+        blackboxWriteSignedVBArray(current->axisPID_P, XYZ_AXIS_COUNT);
+        blackboxWriteSignedVBArray(current->axisPID_I, XYZ_AXIS_COUNT);
 
-    blackboxWrite('I');
+        // Don't bother writing the current D term if the corresponding PID setting is zero
+        for (int x = 0; x < XYZ_AXIS_COUNT; x++) {
+            if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_NONZERO_PID_D_0 + x)) {
+                blackboxWriteSignedVB(current->axisPID_D[x]);
+            }
+        }
 
-    blackboxWriteUnsignedVB(blackboxIteration);
-    blackboxWriteUnsignedVB(blackboxCurrent->time);
+        blackboxWriteSignedVBArray(current->axisPID_F, XYZ_AXIS_COUNT);
+        return;
+    }
 
-    blackboxWriteSignedVBArray(blackboxCurrent->axisPID_P, XYZ_AXIS_COUNT);
-    blackboxWriteSignedVBArray(blackboxCurrent->axisPID_I, XYZ_AXIS_COUNT);
+    int32_t deltas[XYZ_AXIS_COUNT];
+
+    arraySubInt32(deltas, current->axisPID_P, last->axisPID_P, XYZ_AXIS_COUNT);
+    blackboxWriteSignedVBArray(deltas, XYZ_AXIS_COUNT);
+
+    /*
+     * The PID I field changes very slowly, most of the time +-2, so use an encoding
+     * that can pack all three fields into one byte in that situation.
+     */
+    arraySubInt32(deltas, current->axisPID_I, last->axisPID_I, XYZ_AXIS_COUNT);
+    blackboxWriteTag2_3S32(deltas);
 
-    // Don't bother writing the current D term if the corresponding PID setting is zero
+    /*
+     * The PID D term is frequently set to zero for yaw, which makes the result from the calculation
+     * always zero. So don't bother recording D results when PID D terms are zero.
+     */
     for (int x = 0; x < XYZ_AXIS_COUNT; x++) {
         if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_NONZERO_PID_D_0 + x)) {
-            blackboxWriteSignedVB(blackboxCurrent->axisPID_D[x]);
+            blackboxWriteSignedVB(current->axisPID_D[x] - last->axisPID_D[x]);
         }
     }
 
-    blackboxWriteSignedVBArray(blackboxCurrent->axisPID_F, XYZ_AXIS_COUNT);
+    arraySubInt32(deltas, current->axisPID_F, last->axisPID_F, XYZ_AXIS_COUNT);
+    blackboxWriteSignedVBArray(deltas, XYZ_AXIS_COUNT);
+}
+
+/*
+ * Write the fields of the RC group, rcCommand and setpoint, like writePidFields().
+ */
+static void writeRcFields(blackboxMainState_t *current, blackboxMainState_t *last)
+{
+    if (!last) {
+        // Write roll, pitch and yaw first:
+        blackboxWriteSigned16VBArray(current->rcCommand, 3);
+
+        /*
+         * Write the throttle separately from the rest of the RC data as it's unsigned.
+         * Throttle lies in range [PWM_RANGE_MIN..PWM_RANGE_MAX]:
+         */
+        blackboxWriteUnsignedVB(current->rcCommand[THROTTLE]);
+
+        // Write setpoint roll, pitch, yaw, and throttle
+        blackboxWriteSigned16VBArray(current->setpoint, 4);
+        return;
+    }
 
-    // Write roll, pitch and yaw first:
-    blackboxWriteSigned16VBArray(blackboxCurrent->rcCommand, 3);
+    int32_t deltas[4];
+    int32_t setpointDeltas[4];
 
     /*
-     * Write the throttle separately from the rest of the RC data as it's unsigned.
-     * Throttle lies in range [PWM_RANGE_MIN..PWM_RANGE_MAX]:
+     * RC tends to stay the same or fairly small for many frames at a time, so use an encoding that
+     * can pack multiple values per byte:
      */
-    blackboxWriteUnsignedVB(blackboxCurrent->rcCommand[THROTTLE]);
+    for (int x = 0; x < 4; x++) {
+        deltas[x] = current->rcCommand[x] - last->rcCommand[x];
+        setpointDeltas[x] = current->setpoint[x] - last->setpoint[x];
+    }
+
+    blackboxWriteTag8_4S16(deltas);
+    blackboxWriteTag8_4S16(setpointDeltas);
+}
+
+typedef struct blackboxFieldGroup_s {
+    char intraFrameChar;
+    char interFrameChar;
+    // Where the fields of the group are in blackboxMainState_t
+    uint8_t stateOffset;
+    uint8_t stateSize;
+    void (*writeFields)(blackboxMainState_t *current, blackboxMainState_t *last);
+} blackboxFieldGroup_t;
+
+static const blackboxFieldGroup_t blackboxFieldGroups[FLIGHT_LOG_FIELD_GROUP_COUNT] = {
+    [FLIGHT_LOG_FIELD_GROUP_PID] = {
+        'J', 'K',
+        offsetof(blackboxMainState_t, axisPID_P), offsetof(blackboxMainState_t, rcCommand) - offsetof(blackboxMainState_t, axisPID_P),
+        writePidFields
+    },
+    [FLIGHT_LOG_FIELD_GROUP_RC] = {
+        'R', 'Q',
+        offsetof(blackboxMainState_t, rcCommand), offsetof(blackboxMainState_t, gyroADC) - offsetof(blackboxMainState_t, rcCommand),
+        writeRcFields
+    },
+};
+
+/*
+ * Called with every main frame, true if the group gets a frame of its own along with this one. Every I-frame is
+ * followed by one so a reader can resynchronise the group there.
+ */
+STATIC_UNIT_TESTED bool blackboxShouldLogFieldGroupFrame(FlightLogFieldGroup group, bool intraframe)
+{
+    if (!blackboxFieldGroupHasOwnFrames(group)) {
+        return false;
+    }
+    if (intraframe || ++blackboxFieldGroupFrameIndex[group] >= blackboxFieldGroupRatio(group)) {
+        blackboxFieldGroupFrameIndex[group] = 0;
+        return true;
+    }
+    return false;
+}
+
+// Write the frames of the groups that are due with the main frame in blackboxHistory[0]
+static void writeFieldGroupFrames(bool intraframe)
+{
+    for (FlightLogFieldGroup group = FLIGHT_LOG_FIELD_GROUP_MAIN + 1; group < FLIGHT_LOG_FIELD_GROUP_COUNT; group++) {
+        if (!blackboxShouldLogFieldGroupFrame(group, intraframe)) {
+            continue;
+        }
 
-    // Write setpoint roll, pitch, yaw, and throttle
-    blackboxWriteSigned16VBArray(blackboxCurrent->setpoint, 4);
+        const blackboxFieldGroup_t *fieldGroup = &blackboxFieldGroups[group];
+
+        blackboxFrameBegin();
+        blackboxWrite(intraframe ? fieldGroup->intraFrameChar : fieldGroup->interFrameChar);
+        fieldGroup->writeFields(blackboxHistory[0], intraframe ? NULL : &blackboxFieldGroupHistory);
+        blackboxFrameEnd();
+
+        // The next inter frame of the group is predicted from this one
+        memcpy((uint8_t *)&blackboxFieldGroupHistory + fieldGroup->stateOffset, (uint8_t *)blackboxHistory[0] + fieldGroup->stateOffset, fieldGroup->stateSize);
+    }
+}
+
+static void writeIntraframe(void)
+{
+    blackboxMainState_t *blackboxCurrent = blackboxHistory[0];
+
+    blackboxFrameBegin();
+    blackboxWrite('I');
+
+    blackboxWriteUnsignedVB(blackboxIteration);
+    blackboxWriteUnsignedVB(blackboxCurrent->time);
+
+    if (!blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_PID)) {
+        writePidFields(blackboxCurrent, NULL);
+    }
+    if (!blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_RC)) {
+        writeRcFields(blackboxCurrent, NULL);
+    }
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_VBAT)) {
         /*
@@ -617,30 +824,59 @@ static void writeIntraframe(void)
         blackboxWriteSignedVB(blackboxCurrent->servo[5] - 1500);
     }
 
+    blackboxFrameEnd();
+
+    writeFieldGroupFrames(true);
+
     //Rotate our history buffers:
 
     //The current state becomes the new "before" state
     blackboxHistory[1] = blackboxHistory[0];
-    //And since we have no other history, we also use it for the "before, before" state
+    //And since we have no other history, we also use it for the older states
     blackboxHistory[2] = blackboxHistory[0];
+    blackboxHistory[3] = blackboxHistory[0];
     //And advance the current state over to a blank space ready to be filled
-    blackboxHistory[0] = ((blackboxHistory[0] - blackboxHistoryRing + 1) % 3) + blackboxHistoryRing;
+    blackboxHistory[0] = ((blackboxHistory[0] - blackboxHistoryRing + 1) % ARRAYLEN(blackboxHistoryRing)) + blackboxHistoryRing;
 
     blackboxLoggedAnyFrames = true;
 }
 
-static void blackboxWriteMainStateArrayUsingAveragePredictor(int arrOffsetInHistory, int count)
+/*
+ * Write elements first to count - 1 of an int16_t array in the main state, predicted from the history with one of
+ * AVERAGE_2, STRAIGHT_LINE, SECOND_ORDER or MOTOR_0 (element 0 of the current state).
+ */
+static void blackboxWriteMainStateArrayUsingPredictor(int arrOffsetInHistory, int first, int count, uint8_t predictor)
 {
     int16_t *curr  = (int16_t*) ((char*) (blackboxHistory[0]) + arrOffsetInHistory);
     int16_t *prev1 = (int16_t*) ((char*) (blackboxHistory[1]) + arrOffsetInHistory);
     int16_t *prev2 = (int16_t*) ((char*) (blackboxHistory[2]) + arrOffsetInHistory);
+    int16_t *prev3 = (int16_t*) ((char*) (blackboxHistory[3]) + arrOffsetInHistory);
+
+    int32_t deltas[MAX(MAX_SUPPORTED_MOTORS, DEBUG16_VALUE_COUNT)];
 
-    for (int i = 0; i < count; i++) {
-        // Predictor is the average of the previous two history states
-        int32_t predictor = (prev1[i] + prev2[i]) / 2;
+    for (int i = first; i < count; i++) {
+        int32_t prediction;
+
+        switch (predictor) {
+        case PREDICT(STRAIGHT_LINE):
+            prediction = 2 * prev1[i] - prev2[i];
+            break;
+        case PREDICT(SECOND_ORDER):
+            prediction = 3 * (prev1[i] - prev2[i]) + prev3[i];
+            break;
+        case PREDICT(MOTOR_0):
+            prediction = curr[0];
+            break;
+        default:
+            // The average of the previous two history states
+            prediction = (prev1[i] + prev2[i]) / 2;
+            break;
+        }
 
-        blackboxWriteSignedVB(curr[i] - predictor);
+        deltas[i - first] = curr[i] - prediction;
     }
+
+    blackboxWriteSignedVBArray(deltas, count - first);
 }
 
 static void writeInterframe(void)
@@ -648,6 +884,7 @@ static void writeInterframe(void)
     blackboxMainState_t *blackboxCurrent = blackboxHistory[0];
     blackboxMainState_t *blackboxLast = blackboxHistory[1];
 
+    blackboxFrameBegin();
     blackboxWrite('P');
 
     //No need to store iteration count since its delta is always 1
@@ -658,43 +895,14 @@ static void writeInterframe(void)
      */
     blackboxWriteSignedVB((int32_t) (blackboxHistory[0]->time - 2 * blackboxHistory[1]->time + blackboxHistory[2]->time));
 
-    int32_t deltas[8];
-    int32_t setpointDeltas[4];
-    
-    arraySubInt32(deltas, blackboxCurrent->axisPID_P, blackboxLast->axisPID_P, XYZ_AXIS_COUNT);
-    blackboxWriteSignedVBArray(deltas, XYZ_AXIS_COUNT);
-
-    /*
-     * The PID I field changes very slowly, most of the time +-2, so use an encoding
-     * that can pack all three fields into one byte in that situation.
-     */
-    arraySubInt32(deltas, blackboxCurrent->axisPID_I, blackboxLast->axisPID_I, XYZ_AXIS_COUNT);
-    blackboxWriteTag2_3S32(deltas);
-
-    /*
-     * The PID D term is frequently set to zero for yaw, which makes the result from the calculation
-     * always zero. So don't bother recording D results when PID D terms are zero.
-     */
-    for (int x = 0; x < XYZ_AXIS_COUNT; x++) {
-        if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_NONZERO_PID_D_0 + x)) {
-            blackboxWriteSignedVB(blackboxCurrent->axisPID_D[x] - blackboxLast->axisPID_D[x]);
-        }
+    if (!blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_PID)) {
+        writePidFields(blackboxCurrent, blackboxLast);
     }
-
-    arraySubInt32(deltas, blackboxCurrent->axisPID_F, blackboxLast->axisPID_F, XYZ_AXIS_COUNT);
-    blackboxWriteSignedVBArray(deltas, XYZ_AXIS_COUNT);
-
-    /*
-     * RC tends to stay the same or fairly small for many frames at a time, so use an encoding that
-     * can pack multiple values per byte:
-     */
-    for (int x = 0; x < 4; x++) {
-        deltas[x] = blackboxCurrent->rcCommand[x] - blackboxLast->rcCommand[x];
-        setpointDeltas[x] = blackboxCurrent->setpoint[x] - blackboxLast->setpoint[x];
+    if (!blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_RC)) {
+        writeRcFields(blackboxCurrent, blackboxLast);
     }
 
-    blackboxWriteTag8_4S16(deltas);
-    blackboxWriteTag8_4S16(setpointDeltas);
+    int32_t deltas[8];
 
     //Check for sensors that are updated periodically (so deltas are normally zero)
     int optionalFieldCount = 0;
@@ -734,23 +942,29 @@ static void writeInterframe(void)
     blackboxWriteTag8_8SVB(deltas, optionalFieldCount);
 
     //Since gyros, accs and motors are noisy, base their predictions on the average of the history:
-    blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, gyroADC),   XYZ_AXIS_COUNT);
+    blackboxWriteMainStateArrayUsingPredictor(offsetof(blackboxMainState_t, gyroADC), 0, XYZ_AXIS_COUNT, blackboxGyroPPredictor);
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_ACC)) {
-        blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, accADC), XYZ_AXIS_COUNT);
+        blackboxWriteMainStateArrayUsingPredictor(offsetof(blackboxMainState_t, accADC), 0, XYZ_AXIS_COUNT, PREDICT(AVERAGE_2));
     }
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_DEBUG)) {
-        blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, debug), DEBUG16_VALUE_COUNT);
+        blackboxWriteMainStateArrayUsingPredictor(offsetof(blackboxMainState_t, debug), 0, DEBUG16_VALUE_COUNT, PREDICT(AVERAGE_2));
     }
-    blackboxWriteMainStateArrayUsingAveragePredictor(offsetof(blackboxMainState_t, motor),     getMotorCount());
+    blackboxWriteMainStateArrayUsingPredictor(offsetof(blackboxMainState_t, motor), 0, 1, blackboxMotor0PPredictor);
+    blackboxWriteMainStateArrayUsingPredictor(offsetof(blackboxMainState_t, motor), 1, getMotorCount(), blackboxMotorPPredictor);
 
     if (testBlackboxCondition(FLIGHT_LOG_FIELD_CONDITION_TRICOPTER)) {
         blackboxWriteSignedVB(blackboxCurrent->servo[5] - blackboxLast->servo[5]);
     }
 
+    blackboxFrameEnd();
+
+    writeFieldGroupFrames(false);
+
     //Rotate our history buffers
+    blackboxHistory[3] = blackboxHistory[2];
     blackboxHistory[2] = blackboxHistory[1];
     blackboxHistory[1] = blackboxHistory[0];
-    blackboxHistory[0] = ((blackboxHistory[0] - blackboxHistoryRing + 1) % 3) + blackboxHistoryRing;
+    blackboxHistory[0] = ((blackboxHistory[0] - blackboxHistoryRing + 1) % ARRAYLEN(blackboxHistoryRing)) + blackboxHistoryRing;
 
     blackboxLoggedAnyFrames = true;
 }
@@ -761,6 +975,7 @@ static void writeSlowFrame(void)
 {
     int32_t values[3];
 
+    blackboxFrameBegin();
     blackboxWrite('S');
 
     blackboxWriteUnsignedVB(slowHistory.flightModeFlags);
@@ -774,6 +989,8 @@ static void writeSlowFrame(void)
     values[2] = slowHistory.rxFlightChannelsValid ? 1 : 0;
     blackboxWriteTag2_3S32(values);
 
+    blackboxFrameEnd();
+
     blackboxSlowFrameIterationTimer = 0;
 }
 
@@ -832,12 +1049,77 @@ void blackboxValidateConfig(void)
     case BLACKBOX_DEVICE_SDCARD:
 #endif
     case BLACKBOX_DEVICE_SERIAL:
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+#endif
         // Device supported, leave the setting alone
         break;
 
     default:
         blackboxConfigMutable()->device = BLACKBOX_DEVICE_SERIAL;
     }
+
+    // Only the motors can be predicted from motor[0]
+    if (blackboxConfig()->gyro_predictor >= BLACKBOX_PREDICTOR_MOTOR_0) {
+        blackboxConfigMutable()->gyro_predictor = BLACKBOX_PREDICTOR_AVERAGE;
+    }
+    if (blackboxConfig()->motor_predictor >= BLACKBOX_PREDICTOR_COUNT) {
+        blackboxConfigMutable()->motor_predictor = BLACKBOX_PREDICTOR_AVERAGE;
+    }
+
+    if (blackboxConfig()->pid_ratio == 0) {
+        blackboxConfigMutable()->pid_ratio = 1;
+    }
+    if (blackboxConfig()->rc_ratio == 0) {
+        blackboxConfigMutable()->rc_ratio = 1;
+    }
+
+#ifdef USE_BLACKBOX_CAPTURE
+    if (blackboxConfig()->mode > BLACKBOX_MODE_TRIGGERED) {
+#else
+    if (blackboxConfig()->mode > BLACKBOX_MODE_ALWAYS_ON) {
+#endif
+        blackboxConfigMutable()->mode = BLACKBOX_MODE_NORMAL;
+    }
+
+#ifdef USE_HUFFMAN
+    if (blackboxConfig()->compression > BLACKBOX_COMPRESSION_HUFFMAN) {
+        blackboxConfigMutable()->compression = BLACKBOX_COMPRESSION_NONE;
+    }
+#else
+    blackboxConfigMutable()->compression = BLACKBOX_COMPRESSION_NONE;
+#endif
+}
+
+STATIC_UNIT_TESTED uint8_t blackboxFieldPredictor(uint8_t predictor)
+{
+    switch (predictor) {
+    case BLACKBOX_PREDICTOR_STRAIGHT_LINE:
+        return PREDICT(STRAIGHT_LINE);
+    case BLACKBOX_PREDICTOR_SECOND_ORDER:
+        return PREDICT(SECOND_ORDER);
+    case BLACKBOX_PREDICTOR_MOTOR_0:
+        return PREDICT(MOTOR_0);
+    default:
+        return PREDICT(AVERAGE_2);
+    }
+}
+
+/*
+ * The P-frame predictor to advertise for a main field, for the field groups with a configurable predictor that's the
+ * one picked at blackboxStart().
+ */
+STATIC_UNIT_TESTED uint8_t blackboxMainFieldPPredictor(int fieldIndex)
+{
+    const blackboxDeltaFieldDefinition_t *field = &blackboxMainFields[fieldIndex];
+
+    if (strcmp(field->name, "gyroADC") == 0) {
+        return blackboxGyroPPredictor;
+    }
+    if (strcmp(field->name, "motor") == 0) {
+        return field->fieldNameIndex == 0 ? blackboxMotor0PPredictor : blackboxMotorPPredictor;
+    }
+    return field->Ppredict;
 }
 
 static void blackboxResetIterationTimers(void)
@@ -857,6 +1139,12 @@ static void blackboxStart(void)
     blackboxValidateConfig();
 
     if (!blackboxDeviceOpen()) {
+#ifdef USE_BLACKBOX_STREAM
+        // Nobody is listening yet, stay stopped so the log starts once the capture tool attaches
+        if (blackboxConfig()->device == BLACKBOX_DEVICE_STREAM) {
+            return;
+        }
+#endif
         blackboxSetState(BLACKBOX_STATE_DISABLED);
         return;
     }
@@ -866,6 +1154,16 @@ static void blackboxStart(void)
     blackboxHistory[0] = &blackboxHistoryRing[0];
     blackboxHistory[1] = &blackboxHistoryRing[1];
     blackboxHistory[2] = &blackboxHistoryRing[2];
+    blackboxHistory[3] = &blackboxHistoryRing[3];
+
+    blackboxGyroPPredictor = blackboxFieldPredictor(blackboxConfig()->gyro_predictor);
+    if (blackboxConfig()->motor_predictor == BLACKBOX_PREDICTOR_MOTOR_0) {
+        // motor[0] can't predict itself
+        blackboxMotor0PPredictor = PREDICT(AVERAGE_2);
+    } else {
+        blackboxMotor0PPredictor = blackboxFieldPredictor(blackboxConfig()->motor_predictor);
+    }
+    blackboxMotorPPredictor = blackboxFieldPredictor(blackboxConfig()->motor_predictor);
 
     vbatReference = getBatteryVoltageLatest();
 
@@ -892,6 +1190,34 @@ static void blackboxStart(void)
     blackboxSetState(BLACKBOX_STATE_PREPARE_LOG_FILE);
 }
 
+#ifdef USE_BLACKBOX_CAPTURE
+// Anything that makes the frames around it worth keeping in BLACKBOX_MODE_TRIGGERED
+static bool blackboxCaptureTriggered(void)
+{
+    return crashRecoveryModeActive()
+        || (getArmingDisableFlags() & ARMING_DISABLED_CRASH_DETECTED)
+        || gyroOverflowDetected()
+        || failsafeIsActive()
+        || (blackboxModeActivationConditionPresent && IS_RC_MODE_ACTIVE(BOXBLACKBOX));
+}
+
+static void blackboxTriggerCapture(timeUs_t currentTimeUs)
+{
+    blackboxCaptureTrigger(currentTimeUs - blackboxConfig()->trigger_pre_ms * 1000);
+    blackboxCaptureLiveUntilUs = currentTimeUs + blackboxConfig()->trigger_post_ms * 1000;
+}
+
+// Commit while a trigger is on and for trigger_post_ms after
+static void blackboxUpdateCapture(timeUs_t currentTimeUs)
+{
+    if (blackboxCaptureTriggered()) {
+        blackboxTriggerCapture(currentTimeUs);
+    } else if (blackboxCaptureIsLive() && cmpTimeUs(currentTimeUs, blackboxCaptureLiveUntilUs) >= 0) {
+        blackboxCaptureRelease();
+    }
+}
+#endif
+
 /**
  * Begin Blackbox shutdown.
  */
@@ -905,6 +1231,13 @@ void blackboxFinish(void)
         break;
     case BLACKBOX_STATE_RUNNING:
     case BLACKBOX_STATE_PAUSED:
+#ifdef USE_BLACKBOX_CAPTURE
+        // A disarm by crash detection or failsafe is reason enough to keep what led up to it
+        if (blackboxConfig()->mode == BLACKBOX_MODE_TRIGGERED && blackboxCaptureTriggered()) {
+            blackboxTriggerCapture(micros());
+        }
+        blackboxCaptureFinish();
+#endif
         blackboxLogEvent(FLIGHT_LOG_EVENT_LOG_END, NULL);
         FALLTHROUGH;
     default:
@@ -927,6 +1260,11 @@ static void startInTestMode(void)
             }
         }
         blackboxStart();
+#ifdef USE_BLACKBOX_STREAM
+        if (blackboxState == BLACKBOX_STATE_STOPPED) {
+            return; // Stream not attached yet, try again next time
+        }
+#endif
         startedLoggingInTestMode = true;
     }
 }
@@ -964,18 +1302,22 @@ static bool inMotorTestMode(void) {
 #ifdef USE_GPS
 static void writeGPSHomeFrame(void)
 {
+    blackboxFrameBegin();
     blackboxWrite('H');
 
     blackboxWriteSignedVB(GPS_home[0]);
     blackboxWriteSignedVB(GPS_home[1]);
     //TODO it'd be great if we could grab the GPS current time and write that too
 
+    blackboxFrameEnd();
+
     gpsHistory.GPS_home[0] = GPS_home[0];
     gpsHistory.GPS_home[1] = GPS_home[1];
 }
 
 static void writeGPSFrame(timeUs_t currentTimeUs)
 {
+    blackboxFrameBegin();
     blackboxWrite('G');
 
     /*
@@ -996,6 +1338,8 @@ static void writeGPSFrame(timeUs_t currentTimeUs)
     blackboxWriteUnsignedVB(gpsSol.groundSpeed);
     blackboxWriteUnsignedVB(gpsSol.groundCourse);
 
+    blackboxFrameEnd();
+
     gpsHistory.GPS_numSat = gpsSol.numSat;
     gpsHistory.GPS_coord[LAT] = gpsSol.llh.lat;
     gpsHistory.GPS_coord[LON] = gpsSol.llh.lon;
@@ -1081,6 +1425,8 @@ static void loadMainState(timeUs_t currentTimeUs)
  * Provide an array 'conditions' of FlightLogFieldCondition enums if you want these conditions to decide whether a field
  * should be included or not. Otherwise provide NULL for this parameter and NULL for secondCondition.
  *
+ * For the main fields provide the FlightLogFieldGroup to write the definitions of, otherwise -1.
+ *
  * Set xmitState.headerIndex to 0 and xmitState.u.fieldIndex to -1 before calling for the first time.
  *
  * secondFieldDefinition and secondCondition element pointers need to be provided in order to compute the stride of the
@@ -1089,7 +1435,8 @@ static void loadMainState(timeUs_t currentTimeUs)
  * Returns true if there is still header left to transmit (so call again to continue transmission).
  */
 static bool sendFieldDefinition(char mainFrameChar, char deltaFrameChar, const void *fieldDefinitions,
-        const void *secondFieldDefinition, int fieldCount, const uint8_t *conditions, const uint8_t *secondCondition)
+        const void *secondFieldDefinition, int fieldCount, const uint8_t *conditions, const uint8_t *secondCondition,
+        int group)
 {
     const blackboxFieldDefinition_t *def;
     unsigned int headerCount;
@@ -1132,7 +1479,8 @@ static bool sendFieldDefinition(char mainFrameChar, char deltaFrameChar, const v
     for (; xmitState.u.fieldIndex < fieldCount; xmitState.u.fieldIndex++) {
         def = (const blackboxFieldDefinition_t*) ((const char*)fieldDefinitions + definitionStride * xmitState.u.fieldIndex);
 
-        if (!conditions || testBlackboxCondition(conditions[conditionsStride * xmitState.u.fieldIndex])) {
+        if ((!conditions || testBlackboxCondition(conditions[conditionsStride * xmitState.u.fieldIndex]))
+            && (group < 0 || (int)blackboxMainFieldGroup(xmitState.u.fieldIndex) == group)) {
             // First (over)estimate the length of the string we want to print
 
             int32_t bytesToWrite = 1; // Leading comma
@@ -1167,6 +1515,8 @@ static bool sendFieldDefinition(char mainFrameChar, char deltaFrameChar, const v
                 if (def->fieldNameIndex != -1) {
                     blackboxPrintf("[%d]", def->fieldNameIndex);
                 }
+            } else if (deltaFrameChar == 'P' && xmitState.headerIndex == BLACKBOX_P_PREDICTOR_HEADER_INDEX) {
+                blackboxPrintf("%d", blackboxMainFieldPPredictor(xmitState.u.fieldIndex));
             } else {
                 //The other headers are integers
                 blackboxPrintf("%d", def->arr[xmitState.headerIndex - 1]);
@@ -1241,6 +1591,9 @@ static bool blackboxWriteSysinfo(void)
         BLACKBOX_PRINT_HEADER_LINE("I interval", "%d",                      blackboxIInterval);
         BLACKBOX_PRINT_HEADER_LINE("P interval", "%d",                      blackboxPInterval);
         BLACKBOX_PRINT_HEADER_LINE("P ratio", "%d",                         blackboxConfig()->p_ratio);
+        // P-frames per J/K and R/Q frame, 1 when the group is in the main frames
+        BLACKBOX_PRINT_HEADER_LINE("PID ratio", "%d",                       blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_PID) ? blackboxConfig()->pid_ratio : 1);
+        BLACKBOX_PRINT_HEADER_LINE("RC ratio", "%d",                        blackboxFieldGroupHasOwnFrames(FLIGHT_LOG_FIELD_GROUP_RC) ? blackboxConfig()->rc_ratio : 1);
         BLACKBOX_PRINT_HEADER_LINE("minthrottle", "%d",                     motorConfig()->minthrottle);
         BLACKBOX_PRINT_HEADER_LINE("maxthrottle", "%d",                     motorConfig()->maxthrottle);
         BLACKBOX_PRINT_HEADER_LINE("gyro_scale","0x%x",                     castFloatBytesToInt(1.0f));
@@ -1442,6 +1795,7 @@ void blackboxLogEvent(FlightLogEvent event, flightLogEventData_t *data)
     }
 
     //Shared header for event frames
+    blackboxFrameBegin();
     blackboxWrite('E');
     blackboxWrite(event);
 
@@ -1472,6 +1826,19 @@ void blackboxLogEvent(FlightLogEvent event, flightLogEventData_t *data)
         blackboxWrite(0);
         break;
     }
+
+    blackboxFrameEnd();
+}
+
+// Tell the decoder that the next frame doesn't follow on from the one before it
+static void blackboxLogLoggingResume(timeUs_t currentTimeUs)
+{
+    flightLogEvent_loggingResume_t resume;
+
+    resume.logIteration = blackboxIteration;
+    resume.currentTime = currentTimeUs;
+
+    blackboxLogEvent(FLIGHT_LOG_EVENT_LOGGING_RESUME, (flightLogEventData_t *) &resume);
 }
 
 /* If an arming beep has played since it was last logged, write the time of the arming beep to the log as a synchronization point */
@@ -1547,6 +1914,20 @@ STATIC_UNIT_TESTED void blackboxLogIteration(timeUs_t currentTimeUs)
 {
     // Write a keyframe every blackboxIInterval frames so we can resynchronise upon missing frames
     if (blackboxShouldLogIFrame()) {
+#ifdef USE_BLACKBOX_CAPTURE
+        if (blackboxCaptureKeyframe(currentTimeUs)) {
+            // A capture may start here, give the decoder all it needs to start from this I-frame
+            blackboxLogLoggingResume(currentTimeUs);
+            blackboxSlowFrameIterationTimer = blackboxSInterval;
+            writeSlowFrameIfNeeded();
+#ifdef USE_GPS
+            // GPS frames are predicted from home, which is otherwise only logged now and then
+            if (featureIsEnabled(FEATURE_GPS)) {
+                writeGPSHomeFrame();
+            }
+#endif
+        }
+#endif
         /*
          * Don't log a slow frame if the slow data didn't change ("I" frames are already large enough without adding
          * an additional item to write at the same time). Unless we're *only* logging "I" frames, then we have no choice.
@@ -1636,7 +2017,20 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         blackboxReplenishHeaderBudget();
         //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
         if (!sendFieldDefinition('I', 'P', blackboxMainFields, blackboxMainFields + 1, ARRAYLEN(blackboxMainFields),
-                &blackboxMainFields[0].condition, &blackboxMainFields[1].condition)) {
+                &blackboxMainFields[0].condition, &blackboxMainFields[1].condition, FLIGHT_LOG_FIELD_GROUP_MAIN)) {
+            blackboxSetState(BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER);
+        }
+        break;
+    case BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER:
+        blackboxReplenishHeaderBudget();
+        //On entry of this state, xmitState.group is the first group with frames of its own, if there is one
+        if (xmitState.group < FLIGHT_LOG_FIELD_GROUP_COUNT) {
+            const blackboxFieldGroup_t *fieldGroup = &blackboxFieldGroups[xmitState.group];
+            if (!sendFieldDefinition(fieldGroup->intraFrameChar, fieldGroup->interFrameChar, blackboxMainFields, blackboxMainFields + 1, ARRAYLEN(blackboxMainFields),
+                    &blackboxMainFields[0].condition, &blackboxMainFields[1].condition, xmitState.group)) {
+                blackboxSetState(BLACKBOX_STATE_SEND_FIELD_GROUP_HEADER);
+            }
+        } else {
 #ifdef USE_GPS
             if (featureIsEnabled(FEATURE_GPS)) {
                 blackboxSetState(BLACKBOX_STATE_SEND_GPS_H_HEADER);
@@ -1650,7 +2044,7 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         blackboxReplenishHeaderBudget();
         //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
         if (!sendFieldDefinition('H', 0, blackboxGpsHFields, blackboxGpsHFields + 1, ARRAYLEN(blackboxGpsHFields),
-                NULL, NULL)) {
+                NULL, NULL, -1)) {
             blackboxSetState(BLACKBOX_STATE_SEND_GPS_G_HEADER);
         }
         break;
@@ -1658,7 +2052,7 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         blackboxReplenishHeaderBudget();
         //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
         if (!sendFieldDefinition('G', 0, blackboxGpsGFields, blackboxGpsGFields + 1, ARRAYLEN(blackboxGpsGFields),
-                &blackboxGpsGFields[0].condition, &blackboxGpsGFields[1].condition)) {
+                &blackboxGpsGFields[0].condition, &blackboxGpsGFields[1].condition, -1)) {
             blackboxSetState(BLACKBOX_STATE_SEND_SLOW_HEADER);
         }
         break;
@@ -1667,7 +2061,7 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         blackboxReplenishHeaderBudget();
         //On entry of this state, xmitState.headerIndex is 0 and xmitState.u.fieldIndex is -1
         if (!sendFieldDefinition('S', 0, blackboxSlowFields, blackboxSlowFields + 1, ARRAYLEN(blackboxSlowFields),
-                NULL, NULL)) {
+                NULL, NULL, -1)) {
             blackboxSetState(BLACKBOX_STATE_SEND_SYSINFO);
         }
         break;
@@ -1691,12 +2085,7 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         // Only allow resume to occur during an I-frame iteration, so that we have an "I" base to work from
         if (IS_RC_MODE_ACTIVE(BOXBLACKBOX) && blackboxShouldLogIFrame()) {
             // Write a log entry so the decoder is aware that our large time/iteration skip is intended
-            flightLogEvent_loggingResume_t resume;
-
-            resume.logIteration = blackboxIteration;
-            resume.currentTime = currentTimeUs;
-
-            blackboxLogEvent(FLIGHT_LOG_EVENT_LOGGING_RESUME, (flightLogEventData_t *) &resume);
+            blackboxLogLoggingResume(currentTimeUs);
             blackboxSetState(BLACKBOX_STATE_RUNNING);
 
             blackboxLogIteration(currentTimeUs);
@@ -1706,6 +2095,15 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         break;
     case BLACKBOX_STATE_RUNNING:
         // On entry to this state, blackboxIteration, blackboxPFrameIndex and blackboxIFrameIndex are reset to 0
+#ifdef USE_BLACKBOX_CAPTURE
+        if (blackboxConfig()->mode == BLACKBOX_MODE_TRIGGERED) {
+            // The switch is one of the triggers rather than a pause
+            blackboxUpdateCapture(currentTimeUs);
+            blackboxLogIteration(currentTimeUs);
+            blackboxAdvanceIterationTimers();
+            break;
+        }
+#endif
         // Prevent the Pausing of the log on the mode switch if in Motor Test Mode
         if (blackboxModeActivationConditionPresent && !IS_RC_MODE_ACTIVE(BOXBLACKBOX) && !startedLoggingInTestMode) {
             blackboxSetState(BLACKBOX_STATE_PAUSED);
@@ -1716,6 +2114,18 @@ void blackboxUpdate(timeUs_t currentTimeUs)
         break;
     case BLACKBOX_STATE_SHUTTING_DOWN:
         //On entry of this state, startTime is set
+#ifdef USE_BLACKBOX_CAPTURE
+        if (blackboxCapturePending() != blackboxCaptureShutdownPending) {
+            // Still taking the capture, the timeout is for a device that stopped taking data
+            blackboxCaptureShutdownPending = blackboxCapturePending();
+            xmitState.u.startTime = millis();
+        }
+        if (blackboxCapturePending() && millis() <= xmitState.u.startTime + BLACKBOX_SHUTDOWN_TIMEOUT_MILLIS) {
+            // The log may only end once the rest of the capture is out
+            blackboxDeviceFlush();
+            break;
+        }
+#endif
         /*
          * Wait for the log we've transmitted to make its way to the logger before we release the serial port,
          * since releasing the port clears the Tx buffer.
@@ -1830,6 +2240,12 @@ void blackboxInit(void)
     } else {
         blackboxPInterval = blackboxIInterval /  blackboxConfig()->p_ratio;
     }
+#ifdef USE_BLACKBOX_STREAM
+    // Listen from boot so the capture tool can attach before the log starts
+    if (blackboxConfig()->device == BLACKBOX_DEVICE_STREAM) {
+        blackboxStreamInit();
+    }
+#endif
     if (blackboxConfig()->device) {
         blackboxSetState(BLACKBOX_STATE_STOPPED);
     } else {
@@ -33,15 +33,30 @@ typedef enum BlackboxDevice {
 #ifdef USE_SDCARD
     BLACKBOX_DEVICE_SDCARD = 2,
 #endif
-    BLACKBOX_DEVICE_SERIAL = 3
+    BLACKBOX_DEVICE_SERIAL = 3,
+#ifdef USE_BLACKBOX_STREAM
+    BLACKBOX_DEVICE_STREAM = 4,
+#endif
 } BlackboxDevice_e;
 
 typedef enum BlackboxMode {
     BLACKBOX_MODE_NORMAL = 0,
     BLACKBOX_MODE_MOTOR_TEST,
-    BLACKBOX_MODE_ALWAYS_ON
+    BLACKBOX_MODE_ALWAYS_ON,
+#ifdef USE_BLACKBOX_CAPTURE
+    BLACKBOX_MODE_TRIGGERED,        // frames go to RAM, only those around a crash, failsafe or the switch are kept
+#endif
 } BlackboxMode;
 
+// P-frame predictors the config can pick for a field group
+typedef enum BlackboxPredictor {
+    BLACKBOX_PREDICTOR_AVERAGE = 0,
+    BLACKBOX_PREDICTOR_STRAIGHT_LINE,
+    BLACKBOX_PREDICTOR_SECOND_ORDER,
+    BLACKBOX_PREDICTOR_MOTOR_0,     // motors only
+    BLACKBOX_PREDICTOR_COUNT
+} BlackboxPredictor_e;
+
 typedef enum FlightLogEvent {
     FLIGHT_LOG_EVENT_SYNC_BEEP = 0,
     FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT = 13,
@@ -55,6 +70,13 @@ typedef struct blackboxConfig_s {
     uint8_t device;
     uint8_t record_acc;
     uint8_t mode;
+    uint8_t gyro_predictor;         // BlackboxPredictor_e for gyroADC in P-frames
+    uint8_t motor_predictor;        // BlackboxPredictor_e for motor in P-frames
+    uint8_t compression;            // BlackboxCompression_e, for flash and SD card logs
+    uint8_t pid_ratio;              // P-frames per PID field group frame, 1 logs the group in the main frames
+    uint8_t rc_ratio;               // P-frames per rcCommand/setpoint field group frame
+    uint16_t trigger_pre_ms;        // history kept in front of a trigger in BLACKBOX_MODE_TRIGGERED, at most what the ring holds
+    uint16_t trigger_post_ms;       // and frames kept after it ends
 } blackboxConfig_t;
 
 PG_DECLARE(blackboxConfig_t, blackboxConfig);
@@ -78,6 +100,8 @@ STATIC_UNIT_TESTED bool blackboxShouldLogGpsHomeFrame(void);
 STATIC_UNIT_TESTED bool writeSlowFrameIfNeeded(void);
 // Called once every FC loop in order to keep track of how many FC loop iterations have passed
 STATIC_UNIT_TESTED void blackboxAdvanceIterationTimers(void);
+STATIC_UNIT_TESTED uint8_t blackboxFieldPredictor(uint8_t predictor);
+STATIC_UNIT_TESTED uint8_t blackboxMainFieldPPredictor(int fieldIndex);
 extern int32_t blackboxSInterval;
 extern int32_t blackboxSlowFrameIterationTimer;
 #endif
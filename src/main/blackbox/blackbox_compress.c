@@ -0,0 +1,112 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifdef USE_HUFFMAN
+
+#include "blackbox_compress.h"
+
+#include "common/crc.h"
+#include "common/huffman.h"
+
+#define HUFFMAN_EOF 256
+
+// Erased flash reads as 0xFF and a run of zero codes packs into 0xFF bytes too, so the marker mixes both
+const uint8_t blackboxCompressionSync[BLACKBOX_COMPRESSION_SYNC_SIZE] = { 0xB1, 0xAC, 0x0B, 0x7E };
+
+void blackboxCompressInit(blackboxCompressor_t *compressor)
+{
+    memset(compressor, 0, sizeof(*compressor));
+}
+
+static uint8_t *putCode(blackboxCompressor_t *compressor, uint8_t *out, int symbol)
+{
+    const int codeLen = huffmanTable[symbol].codeLen;
+
+    // Table codes are left aligned in 16 bits, at most 7 bits are pending so this fits easily
+    compressor->bits = (compressor->bits << codeLen) | (huffmanTable[symbol].code >> (16 - codeLen));
+    compressor->bitCount += codeLen;
+
+    while (compressor->bitCount >= 8) {
+        compressor->bitCount -= 8;
+        *out++ = compressor->bits >> compressor->bitCount;
+    }
+
+    return out;
+}
+
+/**
+ * Close the open block, if any, into `out`. Returns the number of bytes written.
+ */
+int blackboxCompressEndBlock(blackboxCompressor_t *compressor, uint8_t *out)
+{
+    if (!compressor->blockOpen) {
+        return 0;
+    }
+
+    uint8_t *pos = putCode(compressor, out, HUFFMAN_EOF);
+    if (compressor->bitCount > 0) {
+        *pos++ = compressor->bits << (8 - compressor->bitCount);
+    }
+    *pos++ = compressor->crc;
+
+    blackboxCompressInit(compressor);
+
+    return pos - out;
+}
+
+/**
+ * Compress `length` bytes of `data` into `out`, which has to hold BLACKBOX_COMPRESSED_SIZE_MAX(length) bytes.
+ * Returns the number of bytes written, the last partial byte is kept until the next call.
+ */
+int blackboxCompress(blackboxCompressor_t *compressor, uint8_t *out, const uint8_t *data, int length)
+{
+    uint8_t *pos = out;
+
+    if (length <= 0) {
+        return 0;
+    }
+
+    if (!compressor->blockOpen) {
+        memcpy(pos, blackboxCompressionSync, BLACKBOX_COMPRESSION_SYNC_SIZE);
+        pos += BLACKBOX_COMPRESSION_SYNC_SIZE;
+        compressor->blockOpen = true;
+    }
+
+    for (int i = 0; i < length; i++) {
+        pos = putCode(compressor, pos, data[i]);
+    }
+
+    compressor->crc = crc8_dvb_s2_update(compressor->crc, data, length);
+    compressor->blockLength += length;
+
+    if (compressor->blockLength >= BLACKBOX_COMPRESSION_BLOCK_SIZE) {
+        pos += blackboxCompressEndBlock(compressor, pos);
+    }
+
+    return pos - out;
+}
+
+#endif // USE_HUFFMAN
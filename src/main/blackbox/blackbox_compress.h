@@ -0,0 +1,63 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Compressed blackbox stream, the encoded frames are coded with the static table of common/huffman_table.c.
+ *
+ * The stream is cut into self contained blocks so a log survives a write that was cut short:
+ *
+ *     sync (4 bytes) | huffman codes of the raw bytes | EOF code | zero bits up to a byte | crc8 of the raw bytes
+ *
+ * Codes are packed MSB first. A block is closed at the first write that takes it past
+ * BLACKBOX_COMPRESSION_BLOCK_SIZE raw bytes, and at the end of the log. Bytes outside of blocks are plain
+ * log data, so a reader can handle compressed and uncompressed logs alike.
+ */
+
+typedef enum {
+    BLACKBOX_COMPRESSION_NONE = 0,
+    BLACKBOX_COMPRESSION_HUFFMAN
+} BlackboxCompression_e;
+
+#define BLACKBOX_COMPRESSION_SYNC_SIZE      4
+#define BLACKBOX_COMPRESSION_BLOCK_SIZE     2048
+#define BLACKBOX_COMPRESSION_MAX_CODE_LEN   12
+
+// Most bytes blackboxCompress() can produce from `length` raw bytes, sync and block end included
+#define BLACKBOX_COMPRESSED_SIZE_MAX(length) \
+    (BLACKBOX_COMPRESSION_SYNC_SIZE + (((length) + 1) * BLACKBOX_COMPRESSION_MAX_CODE_LEN + 7) / 8 + 2)
+
+extern const uint8_t blackboxCompressionSync[BLACKBOX_COMPRESSION_SYNC_SIZE];
+
+typedef struct blackboxCompressor_s {
+    uint32_t bits;          // codes not yet written out, right aligned
+    uint8_t bitCount;       // less than 8 between calls
+    uint8_t crc;
+    uint16_t blockLength;   // raw bytes in the open block
+    bool blockOpen;
+} blackboxCompressor_t;
+
+void blackboxCompressInit(blackboxCompressor_t *compressor);
+int blackboxCompress(blackboxCompressor_t *compressor, uint8_t *out, const uint8_t *data, int length);
+int blackboxCompressEndBlock(blackboxCompressor_t *compressor, uint8_t *out);
@@ -0,0 +1,177 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "blackbox_compress.h"
+#include "blackbox_decompress.h"
+
+#include "common/crc.h"
+#include "common/huffman.h"
+
+#define HUFFMAN_EOF 256
+#define ERASED_BYTE 0xFF
+
+typedef struct decodeEntry_s {
+    uint16_t symbol;
+    uint8_t codeLen;    // 0 for bit patterns no code starts with
+} decodeEntry_t;
+
+// Indexed by the next BLACKBOX_COMPRESSION_MAX_CODE_LEN bits of the stream
+static decodeEntry_t decodeTable[1 << BLACKBOX_COMPRESSION_MAX_CODE_LEN];
+static bool decodeTableBuilt;
+
+typedef enum {
+    BLOCK_OK,
+    BLOCK_BAD_CRC,
+    BLOCK_TRUNCATED
+} blockStatus_e;
+
+static void buildDecodeTable(void)
+{
+    for (int symbol = 0; symbol < HUFFMAN_TABLE_SIZE; symbol++) {
+        const int codeLen = huffmanTable[symbol].codeLen;
+        const int first = huffmanTable[symbol].code >> (16 - BLACKBOX_COMPRESSION_MAX_CODE_LEN);
+        const int count = 1 << (BLACKBOX_COMPRESSION_MAX_CODE_LEN - codeLen);
+
+        for (int i = first; i < first + count; i++) {
+            decodeTable[i].symbol = symbol;
+            decodeTable[i].codeLen = codeLen;
+        }
+    }
+    decodeTableBuilt = true;
+}
+
+static bool isSync(const uint8_t *data, int remaining)
+{
+    return remaining >= BLACKBOX_COMPRESSION_SYNC_SIZE && memcmp(data, blackboxCompressionSync, BLACKBOX_COMPRESSION_SYNC_SIZE) == 0;
+}
+
+static int findSync(const uint8_t *data, int start, int length)
+{
+    for (int i = start; i < length; i++) {
+        if (isSync(&data[i], length - i)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+/*
+ * Decode the block body in data[0..length), stopping at the EOF code or when the input runs out.
+ * *outLength is what was decoded either way, *consumed the block length including its crc.
+ */
+static blockStatus_e decodeBlock(const uint8_t *data, int length, uint8_t *out, int *outLength, int *consumed)
+{
+    uint32_t window = 0;
+    int bits = 0;
+    int index = 0;
+    int written = 0;
+
+    while (true) {
+        while (bits < BLACKBOX_COMPRESSION_MAX_CODE_LEN && index < length) {
+            window = (window << 8) | data[index++];
+            bits += 8;
+        }
+
+        // Near the end of the input the peek runs past it, the zero bits only match if a code fits in what's left
+        const int peek = bits >= BLACKBOX_COMPRESSION_MAX_CODE_LEN
+            ? (window >> (bits - BLACKBOX_COMPRESSION_MAX_CODE_LEN)) & ((1 << BLACKBOX_COMPRESSION_MAX_CODE_LEN) - 1)
+            : (window << (BLACKBOX_COMPRESSION_MAX_CODE_LEN - bits)) & ((1 << BLACKBOX_COMPRESSION_MAX_CODE_LEN) - 1);
+        const decodeEntry_t entry = decodeTable[peek];
+
+        if (entry.codeLen == 0 || entry.codeLen > bits) {
+            *outLength = written;
+            *consumed = index;
+            return BLOCK_TRUNCATED;
+        }
+
+        bits -= entry.codeLen;
+        window &= (1 << bits) - 1;
+
+        if (entry.symbol == HUFFMAN_EOF) {
+            break;
+        }
+        out[written++] = entry.symbol;
+    }
+
+    // The rest of the current byte is padding, whole bytes still in the window belong to what follows
+    const int crcIndex = index - bits / 8;
+
+    *outLength = written;
+    if (crcIndex >= length) {
+        *consumed = length;
+        return BLOCK_TRUNCATED;
+    }
+    *consumed = crcIndex + 1;
+
+    return crc8_dvb_s2_update(0, out, written) == data[crcIndex] ? BLOCK_OK : BLOCK_BAD_CRC;
+}
+
+int blackboxDecompress(uint8_t *out, const uint8_t *data, int length, blackboxDecompressStats_t *stats)
+{
+    int pos = 0;
+    int written = 0;
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (!decodeTableBuilt) {
+        buildDecodeTable();
+    }
+
+    while (pos < length) {
+        if (!isSync(&data[pos], length - pos)) {
+            out[written++] = data[pos++];
+            stats->plainBytes++;
+            continue;
+        }
+
+        const int bodyStart = pos + BLACKBOX_COMPRESSION_SYNC_SIZE;
+        int decoded;
+        int consumed;
+
+        if (decodeBlock(&data[bodyStart], length - bodyStart, &out[written], &decoded, &consumed) == BLOCK_OK) {
+            written += decoded;
+            pos = bodyStart + consumed;
+            stats->blocks++;
+            continue;
+        }
+
+        /*
+         * Keep what can be decoded up to the next block, the log parser resynchronises on the next good frame.
+         * A log cut short by a power loss is followed by erased flash, which would decode as a run of zeros.
+         */
+        const int nextBlock = findSync(data, bodyStart, length);
+        int bodyEnd = nextBlock;
+        while (bodyEnd > bodyStart && data[bodyEnd - 1] == ERASED_BYTE) {
+            bodyEnd--;
+        }
+
+        decodeBlock(&data[bodyStart], bodyEnd - bodyStart, &out[written], &decoded, &consumed);
+        written += decoded;
+        pos = nextBlock;
+        stats->damagedBlocks++;
+    }
+
+    return written;
+}
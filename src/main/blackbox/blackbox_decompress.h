@@ -0,0 +1,42 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Reader for the compressed blackbox stream of blackbox_compress.h. This is host side code for
+ * support/blackbox_decompress and the unit tests, the firmware only ever writes the stream.
+ */
+
+// Every code is at least 2 bits long
+#define BLACKBOX_DECOMPRESSED_SIZE_MAX(length) (4 * (length))
+
+typedef struct blackboxDecompressStats_s {
+    uint32_t blocks;            // blocks that decoded with a matching crc
+    uint32_t damagedBlocks;     // blocks cut short or corrupted, decoded as far as they go
+    uint32_t plainBytes;        // bytes outside of blocks, copied as they are
+} blackboxDecompressStats_t;
+
+// Decode the whole of `data` into `out`, which has to hold BLACKBOX_DECOMPRESSED_SIZE_MAX(length) bytes.
+// Returns the number of bytes written.
+int blackboxDecompress(uint8_t *out, const uint8_t *data, int length, blackboxDecompressStats_t *stats);
@@ -85,17 +85,68 @@ void blackboxPrintfHeaderLine(const char *name, const char *fmt, ...)
     blackboxHeaderBudget -= written + 3;
 }
 
+/*
+ * The encoders below work out the length of their output up front with CLZ and assemble it in a 64 bit word, lowest
+ * byte first, which blackboxWriteWord() stores in one go. The bytes are exactly the ones the original byte at a time
+ * encoders produced.
+ */
+
+// Magnitude of a signed value, fits in as many bits as the value minus its sign bit
+static inline uint32_t signedMagnitude(int32_t value)
+{
+    return (uint32_t)(value ^ (value >> 31));
+}
+
+// Bytes collected for one blackboxWriteWord(), lowest byte first
+typedef struct blackboxAccumulator_s {
+    uint64_t word;
+    int length;
+} blackboxAccumulator_t;
+
+static inline void accumulatorAdd(blackboxAccumulator_t *accumulator, uint64_t word, int length)
+{
+    if (accumulator->length + length > (int)sizeof(accumulator->word)) {
+        blackboxWriteWord(accumulator->word, accumulator->length);
+        accumulator->word = 0;
+        accumulator->length = 0;
+    }
+    accumulator->word |= word << (8 * accumulator->length);
+    accumulator->length += length;
+}
+
+static inline void accumulatorFlush(blackboxAccumulator_t *accumulator)
+{
+    if (accumulator->length > 0) {
+        blackboxWriteWord(accumulator->word, accumulator->length);
+    }
+}
+
+// Variable byte encoding of value, returns the encoded bytes and their count in length
+static inline uint64_t encodeUnsignedVB(uint32_t value, int *length)
+{
+    // 7 bits per byte, so 1 to 5 bytes
+    *length = (32 - __builtin_clz(value | 1) + 6) / 7;
+
+    const uint64_t v = value;
+    const uint64_t word = (v & 0x7F) | ((v << 1) & 0x7F00) | ((v << 2) & 0x7F0000) | ((v << 3) & 0x7F000000) | ((v << 4) & 0x7F00000000);
+    // Set the high bit of every byte but the last to mean "more bytes follow"
+    return word | (0x8080808080 & ((1ULL << (8 * (*length - 1))) - 1));
+}
+
+static inline uint64_t encodeSignedVB(int32_t value, int *length)
+{
+    //ZigZag encode to make the value always positive
+    return encodeUnsignedVB((uint32_t)((value << 1) ^ (value >> 31)), length);
+}
+
 /**
  * Write an unsigned integer to the blackbox serial port using variable byte encoding.
  */
 void blackboxWriteUnsignedVB(uint32_t value)
 {
-    //While this isn't the final byte (we can only write 7 bits at a time)
-    while (value > 127) {
-        blackboxWrite((uint8_t) (value | 0x80)); // Set the high bit to mean "more bytes follow"
-        value >>= 7;
-    }
-    blackboxWrite(value);
+    int length;
+    const uint64_t word = encodeUnsignedVB(value, &length);
+    blackboxWriteWord(word, length);
 }
 
 /**
@@ -103,22 +154,31 @@ void blackboxWriteUnsignedVB(uint32_t value)
  */
 void blackboxWriteSignedVB(int32_t value)
 {
-    //ZigZag encode to make the value always positive
-    blackboxWriteUnsignedVB(zigzagEncode(value));
+    int length;
+    const uint64_t word = encodeSignedVB(value, &length);
+    blackboxWriteWord(word, length);
 }
 
 void blackboxWriteSignedVBArray(int32_t *array, int count)
 {
+    blackboxAccumulator_t accumulator = { 0, 0 };
     for (int i = 0; i < count; i++) {
-        blackboxWriteSignedVB(array[i]);
+        int length;
+        const uint64_t word = encodeSignedVB(array[i], &length);
+        accumulatorAdd(&accumulator, word, length);
     }
+    accumulatorFlush(&accumulator);
 }
 
 void blackboxWriteSigned16VBArray(int16_t *array, int count)
 {
+    blackboxAccumulator_t accumulator = { 0, 0 };
     for (int i = 0; i < count; i++) {
-        blackboxWriteSignedVB(array[i]);
+        int length;
+        const uint64_t word = encodeSignedVB(array[i], &length);
+        accumulatorAdd(&accumulator, word, length);
     }
+    accumulatorFlush(&accumulator);
 }
 
 void blackboxWriteS16(int16_t value)
@@ -142,15 +202,6 @@ void blackboxWriteTag2_3S32(int32_t *values)
         BITS_32 = 3
     };
 
-    enum {
-        BYTES_1  = 0,
-        BYTES_2  = 1,
-        BYTES_3  = 2,
-        BYTES_4  = 3
-    };
-
-    int selector = BITS_2, selector2;
-
     /*
      * Find out how many bits the largest value requires to encode, and use it to choose one of the packing schemes
      * below:
@@ -162,90 +213,44 @@ void blackboxWriteTag2_3S32(int32_t *values)
      * 6 bits per field  ss11 1111 0022 2222 0033 3333
      * 32 bits per field sstt tttt followed by fields of various byte counts
      */
-    for (int x = 0; x < NUM_FIELDS; x++) {
-        //Require more than 6 bits?
-        if (values[x] >= 32 || values[x] < -32) {
-            selector = BITS_32;
-            break;
-        }
-
-        //Require more than 4 bits?
-        if (values[x] >= 8 || values[x] < -8) {
-             if (selector < BITS_6) {
-                 selector = BITS_6;
-             }
-        } else if (values[x] >= 2 || values[x] < -2) { //Require more than 2 bits?
-            if (selector < BITS_4) {
-                selector = BITS_4;
-            }
-        }
-    }
+    const uint32_t magnitude = signedMagnitude(values[0]) | signedMagnitude(values[1]) | signedMagnitude(values[2]);
+    const int selector = (magnitude >= 2) + (magnitude >= 8) + (magnitude >= 32);
 
     switch (selector) {
     case BITS_2:
         blackboxWrite((selector << 6) | ((values[0] & 0x03) << 4) | ((values[1] & 0x03) << 2) | (values[2] & 0x03));
         break;
     case BITS_4:
-        blackboxWrite((selector << 6) | (values[0] & 0x0F));
-        blackboxWrite((values[1] << 4) | (values[2] & 0x0F));
+        blackboxWriteWord((selector << 6) | (values[0] & 0x0F)
+            | (((values[1] & 0x0F) << 4 | (values[2] & 0x0F)) << 8), 2);
         break;
     case BITS_6:
-        blackboxWrite((selector << 6) | (values[0] & 0x3F));
-        blackboxWrite((uint8_t)values[1]);
-        blackboxWrite((uint8_t)values[2]);
+        blackboxWriteWord((selector << 6) | (values[0] & 0x3F)
+            | (values[1] & 0xFF) << 8 | (values[2] & 0xFF) << 16, 3);
         break;
     case BITS_32:
-        /*
-         * Do another round to compute a selector for each field, assuming that they are at least 8 bits each
-         *
-         * Selector2 field possibilities
-         * 0 - 8 bits
-         * 1 - 16 bits
-         * 2 - 24 bits
-         * 3 - 32 bits
-         */
-        selector2 = 0;
-
-        //Encode in reverse order so the first field is in the low bits:
-        for (int x = NUM_FIELDS - 1; x >= 0; x--) {
-            selector2 <<= 2;
-
-            if (values[x] < 128 && values[x] >= -128) {
-                selector2 |= BYTES_1;
-            } else if (values[x] < 32768 && values[x] >= -32768) {
-                selector2 |= BYTES_2;
-            } else if (values[x] < 8388608 && values[x] >= -8388608) {
-                selector2 |= BYTES_3;
-            } else {
-                selector2 |= BYTES_4;
+        {
+            /*
+             * Pick the number of bytes for each field, assuming that they are at least 8 bits each
+             *
+             * Selector2 field possibilities
+             * 0 - 8 bits
+             * 1 - 16 bits
+             * 2 - 24 bits
+             * 3 - 32 bits
+             */
+            int bytes[3];
+            int selector2 = 0;
+            //Encode in reverse order so the first field is in the low bits:
+            for (int x = NUM_FIELDS - 1; x >= 0; x--) {
+                bytes[x] = (40 - __builtin_clz(signedMagnitude(values[x]) | 1)) / 8;
+                selector2 = (selector2 << 2) | (bytes[x] - 1);
             }
-        }
-
-        //Write the selectors
-        blackboxWrite((selector << 6) | selector2);
 
-        //And now the values according to the selectors we picked for them
-        for (int x = 0; x < NUM_FIELDS; x++, selector2 >>= 2) {
-            switch (selector2 & 0x03) {
-            case BYTES_1:
-                blackboxWrite(values[x]);
-                break;
-            case BYTES_2:
-                blackboxWrite(values[x]);
-                blackboxWrite(values[x] >> 8);
-                break;
-            case BYTES_3:
-                blackboxWrite(values[x]);
-                blackboxWrite(values[x] >> 8);
-                blackboxWrite(values[x] >> 16);
-                break;
-            case BYTES_4:
-                blackboxWrite(values[x]);
-                blackboxWrite(values[x] >> 8);
-                blackboxWrite(values[x] >> 16);
-                blackboxWrite(values[x] >> 24);
-                break;
-            }
+            //Write the selectors together with the first field, then the remaining fields
+            blackboxWriteWord((selector << 6) | selector2 | (uint64_t)(uint32_t)values[0] << 8, 1 + bytes[0]);
+            blackboxWriteWord((uint32_t)values[1], bytes[1]);
+            blackboxWriteWord((uint32_t)values[2], bytes[2]);
         }
         break;
     }
@@ -379,79 +384,30 @@ int blackboxWriteTag2_3SVariable(int32_t *values)
  */
 void blackboxWriteTag8_4S16(int32_t *values)
 {
-
-    //Need to be enums rather than const ints if we want to switch on them (due to being C)
-    enum {
-        FIELD_ZERO  = 0,
-        FIELD_4BIT  = 1,
-        FIELD_8BIT  = 2,
-        FIELD_16BIT = 3
-    };
+    // Field sizes in bits for the field selectors FIELD_ZERO, FIELD_4BIT, FIELD_8BIT and FIELD_16BIT
+    static const uint8_t fieldBits[4] = { 0, 4, 8, 16 };
 
     uint8_t selector = 0;
-    //Encode in reverse order so the first field is in the low bits:
-    for (int x = 3; x >= 0; x--) {
-        selector <<= 2;
-
-        if (values[x] == 0) {
-            selector |= FIELD_ZERO;
-        } else if (values[x] < 8 && values[x] >= -8) {
-            selector |= FIELD_4BIT;
-        } else if (values[x] < 128 && values[x] >= -128) {
-            selector |= FIELD_8BIT;
-        } else {
-            selector |= FIELD_16BIT;
-        }
+    // The fields form one bit stream, high bits first, so they're shifted into the bottom of the accumulator
+    uint64_t fields = 0;
+    int bitCount = 0;
+    for (int x = 0; x < 4; x++) {
+        const uint32_t magnitude = signedMagnitude(values[x]);
+        const int field = (values[x] != 0) + (magnitude >= 8) + (magnitude >= 128);
+        const int bits = fieldBits[field];
+
+        //First field is in the low bits of the selector
+        selector |= field << (2 * x);
+        fields = (fields << bits) | ((uint32_t)values[x] & ((1U << bits) - 1));
+        bitCount += bits;
     }
 
     blackboxWrite(selector);
 
-    int nibbleIndex = 0;
-    uint8_t buffer = 0;
-    for (int x = 0; x < 4; x++, selector >>= 2) {
-        switch (selector & 0x03) {
-        case FIELD_ZERO:
-            //No-op
-            break;
-        case FIELD_4BIT:
-            if (nibbleIndex == 0) {
-                //We fill high-bits first
-                buffer = values[x] << 4;
-                nibbleIndex = 1;
-            } else {
-                blackboxWrite(buffer | (values[x] & 0x0F));
-                nibbleIndex = 0;
-            }
-            break;
-        case FIELD_8BIT:
-            if (nibbleIndex == 0) {
-                blackboxWrite(values[x]);
-            } else {
-                //Write the high bits of the value first (mask to avoid sign extension)
-                blackboxWrite(buffer | ((values[x] >> 4) & 0x0F));
-                //Now put the leftover low bits into the top of the next buffer entry
-                buffer = values[x] << 4;
-            }
-            break;
-        case FIELD_16BIT:
-            if (nibbleIndex == 0) {
-                //Write high byte first
-                blackboxWrite(values[x] >> 8);
-                blackboxWrite(values[x]);
-            } else {
-                //First write the highest 4 bits
-                blackboxWrite(buffer | ((values[x] >> 12) & 0x0F));
-                // Then the middle 8
-                blackboxWrite(values[x] >> 4);
-                //Only the smallest 4 bits are still left to write
-                buffer = values[x] << 4;
-            }
-            break;
-        }
-    }
-    //Anything left over to write?
-    if (nibbleIndex == 1) {
-        blackboxWrite(buffer);
+    if (bitCount > 0) {
+        // Anything left over is padded with zeros to a whole byte, then the first byte of the stream moves to the bottom
+        const int length = (bitCount + 7) / 8;
+        blackboxWriteWord(__builtin_bswap64(fields << (64 - bitCount)), length);
     }
 }
 
@@ -463,32 +419,26 @@ void blackboxWriteTag8_4S16(int32_t *values)
  */
 void blackboxWriteTag8_8SVB(int32_t *values, int valueCount)
 {
-    uint8_t header;
-
     if (valueCount > 0) {
         //If we're only writing one field then we can skip the header
         if (valueCount == 1) {
             blackboxWriteSignedVB(values[0]);
         } else {
-            //First write a one-byte header that marks which fields are non-zero
-            header = 0;
-
-            // First field should be in low bits of header
-            for (int i = valueCount - 1; i >= 0; i--) {
-                header <<= 1;
-
-                if (values[i] != 0) {
-                    header |= 0x01;
-                }
+            //First write a one-byte header that marks which fields are non-zero, first field in the low bit
+            uint8_t header = 0;
+            for (int i = 0; i < valueCount; i++) {
+                header |= (values[i] != 0) << i;
             }
 
-            blackboxWrite(header);
-
+            blackboxAccumulator_t accumulator = { header, 1 };
             for (int i = 0; i < valueCount; i++) {
                 if (values[i] != 0) {
-                    blackboxWriteSignedVB(values[i]);
+                    int length;
+                    const uint64_t word = encodeSignedVB(values[i], &length);
+                    accumulatorAdd(&accumulator, word, length);
                 }
             }
+            accumulatorFlush(&accumulator);
         }
     }
 }
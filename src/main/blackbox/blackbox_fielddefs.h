@@ -54,6 +54,19 @@ typedef enum FlightLogFieldCondition {
     FLIGHT_LOG_FIELD_CONDITION_LAST = FLIGHT_LOG_FIELD_CONDITION_NEVER
 } FlightLogFieldCondition;
 
+/*
+ * The main fields are split into groups. MAIN is written in every I and P frame, the other groups either go along in
+ * the main frames or, with a ratio above 1 in the config, in frames of their own right after every I frame and every
+ * ratio-th P frame. Those frames take the time of the main frame before them and have intra and inter variants like
+ * I and P, the inter one predicted from the previous frame of the group.
+ */
+typedef enum FlightLogFieldGroup {
+    FLIGHT_LOG_FIELD_GROUP_MAIN = 0,
+    FLIGHT_LOG_FIELD_GROUP_PID,         // axisP, axisI, axisD, axisF in 'J' and 'K' frames
+    FLIGHT_LOG_FIELD_GROUP_RC,          // rcCommand, setpoint in 'R' and 'Q' frames
+    FLIGHT_LOG_FIELD_GROUP_COUNT
+} FlightLogFieldGroup;
+
 typedef enum FlightLogFieldPredictor {
     //No prediction:
     FLIGHT_LOG_FIELD_PREDICTOR_0              = 0,
@@ -89,7 +102,10 @@ typedef enum FlightLogFieldPredictor {
     FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME = 10,
 
     //Predict that this field is the minimum motor output
-    FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR       = 11
+    FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR       = 11,
+
+    //Predict that the second difference of the last three history items carries on (3 * previous - 3 * previous2 + previous3):
+    FLIGHT_LOG_FIELD_PREDICTOR_SECOND_ORDER   = 12
 
 } FlightLogFieldPredictor;
 
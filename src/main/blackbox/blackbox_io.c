@@ -29,9 +29,13 @@
 #ifdef USE_BLACKBOX
 
 #include "blackbox.h"
+#include "blackbox_compress.h"
 #include "blackbox_io.h"
+#include "blackbox_ring.h"
+#include "blackbox_stream.h"
 
 #include "common/maths.h"
+#include "common/utils.h"
 
 #include "flight/pid.h"
 
@@ -56,6 +60,47 @@ int32_t blackboxHeaderBudget;
 static serialPort_t *blackboxPort = NULL;
 static portSharing_e blackboxPortSharing;
 
+// The device is picked once by blackboxDeviceOpen() so the write path doesn't look up the config for every byte
+static BlackboxDevice_e blackboxDevice = BLACKBOX_DEVICE_NONE;
+
+// Frames are encoded into here and handed to the device in one write, see blackboxFrameBegin()
+static struct {
+    uint8_t buffer[BLACKBOX_FRAME_BUFFER_SIZE];
+    int length;
+    bool active;
+} blackboxFrame;
+
+// Serial logs are read by tools that don't know about blocks, only what lands on our own storage is compressed
+#if defined(USE_HUFFMAN) && (defined(USE_FLASHFS) || defined(USE_SDCARD))
+#define USE_BLACKBOX_COMPRESSION
+#endif
+
+#ifdef USE_BLACKBOX_COMPRESSION
+// Raw bytes compressed per device write, keeps the output within what flashfs buffers in one go
+#define BLACKBOX_COMPRESS_CHUNK_SIZE 64
+
+static bool blackboxCompressionEnabled;
+static blackboxCompressor_t blackboxCompressor;
+static uint8_t blackboxCompressBuffer[BLACKBOX_COMPRESSED_SIZE_MAX(BLACKBOX_COMPRESS_CHUNK_SIZE)];
+#endif
+
+#ifdef USE_BLACKBOX_CAPTURE
+// Reserved whatever the blackbox_mode, so targets opt in to USE_BLACKBOX_CAPTURE in target.h. The ring holds
+// BLACKBOX_CAPTURE_BUFFER_SIZE / (log bytes per second) of history, a capture starts at the oldest I-frame held when
+// blackbox_trigger_pre_ms asks for more than that. At 2kHz with about 40 bytes per frame 32kB is 0.4s.
+#ifndef BLACKBOX_CAPTURE_BUFFER_SIZE
+#define BLACKBOX_CAPTURE_BUFFER_SIZE (32 * 1024)
+#endif
+STATIC_ASSERT((BLACKBOX_CAPTURE_BUFFER_SIZE & (BLACKBOX_CAPTURE_BUFFER_SIZE - 1)) == 0, BLACKBOX_CAPTURE_BUFFER_SIZE_not_a_power_of_two);
+
+// Committed history is handed to the device at most this many bytes per loop iteration
+#define BLACKBOX_CAPTURE_DRAIN_MAX 512
+
+static bool blackboxCaptureEnabled;
+static blackboxRing_t blackboxCaptureRing;
+static uint8_t blackboxCaptureBuffer[BLACKBOX_CAPTURE_BUFFER_SIZE];
+#endif
+
 #ifdef USE_SDCARD
 
 static struct {
@@ -87,58 +132,281 @@ void blackboxOpen(void)
     }
 }
 
-void blackboxWrite(uint8_t value)
+static void blackboxDeviceWriteRaw(const uint8_t *data, int length)
 {
-    switch (blackboxConfig()->device) {
+    switch (blackboxDevice) {
 #ifdef USE_FLASHFS
     case BLACKBOX_DEVICE_FLASH:
-        flashfsWriteByte(value); // Write byte asynchronously
+        flashfsWrite(data, length, false); // Write asynchronously
         break;
-#endif
+#endif // USE_FLASHFS
+
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
-        afatfs_fputc(blackboxSDCard.logFile, value);
+        afatfs_fwrite(blackboxSDCard.logFile, data, length); // Ignore failures due to buffers filling up
+        break;
+#endif // USE_SDCARD
+
+    case BLACKBOX_DEVICE_SERIAL:
+        serialWriteBuf(blackboxPort, data, length);
+        break;
+
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        blackboxStreamWrite(data, length);
         break;
 #endif
+
+    default:
+        ;
+    }
+}
+
+static void blackboxDeviceEncode(const uint8_t *data, int length)
+{
+#ifdef USE_BLACKBOX_COMPRESSION
+    if (blackboxCompressionEnabled) {
+        while (length > 0) {
+            const int chunk = MIN(length, BLACKBOX_COMPRESS_CHUNK_SIZE);
+            blackboxDeviceWriteRaw(blackboxCompressBuffer, blackboxCompress(&blackboxCompressor, blackboxCompressBuffer, data, chunk));
+            data += chunk;
+            length -= chunk;
+        }
+        return;
+    }
+#endif
+    blackboxDeviceWriteRaw(data, length);
+}
+
+static void blackboxDeviceWrite(const uint8_t *data, int length)
+{
+#ifdef USE_BLACKBOX_CAPTURE
+    if (blackboxCaptureEnabled) {
+        // Only reaches the device if a trigger commits it, see blackboxCaptureDrain()
+        blackboxRingWrite(&blackboxCaptureRing, data, length);
+        return;
+    }
+#endif
+    blackboxDeviceEncode(data, length);
+}
+
+// How many bytes the device takes right now without dropping any
+static int32_t blackboxDeviceTxBytesFree(void)
+{
+    switch (blackboxDevice) {
     case BLACKBOX_DEVICE_SERIAL:
+        return serialTxBytesFree(blackboxPort);
+#ifdef USE_FLASHFS
+    case BLACKBOX_DEVICE_FLASH:
+        return flashfsGetWriteBufferFreeSpace();
+#endif
+#ifdef USE_SDCARD
+    case BLACKBOX_DEVICE_SDCARD:
+        return afatfs_getFreeBufferSpace();
+#endif
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        return blackboxStreamTxBytesFree();
+#endif
     default:
-        serialWrite(blackboxPort, value);
-        break;
+        return 0;
     }
 }
 
-// Print the null-terminated string 's' to the blackbox device and return the number of bytes written
-int blackboxWriteString(const char *s)
+// How many log bytes can be written to `space` bytes of the device
+static int32_t blackboxDeviceLogBytesFor(int32_t space)
 {
-    int length;
-    const uint8_t *pos;
+#ifdef USE_BLACKBOX_COMPRESSION
+    if (blackboxCompressionEnabled) {
+        // A compressed chunk can come out larger than it went in, and a block adds its sync and end on top
+        return space / (int32_t)sizeof(blackboxCompressBuffer) * BLACKBOX_COMPRESS_CHUNK_SIZE;
+    }
+#endif
+    return space;
+}
 
-    switch (blackboxConfig()->device) {
+#ifdef USE_BLACKBOX_CAPTURE
+// Hand as much of the committed history to the device as it takes
+static void blackboxCaptureDrain(void)
+{
+    int32_t budget = blackboxDeviceLogBytesFor(MIN(blackboxDeviceTxBytesFree(), BLACKBOX_CAPTURE_DRAIN_MAX));
+
+    const uint8_t *data;
+    uint32_t length;
+    while (budget > 0 && (length = blackboxRingPeek(&blackboxCaptureRing, &data)) > 0) {
+        length = MIN(length, (uint32_t)budget);
+        blackboxDeviceEncode(data, length);
+        blackboxRingConsume(&blackboxCaptureRing, length);
+        budget -= length;
+    }
+}
+
+/**
+ * Send the frames from here on to the RAM ring, the device only gets what blackboxCaptureTrigger() commits.
+ */
+void blackboxCaptureStart(void)
+{
+    blackboxRingInit(&blackboxCaptureRing, blackboxCaptureBuffer, sizeof(blackboxCaptureBuffer));
+    blackboxCaptureEnabled = true;
+}
+
+/**
+ * Call just before an I-frame is encoded. Returns true if the decoder should be told where the I-frame is, because
+ * the device may not get what came before it.
+ */
+bool blackboxCaptureKeyframe(timeUs_t currentTimeUs)
+{
+    return blackboxCaptureEnabled && blackboxRingKeyframe(&blackboxCaptureRing, currentTimeUs);
+}
+
+/**
+ * Commit the frames from `since` on, and all that follow until blackboxCaptureRelease().
+ */
+void blackboxCaptureTrigger(timeUs_t since)
+{
+    if (blackboxCaptureEnabled) {
+        blackboxRingCommit(&blackboxCaptureRing, since);
+    }
+}
+
+void blackboxCaptureRelease(void)
+{
+    blackboxRingRelease(&blackboxCaptureRing);
+}
+
+bool blackboxCaptureIsLive(void)
+{
+    return blackboxCaptureEnabled && blackboxRingIsLive(&blackboxCaptureRing);
+}
+
+/**
+ * Call before the end of the log is written. A capture in progress is carried on up to the end of the log, history
+ * nobody committed is thrown away.
+ */
+void blackboxCaptureFinish(void)
+{
+    if (blackboxRingIsLive(&blackboxCaptureRing) || blackboxRingPending(&blackboxCaptureRing)) {
+        blackboxRingCommit(&blackboxCaptureRing, 0);
+        // The end of log event that follows must not be dropped along with frames a decoder would skip anyway
+        blackboxRingStopDropping(&blackboxCaptureRing);
+    } else {
+        blackboxCaptureEnabled = false;
+    }
+}
+
+// Committed bytes the device hasn't taken yet
+uint32_t blackboxCapturePending(void)
+{
+    return blackboxRingPending(&blackboxCaptureRing);
+}
+#endif // USE_BLACKBOX_CAPTURE
+
+static void blackboxFrameFlush(void)
+{
+    if (blackboxFrame.length > 0) {
+        blackboxDeviceWrite(blackboxFrame.buffer, blackboxFrame.length);
+        blackboxFrame.length = 0;
+    }
+}
+
+/**
+ * Start encoding a frame. Until blackboxFrameEnd() is called, bytes from blackboxWrite() and blackboxWriteString()
+ * are collected in RAM and written to the device in one go, frames longer than BLACKBOX_FRAME_BUFFER_SIZE are
+ * written in chunks of that size.
+ */
+void blackboxFrameBegin(void)
+{
+    blackboxFrame.length = 0;
+    blackboxFrame.active = true;
+}
+
+/**
+ * Hand the frame encoded since blackboxFrameBegin() over to the device.
+ */
+void blackboxFrameEnd(void)
+{
+    blackboxFrameFlush();
+    blackboxFrame.active = false;
+}
+
+void blackboxWrite(uint8_t value)
+{
+    if (blackboxFrame.active) {
+        if (blackboxFrame.length == BLACKBOX_FRAME_BUFFER_SIZE) {
+            blackboxFrameFlush();
+        }
+        blackboxFrame.buffer[blackboxFrame.length++] = value;
+        return;
+    }
+
+#ifdef USE_BLACKBOX_CAPTURE
+    if (blackboxCaptureEnabled) {
+        blackboxDeviceWrite(&value, 1);
+        return;
+    }
+#endif
+#ifdef USE_BLACKBOX_COMPRESSION
+    if (blackboxCompressionEnabled) {
+        blackboxDeviceWrite(&value, 1);
+        return;
+    }
+#endif
 
+    switch (blackboxDevice) {
 #ifdef USE_FLASHFS
     case BLACKBOX_DEVICE_FLASH:
-        length = strlen(s);
-        flashfsWrite((const uint8_t*) s, length, false); // Write asynchronously
+        flashfsWriteByte(value); // Write byte asynchronously
         break;
-#endif // USE_FLASHFS
-
+#endif
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
-        length = strlen(s);
-        afatfs_fwrite(blackboxSDCard.logFile, (const uint8_t*) s, length); // Ignore failures due to buffers filling up
+        afatfs_fputc(blackboxSDCard.logFile, value);
         break;
-#endif // USE_SDCARD
-
+#endif
     case BLACKBOX_DEVICE_SERIAL:
+        serialWrite(blackboxPort, value);
+        break;
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        blackboxStreamWrite(&value, 1);
+        break;
+#endif
     default:
-        pos = (uint8_t*) s;
-        while (*pos) {
-            serialWrite(blackboxPort, *pos);
-            pos++;
-        }
+        ;
+    }
+}
 
-        length = pos - (uint8_t*) s;
-        break;
+/**
+ * Write the lowest `length` bytes of `word` (at most 8), lowest byte first.
+ */
+void blackboxWriteWord(uint64_t word, int length)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (blackboxFrame.active && blackboxFrame.length <= BLACKBOX_FRAME_BUFFER_SIZE - (int)sizeof(word)) {
+        // Store the whole word, the bytes past `length` are overwritten by whatever comes next
+        memcpy(&blackboxFrame.buffer[blackboxFrame.length], &word, sizeof(word));
+        blackboxFrame.length += length;
+        return;
+    }
+#endif
+
+    for (; length > 0; length--) {
+        blackboxWrite(word);
+        word >>= 8;
+    }
+}
+
+// Print the null-terminated string 's' to the blackbox device and return the number of bytes written
+int blackboxWriteString(const char *s)
+{
+    const int length = strlen(s);
+
+    if (blackboxFrame.active) {
+        for (int i = 0; i < length; i++) {
+            blackboxWrite(s[i]);
+        }
+    } else {
+        blackboxDeviceWrite((const uint8_t*) s, length);
     }
 
     return length;
@@ -151,17 +419,28 @@ int blackboxWriteString(const char *s)
  */
 void blackboxDeviceFlush(void)
 {
-    switch (blackboxConfig()->device) {
+#ifdef USE_BLACKBOX_CAPTURE
+    blackboxCaptureDrain();
+#endif
+
+    switch (blackboxDevice) {
 #ifdef USE_FLASHFS
         /*
          * This is our only output device which requires us to call flush() in order for it to write anything. The other
          * devices will progressively write in the background without Blackbox calling anything.
          */
     case BLACKBOX_DEVICE_FLASH:
-        flashfsFlushAsync();
+        flashfsFlushAsync(false);
         break;
 #endif // USE_FLASHFS
 
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        // Chunks go out as they fill up, this only sends a part filled one that has waited too long
+        blackboxStreamFlush(false);
+        break;
+#endif
+
     default:
         ;
     }
@@ -174,14 +453,22 @@ void blackboxDeviceFlush(void)
  */
 bool blackboxDeviceFlushForce(void)
 {
-    switch (blackboxConfig()->device) {
+#ifdef USE_BLACKBOX_CAPTURE
+    if (blackboxRingPending(&blackboxCaptureRing)) {
+        // Not done before the committed history is out of the ring
+        blackboxDeviceFlush();
+        return false;
+    }
+#endif
+
+    switch (blackboxDevice) {
     case BLACKBOX_DEVICE_SERIAL:
         // Nothing to speed up flushing on serial, as serial is continuously being drained out of its buffer
         return isSerialTransmitBufferEmpty(blackboxPort);
 
 #ifdef USE_FLASHFS
     case BLACKBOX_DEVICE_FLASH:
-        return flashfsFlushAsync();
+        return flashfsFlushAsync(true);
 #endif // USE_FLASHFS
 
 #ifdef USE_SDCARD
@@ -192,6 +479,13 @@ bool blackboxDeviceFlushForce(void)
         return afatfs_flush();
 #endif // USE_SDCARD
 
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        // Whatever the transport doesn't take is counted as dropped, so there's nothing to wait for
+        blackboxStreamFlush(true);
+        return true;
+#endif
+
     default:
         return false;
     }
@@ -202,7 +496,30 @@ bool blackboxDeviceFlushForce(void)
  */
 bool blackboxDeviceOpen(void)
 {
-    switch (blackboxConfig()->device) {
+    blackboxDevice = blackboxConfig()->device;
+    blackboxFrame.active = false;
+#ifdef USE_BLACKBOX_CAPTURE
+    blackboxCaptureEnabled = false;
+    blackboxRingInit(&blackboxCaptureRing, blackboxCaptureBuffer, sizeof(blackboxCaptureBuffer));
+#endif
+
+#ifdef USE_BLACKBOX_COMPRESSION
+    switch (blackboxDevice) {
+#ifdef USE_FLASHFS
+    case BLACKBOX_DEVICE_FLASH:
+#endif
+#ifdef USE_SDCARD
+    case BLACKBOX_DEVICE_SDCARD:
+#endif
+        blackboxCompressionEnabled = blackboxConfig()->compression == BLACKBOX_COMPRESSION_HUFFMAN;
+        break;
+    default:
+        blackboxCompressionEnabled = false;
+    }
+    blackboxCompressInit(&blackboxCompressor);
+#endif
+
+    switch (blackboxDevice) {
     case BLACKBOX_DEVICE_SERIAL:
         {
             serialPortConfig_t *portConfig = findSerialPortConfig(FUNCTION_BLACKBOX);
@@ -283,6 +600,13 @@ bool blackboxDeviceOpen(void)
         return true;
         break;
 #endif // USE_SDCARD
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        blackboxMaxHeaderBytesPerIteration = BLACKBOX_TARGET_HEADER_BUDGET_PER_ITERATION;
+
+        return blackboxStreamOpen();
+        break;
+#endif
     default:
         return false;
     }
@@ -326,7 +650,11 @@ bool isBlackboxErased(void)
  */
 void blackboxDeviceClose(void)
 {
-    switch (blackboxConfig()->device) {
+#ifdef USE_BLACKBOX_CAPTURE
+    blackboxCaptureEnabled = false;
+#endif
+
+    switch (blackboxDevice) {
     case BLACKBOX_DEVICE_SERIAL:
         // Can immediately close without attempting to flush any remaining data.
         // Since the serial port could be shared with other processes, we have to give it back here
@@ -477,11 +805,20 @@ static bool blackboxSDCardBeginLog(void)
  */
 bool blackboxDeviceBeginLog(void)
 {
-    switch (blackboxConfig()->device) {
+    switch (blackboxDevice) {
+#ifdef USE_FLASHFS
+    case BLACKBOX_DEVICE_FLASH:
+        return flashfsBeginLog();
+#endif // USE_FLASHFS
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
         return blackboxSDCardBeginLog();
 #endif // USE_SDCARD
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        blackboxStreamBeginLog();
+        return true;
+#endif
     default:
         return true;
     }
@@ -501,7 +838,14 @@ bool blackboxDeviceEndLog(bool retainLog)
     UNUSED(retainLog);
 #endif
 
-    switch (blackboxConfig()->device) {
+#ifdef USE_BLACKBOX_COMPRESSION
+    // Close the last block so the reader can check it, does nothing once the block is closed
+    if (blackboxCompressionEnabled) {
+        blackboxDeviceWriteRaw(blackboxCompressBuffer, blackboxCompressEndBlock(&blackboxCompressor, blackboxCompressBuffer));
+    }
+#endif
+
+    switch (blackboxDevice) {
 #ifdef USE_SDCARD
     case BLACKBOX_DEVICE_SDCARD:
         // Keep retrying until the close operation queues
@@ -516,6 +860,11 @@ bool blackboxDeviceEndLog(bool retainLog)
         }
         return false;
 #endif // USE_SDCARD
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        blackboxStreamEndLog();
+        return true;
+#endif
     default:
         return true;
     }
@@ -558,6 +907,11 @@ bool isBlackboxDeviceWorking(void)
         return flashfsIsReady();
 #endif
 
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        return blackboxStreamIsConnected();
+#endif
+
     default:
         return false;
     }
@@ -577,25 +931,8 @@ unsigned int blackboxGetLogNumber(void)
  */
 void blackboxReplenishHeaderBudget(void)
 {
-    int32_t freeSpace;
+    const int32_t freeSpace = blackboxDeviceLogBytesFor(blackboxDeviceTxBytesFree());
 
-    switch (blackboxConfig()->device) {
-    case BLACKBOX_DEVICE_SERIAL:
-        freeSpace = serialTxBytesFree(blackboxPort);
-        break;
-#ifdef USE_FLASHFS
-    case BLACKBOX_DEVICE_FLASH:
-        freeSpace = flashfsGetWriteBufferFreeSpace();
-        break;
-#endif
-#ifdef USE_SDCARD
-    case BLACKBOX_DEVICE_SDCARD:
-        freeSpace = afatfs_getFreeBufferSpace();
-        break;
-#endif
-    default:
-        freeSpace = 0;
-    }
     blackboxHeaderBudget = MIN(MIN(freeSpace, blackboxHeaderBudget + blackboxMaxHeaderBytesPerIteration), BLACKBOX_MAX_ACCUMULATED_HEADER_BUDGET);
 }
 
@@ -624,7 +961,7 @@ blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(int32_t bytes)
     }
 
     // Handle failure:
-    switch (blackboxConfig()->device) {
+    switch (blackboxDevice) {
     case BLACKBOX_DEVICE_SERIAL:
         /*
          * One byte of the tx buffer isn't available for user data (due to its circular list implementation),
@@ -637,17 +974,17 @@ blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(int32_t bytes)
 
 #ifdef USE_FLASHFS
     case BLACKBOX_DEVICE_FLASH:
-        if (bytes > (int32_t) flashfsGetWriteBufferSize()) {
+        if (bytes > blackboxDeviceLogBytesFor(flashfsGetWriteBufferSize())) {
             return BLACKBOX_RESERVE_PERMANENT_FAILURE;
         }
 
-        if (bytes > (int32_t) flashfsGetWriteBufferFreeSpace()) {
+        if (bytes > blackboxDeviceLogBytesFor(flashfsGetWriteBufferFreeSpace())) {
             /*
              * The write doesn't currently fit in the buffer, so try to make room for it. Our flushing here means
              * that the Blackbox header writing code doesn't have to guess about the best time to ask flashfs to
              * flush, and doesn't stall waiting for a flush that would otherwise not automatically be called.
              */
-            flashfsFlushAsync();
+            flashfsFlushAsync(false);
         }
         return BLACKBOX_RESERVE_TEMPORARY_FAILURE;
 #endif // USE_FLASHFS
@@ -658,6 +995,12 @@ blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(int32_t bytes)
         return BLACKBOX_RESERVE_TEMPORARY_FAILURE;
 #endif // USE_SDCARD
 
+#ifdef USE_BLACKBOX_STREAM
+    case BLACKBOX_DEVICE_STREAM:
+        // Waits for the transport to catch up, the budget is far smaller than what it buffers
+        return BLACKBOX_RESERVE_TEMPORARY_FAILURE;
+#endif
+
     default:
         return BLACKBOX_RESERVE_PERMANENT_FAILURE;
     }
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "common/time.h"
+
 typedef enum {
     BLACKBOX_RESERVE_SUCCESS,
     BLACKBOX_RESERVE_TEMPORARY_FAILURE,
@@ -38,10 +40,19 @@ typedef enum {
  */
 #define BLACKBOX_TARGET_HEADER_BUDGET_PER_ITERATION 64
 
+/*
+ * Frames are encoded into a RAM buffer of this size before they are written to the device. Larger frames still work,
+ * they're written in several pieces.
+ */
+#define BLACKBOX_FRAME_BUFFER_SIZE 256
+
 extern int32_t blackboxHeaderBudget;
 
 void blackboxOpen(void);
+void blackboxFrameBegin(void);
+void blackboxFrameEnd(void);
 void blackboxWrite(uint8_t value);
+void blackboxWriteWord(uint64_t word, int length);
 int blackboxWriteString(const char *s);
 
 void blackboxDeviceFlush(void);
@@ -61,3 +72,13 @@ unsigned int blackboxGetLogNumber(void);
 
 void blackboxReplenishHeaderBudget(void);
 blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(int32_t bytes);
+
+#ifdef USE_BLACKBOX_CAPTURE
+void blackboxCaptureStart(void);
+bool blackboxCaptureKeyframe(timeUs_t currentTimeUs);
+void blackboxCaptureTrigger(timeUs_t since);
+void blackboxCaptureRelease(void);
+bool blackboxCaptureIsLive(void);
+void blackboxCaptureFinish(void);
+uint32_t blackboxCapturePending(void);
+#endif
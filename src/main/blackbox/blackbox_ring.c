@@ -0,0 +1,174 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifdef USE_BLACKBOX_CAPTURE
+
+#include "blackbox_ring.h"
+
+#include "common/maths.h"
+
+void blackboxRingInit(blackboxRing_t *ring, uint8_t *buffer, uint32_t size)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->buffer = buffer;
+    ring->size = size;
+}
+
+static bool blackboxRingHasCommitted(const blackboxRing_t *ring)
+{
+    return ring->live || ring->commitEnd != ring->tail;
+}
+
+/**
+ * Note that the next byte written starts an I-frame encoded at `time`. Returns true if the reader may have lost
+ * what came before it.
+ */
+bool blackboxRingKeyframe(blackboxRing_t *ring, timeUs_t time)
+{
+    blackboxRingKeyframe_t *keyframe = &ring->keyframes[ring->keyframeCount++ & (BLACKBOX_RING_KEYFRAME_COUNT - 1)];
+    keyframe->position = ring->head;
+    keyframe->time = time;
+
+    // Anything that isn't live yet may later be committed from this I-frame on
+    const bool gap = !ring->live || ring->resync;
+    ring->resync = false;
+    return gap;
+}
+
+void blackboxRingWrite(blackboxRing_t *ring, const uint8_t *data, uint32_t length)
+{
+    if (ring->resync) {
+        return;
+    }
+
+    if (blackboxRingHasCommitted(ring)) {
+        if (ring->head + length - ring->tail > ring->size) {
+            // The device can't keep up, what follows is useless to the decoder until the next I-frame
+            if (ring->live) {
+                ring->droppedBytes += length;
+            }
+            ring->resync = true;
+            return;
+        }
+    } else if (ring->head - ring->tail > ring->size) {
+        // Keep the last read position within reach, it is where a capture that follows on from it starts
+        ring->tail = ring->commitEnd = ring->head - ring->size;
+    }
+
+    if (length > ring->size) {
+        ring->resync = true;
+        return;
+    }
+
+    const uint32_t offset = ring->head & (ring->size - 1);
+    const uint32_t first = MIN(length, ring->size - offset);
+    memcpy(&ring->buffer[offset], data, first);
+    memcpy(ring->buffer, data + first, length - first);
+    ring->head += length;
+
+    if (ring->live) {
+        ring->commitEnd = ring->head;
+    }
+}
+
+/**
+ * Take writes again before the next I-frame, for what a reader can make sense of without the frames in front of it.
+ */
+void blackboxRingStopDropping(blackboxRing_t *ring)
+{
+    ring->resync = false;
+}
+
+/**
+ * Commit the history from the oldest I-frame encoded at or after `since` and everything written from now on. A
+ * capture that is still being read out just carries on, so do captures that find nothing overwritten since the last
+ * one ended.
+ */
+void blackboxRingCommit(blackboxRing_t *ring, timeUs_t since)
+{
+    if (ring->live) {
+        return;
+    }
+    ring->live = true;
+
+    if (ring->commitEnd != ring->tail) {
+        ring->commitEnd = ring->head;
+        return;
+    }
+
+    const uint32_t oldest = ring->keyframeCount > BLACKBOX_RING_KEYFRAME_COUNT ? ring->keyframeCount - BLACKBOX_RING_KEYFRAME_COUNT : 0;
+    for (uint32_t i = oldest; i != ring->keyframeCount; i++) {
+        const blackboxRingKeyframe_t *keyframe = &ring->keyframes[i & (BLACKBOX_RING_KEYFRAME_COUNT - 1)];
+        const bool held = ring->head - keyframe->position <= ring->size;
+        const bool unread = keyframe->position - ring->commitEnd <= ring->head - ring->commitEnd;
+
+        if (held && unread && cmpTimeUs(keyframe->time, since) >= 0) {
+            ring->tail = keyframe->position;
+            ring->commitEnd = ring->head;
+            return;
+        }
+    }
+
+    // No I-frame recent enough is held, the capture starts with the next one
+    ring->tail = ring->commitEnd = ring->head;
+    ring->resync = true;
+}
+
+/**
+ * Stop committing new writes, what is committed already is still read out.
+ */
+void blackboxRingRelease(blackboxRing_t *ring)
+{
+    ring->live = false;
+}
+
+bool blackboxRingIsLive(const blackboxRing_t *ring)
+{
+    return ring->live;
+}
+
+uint32_t blackboxRingPending(const blackboxRing_t *ring)
+{
+    return ring->commitEnd - ring->tail;
+}
+
+/**
+ * Point `data` at the oldest committed bytes and return how many of them are contiguous in the buffer.
+ */
+uint32_t blackboxRingPeek(const blackboxRing_t *ring, const uint8_t **data)
+{
+    const uint32_t offset = ring->tail & (ring->size - 1);
+
+    *data = &ring->buffer[offset];
+    return MIN(blackboxRingPending(ring), ring->size - offset);
+}
+
+void blackboxRingConsume(blackboxRing_t *ring, uint32_t length)
+{
+    ring->tail += MIN(length, blackboxRingPending(ring));
+}
+
+#endif // USE_BLACKBOX_CAPTURE
@@ -0,0 +1,70 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/time.h"
+
+/*
+ * RAM ring behind the triggered blackbox mode. Encoded frames go into the ring and the oldest ones are overwritten
+ * while nothing happens. blackboxRingCommit() commits the history from the oldest I-frame that is recent enough and
+ * everything written after it until blackboxRingRelease(). Committed bytes are read out with blackboxRingPeek() and
+ * blackboxRingConsume() as fast as the device takes them and are never overwritten, a write that doesn't fit is
+ * dropped together with everything up to the next I-frame.
+ *
+ * The writer calls blackboxRingKeyframe() just before it encodes an I-frame. When that returns true the reader may
+ * see a gap in front of the I-frame and the writer should put a LOGGING_RESUME event there.
+ *
+ * Positions are running byte counts that are allowed to wrap, the buffer size must be a power of two.
+ */
+
+#define BLACKBOX_RING_KEYFRAME_COUNT    128     // power of two, 4s of I-frames at the usual 32ms interval
+
+typedef struct blackboxRingKeyframe_s {
+    uint32_t position;
+    timeUs_t time;
+} blackboxRingKeyframe_t;
+
+typedef struct blackboxRing_s {
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t head;          // end of what was written
+    uint32_t tail;          // next committed byte for the reader
+    uint32_t commitEnd;     // bytes from tail up to here are committed
+    uint32_t droppedBytes;  // committed bytes that found no room
+    uint32_t keyframeCount;
+    bool live;              // commit every write
+    bool resync;            // drop writes up to the next I-frame
+    blackboxRingKeyframe_t keyframes[BLACKBOX_RING_KEYFRAME_COUNT];
+} blackboxRing_t;
+
+void blackboxRingInit(blackboxRing_t *ring, uint8_t *buffer, uint32_t size);
+bool blackboxRingKeyframe(blackboxRing_t *ring, timeUs_t time);
+void blackboxRingWrite(blackboxRing_t *ring, const uint8_t *data, uint32_t length);
+void blackboxRingStopDropping(blackboxRing_t *ring);
+void blackboxRingCommit(blackboxRing_t *ring, timeUs_t since);
+void blackboxRingRelease(blackboxRing_t *ring);
+bool blackboxRingIsLive(const blackboxRing_t *ring);
+uint32_t blackboxRingPending(const blackboxRing_t *ring);
+uint32_t blackboxRingPeek(const blackboxRing_t *ring, const uint8_t **data);
+void blackboxRingConsume(blackboxRing_t *ring, uint32_t length);
@@ -0,0 +1,157 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#ifdef USE_BLACKBOX_STREAM
+
+#include "blackbox_stream.h"
+
+#include "common/maths.h"
+#include "common/time.h"
+
+#include "drivers/time.h"
+
+// Header and payload sit back to back so a chunk goes to the transport in one call
+static struct {
+    blackboxStreamHeader_t header;
+    uint8_t payload[BLACKBOX_STREAM_CHUNK_SIZE];
+} __attribute__((packed)) blackboxStreamChunk;
+
+static uint32_t blackboxStreamSequence;
+static uint32_t blackboxStreamDropped;
+static uint16_t blackboxStreamPendingFlags;
+static timeMs_t blackboxStreamChunkStartMs;
+
+static void blackboxStreamSendChunk(void)
+{
+    blackboxStreamHeader_t *header = &blackboxStreamChunk.header;
+
+    header->magic = BLACKBOX_STREAM_MAGIC;
+    header->sequence = blackboxStreamSequence++;
+    header->droppedBytes = blackboxStreamDropped;
+    header->flags = blackboxStreamPendingFlags;
+
+    if (!blackboxStreamTransportSend((const uint8_t *)&blackboxStreamChunk, sizeof(*header) + header->length)) {
+        // The reader sees the gap in the sequence and how much it cost with the next chunk that makes it
+        blackboxStreamDropped += header->length;
+    }
+
+    header->length = 0;
+    blackboxStreamPendingFlags = 0;
+}
+
+void blackboxStreamInit(void)
+{
+    blackboxStreamTransportInit();
+}
+
+/**
+ * Start a new stream, returns false while nobody is listening.
+ */
+bool blackboxStreamOpen(void)
+{
+    blackboxStreamChunk.header.length = 0;
+    blackboxStreamSequence = 0;
+    blackboxStreamDropped = 0;
+    blackboxStreamPendingFlags = 0;
+
+    return blackboxStreamTransportIsConnected();
+}
+
+void blackboxStreamBeginLog(void)
+{
+    if (blackboxStreamChunk.header.length > 0) {
+        blackboxStreamSendChunk();
+    }
+    blackboxStreamPendingFlags = BLACKBOX_STREAM_FLAG_LOG_START;
+}
+
+void blackboxStreamWrite(const uint8_t *data, int length)
+{
+    blackboxStreamHeader_t *header = &blackboxStreamChunk.header;
+
+    while (length > 0) {
+        if (header->length == 0) {
+            blackboxStreamChunkStartMs = millis();
+        }
+
+        const int count = MIN(length, BLACKBOX_STREAM_CHUNK_SIZE - header->length);
+        memcpy(&blackboxStreamChunk.payload[header->length], data, count);
+        header->length += count;
+        data += count;
+        length -= count;
+
+        if (header->length == BLACKBOX_STREAM_CHUNK_SIZE) {
+            blackboxStreamSendChunk();
+        }
+    }
+}
+
+/**
+ * Send the chunk being filled once it is BLACKBOX_STREAM_MAX_LATENCY_MS old, so a slow log still shows up live.
+ * `force` sends it right away.
+ */
+void blackboxStreamFlush(bool force)
+{
+    if (blackboxStreamChunk.header.length > 0
+        && (force || millis() - blackboxStreamChunkStartMs >= BLACKBOX_STREAM_MAX_LATENCY_MS)) {
+        blackboxStreamSendChunk();
+    }
+}
+
+/**
+ * Send what is left of the log, the last chunk is sent even when empty to carry the end marker.
+ */
+void blackboxStreamEndLog(void)
+{
+    blackboxStreamPendingFlags |= BLACKBOX_STREAM_FLAG_LOG_END;
+    blackboxStreamSendChunk();
+}
+
+bool blackboxStreamIsConnected(void)
+{
+    return blackboxStreamTransportIsConnected();
+}
+
+/**
+ * Bytes that can be written without the chunk they end up in being dropped by the transport, nothing while the
+ * transport has no room for a full chunk.
+ */
+int32_t blackboxStreamTxBytesFree(void)
+{
+    const uint32_t transportFree = blackboxStreamTransportTxBytesFree();
+
+    if (transportFree < sizeof(blackboxStreamChunk)) {
+        return 0;
+    }
+    return transportFree - sizeof(blackboxStreamHeader_t) - blackboxStreamChunk.header.length;
+}
+
+uint32_t blackboxStreamDroppedBytes(void)
+{
+    return blackboxStreamDropped;
+}
+
+#endif // USE_BLACKBOX_STREAM
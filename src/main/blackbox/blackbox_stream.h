@@ -0,0 +1,68 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Live blackbox stream for SITL and bench rigs. The encoded log is cut into chunks that are handed to the transport
+ * in one piece each, behind a small header:
+ *
+ *     magic (4) | sequence (4) | dropped bytes (4) | payload length (2) | flags (2) | payload
+ *
+ * Fields are little endian. Every chunk takes the next sequence number whether the transport took it or not, the
+ * payload of a chunk that couldn't be sent is added to the dropped byte count carried by the chunks after it. Both
+ * start over from zero at blackboxStreamOpen(). The payloads put back to back are a plain log.
+ */
+
+#define BLACKBOX_STREAM_MAGIC           0x53424231  // "1BBS" on the wire
+#define BLACKBOX_STREAM_CHUNK_SIZE      4096        // payload bytes
+#define BLACKBOX_STREAM_MAX_LATENCY_MS  100         // a partly filled chunk is sent after this long
+
+typedef enum {
+    BLACKBOX_STREAM_FLAG_LOG_START = 1 << 0,        // payload starts with the log header
+    BLACKBOX_STREAM_FLAG_LOG_END = 1 << 1           // last chunk of the log
+} blackboxStreamFlags_e;
+
+typedef struct blackboxStreamHeader_s {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t droppedBytes;
+    uint16_t length;
+    uint16_t flags;
+} __attribute__((packed)) blackboxStreamHeader_t;
+
+void blackboxStreamInit(void);
+bool blackboxStreamOpen(void);
+void blackboxStreamBeginLog(void);
+void blackboxStreamWrite(const uint8_t *data, int length);
+void blackboxStreamFlush(bool force);
+void blackboxStreamEndLog(void);
+bool blackboxStreamIsConnected(void);
+int32_t blackboxStreamTxBytesFree(void);
+uint32_t blackboxStreamDroppedBytes(void);
+
+// Provided by the target, blackboxStreamTransportSend() takes all of the data or none of it
+void blackboxStreamTransportInit(void);
+bool blackboxStreamTransportIsConnected(void);
+uint32_t blackboxStreamTransportTxBytesFree(void);
+bool blackboxStreamTransportSend(const uint8_t *data, int length);
@@ -2409,6 +2409,16 @@ static void cliFlashInfo(char *cmdline)
             FLASH_PARTITION_SECTOR_COUNT(flashPartition) * layout->sectorSize,
             flashfsGetOffset()
     );
+
+    const flashfsWriteStats_t *writeStats = flashfsGetWriteStats();
+    cliPrintLinef("FlashFS programs=%u, partial=%u, stalls=%u, dropped=%u",
+            writeStats->pagePrograms, writeStats->partialPrograms, writeStats->stalls, writeStats->bytesDropped);
+
+    uint32_t start;
+    uint32_t end;
+    for (int i = 0; flashfsGetLog(i, &start, &end); i++) {
+        cliPrintLinef("  log %d: %u %u", i + 1, start, end);
+    }
 #endif
 }
 
@@ -4694,9 +4704,39 @@ static void cliStatus(char *cmdline)
 }
 
 #if defined(USE_TASK_STATISTICS)
+#if defined(USE_TASK_HISTOGRAMS)
+static void cliTasksHistogram(void)
+{
+    cliPrintLine("Task list               samples  exec p50/p99/p99.9 us    late p50/p99/p99.9 us");
+    for (cfTaskId_e taskId = 0; taskId < TASK_COUNT; taskId++) {
+        cfTaskInfo_t taskInfo;
+        getTaskInfo(taskId, &taskInfo);
+        if (taskInfo.isEnabled) {
+            cfTaskHistogramInfo_t histogramInfo;
+            getTaskHistogramInfo(taskId, &histogramInfo);
+            cliPrintLinef("%02d - (%15s) %8d %6d %6d %6d %7d %6d %6d",
+                taskId, taskInfo.taskName, histogramInfo.sampleCount,
+                histogramInfo.executionTime[TASK_PERCENTILE_50], histogramInfo.executionTime[TASK_PERCENTILE_99], histogramInfo.executionTime[TASK_PERCENTILE_99_9],
+                histogramInfo.lateness[TASK_PERCENTILE_50], histogramInfo.lateness[TASK_PERCENTILE_99], histogramInfo.lateness[TASK_PERCENTILE_99_9]);
+        }
+    }
+}
+#endif
+
 static void cliTasks(char *cmdline)
 {
+#if defined(USE_TASK_HISTOGRAMS)
+    if (strcasecmp(cmdline, "histogram") == 0) {
+        if (systemConfig()->task_statistics) {
+            cliTasksHistogram();
+        } else {
+            cliPrintLine("Task statistics are disabled");
+        }
+        return;
+    }
+#else
     UNUSED(cmdline);
+#endif
     int maxLoadSum = 0;
     int averageLoadSum = 0;
 
@@ -6357,8 +6397,12 @@ const clicmd_t cmdTable[] = {
 #endif
     CLI_COMMAND_DEF("status", "show status", NULL, cliStatus),
 #if defined(USE_TASK_STATISTICS)
+#if defined(USE_TASK_HISTOGRAMS)
+    CLI_COMMAND_DEF("tasks", "show task stats", "[histogram]", cliTasks),
+#else
     CLI_COMMAND_DEF("tasks", "show task stats", NULL, cliTasks),
 #endif
+#endif
 #ifdef USE_TIMER_MGMT
     CLI_COMMAND_DEF("timer", "show/set timers", "<> | <pin> list | <pin> [af<alternate function>|none|<option(deprecated)>] | list | show", cliTimer),
 #endif
@@ -201,13 +201,33 @@ static const char * const lookupTableGimbalMode[] = {
 
 #ifdef USE_BLACKBOX
 static const char * const lookupTableBlackboxDevice[] = {
-    "NONE", "SPIFLASH", "SDCARD", "SERIAL"
+    "NONE", "SPIFLASH", "SDCARD", "SERIAL",
+#ifdef USE_BLACKBOX_STREAM
+    "STREAM",
+#endif
 };
 
 static const char * const lookupTableBlackboxMode[] = {
-    "NORMAL", "MOTOR_TEST", "ALWAYS"
+    "NORMAL", "MOTOR_TEST", "ALWAYS",
+#ifdef USE_BLACKBOX_CAPTURE
+    "TRIGGERED",
+#endif
+};
+
+static const char * const lookupTableBlackboxGyroPredictor[] = {
+    "AVERAGE", "STRAIGHT_LINE", "SECOND_ORDER"
+};
+
+static const char * const lookupTableBlackboxMotorPredictor[] = {
+    "AVERAGE", "STRAIGHT_LINE", "SECOND_ORDER", "MOTOR_0"
+};
+
+#ifdef USE_HUFFMAN
+static const char * const lookupTableBlackboxCompression[] = {
+    "NONE", "HUFFMAN"
 };
 #endif
+#endif
 
 #ifdef USE_SERIAL_RX
 static const char * const lookupTableSerialRX[] = {
@@ -406,6 +426,10 @@ static const char * const lookupTableRcSmoothingDerivativeType[] = {
 static const char * const lookupTableDynamicFilterRange[] = {
     "HIGH", "MEDIUM", "LOW", "AUTO"
 };
+
+static const char * const lookupTableDynamicNotchEngine[] = {
+    "FFT", "SDFT"
+};
 #endif // USE_GYRO_DATA_ANALYSE
 
 #ifdef USE_VTX_COMMON
@@ -499,6 +523,11 @@ const lookupTableEntry_t lookupTables[] = {
 #ifdef USE_BLACKBOX
     LOOKUP_TABLE_ENTRY(lookupTableBlackboxDevice),
     LOOKUP_TABLE_ENTRY(lookupTableBlackboxMode),
+    LOOKUP_TABLE_ENTRY(lookupTableBlackboxGyroPredictor),
+    LOOKUP_TABLE_ENTRY(lookupTableBlackboxMotorPredictor),
+#ifdef USE_HUFFMAN
+    LOOKUP_TABLE_ENTRY(lookupTableBlackboxCompression),
+#endif
 #endif
     LOOKUP_TABLE_ENTRY(currentMeterSourceNames),
     LOOKUP_TABLE_ENTRY(voltageMeterSourceNames),
@@ -574,6 +603,7 @@ const lookupTableEntry_t lookupTables[] = {
 #endif // USE_RC_SMOOTHING_FILTER
 #ifdef USE_GYRO_DATA_ANALYSE
     LOOKUP_TABLE_ENTRY(lookupTableDynamicFilterRange),
+    LOOKUP_TABLE_ENTRY(lookupTableDynamicNotchEngine),
 #endif // USE_GYRO_DATA_ANALYSE
 #ifdef USE_VTX_COMMON
     LOOKUP_TABLE_ENTRY(lookupTableVtxLowPowerDisarm),
@@ -641,6 +671,8 @@ const clivalue_t valueTable[] = {
     { "dyn_notch_width_percent",   VAR_UINT8   | MASTER_VALUE, .config.minmaxUnsigned = { 0, 20 }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_notch_width_percent) },
     { "dyn_notch_q",               VAR_UINT16  | MASTER_VALUE, .config.minmaxUnsigned = { 1, 1000 }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_notch_q) },
     { "dyn_notch_min_hz",          VAR_UINT16  | MASTER_VALUE, .config.minmaxUnsigned = { 60, 1000 }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_notch_min_hz) },
+    { "dyn_notch_engine",          VAR_UINT8   | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_DYNAMIC_NOTCH_ENGINE }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_notch_engine) },
+    { "dyn_notch_peak_track",      VAR_UINT8   | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_notch_peak_track) },
 #endif
 #ifdef USE_DYN_LPF
     { "dyn_lpf_gyro_min_hz",        VAR_UINT16 | MASTER_VALUE, .config.minmaxUnsigned = { 0, 1000 }, PG_GYRO_CONFIG, offsetof(gyroConfig_t, dyn_lpf_gyro_min_hz) },
@@ -757,6 +789,17 @@ const clivalue_t valueTable[] = {
     { "blackbox_device",            VAR_UINT8  | HARDWARE_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_DEVICE }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, device) },
     { "blackbox_record_acc",        VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, record_acc) },
     { "blackbox_mode",              VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_MODE }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, mode) },
+    { "blackbox_gyro_predictor",    VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_GYRO_PREDICTOR }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, gyro_predictor) },
+    { "blackbox_motor_predictor",   VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_MOTOR_PREDICTOR }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, motor_predictor) },
+    { "blackbox_pid_ratio",         VAR_UINT8  | MASTER_VALUE, .config.minmaxUnsigned = { 1, UINT8_MAX }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, pid_ratio) },
+    { "blackbox_rc_ratio",          VAR_UINT8  | MASTER_VALUE, .config.minmaxUnsigned = { 1, UINT8_MAX }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, rc_ratio) },
+#ifdef USE_BLACKBOX_CAPTURE
+    { "blackbox_trigger_pre_ms",    VAR_UINT16 | MASTER_VALUE, .config.minmaxUnsigned = { 0, 4000 }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, trigger_pre_ms) },
+    { "blackbox_trigger_post_ms",   VAR_UINT16 | MASTER_VALUE, .config.minmaxUnsigned = { 0, 60000 }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, trigger_post_ms) },
+#endif
+#ifdef USE_HUFFMAN
+    { "blackbox_compression",       VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_BLACKBOX_COMPRESSION }, PG_BLACKBOX_CONFIG, offsetof(blackboxConfig_t, compression) },
+#endif
 #endif
 
 // PG_MOTOR_CONFIG
@@ -1369,6 +1412,8 @@ const clivalue_t valueTable[] = {
 #endif
     { "pwr_on_arm_grace",           VAR_UINT8  | MASTER_VALUE, .config.minmaxUnsigned = { 0, 30 }, PG_SYSTEM_CONFIG, offsetof(systemConfig_t, powerOnArmingGraceTime) },
     { "scheduler_optimize_rate",    VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON_AUTO }, PG_SYSTEM_CONFIG, offsetof(systemConfig_t, schedulerOptimizeRate) },
+    { "scheduler_deadline_queue",   VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON }, PG_SYSTEM_CONFIG, offsetof(systemConfig_t, schedulerDeadlineQueue) },
+    { "scheduler_deadline_guard",   VAR_UINT8  | MASTER_VALUE | MODE_LOOKUP, .config.lookup = { TABLE_OFF_ON }, PG_SYSTEM_CONFIG, offsetof(systemConfig_t, schedulerDeadlineGuard) },
 
 // PG_VTX_CONFIG
 #ifdef USE_VTX_COMMON
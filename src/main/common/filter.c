@@ -25,10 +25,18 @@
 
 #include "platform.h"
 
+#include "common/axis.h"
 #include "common/filter.h"
 #include "common/maths.h"
 #include "common/utils.h"
 
+#if (defined(SIMULATOR_BUILD) || defined(UNIT_TEST)) && defined(__SSE__)
+// Host builds vectorise the axis-vector filters explicitly, on the flight controller the FPU is scalar and the
+// plain loops over the contiguous lanes are what the compiler schedules best
+#include <xmmintrin.h>
+#define USE_FILTER_SSE
+#endif
+
 #define M_LN2_FLOAT 0.69314718055994530942f
 #define M_PI_FLOAT  3.14159265358979323846f
 #define BIQUAD_Q 1.0f / sqrtf(2.0f)     /* quality factor - 2nd order butterworth*/
@@ -41,6 +49,12 @@ FAST_CODE float nullFilterApply(filter_t *filter, float input)
     return input;
 }
 
+FAST_CODE void nullFilterApply3(filter3_t *filter, float *values)
+{
+    UNUSED(filter);
+    UNUSED(values);
+}
+
 
 // PT1 Low Pass filter
 
@@ -225,3 +239,142 @@ FAST_CODE float laggedMovingAverageUpdate(laggedMovingAverage_t *filter, float i
     const uint16_t denom = filter->primed ? filter->windowSize : filter->movingWindowIndex;
     return filter->movingSum  / denom;
 }
+
+// Axis-vector PT1 Low Pass filter
+
+void pt1Filter3Init(pt1Filter3_t *filter, float k)
+{
+    for (int lane = 0; lane < FILTER_AXIS_LANES; lane++) {
+        filter->state[lane] = 0.0f;
+        filter->k[lane] = k;
+    }
+}
+
+void pt1Filter3UpdateCutoff(pt1Filter3_t *filter, float k)
+{
+    for (int lane = 0; lane < FILTER_AXIS_LANES; lane++) {
+        filter->k[lane] = k;
+    }
+}
+
+FAST_CODE void pt1FilterApply3(pt1Filter3_t *filter, float *values)
+{
+#ifdef USE_FILTER_SSE
+    const __m128 input = _mm_set_ps(0.0f, values[Z], values[Y], values[X]);
+    __m128 state = _mm_loadu_ps(filter->state);
+    state = _mm_add_ps(state, _mm_mul_ps(_mm_loadu_ps(filter->k), _mm_sub_ps(input, state)));
+    _mm_storeu_ps(filter->state, state);
+#else
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        filter->state[axis] = filter->state[axis] + filter->k[axis] * (values[axis] - filter->state[axis]);
+    }
+#endif
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        values[axis] = filter->state[axis];
+    }
+}
+
+// Axis-vector Biquad filter, the coefficients are calculated as for biquadFilter_t
+
+static void biquadFilter3SetCoefficients(biquadFilter3_t *filter, int lane, const biquadFilter_t *coefficients)
+{
+    filter->b0[lane] = coefficients->b0;
+    filter->b1[lane] = coefficients->b1;
+    filter->b2[lane] = coefficients->b2;
+    filter->a1[lane] = coefficients->a1;
+    filter->a2[lane] = coefficients->a2;
+}
+
+void biquadFilter3InitLPF(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate)
+{
+    biquadFilter3Init(filter, filterFreq, refreshRate, BIQUAD_Q, FILTER_LPF);
+}
+
+void biquadFilter3Init(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType)
+{
+    memset(filter, 0, sizeof(*filter));
+    biquadFilter3Update(filter, filterFreq, refreshRate, Q, filterType);
+}
+
+FAST_CODE void biquadFilter3Update(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType)
+{
+    biquadFilter_t coefficients;
+    biquadFilterInit(&coefficients, filterFreq, refreshRate, Q, filterType);
+
+    for (int lane = 0; lane < FILTER_AXIS_LANES; lane++) {
+        biquadFilter3SetCoefficients(filter, lane, &coefficients);
+    }
+}
+
+FAST_CODE void biquadFilter3UpdateLPF(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate)
+{
+    biquadFilter3Update(filter, filterFreq, refreshRate, BIQUAD_Q, FILTER_LPF);
+}
+
+FAST_CODE void biquadFilter3UpdateAxis(biquadFilter3_t *filter, int axis, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType)
+{
+    biquadFilter_t coefficients;
+    biquadFilterInit(&coefficients, filterFreq, refreshRate, Q, filterType);
+
+    biquadFilter3SetCoefficients(filter, axis, &coefficients);
+}
+
+/* Computes a biquadFilter3_t filter in direct form 2 on the samples of all axes, as biquadFilterApply */
+FAST_CODE void biquadFilterApply3(biquadFilter3_t *filter, float *values)
+{
+#ifdef USE_FILTER_SSE
+    const __m128 input = _mm_set_ps(0.0f, values[Z], values[Y], values[X]);
+    const __m128 result = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(filter->b0), input), _mm_loadu_ps(filter->x1));
+    _mm_storeu_ps(filter->x1, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(filter->b1), input), _mm_mul_ps(_mm_loadu_ps(filter->a1), result)), _mm_loadu_ps(filter->x2)));
+    _mm_storeu_ps(filter->x2, _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(filter->b2), input), _mm_mul_ps(_mm_loadu_ps(filter->a2), result)));
+
+    float output[FILTER_AXIS_LANES];
+    _mm_storeu_ps(output, result);
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        values[axis] = output[axis];
+    }
+#else
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float input = values[axis];
+        const float result = filter->b0[axis] * input + filter->x1[axis];
+        filter->x1[axis] = filter->b1[axis] * input - filter->a1[axis] * result + filter->x2[axis];
+        filter->x2[axis] = filter->b2[axis] * input - filter->a2[axis] * result;
+        values[axis] = result;
+    }
+#endif
+}
+
+/* Computes a biquadFilter3_t filter in direct form 1 on the samples of all axes, as biquadFilterApplyDF1 */
+FAST_CODE void biquadFilterApply3DF1(biquadFilter3_t *filter, float *values)
+{
+#ifdef USE_FILTER_SSE
+    const __m128 input = _mm_set_ps(0.0f, values[Z], values[Y], values[X]);
+    const __m128 x1 = _mm_loadu_ps(filter->x1);
+    const __m128 y1 = _mm_loadu_ps(filter->y1);
+    __m128 result = _mm_mul_ps(_mm_loadu_ps(filter->b0), input);
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(filter->b1), x1));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(filter->b2), _mm_loadu_ps(filter->x2)));
+    result = _mm_sub_ps(result, _mm_mul_ps(_mm_loadu_ps(filter->a1), y1));
+    result = _mm_sub_ps(result, _mm_mul_ps(_mm_loadu_ps(filter->a2), _mm_loadu_ps(filter->y2)));
+
+    _mm_storeu_ps(filter->x2, x1);
+    _mm_storeu_ps(filter->x1, input);
+    _mm_storeu_ps(filter->y2, y1);
+    _mm_storeu_ps(filter->y1, result);
+
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        values[axis] = filter->y1[axis];
+    }
+#else
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float input = values[axis];
+        const float result = filter->b0[axis] * input + filter->b1[axis] * filter->x1[axis] + filter->b2[axis] * filter->x2[axis]
+            - filter->a1[axis] * filter->y1[axis] - filter->a2[axis] * filter->y2[axis];
+        filter->x2[axis] = filter->x1[axis];
+        filter->x1[axis] = input;
+        filter->y2[axis] = filter->y1[axis];
+        filter->y1[axis] = result;
+        values[axis] = result;
+    }
+#endif
+}
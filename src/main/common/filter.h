@@ -41,6 +41,23 @@ typedef struct biquadFilter_s {
     float x1, x2, y1, y2;
 } biquadFilter_t;
 
+// Axis-vector filters hold the coefficients and state of the X, Y and Z filters side by side, plus one pad lane so that
+// every coefficient and state vector is four floats wide. The coefficients of the axes may differ.
+#define FILTER_AXIS_LANES 4
+
+struct filter3_s;
+typedef struct filter3_s filter3_t;
+
+typedef struct pt1Filter3_s {
+    float state[FILTER_AXIS_LANES];
+    float k[FILTER_AXIS_LANES];
+} pt1Filter3_t;
+
+typedef struct biquadFilter3_s {
+    float b0[FILTER_AXIS_LANES], b1[FILTER_AXIS_LANES], b2[FILTER_AXIS_LANES], a1[FILTER_AXIS_LANES], a2[FILTER_AXIS_LANES];
+    float x1[FILTER_AXIS_LANES], x2[FILTER_AXIS_LANES], y1[FILTER_AXIS_LANES], y2[FILTER_AXIS_LANES];
+} biquadFilter3_t;
+
 typedef struct laggedMovingAverage_s {
     uint16_t movingWindowIndex;
     uint16_t windowSize;
@@ -61,8 +78,10 @@ typedef enum {
 } biquadFilterType_e;
 
 typedef float (*filterApplyFnPtr)(filter_t *filter, float input);
+typedef void (*filter3ApplyFnPtr)(filter3_t *filter, float *values);
 
 float nullFilterApply(filter_t *filter, float input);
+void nullFilterApply3(filter3_t *filter, float *values);
 
 void biquadFilterInitLPF(biquadFilter_t *filter, float filterFreq, uint32_t refreshRate);
 void biquadFilterInit(biquadFilter_t *filter, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType);
@@ -83,3 +102,15 @@ float pt1FilterApply(pt1Filter_t *filter, float input);
 
 void slewFilterInit(slewFilter_t *filter, float slewLimit, float threshold);
 float slewFilterApply(slewFilter_t *filter, float input);
+
+void pt1Filter3Init(pt1Filter3_t *filter, float k);
+void pt1Filter3UpdateCutoff(pt1Filter3_t *filter, float k);
+void pt1FilterApply3(pt1Filter3_t *filter, float *values);
+
+void biquadFilter3InitLPF(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate);
+void biquadFilter3Init(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType);
+void biquadFilter3Update(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType);
+void biquadFilter3UpdateLPF(biquadFilter3_t *filter, float filterFreq, uint32_t refreshRate);
+void biquadFilter3UpdateAxis(biquadFilter3_t *filter, int axis, float filterFreq, uint32_t refreshRate, float Q, biquadFilterType_e filterType);
+void biquadFilterApply3(biquadFilter3_t *filter, float *values);
+void biquadFilterApply3DF1(biquadFilter3_t *filter, float *values);
@@ -0,0 +1,97 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+
+#include "histogram.h"
+
+/*
+ * Values 0 and 1 have a bucket each, every power of two above that is split into two buckets,
+ * so a bucket never spans more than half of its lower bound. Values beyond the last bucket are
+ * counted in the last bucket.
+ */
+int logHistogramBucketIndex(uint32_t value)
+{
+    if (value < 2) {
+        return value;
+    }
+    const int octave = 31 - __builtin_clz(value);
+    const int bucketIndex = 2 * octave + ((value >> (octave - 1)) & 1);
+
+    return bucketIndex < LOG_HISTOGRAM_BUCKET_COUNT ? bucketIndex : LOG_HISTOGRAM_BUCKET_COUNT - 1;
+}
+
+uint32_t logHistogramBucketUpperBound(int bucketIndex)
+{
+    if (bucketIndex < 2) {
+        return bucketIndex;
+    }
+    const int octave = bucketIndex / 2;
+    const uint32_t lowerBound = (2 + (bucketIndex & 1)) << (octave - 1);
+
+    return lowerBound + (1 << (octave - 1)) - 1;
+}
+
+void logHistogramReset(logHistogram_t *histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void logHistogramAdd(logHistogram_t *histogram, uint32_t value)
+{
+    const int bucketIndex = logHistogramBucketIndex(value);
+
+    if (histogram->bucket[bucketIndex] == UINT16_MAX) {
+        // Halve all counts rather than saturate, which also gives more weight to recent samples
+        histogram->count = 0;
+        for (int i = 0; i < LOG_HISTOGRAM_BUCKET_COUNT; i++) {
+            histogram->bucket[i] /= 2;
+            histogram->count += histogram->bucket[i];
+        }
+    }
+
+    histogram->bucket[bucketIndex]++;
+    histogram->count++;
+}
+
+/*
+ * Returns the upper bound of the bucket holding the given percentile, in 1/10000ths.
+ * eg 5000 is the median, 9990 is p99.9
+ */
+uint32_t logHistogramPercentile(const logHistogram_t *histogram, uint16_t permyriad)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    const uint32_t rank = ((uint64_t)histogram->count * permyriad + 9999) / 10000;
+    uint32_t cumulativeCount = 0;
+    for (int i = 0; i < LOG_HISTOGRAM_BUCKET_COUNT; i++) {
+        cumulativeCount += histogram->bucket[i];
+        if (cumulativeCount >= rank && cumulativeCount > 0) {
+            return logHistogramBucketUpperBound(i);
+        }
+    }
+
+    return logHistogramBucketUpperBound(LOG_HISTOGRAM_BUCKET_COUNT - 1);
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Two buckets per power of two, covering 0 to 65535
+#define LOG_HISTOGRAM_BUCKET_COUNT 32
+
+typedef struct logHistogram_s {
+    uint16_t bucket[LOG_HISTOGRAM_BUCKET_COUNT];
+    uint32_t count;
+} logHistogram_t;
+
+void logHistogramReset(logHistogram_t *histogram);
+void logHistogramAdd(logHistogram_t *histogram, uint32_t value);
+uint32_t logHistogramPercentile(const logHistogram_t *histogram, uint16_t permyriad);
+
+int logHistogramBucketIndex(uint32_t value);
+uint32_t logHistogramBucketUpperBound(int bucketIndex);
@@ -41,7 +41,19 @@
 #include "drivers/flash.h"
 #include "drivers/system.h"
 
-static uint16_t eepromConfigSize;
+/*
+ * The stored config is a compacted copy of every PG, protected by a CRC over all of it, followed by a log of
+ * records that were appended to it since. A save appends a record for every PG that differs from what is stored,
+ * each with a CRC of its own, and leaves the rest alone. The last record for a PG is the one that counts. When the
+ * log runs out of room, or what follows it can't be written without an erase, the whole config is compacted again.
+ *
+ * Appended records are aligned to the streamer word so that each of them is programmed into words of its own. Their
+ * CRC is seeded with the generation of the compacted copy in front of them, so records an earlier generation left
+ * behind past the end of the log never pass for one of them.
+ */
+
+static uint16_t eepromConfigSize;   // up to the end of the log
+static uint16_t eepromLogStart;     // where the first record is appended
 
 typedef enum {
     CR_CLASSICATION_SYSTEM   = 0,
@@ -52,10 +64,13 @@ typedef enum {
 #define CRC_START_VALUE         0xFFFF
 #define CRC_CHECK_VALUE         0x1D0F  // pre-calculated value of CRC that includes the CRC itself
 
+#define CONFIG_LOG_ALIGN(size)  (((size) + CONFIG_STREAMER_BUFFER_SIZE - 1) & ~(CONFIG_STREAMER_BUFFER_SIZE - 1))
+
 // Header for the saved copy.
 typedef struct {
     uint8_t eepromConfigVersion;
     uint8_t magic_be;           // magic number, should be 0xBE
+    uint16_t generation;        // incremented every time the config is compacted
 } PG_PACKED configHeader_t;
 
 // Header for each stored PG.
@@ -77,6 +92,9 @@ typedef struct {
 } PG_PACKED configFooter_t;
 // checksum is appended just after footer. It is not included in footer to make checksum calculation consistent
 
+// Appended records are followed by a CRC over the generation and the record itself.
+typedef uint16_t configRecordCrc_t;
+
 // Used to check the compiler packing at build time.
 typedef struct {
     uint8_t byte;
@@ -251,6 +269,7 @@ void initEEPROM(void)
 
     STATIC_ASSERT(sizeof(configFooter_t) == 2, footer_size_failed);
     STATIC_ASSERT(sizeof(configRecord_t) == 6, record_size_failed);
+    STATIC_ASSERT((CONFIG_STREAMER_BUFFER_SIZE & (CONFIG_STREAMER_BUFFER_SIZE - 1)) == 0, streamer_buffer_size_failed);
 
 #if defined(CONFIG_IN_FILE)
     loadEEPROMFromFile();
@@ -281,6 +300,48 @@ bool isEEPROMVersionValid(void)
     return true;
 }
 
+static uint16_t eepromGeneration(void)
+{
+    const configHeader_t *header = (const configHeader_t *)&__config_start;
+
+    return header->generation;
+}
+
+static uint16_t logRecordCrc(const configRecord_t *record, uint16_t generation)
+{
+    uint16_t crc = CRC_START_VALUE;
+    crc = crc16_ccitt_update(crc, &generation, sizeof(generation));
+    crc = crc16_ccitt_update(crc, record, record->size);
+
+    return crc;
+}
+
+// Returns the appended record at p, NULL if there is none because the log ends there.
+static const configRecord_t *logRecordAt(const uint8_t *p)
+{
+    const configRecord_t *record = (const configRecord_t *)p;
+
+    if (p + sizeof(*record) + sizeof(configRecordCrc_t) > &__config_end
+        || record->size < sizeof(*record)
+        || p + record->size + sizeof(configRecordCrc_t) > &__config_end) {
+        return NULL;
+    }
+
+    configRecordCrc_t storedCrc;
+    memcpy(&storedCrc, p + record->size, sizeof(storedCrc));
+    if (storedCrc != logRecordCrc(record, eepromGeneration())) {
+        // Erased, written by an earlier generation or torn by a power loss.
+        return NULL;
+    }
+
+    return record;
+}
+
+static uint16_t logRecordSize(uint16_t recordSize)
+{
+    return CONFIG_LOG_ALIGN(recordSize + sizeof(configRecordCrc_t));
+}
+
 // Scan the EEPROM config. Returns true if the config is valid.
 bool isEEPROMStructureValid(void)
 {
@@ -320,12 +381,23 @@ bool isEEPROMStructureValid(void)
     // include stored CRC in the CRC calculation
     const uint16_t *storedCrc = (const uint16_t *)p;
     crc = crc16_ccitt_update(crc, storedCrc, sizeof(*storedCrc));
-    p += sizeof(storedCrc);
+    p += sizeof(*storedCrc);
+
+    // CRC has the property that if the CRC itself is included in the calculation the resulting CRC will have constant value
+    if (crc != CRC_CHECK_VALUE) {
+        return false;
+    }
+
+    // The log carries on from the compacted copy up to the first record that doesn't check out
+    eepromLogStart = CONFIG_LOG_ALIGN(p - &__config_start);
+    p = &__config_start + eepromLogStart;
+    for (const configRecord_t *record; (record = logRecordAt(p)); ) {
+        p += logRecordSize(record->size);
+    }
 
     eepromConfigSize = p - &__config_start;
 
-    // CRC has the property that if the CRC itself is included in the calculation the resulting CRC will have constant value
-    return crc == CRC_CHECK_VALUE;
+    return true;
 }
 
 uint16_t getEEPROMConfigSize(void)
@@ -347,37 +419,88 @@ size_t getEEPROMStorageSize(void)
 #endif
 }
 
-// find config record for reg + classification (profile info) in EEPROM
+// Returns the record at p and moves p past it, NULL after the last one. The records of the compacted copy come
+// first, then those that were appended to it.
+// this function assumes that EEPROM content is valid
+static const configRecord_t *nextRecord(const uint8_t **p)
+{
+    const uint8_t *logStart = &__config_start + eepromLogStart;
+
+    if (*p < logStart) {
+        const configRecord_t *record = (const configRecord_t *)*p;
+        if (record->size != 0
+            && *p + record->size < &__config_end
+            && record->size >= sizeof(*record)) {
+            *p += record->size;
+            return record;
+        }
+        *p = logStart;
+    }
+
+    const configRecord_t *record = logRecordAt(*p);
+    if (record) {
+        *p += logRecordSize(record->size);
+    }
+    return record;
+}
+
+// find the last config record for reg + classification (profile info) in EEPROM
 // return NULL when record is not found
 // this function assumes that EEPROM content is valid
 static const configRecord_t *findEEPROM(const pgRegistry_t *reg, configRecordFlags_e classification)
 {
+    const configRecord_t *found = NULL;
     const uint8_t *p = &__config_start;
     p += sizeof(configHeader_t);             // skip header
-    while (true) {
-        const configRecord_t *record = (const configRecord_t *)p;
-        if (record->size == 0
-            || p + record->size >= &__config_end
-            || record->size < sizeof(*record))
-            break;
+    for (const configRecord_t *record; (record = nextRecord(&p)); ) {
         if (pgN(reg) == record->pgn
             && (record->flags & CR_CLASSIFICATION_MASK) == classification)
-            return record;
-        p += record->size;
+            found = record;
     }
-    // record not found
-    return NULL;
+    return found;
+}
+
+// Note where the last system record of every PG is, as an offset from the start of the config, 0 if there is none.
+// PGs past PG_REGISTRY_MAX in the registry are left to findEEPROM().
+// this function assumes that EEPROM content is valid
+static void indexEEPROM(uint16_t *recordOffsets)
+{
+    memset(recordOffsets, 0, PG_REGISTRY_MAX * sizeof(*recordOffsets));
+
+    const uint8_t *p = &__config_start;
+    p += sizeof(configHeader_t);             // skip header
+    for (const configRecord_t *record; (record = nextRecord(&p)); ) {
+        if ((record->flags & CR_CLASSIFICATION_MASK) == CR_CLASSICATION_SYSTEM) {
+            const pgRegistry_t *reg = pgFind(record->pgn);
+            // records that were appended later replace those in front of them
+            if (reg && pgRegistryIndex(reg) < PG_REGISTRY_MAX) {
+                recordOffsets[pgRegistryIndex(reg)] = (const uint8_t *)record - &__config_start;
+            }
+        }
+    }
+}
+
+static const configRecord_t *storedRecord(const pgRegistry_t *reg, const uint16_t *recordOffsets)
+{
+    if (pgRegistryIndex(reg) < PG_REGISTRY_MAX) {
+        const uint16_t offset = recordOffsets[pgRegistryIndex(reg)];
+        return offset ? (const configRecord_t *)(&__config_start + offset) : NULL;
+    }
+    return findEEPROM(reg, CR_CLASSICATION_SYSTEM);
 }
 
 // Initialize all PG records from EEPROM.
-// This functions processes all PGs sequentially, scanning EEPROM for each one. This is suboptimal,
-//   but each PG is loaded/initialized exactly once and in defined order.
+// The records are indexed in a single pass, then each PG is loaded/initialized exactly once and in defined order.
 bool loadEEPROM(void)
 {
     bool success = true;
+    uint16_t recordOffsets[PG_REGISTRY_MAX];
+
+    indexEEPROM(recordOffsets);
 
     PG_FOREACH(reg) {
-        const configRecord_t *rec = findEEPROM(reg, CR_CLASSICATION_SYSTEM);
+        const configRecord_t *rec = storedRecord(reg, recordOffsets);
+
         if (rec) {
             // config from EEPROM is available, use it to initialize PG. pgLoad will handle version mismatch
             if (!pgLoad(reg, rec->pg, rec->size - offsetof(configRecord_t, pg), rec->version)) {
@@ -393,6 +516,89 @@ bool loadEEPROM(void)
     return success;
 }
 
+static bool isRecordCurrent(const pgRegistry_t *reg, const configRecord_t *rec)
+{
+    return rec
+        && rec->version == pgVersion(reg)
+        && rec->size == sizeof(configRecord_t) + pgSize(reg)
+        && memcmp(rec->pg, reg->address, pgSize(reg)) == 0;
+}
+
+// Size of the records that have to be appended for the config to match every PG, 0 if it does already.
+// this function assumes that EEPROM content is valid
+static uint32_t unsavedSettingsSize(const uint16_t *recordOffsets)
+{
+    uint32_t size = 0;
+
+    PG_FOREACH(reg) {
+        if (!isRecordCurrent(reg, storedRecord(reg, recordOffsets))) {
+            size += logRecordSize(sizeof(configRecord_t) + pgSize(reg));
+        }
+    }
+
+    return size;
+}
+
+// Append a record for every PG that differs from what is stored. Returns false when the config has to be compacted
+// instead, because it isn't valid, the log is full or what follows it can't be written without an erase.
+static bool appendSettingsToEEPROM(void)
+{
+    if (!isEEPROMVersionValid() || !isEEPROMStructureValid()) {
+        return false;
+    }
+
+    uint16_t recordOffsets[PG_REGISTRY_MAX];
+    indexEEPROM(recordOffsets);
+
+    const uint32_t appendSize = unsavedSettingsSize(recordOffsets);
+    if (appendSize == 0) {
+        return true;
+    }
+
+    uint8_t *logEnd = &__config_start + eepromConfigSize;
+    if (appendSize > (uint32_t)(&__config_end - logEnd)
+        || !config_streamer_is_writable((uintptr_t)logEnd, appendSize)) {
+        return false;
+    }
+
+    config_streamer_t streamer;
+    config_streamer_init(&streamer);
+
+    config_streamer_start(&streamer, (uintptr_t)logEnd, appendSize);
+
+    const uint16_t generation = eepromGeneration();
+    PG_FOREACH(reg) {
+        if (isRecordCurrent(reg, storedRecord(reg, recordOffsets))) {
+            continue;
+        }
+
+        const uint16_t regSize = pgSize(reg);
+        configRecord_t record = {
+            .size = sizeof(configRecord_t) + regSize,
+            .pgn = pgN(reg),
+            .version = pgVersion(reg),
+            .flags = CR_CLASSICATION_SYSTEM
+        };
+
+        uint16_t crc = CRC_START_VALUE;
+        crc = crc16_ccitt_update(crc, &generation, sizeof(generation));
+        crc = crc16_ccitt_update(crc, &record, sizeof(record));
+        crc = crc16_ccitt_update(crc, reg->address, regSize);
+        const configRecordCrc_t recordCrc = crc;
+
+        config_streamer_write(&streamer, (uint8_t *)&record, sizeof(record));
+        config_streamer_write(&streamer, reg->address, regSize);
+        config_streamer_write(&streamer, (uint8_t *)&recordCrc, sizeof(recordCrc));
+
+        // the next record starts on a word of its own
+        config_streamer_flush(&streamer);
+    }
+
+    const bool success = config_streamer_finish(&streamer) == 0;
+
+    return success;
+}
+
 static bool writeSettingsToEEPROM(void)
 {
     config_streamer_t streamer;
@@ -403,6 +609,8 @@ static bool writeSettingsToEEPROM(void)
     configHeader_t header = {
         .eepromConfigVersion =  EEPROM_CONF_VERSION,
         .magic_be =             0xBE,
+        // whatever the log of the last generation left behind is no longer valid
+        .generation =           eepromGeneration() + 1,
     };
 
     config_streamer_write(&streamer, (uint8_t *)&header, sizeof(header));
@@ -442,22 +650,40 @@ static bool writeSettingsToEEPROM(void)
     return success;
 }
 
+static bool reloadEEPROM(void)
+{
+#if defined(CONFIG_IN_EXTERNAL_FLASH)
+    // copy it back from flash to the in-memory buffer.
+    return loadEEPROMFromExternalFlash();
+#elif defined(CONFIG_IN_SDCARD)
+    // copy it back from flash to the in-memory buffer.
+    return loadEEPROMFromSDCard();
+#else
+    return true;
+#endif
+}
+
+// Check that what was written reads back, and that it matches every PG.
+static bool isEEPROMSaved(void)
+{
+    if (!reloadEEPROM() || !isEEPROMVersionValid() || !isEEPROMStructureValid()) {
+        return false;
+    }
+
+    uint16_t recordOffsets[PG_REGISTRY_MAX];
+    indexEEPROM(recordOffsets);
+
+    return unsavedSettingsSize(recordOffsets) == 0;
+}
+
 void writeConfigToEEPROM(void)
 {
-    bool success = false;
-    // write it
+    // append what changed, compact the whole config if that doesn't work out
+    bool success = appendSettingsToEEPROM() && isEEPROMSaved();
+
     for (int attempt = 0; attempt < 3 && !success; attempt++) {
         if (writeSettingsToEEPROM()) {
-            success = true;
-
-#ifdef CONFIG_IN_EXTERNAL_FLASH
-            // copy it back from flash to the in-memory buffer.
-            success = loadEEPROMFromExternalFlash();
-#endif
-#ifdef CONFIG_IN_SDCARD
-            // copy it back from flash to the in-memory buffer.
-            success = loadEEPROMFromSDCard();
-#endif
+            success = reloadEEPROM();
         }
     }
 
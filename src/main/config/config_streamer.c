@@ -22,19 +22,14 @@
 
 #include "platform.h"
 
+#include "common/maths.h"
+#include "common/utils.h"
+
 #include "drivers/system.h"
 #include "drivers/flash.h"
 
 #include "config/config_streamer.h"
 
-#if !defined(CONFIG_IN_FLASH)
-#if defined(CONFIG_IN_RAM) && defined(PERSISTENT)
-PERSISTENT uint8_t eepromData[EEPROM_SIZE];
-#else
-uint8_t eepromData[EEPROM_SIZE];
-#endif
-#endif
-
 
 #if defined(STM32H750xx) && !(defined(CONFIG_IN_EXTERNAL_FLASH) || defined(CONFIG_IN_RAM) || defined(CONFIG_IN_SDCARD))
 #error "STM32750xx only has one flash page which contains the bootloader, no spare flash pages available, use external storage for persistent config or ram for target testing"
@@ -80,6 +75,17 @@ uint8_t eepromData[EEPROM_SIZE];
 # endif
 #endif
 
+#if !defined(CONFIG_IN_FLASH)
+#if defined(CONFIG_IN_RAM) && defined(PERSISTENT)
+PERSISTENT uint8_t eepromData[EEPROM_SIZE];
+#elif defined(CONFIG_IN_FILE)
+// Pages are erased as the streamer gets to them, like the embedded flash
+uint8_t eepromData[EEPROM_SIZE] __attribute__((aligned(FLASH_PAGE_SIZE)));
+#else
+uint8_t eepromData[EEPROM_SIZE];
+#endif
+#endif
+
 void config_streamer_init(config_streamer_t *c)
 {
     memset(c, 0, sizeof(*c));
@@ -90,6 +96,9 @@ void config_streamer_start(config_streamer_t *c, uintptr_t base, int size)
     // base must start at FLASH_PAGE_SIZE boundary when using embedded flash.
     c->address = base;
     c->size = size;
+#ifdef CONFIG_IN_EXTERNAL_FLASH
+    c->pageProgramming = false;
+#endif
     if (!c->unlocked) {
 #if defined(CONFIG_IN_RAM) || defined(CONFIG_IN_EXTERNAL_FLASH) || defined(CONFIG_IN_SDCARD)
         // NOP
@@ -379,10 +388,10 @@ static int write_word(config_streamer_t *c, config_streamer_buffer_align_type_t
     uint32_t flashPageSize = flashGeometry->pageSize;
 
     bool onPageBoundary = (flashAddress % flashPageSize == 0);
-    if (onPageBoundary) {
+    if (onPageBoundary || !c->pageProgramming) {
 
-        bool firstPage = (flashAddress == flashStartAddress);
-        if (!firstPage) {
+        // a stream that carries on from what is there already starts within a page
+        if (c->pageProgramming) {
             flashPageProgramFinish();
         }
 
@@ -391,6 +400,7 @@ static int write_word(config_streamer_t *c, config_streamer_buffer_align_type_t
         }
 
         flashPageProgramBegin(flashAddress);
+        c->pageProgramming = true;
     }
 
     flashPageProgramContinue((uint8_t *)buffer, CONFIG_STREAMER_BUFFER_SIZE);
@@ -400,14 +410,7 @@ static int write_word(config_streamer_t *c, config_streamer_buffer_align_type_t
         memset(eepromData, 0, sizeof(eepromData));
     }
 
-    uint64_t *dest_addr = (uint64_t *)c->address;
-    uint64_t *src_addr = (uint64_t*)buffer;
-    uint8_t row_index = 4;
-    /* copy the 256 bits flash word */
-    do
-    {
-      *dest_addr++ = *src_addr++;
-    } while (--row_index != 0);
+    memcpy((void *)c->address, buffer, CONFIG_STREAMER_BUFFER_SIZE);
 
 #elif defined(CONFIG_IN_FILE)
 
@@ -487,6 +490,46 @@ static int write_word(config_streamer_t *c, config_streamer_buffer_align_type_t
     return 0;
 }
 
+/*
+ * Returns true if `size` bytes from `address` can be streamed out without an erase of what is in front of them. The
+ * streamer erases every page it gets to the start of, what is left of the page the stream starts in has to be
+ * erased already.
+ */
+bool config_streamer_is_writable(uintptr_t address, int size)
+{
+#if defined(CONFIG_IN_RAM) || defined(CONFIG_IN_SDCARD)
+    UNUSED(address);
+    UNUSED(size);
+
+    return true;
+#else
+#if defined(CONFIG_IN_EXTERNAL_FLASH)
+    const flashGeometry_t *flashGeometry = flashGetGeometry();
+    if (flashGeometry->flashType != FLASH_TYPE_NOR) {
+        // NAND pages are programmed in one go
+        return false;
+    }
+
+    // the partition starts on a sector
+    const uint32_t eraseSize = flashGeometry->sectorSize;
+    const uint32_t offset = (uint32_t)(address - (uintptr_t)&eepromData[0]) % eraseSize;
+#else
+    const uint32_t eraseSize = FLASH_PAGE_SIZE;
+    const uint32_t offset = address % eraseSize;
+#endif
+    const uint8_t *p = (const uint8_t *)address;
+    const uint32_t erasedSize = offset ? MIN((uint32_t)size, eraseSize - offset) : 0;
+
+    for (uint32_t i = 0; i < erasedSize; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+#endif
+}
+
 int config_streamer_write(config_streamer_t *c, const uint8_t *p, uint32_t size)
 {
     for (const uint8_t *pat = p; pat != (uint8_t*)p + size; pat++) {
@@ -47,6 +47,9 @@ typedef struct config_streamer_s {
     int at;
     int err;
     bool unlocked;
+#ifdef CONFIG_IN_EXTERNAL_FLASH
+    bool pageProgramming;
+#endif
 } config_streamer_t;
 
 void config_streamer_init(config_streamer_t *c);
@@ -57,3 +60,5 @@ int config_streamer_flush(config_streamer_t *c);
 
 int config_streamer_finish(config_streamer_t *c);
 int config_streamer_status(config_streamer_t *c);
+
+bool config_streamer_is_writable(uintptr_t address, int size);
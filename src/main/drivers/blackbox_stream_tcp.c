@@ -0,0 +1,112 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Blackbox stream transport for SITL, the chunks go to a TCP client on BLACKBOX_STREAM_TCP_PORT, see
+ * support/bbcapture for the reading side.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "platform.h"
+
+#ifdef USE_BLACKBOX_STREAM
+
+#include "blackbox/blackbox_stream.h"
+
+#include "dyad.h"
+
+#define BLACKBOX_STREAM_TCP_PORT    5770    // above the UART ports of serial_tcp.c
+// dyad buffers whatever it can't send right away, a client that falls further behind than this loses chunks
+#define BLACKBOX_STREAM_TCP_BACKLOG (256 * 1024)
+
+static dyad_Stream *streamServer;
+static dyad_Stream *streamClient;
+static uint32_t streamBytesQueued;
+
+static void onClose(dyad_Event *e)
+{
+    if (e->stream == streamClient) {
+        fprintf(stderr, "[CLS]blackbox stream\n");
+        streamClient = NULL;
+    }
+}
+
+static void onAccept(dyad_Event *e)
+{
+    if (streamClient) {
+        // One reader at a time, a second one would get a log with holes
+        dyad_close(e->remote);
+        return;
+    }
+
+    fprintf(stderr, "[NEW]blackbox stream\n");
+    streamBytesQueued = 0;
+    dyad_setNoDelay(e->remote, 1);
+    dyad_addListener(e->remote, DYAD_EVENT_CLOSE, onClose, NULL);
+    streamClient = e->remote;
+}
+
+void blackboxStreamTransportInit(void)
+{
+    if (streamServer) {
+        return;
+    }
+
+    streamServer = dyad_newStream();
+    dyad_addListener(streamServer, DYAD_EVENT_ACCEPT, onAccept, NULL);
+
+    if (dyad_listenEx(streamServer, NULL, BLACKBOX_STREAM_TCP_PORT, 1) == 0) {
+        fprintf(stderr, "bind port %u for blackbox stream\n", (unsigned)BLACKBOX_STREAM_TCP_PORT);
+    } else {
+        fprintf(stderr, "bind port %u for blackbox stream failed!!\n", (unsigned)BLACKBOX_STREAM_TCP_PORT);
+    }
+}
+
+bool blackboxStreamTransportIsConnected(void)
+{
+    return streamClient != NULL;
+}
+
+uint32_t blackboxStreamTransportTxBytesFree(void)
+{
+    if (!streamClient) {
+        return 0;
+    }
+
+    const uint32_t backlog = streamBytesQueued - (uint32_t)dyad_getBytesSent(streamClient);
+    return backlog < BLACKBOX_STREAM_TCP_BACKLOG ? BLACKBOX_STREAM_TCP_BACKLOG - backlog : 0;
+}
+
+bool blackboxStreamTransportSend(const uint8_t *data, int length)
+{
+    if (blackboxStreamTransportTxBytesFree() < (uint32_t)length) {
+        return false;
+    }
+
+    dyad_write(streamClient, data, length);
+    streamBytesQueued += length;
+
+    return true;
+}
+
+#endif // USE_BLACKBOX_STREAM
@@ -23,6 +23,8 @@
 
 #include "platform.h"
 
+#include "common/maths.h"
+
 #include "serial.h"
 
 void serialPrint(serialPort_t *instance, const char *str)
@@ -74,6 +76,20 @@ uint8_t serialRead(serialPort_t *instance)
     return instance->vTable->serialRead(instance);
 }
 
+// Read up to count bytes of what is waiting, returns how many were read.
+uint32_t serialReadBuf(serialPort_t *instance, uint8_t *data, uint32_t count)
+{
+    if (instance->vTable->readBuf) {
+        return instance->vTable->readBuf(instance, data, count);
+    }
+
+    const uint32_t waiting = MIN(count, serialRxBytesWaiting(instance));
+    for (uint32_t i = 0; i < waiting; i++) {
+        data[i] = serialRead(instance);
+    }
+    return waiting;
+}
+
 void serialSetBaudRate(serialPort_t *instance, uint32_t baudRate)
 {
     instance->vTable->serialSetBaudRate(instance, baudRate);
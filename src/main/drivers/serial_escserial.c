@@ -866,7 +866,8 @@ const struct serialPortVTable escSerialVTable[] = {
         .setBaudRateCb = NULL,
         .writeBuf = NULL,
         .beginWrite = NULL,
-        .endWrite = NULL
+        .endWrite = NULL,
+        .readBuf = NULL
     }
 };
 
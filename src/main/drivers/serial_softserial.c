@@ -644,7 +644,8 @@ static const struct serialPortVTable softSerialVTable = {
     .setBaudRateCb = NULL,
     .writeBuf = NULL,
     .beginWrite = NULL,
-    .endWrite = NULL
+    .endWrite = NULL,
+    .readBuf = NULL
 };
 
 #endif
@@ -27,12 +27,14 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include "platform.h"
 
 #include "build/build_config.h"
 
+#include "common/maths.h"
 #include "common/utils.h"
 
 #include "io/serial.h"
@@ -204,6 +206,28 @@ uint8_t tcpRead(serialPort_t *instance)
     return ch;
 }
 
+uint32_t tcpReadBuf(serialPort_t *instance, uint8_t *data, uint32_t count)
+{
+    tcpPort_t *s = (tcpPort_t *)instance;
+    uint32_t read = 0;
+    pthread_mutex_lock(&s->rxLock);
+
+    // At most two spans, up to the end of the buffer and on from its start
+    while (read < count && s->port.rxBufferTail != s->port.rxBufferHead) {
+        const uint32_t end = s->port.rxBufferHead > s->port.rxBufferTail ? s->port.rxBufferHead : s->port.rxBufferSize;
+        const uint32_t span = MIN(count - read, end - s->port.rxBufferTail);
+        memcpy(&data[read], (const uint8_t *)&s->port.rxBuffer[s->port.rxBufferTail], span);
+        read += span;
+        s->port.rxBufferTail += span;
+        if (s->port.rxBufferTail >= s->port.rxBufferSize) {
+            s->port.rxBufferTail = 0;
+        }
+    }
+    pthread_mutex_unlock(&s->rxLock);
+
+    return read;
+}
+
 void tcpWrite(serialPort_t *instance, uint8_t ch)
 {
     tcpPort_t *s = (tcpPort_t *)instance;
@@ -271,4 +295,5 @@ static const struct serialPortVTable tcpVTable = {
         .writeBuf = NULL,
         .beginWrite = NULL,
         .endWrite = NULL,
+        .readBuf = tcpReadBuf,
 };
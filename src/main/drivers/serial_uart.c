@@ -27,6 +27,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -34,6 +35,7 @@
 
 #include "build/build_config.h"
 
+#include "common/maths.h"
 #include "common/utils.h"
 
 #include "drivers/dma.h"
@@ -189,6 +191,39 @@ static uint8_t uartRead(serialPort_t *instance)
     return ch;
 }
 
+static uint32_t uartReadBuf(serialPort_t *instance, uint8_t *data, uint32_t count)
+{
+    uartPort_t *s = (uartPort_t *)instance;
+
+    count = MIN(count, uartTotalRxBytesWaiting(instance));
+
+    // At most two spans, up to the end of the buffer and on from its start
+    for (uint32_t read = 0; read < count; ) {
+#ifdef USE_DMA
+        if (s->rxDMAResource) {
+            const uint32_t span = MIN(count - read, s->rxDMAPos);
+            memcpy(&data[read], (const uint8_t *)&s->port.rxBuffer[s->port.rxBufferSize - s->rxDMAPos], span);
+            read += span;
+            s->rxDMAPos -= span;
+            if (s->rxDMAPos == 0) {
+                s->rxDMAPos = s->port.rxBufferSize;
+            }
+        } else
+#endif
+        {
+            const uint32_t span = MIN(count - read, s->port.rxBufferSize - s->port.rxBufferTail);
+            memcpy(&data[read], (const uint8_t *)&s->port.rxBuffer[s->port.rxBufferTail], span);
+            read += span;
+            s->port.rxBufferTail += span;
+            if (s->port.rxBufferTail >= s->port.rxBufferSize) {
+                s->port.rxBufferTail = 0;
+            }
+        }
+    }
+
+    return count;
+}
+
 static void uartWrite(serialPort_t *instance, uint8_t ch)
 {
     uartPort_t *s = (uartPort_t *)instance;
@@ -229,6 +264,7 @@ const struct serialPortVTable uartVTable[] = {
         .writeBuf = NULL,
         .beginWrite = NULL,
         .endWrite = NULL,
+        .readBuf = uartReadBuf,
     }
 };
 
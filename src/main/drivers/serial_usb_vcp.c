@@ -122,6 +122,13 @@ static uint8_t usbVcpRead(serialPort_t *instance)
     }
 }
 
+static uint32_t usbVcpReadBuf(serialPort_t *instance, uint8_t *data, uint32_t count)
+{
+    UNUSED(instance);
+
+    return CDC_Receive_DATA(data, count);
+}
+
 static void usbVcpWriteBuf(serialPort_t *instance, const void *data, int count)
 {
     UNUSED(instance);
@@ -212,7 +219,8 @@ static const struct serialPortVTable usbVTable[] = {
         .setBaudRateCb = usbVcpSetBaudRateCb,
         .writeBuf = usbVcpWriteBuf,
         .beginWrite = usbVcpBeginWrite,
-        .endWrite = usbVcpEndWrite
+        .endWrite = usbVcpEndWrite,
+        .readBuf = usbVcpReadBuf
     }
 };
 
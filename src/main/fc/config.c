@@ -101,7 +101,7 @@ PG_RESET_TEMPLATE(pilotConfig_t, pilotConfig,
     .displayName = { 0 },
 );
 
-PG_REGISTER_WITH_RESET_TEMPLATE(systemConfig_t, systemConfig, PG_SYSTEM_CONFIG, 2);
+PG_REGISTER_WITH_RESET_TEMPLATE(systemConfig_t, systemConfig, PG_SYSTEM_CONFIG, 4);
 
 PG_RESET_TEMPLATE(systemConfig_t, systemConfig,
     .pidProfileIndex = 0,
@@ -114,6 +114,8 @@ PG_RESET_TEMPLATE(systemConfig_t, systemConfig,
     .hseMhz = SYSTEM_HSE_VALUE,  // Not used for non-F4 targets
     .configurationState = CONFIGURATION_STATE_DEFAULTS_BARE,
     .schedulerOptimizeRate = SCHEDULER_OPTIMIZE_RATE_AUTO,
+    .schedulerDeadlineQueue = false,
+    .schedulerDeadlineGuard = false,
 );
 
 uint8_t getCurrentPidProfileIndex(void)
@@ -148,6 +150,8 @@ void resetConfig(void)
 static void activateConfig(void)
 {
     schedulerOptimizeRate(systemConfig()->schedulerOptimizeRate == SCHEDULER_OPTIMIZE_RATE_ON || (systemConfig()->schedulerOptimizeRate == SCHEDULER_OPTIMIZE_RATE_AUTO && motorConfig()->dev.useDshotTelemetry));
+    schedulerUseDeadlineQueue(systemConfig()->schedulerDeadlineQueue);
+    schedulerUseDeadlineGuard(systemConfig()->schedulerDeadlineGuard);
     loadPidProfile();
     loadControlRateProfile();
 
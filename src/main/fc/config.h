@@ -60,6 +60,8 @@ typedef struct systemConfig_s {
     uint8_t hseMhz; // Not used for non-F4 targets
     uint8_t configurationState; // The state of the configuration (defaults / configured)
     uint8_t schedulerOptimizeRate;
+    uint8_t schedulerDeadlineQueue;
+    uint8_t schedulerDeadlineGuard;
 } systemConfig_t;
 
 PG_DECLARE(systemConfig_t, systemConfig);
@@ -202,6 +202,8 @@ static void taskCalculateAltitude(timeUs_t currentTimeUs)
 #endif // USE_BARO || USE_GPS
 
 #ifdef USE_TELEMETRY
+// Not split into steps like osdUpdate(), only the provider with an open port does any work and the polled ones
+// (SmartPort, Jeti EX Bus, CRSF) have to answer in the run that sees the poll
 static void taskTelemetry(timeUs_t currentTimeUs)
 {
     if (!cliMode && featureIsEnabled(FEATURE_TELEMETRY)) {
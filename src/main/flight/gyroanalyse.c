@@ -23,7 +23,9 @@
  * coding assistance and advice from DieHertz, Rav, eTracer
  * test pilots icr4sh, UAV Tech, Flint723
  */
+#include <math.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -48,18 +50,24 @@
 // A sampling frequency of 1000 and max frequency of 500 at a window size of 32 gives 16 frequency bins each 31.25Hz wide
 // Eg [0,31), [31,62), [62, 93) etc
 // for gyro loop >= 4KHz, sample rate 2000 defines FFT range to 1000Hz, 16 bins each 62.5 Hz wide
-// NB  FFT_WINDOW_SIZE is set to 32 in gyroanalyse.h
-#define FFT_BIN_COUNT             (FFT_WINDOW_SIZE / 2)
+// NB  FFT_WINDOW_SIZE is 32 by default, see gyroanalyse.h
 // smoothing frequency for FFT centre frequency
 #define DYN_NOTCH_SMOOTH_FREQ_HZ  50
 // we need 4 steps for each axis
 #define DYN_NOTCH_CALC_TICKS      (XYZ_AXIS_COUNT * 4)
+// the sliding DFT keeps the spectrum up to date, so it only needs 2 steps for each axis
+#define DYN_NOTCH_SDFT_CALC_TICKS (XYZ_AXIS_COUNT * 2)
+// damping keeps the rounding errors of the sliding DFT from accumulating
+#define SDFT_DAMPING              0.9999f
+// peak tracking follows the tallest two peaks, a second peak smaller than this fraction of the first is ignored
+#define DYN_NOTCH_PEAK_COUNT      2
+#define DYN_NOTCH_PEAK2_MIN_RATIO 0.3f
 
 #define DYN_NOTCH_OSD_MIN_THROTTLE 20
 
 static uint16_t FAST_RAM_ZERO_INIT   fftSamplingRateHz;
 static float FAST_RAM_ZERO_INIT      fftResolution;
-static uint8_t FAST_RAM_ZERO_INIT    fftStartBin;
+static uint16_t FAST_RAM_ZERO_INIT   fftStartBin;
 static uint16_t FAST_RAM_ZERO_INIT   dynNotchMaxCtrHz;
 static uint8_t dynamicFilterRange;
 static float FAST_RAM_ZERO_INIT      dynNotchQ;
@@ -68,10 +76,18 @@ static float FAST_RAM_ZERO_INIT      dynNotch2Ctr;
 static uint16_t FAST_RAM_ZERO_INIT   dynNotchMinHz;
 static bool FAST_RAM dualNotch = true;
 static uint16_t FAST_RAM_ZERO_INIT dynNotchMaxFFT;
+static uint8_t FAST_RAM_ZERO_INIT    dynNotchEngine;
+static bool FAST_RAM_ZERO_INIT       dynNotchPeakTrack;
 
 // Hanning window, see https://en.wikipedia.org/wiki/Window_function#Hann_.28Hanning.29_window
 static FAST_RAM_ZERO_INIT float hanningWindow[FFT_WINDOW_SIZE];
 
+// sliding DFT twiddle factors, damped by SDFT_DAMPING, and the first bin kept up to date
+static FAST_RAM_ZERO_INIT float sdftTwiddleRe[FFT_BIN_COUNT + 1];
+static FAST_RAM_ZERO_INIT float sdftTwiddleIm[FFT_BIN_COUNT + 1];
+static FAST_RAM_ZERO_INIT float sdftDampingPowN;
+static FAST_RAM_ZERO_INIT uint16_t sdftStartBin;
+
 void gyroDataAnalyseInit(uint32_t targetLooptimeUs)
 {
 #ifdef USE_MULTI_GYRO
@@ -88,10 +104,10 @@ void gyroDataAnalyseInit(uint32_t targetLooptimeUs)
     dynNotch2Ctr = 1 + gyroConfig()->dyn_notch_width_percent / 100.0f;
     dynNotchQ = gyroConfig()->dyn_notch_q / 100.0f;
     dynNotchMinHz = gyroConfig()->dyn_notch_min_hz;
+    dynNotchEngine = gyroConfig()->dyn_notch_engine;
+    dynNotchPeakTrack = gyroConfig()->dyn_notch_peak_track;
 
-    if (gyroConfig()->dyn_notch_width_percent == 0) {
-        dualNotch = false;
-    }
+    dualNotch = gyroConfig()->dyn_notch_width_percent != 0;
 
     if (dynamicFilterRange == DYN_NOTCH_RANGE_AUTO) {
         if (gyroConfig()->dyn_lpf_gyro_max_hz > 333) {
@@ -116,13 +132,22 @@ void gyroDataAnalyseInit(uint32_t targetLooptimeUs)
 
     fftResolution = (float)fftSamplingRateHz / FFT_WINDOW_SIZE;
 
-    fftStartBin = dynNotchMinHz / lrintf(fftResolution);
+    // the peak search compares each bin with the one below
+    fftStartBin = MAX(dynNotchMinHz / lrintf(fftResolution), 1);
 
     dynNotchMaxCtrHz = fftSamplingRateHz / 2; //Nyquist
 
     for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
         hanningWindow[i] = (0.5f - 0.5f * cos_approx(2 * M_PIf * i / (FFT_WINDOW_SIZE - 1)));
     }
+
+    // the sliding DFT windows in the frequency domain, which needs the bin either side of the searched ones
+    sdftStartBin = MAX(fftStartBin - 2, 0);
+    for (int i = 0; i <= FFT_BIN_COUNT; i++) {
+        sdftTwiddleRe[i] = SDFT_DAMPING * cos_approx(2 * M_PIf * i / FFT_WINDOW_SIZE);
+        sdftTwiddleIm[i] = SDFT_DAMPING * sin_approx(2 * M_PIf * i / FFT_WINDOW_SIZE);
+    }
+    sdftDampingPowN = powf(SDFT_DAMPING, FFT_WINDOW_SIZE);
 }
 
 void gyroDataAnalyseStateInit(gyroAnalyseState_t *state, uint32_t targetLooptimeUs)
@@ -137,15 +162,24 @@ void gyroDataAnalyseStateInit(gyroAnalyseState_t *state, uint32_t targetLooptime
 
     arm_rfft_fast_init_f32(&state->fftInstance, FFT_WINDOW_SIZE);
 
+    // the sliding DFT removes each sample again once it leaves the window, so both have to start out empty
+    memset(state->downsampledGyroData, 0, sizeof(state->downsampledGyroData));
+    memset(state->sdftRe, 0, sizeof(state->sdftRe));
+    memset(state->sdftIm, 0, sizeof(state->sdftIm));
+
 //    recalculation of filters takes 4 calls per axis => each filter gets updated every DYN_NOTCH_CALC_TICKS calls
 //    at 4khz gyro loop rate this means 4khz / 4 / 3 = 333Hz => update every 3ms
 //    for gyro rate > 16kHz, we have update frequency of 1kHz => 1ms
-    const float looptime = MAX(1000000u / fftSamplingRateHz, targetLooptimeUs * DYN_NOTCH_CALC_TICKS);
+    const int calcTicks = dynNotchEngine == DYN_NOTCH_ENGINE_SDFT ? DYN_NOTCH_SDFT_CALC_TICKS : DYN_NOTCH_CALC_TICKS;
+    const float looptime = MAX(1000000u / fftSamplingRateHz, targetLooptimeUs * calcTicks);
     for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
         // any init value
         state->centerFreq[axis] = dynNotchMaxCtrHz;
         state->prevCenterFreq[axis] = dynNotchMaxCtrHz;
         biquadFilterInitLPF(&state->detectedFrequencyFilter[axis], DYN_NOTCH_SMOOTH_FREQ_HZ, looptime);
+        state->centerFreq2[axis] = dynNotchMaxCtrHz;
+        state->prevCenterFreq2[axis] = dynNotchMaxCtrHz;
+        biquadFilterInitLPF(&state->detectedFrequencyFilter2[axis], DYN_NOTCH_SMOOTH_FREQ_HZ, looptime);
     }
 }
 
@@ -154,12 +188,29 @@ void gyroDataAnalysePush(gyroAnalyseState_t *state, const int axis, const float
     state->oversampledGyroAccumulator[axis] += sample;
 }
 
-static void gyroDataAnalyseUpdate(gyroAnalyseState_t *state, biquadFilter_t *notchFilterDyn, biquadFilter_t *notchFilterDyn2);
+/*
+ * Slide the DFT window of an axis by one sample, only the bins the peak search looks at are updated
+ */
+static FAST_CODE void gyroDataAnalyseSdftPush(gyroAnalyseState_t *state, int axis, float sample, float oldestSample)
+{
+    float *re = state->sdftRe[axis];
+    float *im = state->sdftIm[axis];
+    const float delta = sample - sdftDampingPowN * oldestSample;
+
+    for (int i = sdftStartBin; i <= FFT_BIN_COUNT; i++) {
+        const float binRe = re[i] + delta;
+        const float binIm = im[i];
+        re[i] = sdftTwiddleRe[i] * binRe - sdftTwiddleIm[i] * binIm;
+        im[i] = sdftTwiddleIm[i] * binRe + sdftTwiddleRe[i] * binIm;
+    }
+}
+
+static void gyroDataAnalyseUpdate(gyroAnalyseState_t *state, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2);
 
 /*
  * Collect gyro data, to be analysed in gyroDataAnalyseUpdate function
  */
-void gyroDataAnalyse(gyroAnalyseState_t *state, biquadFilter_t *notchFilterDyn, biquadFilter_t *notchFilterDyn2)
+void gyroDataAnalyse(gyroAnalyseState_t *state, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2)
 {
     // samples should have been pushed by `gyroDataAnalysePush`
     // if gyro sampling is > 1kHz, accumulate multiple samples
@@ -172,6 +223,9 @@ void gyroDataAnalyse(gyroAnalyseState_t *state, biquadFilter_t *notchFilterDyn,
         // calculate mean value of accumulated samples
         for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
             float sample = state->oversampledGyroAccumulator[axis] * state->maxSampleCountRcp;
+            if (dynNotchEngine == DYN_NOTCH_ENGINE_SDFT) {
+                gyroDataAnalyseSdftPush(state, axis, sample, state->downsampledGyroData[axis][state->circularBufferIdx]);
+            }
             state->downsampledGyroData[axis][state->circularBufferIdx] = sample;
             if (axis == 0) {
                 DEBUG_SET(DEBUG_FFT, 2, lrintf(sample));
@@ -183,7 +237,7 @@ void gyroDataAnalyse(gyroAnalyseState_t *state, biquadFilter_t *notchFilterDyn,
         state->circularBufferIdx = (state->circularBufferIdx + 1) % FFT_WINDOW_SIZE;
 
         // We need DYN_NOTCH_CALC_TICKS tick to update all axis with newly sampled value
-        state->updateTicks = DYN_NOTCH_CALC_TICKS;
+        state->updateTicks = dynNotchEngine == DYN_NOTCH_ENGINE_SDFT ? DYN_NOTCH_SDFT_CALC_TICKS : DYN_NOTCH_CALC_TICKS;
     }
 
     // calculate FFT and update filters
@@ -199,10 +253,255 @@ void arm_cfft_radix8by4_f32(arm_cfft_instance_f32 *S, float32_t *p1);
 void arm_radix8_butterfly_f32(float32_t *pSrc, uint16_t fftLen, const float32_t *pCoef, uint16_t twidCoefModifier);
 void arm_bitreversal_32(uint32_t *pSrc, const uint16_t bitRevLen, const uint16_t *pBitRevTable);
 
+/*
+ * Hanning windowed magnitudes of the sliding DFT bins of the current axis, the window is
+ * applied in the frequency domain as a convolution with its three non zero bins
+ */
+static FAST_CODE void gyroDataAnalyseSdftMagnitude(gyroAnalyseState_t *state)
+{
+    const float *re = state->sdftRe[state->updateAxis];
+    const float *im = state->sdftIm[state->updateAxis];
+
+    for (int i = fftStartBin - 1; i < FFT_BIN_COUNT; i++) {
+        // bin -1 is the complex conjugate of bin 1
+        const float lowerRe = i > 0 ? re[i - 1] : re[1];
+        const float lowerIm = i > 0 ? im[i - 1] : -im[1];
+        const float windowedRe = 0.5f * re[i] - 0.25f * (lowerRe + re[i + 1]);
+        const float windowedIm = 0.5f * im[i] - 0.25f * (lowerIm + im[i + 1]);
+        state->fftData[i] = sqrtf(windowedRe * windowedRe + windowedIm * windowedIm);
+    }
+}
+
+/*
+ * Find the tallest local maxima of the spectrum and place them between their neighbouring bins
+ * with quadratic interpolation. Returns the number of peaks found, tallest first.
+ */
+static int gyroDataAnalyseFindPeaks(const float *fftData, float *peakBins)
+{
+    int peakIndex[DYN_NOTCH_PEAK_COUNT] = { 0 };
+    int peakCount = 0;
+
+    for (int i = fftStartBin; i < FFT_BIN_COUNT - 1; i++) {
+        if (fftData[i] > fftData[i - 1] && fftData[i] >= fftData[i + 1]) {
+            if (peakCount < DYN_NOTCH_PEAK_COUNT) {
+                peakCount++;
+            } else if (fftData[i] <= fftData[peakIndex[peakCount - 1]]) {
+                continue;
+            }
+            // insert, keeping the peaks sorted by height
+            int slot = peakCount - 1;
+            while (slot > 0 && fftData[i] > fftData[peakIndex[slot - 1]]) {
+                peakIndex[slot] = peakIndex[slot - 1];
+                slot--;
+            }
+            peakIndex[slot] = i;
+        }
+    }
+
+    for (int i = 1; i < peakCount; i++) {
+        if (fftData[peakIndex[i]] < DYN_NOTCH_PEAK2_MIN_RATIO * fftData[peakIndex[0]]) {
+            peakCount = i;
+            break;
+        }
+    }
+
+    for (int i = 0; i < peakCount; i++) {
+        const float y0 = fftData[peakIndex[i] - 1];
+        const float y1 = fftData[peakIndex[i]];
+        const float y2 = fftData[peakIndex[i] + 1];
+        const float denominator = y0 - 2 * y1 + y2;
+        const float offset = denominator != 0.0f ? 0.5f * (y0 - y2) / denominator : 0.0f;
+        peakBins[i] = peakIndex[i] + constrainf(offset, -0.5f, 0.5f);
+    }
+
+    return peakCount;
+}
+
+/*
+ * Cubed magnitude weighted mean of the tallest peak and its shoulders, returns the mean bin or -1 if there is none
+ */
+static float gyroDataAnalyseWeightedMean(const float *fftData)
+{
+    bool fftIncreased = false;
+    float dataMax = 0;
+    int binStart = 0;
+    int binMax = 0;
+    //for bins after initial decline, identify start bin and max bin 
+    for (int i = fftStartBin; i < FFT_BIN_COUNT; i++) {
+        if (fftIncreased || (fftData[i] > fftData[i - 1])) {
+            if (!fftIncreased) {
+                binStart = i; // first up-step bin
+                fftIncreased = true;
+            }
+            if (fftData[i] > dataMax) {
+                dataMax = fftData[i];
+                binMax = i;  // tallest bin
+            }
+        }
+    }
+    // accumulate fftSum and fftWeightedSum from peak bin, and shoulder bins either side of peak
+    float cubedData = fftData[binMax] * fftData[binMax] * fftData[binMax];
+    float fftSum = cubedData;
+    float fftWeightedSum = cubedData * (binMax + 1);
+    // accumulate upper shoulder
+    for (int i = binMax; i < FFT_BIN_COUNT - 1; i++) {
+        if (fftData[i] > fftData[i + 1]) {
+            cubedData = fftData[i] * fftData[i] * fftData[i];
+            fftSum += cubedData;
+            fftWeightedSum += cubedData * (i + 1);
+        } else {
+        break;
+        }
+    }
+    // accumulate lower shoulder
+    for (int i = binMax; i > binStart + 1; i--) {
+        if (fftData[i] > fftData[i - 1]) {
+            cubedData = fftData[i] * fftData[i] * fftData[i];
+            fftSum += cubedData;
+            fftWeightedSum += cubedData * (i + 1);
+        } else {
+        break;
+        }
+    }
+    // idx was shifted by 1 to start at 1, not 0
+    if (fftSum > 0) {
+        return (fftWeightedSum / fftSum) - 1;
+    }
+    return -1;
+}
+
+static FAST_CODE_NOINLINE void gyroDataAnalyseCalcFrequencies(gyroAnalyseState_t *state)
+{
+    const int axis = state->updateAxis;
+
+    // get center of relevant frequency range (this way we have a better resolution than 31.25Hz)
+    float centerFreq = state->prevCenterFreq[axis];
+    float centerFreq2 = 0;
+    float fftMeanIndex = 0;
+    if (dynNotchPeakTrack) {
+        float peakBins[DYN_NOTCH_PEAK_COUNT];
+        const int peakCount = gyroDataAnalyseFindPeaks(state->fftData, peakBins);
+        if (peakCount > 0) {
+            fftMeanIndex = peakBins[0];
+            centerFreq = peakBins[0] * fftResolution;
+        }
+        // without a second peak the second notch deepens the first
+        centerFreq2 = centerFreq;
+        if (peakCount > 1) {
+            centerFreq2 = peakBins[1] * fftResolution;
+            // keep each peak on its own notch, so the notches don't swap places when the peaks change height
+            if (fabsf(centerFreq - state->centerFreq2[axis]) + fabsf(centerFreq2 - state->centerFreq[axis])
+                < fabsf(centerFreq - state->centerFreq[axis]) + fabsf(centerFreq2 - state->centerFreq2[axis])) {
+                const float swap = centerFreq;
+                centerFreq = centerFreq2;
+                centerFreq2 = swap;
+            }
+        }
+    } else {
+        fftMeanIndex = gyroDataAnalyseWeightedMean(state->fftData);
+        if (fftMeanIndex >= 0) {
+            // the index points at the center frequency of each bin so index 0 is actually 16.125Hz
+            centerFreq = fftMeanIndex * fftResolution;
+        } else {
+            fftMeanIndex = 0;
+        }
+    }
+
+    centerFreq = fmax(centerFreq, dynNotchMinHz);
+    centerFreq = biquadFilterApply(&state->detectedFrequencyFilter[axis], centerFreq);
+    state->prevCenterFreq[axis] = state->centerFreq[axis];
+    state->centerFreq[axis] = centerFreq;
+
+    if (dynNotchPeakTrack) {
+        centerFreq2 = fmax(centerFreq2, dynNotchMinHz);
+        centerFreq2 = biquadFilterApply(&state->detectedFrequencyFilter2[axis], centerFreq2);
+        state->prevCenterFreq2[axis] = state->centerFreq2[axis];
+        state->centerFreq2[axis] = centerFreq2;
+    }
+
+    if(calculateThrottlePercentAbs() > DYN_NOTCH_OSD_MIN_THROTTLE) {
+        dynNotchMaxFFT = MAX(dynNotchMaxFFT, state->centerFreq[axis]);
+    }
+
+    if (axis == 0) {
+        DEBUG_SET(DEBUG_FFT, 3, lrintf(fftMeanIndex * 100));
+        DEBUG_SET(DEBUG_FFT_FREQ, 0, state->centerFreq[axis]);
+        DEBUG_SET(DEBUG_DYN_LPF, 1, state->centerFreq[axis]);
+    }
+    if (axis == 1) {
+        DEBUG_SET(DEBUG_FFT_FREQ, 1, state->centerFreq[axis]);
+    }
+    // Debug FFT_Freq carries raw gyro, gyro after first filter set, FFT centre for roll and for pitch
+}
+
+static FAST_CODE_NOINLINE void gyroDataAnalyseUpdateFilters(gyroAnalyseState_t *state, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2)
+{
+    const int axis = state->updateAxis;
+
+    if (dynNotchPeakTrack) {
+        // the notches sit on the tracked peaks
+        if (state->prevCenterFreq[axis] != state->centerFreq[axis]) {
+            biquadFilter3UpdateAxis(notchFilterDyn, axis, state->centerFreq[axis], gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
+        }
+        if (dualNotch && state->prevCenterFreq2[axis] != state->centerFreq2[axis]) {
+            biquadFilter3UpdateAxis(notchFilterDyn2, axis, state->centerFreq2[axis], gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
+        }
+        return;
+    }
+
+    // calculate cutoffFreq and notch Q, update notch filter  =1.8+((A2-150)*0.004)
+    if (state->prevCenterFreq[axis] != state->centerFreq[axis]) {
+        if (dualNotch) {
+            biquadFilter3UpdateAxis(notchFilterDyn, axis, state->centerFreq[axis] * dynNotch1Ctr, gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
+            biquadFilter3UpdateAxis(notchFilterDyn2, axis, state->centerFreq[axis] * dynNotch2Ctr, gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
+        } else {
+            biquadFilter3UpdateAxis(notchFilterDyn, axis, state->centerFreq[axis], gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
+        }
+    }
+}
+
+/*
+ * Analyse the sliding DFT spectrum, kept up to date by gyroDataAnalyseSdftPush
+ */
+static FAST_CODE_NOINLINE void gyroDataAnalyseUpdateSdft(gyroAnalyseState_t *state, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2)
+{
+    enum {
+        STEP_SDFT_MAGNITUDE,
+        STEP_UPDATE_FILTERS,
+        STEP_COUNT
+    };
+
+    uint32_t startTime = 0;
+    if (debugMode == (DEBUG_FFT_TIME)) {
+        startTime = micros();
+    }
+
+    DEBUG_SET(DEBUG_FFT_TIME, 0, state->updateStep);
+    switch (state->updateStep) {
+        case STEP_SDFT_MAGNITUDE:
+        {
+            gyroDataAnalyseSdftMagnitude(state);
+            gyroDataAnalyseCalcFrequencies(state);
+            DEBUG_SET(DEBUG_FFT_TIME, 1, micros() - startTime);
+            break;
+        }
+        case STEP_UPDATE_FILTERS:
+        {
+            gyroDataAnalyseUpdateFilters(state, notchFilterDyn, notchFilterDyn2);
+            DEBUG_SET(DEBUG_FFT_TIME, 1, micros() - startTime);
+
+            state->updateAxis = (state->updateAxis + 1) % XYZ_AXIS_COUNT;
+            break;
+        }
+    }
+
+    state->updateStep = (state->updateStep + 1) % STEP_COUNT;
+}
+
 /*
  * Analyse last gyro data from the last FFT_WINDOW_SIZE milliseconds
  */
-static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state, biquadFilter_t *notchFilterDyn, biquadFilter_t *notchFilterDyn2)
+static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2)
 {
     enum {
         STEP_ARM_CFFT_F32,
@@ -215,6 +514,11 @@ static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state,
         STEP_COUNT
     };
 
+    if (dynNotchEngine == DYN_NOTCH_ENGINE_SDFT) {
+        gyroDataAnalyseUpdateSdft(state, notchFilterDyn, notchFilterDyn2);
+        return;
+    }
+
     arm_cfft_instance_f32 *Sint = &(state->fftInstance.Sint);
 
     uint32_t startTime = 0;
@@ -228,6 +532,7 @@ static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state,
         {
             switch (FFT_BIN_COUNT) {
             case 16:
+            case 128:
                 // 16us
                 arm_cfft_radix8by2_f32(Sint, state->fftData);
                 break;
@@ -269,91 +574,14 @@ static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state,
         }
         case STEP_CALC_FREQUENCIES:
         {
-            bool fftIncreased = false;
-            float dataMax = 0;
-            uint8_t binStart = 0;
-            uint8_t binMax = 0;
-            //for bins after initial decline, identify start bin and max bin 
-            for (int i = fftStartBin; i < FFT_BIN_COUNT; i++) {
-                if (fftIncreased || (state->fftData[i] > state->fftData[i - 1])) {
-                    if (!fftIncreased) {
-                        binStart = i; // first up-step bin
-                        fftIncreased = true;
-                    }
-                    if (state->fftData[i] > dataMax) {
-                        dataMax = state->fftData[i];
-                        binMax = i;  // tallest bin
-                    }
-                }
-            }
-            // accumulate fftSum and fftWeightedSum from peak bin, and shoulder bins either side of peak
-            float cubedData = state->fftData[binMax] * state->fftData[binMax] * state->fftData[binMax];
-            float fftSum = cubedData;
-            float fftWeightedSum = cubedData * (binMax + 1);
-            // accumulate upper shoulder
-            for (int i = binMax; i < FFT_BIN_COUNT - 1; i++) {
-                if (state->fftData[i] > state->fftData[i + 1]) {
-                    cubedData = state->fftData[i] * state->fftData[i] * state->fftData[i];
-                    fftSum += cubedData;
-                    fftWeightedSum += cubedData * (i + 1);
-                } else {
-                break;
-                }
-            }
-            // accumulate lower shoulder
-            for (int i = binMax; i > binStart + 1; i--) {
-                if (state->fftData[i] > state->fftData[i - 1]) {
-                    cubedData = state->fftData[i] * state->fftData[i] * state->fftData[i];
-                    fftSum += cubedData;
-                    fftWeightedSum += cubedData * (i + 1);
-                } else {
-                break;
-                }
-            }
-            // get weighted center of relevant frequency range (this way we have a better resolution than 31.25Hz)
-            float centerFreq = dynNotchMaxCtrHz;
-            float fftMeanIndex = 0;
-             // idx was shifted by 1 to start at 1, not 0
-            if (fftSum > 0) {
-                fftMeanIndex = (fftWeightedSum / fftSum) - 1;
-                // the index points at the center frequency of each bin so index 0 is actually 16.125Hz
-                centerFreq = fftMeanIndex * fftResolution;
-            } else {
-                centerFreq = state->prevCenterFreq[state->updateAxis];
-            }
-            centerFreq = fmax(centerFreq, dynNotchMinHz);
-            centerFreq = biquadFilterApply(&state->detectedFrequencyFilter[state->updateAxis], centerFreq);
-            state->prevCenterFreq[state->updateAxis] = state->centerFreq[state->updateAxis];
-            state->centerFreq[state->updateAxis] = centerFreq;
-
-            if(calculateThrottlePercentAbs() > DYN_NOTCH_OSD_MIN_THROTTLE) {
-                dynNotchMaxFFT = MAX(dynNotchMaxFFT, state->centerFreq[state->updateAxis]);
-            }
-
-            if (state->updateAxis == 0) {
-                DEBUG_SET(DEBUG_FFT, 3, lrintf(fftMeanIndex * 100));
-                DEBUG_SET(DEBUG_FFT_FREQ, 0, state->centerFreq[state->updateAxis]);
-                DEBUG_SET(DEBUG_DYN_LPF, 1, state->centerFreq[state->updateAxis]);
-            }
-            if (state->updateAxis == 1) {
-                DEBUG_SET(DEBUG_FFT_FREQ, 1, state->centerFreq[state->updateAxis]);
-            }
-            // Debug FFT_Freq carries raw gyro, gyro after first filter set, FFT centre for roll and for pitch
+            gyroDataAnalyseCalcFrequencies(state);
             DEBUG_SET(DEBUG_FFT_TIME, 1, micros() - startTime);
             break;
         }
         case STEP_UPDATE_FILTERS:
         {
             // 7us
-            // calculate cutoffFreq and notch Q, update notch filter  =1.8+((A2-150)*0.004)
-            if (state->prevCenterFreq[state->updateAxis] != state->centerFreq[state->updateAxis]) {
-                if (dualNotch) {
-                    biquadFilterUpdate(&notchFilterDyn[state->updateAxis], state->centerFreq[state->updateAxis] * dynNotch1Ctr, gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
-                    biquadFilterUpdate(&notchFilterDyn2[state->updateAxis], state->centerFreq[state->updateAxis] * dynNotch2Ctr, gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
-                } else {
-                    biquadFilterUpdate(&notchFilterDyn[state->updateAxis], state->centerFreq[state->updateAxis], gyro.targetLooptime, dynNotchQ, FILTER_NOTCH);
-                }
-            }
+            gyroDataAnalyseUpdateFilters(state, notchFilterDyn, notchFilterDyn2);
             DEBUG_SET(DEBUG_FFT_TIME, 1, micros() - startTime);
 
             state->updateAxis = (state->updateAxis + 1) % XYZ_AXIS_COUNT;
@@ -365,7 +593,7 @@ static FAST_CODE_NOINLINE void gyroDataAnalyseUpdate(gyroAnalyseState_t *state,
             // 5us
             // apply hanning window to gyro samples and store result in fftData
             // hanning starts and ends with 0, could be skipped for minor speed improvement
-            const uint8_t ringBufIdx = FFT_WINDOW_SIZE - state->circularBufferIdx;
+            const uint16_t ringBufIdx = FFT_WINDOW_SIZE - state->circularBufferIdx;
             arm_mult_f32(&state->downsampledGyroData[state->updateAxis][state->circularBufferIdx], &hanningWindow[0], &state->fftData[0], ringBufIdx);
             if (state->circularBufferIdx > 0) {
                 arm_mult_f32(&state->downsampledGyroData[state->updateAxis][0], &hanningWindow[ringBufIdx], &state->fftData[ringBufIdx], state->circularBufferIdx);
@@ -25,8 +25,12 @@
 #include "common/filter.h"
 
 
-// max for F3 targets
+// 32 is the max for F3 targets, targets with RAM and CPU to spare can use 64, 128 or 256
+#ifndef FFT_WINDOW_SIZE
 #define FFT_WINDOW_SIZE 32
+#endif
+
+#define FFT_BIN_COUNT (FFT_WINDOW_SIZE / 2)
 
 typedef struct gyroAnalyseState_s {
     // accumulator for oversampled data => no aliasing and less noise
@@ -36,7 +40,7 @@ typedef struct gyroAnalyseState_s {
     float oversampledGyroAccumulator[XYZ_AXIS_COUNT];
 
     // downsampled gyro data circular buffer for frequency analysis
-    uint8_t circularBufferIdx;
+    uint16_t circularBufferIdx;
     float downsampledGyroData[XYZ_AXIS_COUNT][FFT_WINDOW_SIZE];
 
     // update state machine step information
@@ -48,15 +52,24 @@ typedef struct gyroAnalyseState_s {
     float fftData[FFT_WINDOW_SIZE];
     float rfftData[FFT_WINDOW_SIZE];
 
+    // sliding DFT bins of each axis, updated with every downsampled sample
+    float sdftRe[XYZ_AXIS_COUNT][FFT_BIN_COUNT + 1];
+    float sdftIm[XYZ_AXIS_COUNT][FFT_BIN_COUNT + 1];
+
     biquadFilter_t detectedFrequencyFilter[XYZ_AXIS_COUNT];
     uint16_t centerFreq[XYZ_AXIS_COUNT];
     uint16_t prevCenterFreq[XYZ_AXIS_COUNT];
+
+    // second tracked peak, 0 if there is none
+    biquadFilter_t detectedFrequencyFilter2[XYZ_AXIS_COUNT];
+    uint16_t centerFreq2[XYZ_AXIS_COUNT];
+    uint16_t prevCenterFreq2[XYZ_AXIS_COUNT];
 } gyroAnalyseState_t;
 
-STATIC_ASSERT(FFT_WINDOW_SIZE <= (uint8_t) -1, window_size_greater_than_underlying_type);
+STATIC_ASSERT(FFT_WINDOW_SIZE == 32 || FFT_WINDOW_SIZE == 64 || FFT_WINDOW_SIZE == 128 || FFT_WINDOW_SIZE == 256, fft_window_size_not_supported);
 
 void gyroDataAnalyseStateInit(gyroAnalyseState_t *gyroAnalyse, uint32_t targetLooptime);
 void gyroDataAnalysePush(gyroAnalyseState_t *gyroAnalyse, int axis, float sample);
-void gyroDataAnalyse(gyroAnalyseState_t *gyroAnalyse, biquadFilter_t *notchFilterDyn, biquadFilter_t *notchFilterDyn2);
+void gyroDataAnalyse(gyroAnalyseState_t *gyroAnalyse, biquadFilter3_t *notchFilterDyn, biquadFilter3_t *notchFilterDyn2);
 uint16_t getMaxFFT(void);
 void resetMaxFFT(void);
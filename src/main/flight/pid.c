@@ -260,18 +260,18 @@ void pidStabilisationState(pidStabilisationState_e pidControllerState)
 const angle_index_t rcAliasToAngleIndexMap[] = { AI_ROLL, AI_PITCH };
 
 typedef union dtermLowpass_u {
-    pt1Filter_t pt1Filter;
-    biquadFilter_t biquadFilter;
+    pt1Filter3_t pt1Filter;
+    biquadFilter3_t biquadFilter;
 } dtermLowpass_t;
 
 static FAST_RAM_ZERO_INIT float previousPidSetpoint[XYZ_AXIS_COUNT];
 
-static FAST_RAM_ZERO_INIT filterApplyFnPtr dtermNotchApplyFn;
-static FAST_RAM_ZERO_INIT biquadFilter_t dtermNotch[XYZ_AXIS_COUNT];
-static FAST_RAM_ZERO_INIT filterApplyFnPtr dtermLowpassApplyFn;
-static FAST_RAM_ZERO_INIT dtermLowpass_t dtermLowpass[XYZ_AXIS_COUNT];
-static FAST_RAM_ZERO_INIT filterApplyFnPtr dtermLowpass2ApplyFn;
-static FAST_RAM_ZERO_INIT dtermLowpass_t dtermLowpass2[XYZ_AXIS_COUNT];
+static FAST_RAM_ZERO_INIT filter3ApplyFnPtr dtermNotchApplyFn;
+static FAST_RAM_ZERO_INIT biquadFilter3_t dtermNotch;
+static FAST_RAM_ZERO_INIT filter3ApplyFnPtr dtermLowpassApplyFn;
+static FAST_RAM_ZERO_INIT dtermLowpass_t dtermLowpass;
+static FAST_RAM_ZERO_INIT filter3ApplyFnPtr dtermLowpass2ApplyFn;
+static FAST_RAM_ZERO_INIT dtermLowpass_t dtermLowpass2;
 static FAST_RAM_ZERO_INIT filterApplyFnPtr ptermYawLowpassApplyFn;
 static FAST_RAM_ZERO_INIT pt1Filter_t ptermYawLowpass;
 
@@ -334,8 +334,9 @@ void pidInitFilters(const pidProfile_t *pidProfile)
 
     if (targetPidLooptime == 0) {
         // no looptime set, so set all the filters to null
-        dtermNotchApplyFn = nullFilterApply;
-        dtermLowpassApplyFn = nullFilterApply;
+        dtermNotchApplyFn = nullFilterApply3;
+        dtermLowpassApplyFn = nullFilterApply3;
+        dtermLowpass2ApplyFn = nullFilterApply3;
         ptermYawLowpassApplyFn = nullFilterApply;
         return;
     }
@@ -354,13 +355,11 @@ void pidInitFilters(const pidProfile_t *pidProfile)
     }
 
     if (dTermNotchHz != 0 && pidProfile->dterm_notch_cutoff != 0) {
-        dtermNotchApplyFn = (filterApplyFnPtr)biquadFilterApply;
+        dtermNotchApplyFn = (filter3ApplyFnPtr)biquadFilterApply3;
         const float notchQ = filterGetNotchQ(dTermNotchHz, pidProfile->dterm_notch_cutoff);
-        for (int axis = FD_ROLL; axis <= FD_YAW; axis++) {
-            biquadFilterInit(&dtermNotch[axis], dTermNotchHz, targetPidLooptime, notchQ, FILTER_NOTCH);
-        }
+        biquadFilter3Init(&dtermNotch, dTermNotchHz, targetPidLooptime, notchQ, FILTER_NOTCH);
     } else {
-        dtermNotchApplyFn = nullFilterApply;
+        dtermNotchApplyFn = nullFilterApply3;
     }
 
     //1st Dterm Lowpass Filter
@@ -375,48 +374,40 @@ void pidInitFilters(const pidProfile_t *pidProfile)
     if (dterm_lowpass_hz > 0 && dterm_lowpass_hz < pidFrequencyNyquist) {
         switch (pidProfile->dterm_filter_type) {
         case FILTER_PT1:
-            dtermLowpassApplyFn = (filterApplyFnPtr)pt1FilterApply;
-            for (int axis = FD_ROLL; axis <= FD_YAW; axis++) {
-                pt1FilterInit(&dtermLowpass[axis].pt1Filter, pt1FilterGain(dterm_lowpass_hz, dT));
-            }
+            dtermLowpassApplyFn = (filter3ApplyFnPtr)pt1FilterApply3;
+            pt1Filter3Init(&dtermLowpass.pt1Filter, pt1FilterGain(dterm_lowpass_hz, dT));
             break;
         case FILTER_BIQUAD:
 #ifdef USE_DYN_LPF
-            dtermLowpassApplyFn = (filterApplyFnPtr)biquadFilterApplyDF1;
+            dtermLowpassApplyFn = (filter3ApplyFnPtr)biquadFilterApply3DF1;
 #else
-            dtermLowpassApplyFn = (filterApplyFnPtr)biquadFilterApply;
+            dtermLowpassApplyFn = (filter3ApplyFnPtr)biquadFilterApply3;
 #endif
-            for (int axis = FD_ROLL; axis <= FD_YAW; axis++) {
-                biquadFilterInitLPF(&dtermLowpass[axis].biquadFilter, dterm_lowpass_hz, targetPidLooptime);
-            }
+            biquadFilter3InitLPF(&dtermLowpass.biquadFilter, dterm_lowpass_hz, targetPidLooptime);
             break;
         default:
-            dtermLowpassApplyFn = nullFilterApply;
+            dtermLowpassApplyFn = nullFilterApply3;
             break;
         }
     } else {
-        dtermLowpassApplyFn = nullFilterApply;
+        dtermLowpassApplyFn = nullFilterApply3;
     }
 
     //2nd Dterm Lowpass Filter
     if (pidProfile->dterm_lowpass2_hz == 0 || pidProfile->dterm_lowpass2_hz > pidFrequencyNyquist) {
-    	dtermLowpass2ApplyFn = nullFilterApply;
+    	dtermLowpass2ApplyFn = nullFilterApply3;
     } else {
         switch (pidProfile->dterm_filter2_type) {
         case FILTER_PT1:
-            dtermLowpass2ApplyFn = (filterApplyFnPtr)pt1FilterApply;
-            for (int axis = FD_ROLL; axis <= FD_YAW; axis++) {
-                pt1FilterInit(&dtermLowpass2[axis].pt1Filter, pt1FilterGain(pidProfile->dterm_lowpass2_hz, dT));
-            }
+            dtermLowpass2ApplyFn = (filter3ApplyFnPtr)pt1FilterApply3;
+            pt1Filter3Init(&dtermLowpass2.pt1Filter, pt1FilterGain(pidProfile->dterm_lowpass2_hz, dT));
             break;
         case FILTER_BIQUAD:
-            dtermLowpass2ApplyFn = (filterApplyFnPtr)biquadFilterApply;
-            for (int axis = FD_ROLL; axis <= FD_YAW; axis++) {
-                biquadFilterInitLPF(&dtermLowpass2[axis].biquadFilter, pidProfile->dterm_lowpass2_hz, targetPidLooptime);
-            }
+            dtermLowpass2ApplyFn = (filter3ApplyFnPtr)biquadFilterApply3;
+            biquadFilter3InitLPF(&dtermLowpass2.biquadFilter, pidProfile->dterm_lowpass2_hz, targetPidLooptime);
             break;
         default:
-            dtermLowpass2ApplyFn = nullFilterApply;
+            dtermLowpass2ApplyFn = nullFilterApply3;
             break;
         }
     }
@@ -1308,13 +1299,13 @@ void FAST_CODE pidController(const pidProfile_t *pidProfile, timeUs_t currentTim
     float gyroRateDterm[XYZ_AXIS_COUNT];
     for (int axis = FD_ROLL; axis <= FD_YAW; ++axis) {
         gyroRateDterm[axis] = gyro.gyroADCf[axis];
+    }
 #ifdef USE_RPM_FILTER
-        gyroRateDterm[axis] = rpmFilterDterm(axis,gyroRateDterm[axis]);
+    rpmFilterDterm(gyroRateDterm);
 #endif
-        gyroRateDterm[axis] = dtermNotchApplyFn((filter_t *) &dtermNotch[axis], gyroRateDterm[axis]);
-        gyroRateDterm[axis] = dtermLowpassApplyFn((filter_t *) &dtermLowpass[axis], gyroRateDterm[axis]);
-        gyroRateDterm[axis] = dtermLowpass2ApplyFn((filter_t *) &dtermLowpass2[axis], gyroRateDterm[axis]);
-    }
+    dtermNotchApplyFn((filter3_t *) &dtermNotch, gyroRateDterm);
+    dtermLowpassApplyFn((filter3_t *) &dtermLowpass, gyroRateDterm);
+    dtermLowpass2ApplyFn((filter3_t *) &dtermLowpass2, gyroRateDterm);
 
     rotateItermAndAxisError();
 #ifdef USE_RPM_FILTER
@@ -1593,13 +1584,9 @@ void dynLpfDTermUpdate(float throttle)
         const unsigned int cutoffFreq = fmax(dynThrottle(throttle) * dynLpfMax, dynLpfMin);
 
          if (dynLpfFilter == DYN_LPF_PT1) {
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                pt1FilterUpdateCutoff(&dtermLowpass[axis].pt1Filter, pt1FilterGain(cutoffFreq, dT));
-            }
+            pt1Filter3UpdateCutoff(&dtermLowpass.pt1Filter, pt1FilterGain(cutoffFreq, dT));
         } else if (dynLpfFilter == DYN_LPF_BIQUAD) {
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                biquadFilterUpdateLPF(&dtermLowpass[axis].biquadFilter, cutoffFreq, targetPidLooptime);
-            }
+            biquadFilter3UpdateLPF(&dtermLowpass.biquadFilter, cutoffFreq, targetPidLooptime);
         }
     }
 }
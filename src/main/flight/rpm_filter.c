@@ -21,6 +21,7 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "platform.h"
 
@@ -45,39 +46,49 @@
 #include "rpm_filter.h"
 
 #define RPM_FILTER_MAXHARMONICS 3
+#define RPM_FILTER_MAXNOTCHES   (MAX_SUPPORTED_MOTORS * RPM_FILTER_MAXHARMONICS)
 #define SECONDS_PER_MINUTE      60.0f
 #define ERPM_PER_LSB            100.0f
-#define MIN_UPDATE_T            0.001f
 
 
 static pt1Filter_t rpmFilters[MAX_SUPPORTED_MOTORS];
 
-typedef struct rpmNotchFilter_s
+// All notches of the bank share one Q, are indexed [motor * harmonics + harmonic]
+// and are applied in series to the samples of all axes. With b2 == b0 and a1 == b1
+// a notch in direct form 1 reduces to
+//   y = b0 * (x + x2) + b1 * (x1 - y1) - a2 * y2
+// The output history of a notch is the input history of the next one, so the bank
+// keeps notchCount + 1 sample histories, the first being the bank input.
+typedef struct rpmNotchBank_s
 {
     uint8_t harmonics;
+    uint8_t notchCount;
     float   minHz;
     float   maxHz;
-    float   q;
-    float   loopTime;
+    float   omegaPerHz;
+    float   alphaScale;
 
-    biquadFilter_t notch[XYZ_AXIS_COUNT][MAX_SUPPORTED_MOTORS][RPM_FILTER_MAXHARMONICS];
-} rpmNotchFilter_t;
+    // sin and cos of the clamp frequencies, they don't change after init
+    float   minHzSin;
+    float   minHzCos;
+    float   maxHzSin;
+    float   maxHzCos;
+
+    float   b0[RPM_FILTER_MAXNOTCHES];
+    float   b1[RPM_FILTER_MAXNOTCHES];
+    float   a2[RPM_FILTER_MAXNOTCHES];
+
+    float   history1[RPM_FILTER_MAXNOTCHES + 1][FILTER_AXIS_LANES];
+    float   history2[RPM_FILTER_MAXNOTCHES + 1][FILTER_AXIS_LANES];
+} rpmNotchBank_t;
 
 FAST_RAM_ZERO_INIT static float   erpmToHz;
 FAST_RAM_ZERO_INIT static float   filteredMotorErpm[MAX_SUPPORTED_MOTORS];
 FAST_RAM_ZERO_INIT static float   minMotorFrequency;
-FAST_RAM_ZERO_INIT static uint8_t numberFilters;
-FAST_RAM_ZERO_INIT static uint8_t numberRpmNotchFilters;
-FAST_RAM_ZERO_INIT static uint8_t filterUpdatesPerIteration;
 FAST_RAM_ZERO_INIT static float   pidLooptime;
-FAST_RAM_ZERO_INIT static rpmNotchFilter_t filters[2];
-FAST_RAM_ZERO_INIT static rpmNotchFilter_t* gyroFilter;
-FAST_RAM_ZERO_INIT static rpmNotchFilter_t* dtermFilter;
-
-FAST_RAM_ZERO_INIT static uint8_t currentMotor;
-FAST_RAM_ZERO_INIT static uint8_t currentHarmonic;
-FAST_RAM_ZERO_INIT static uint8_t currentFilterNumber;
-FAST_RAM static rpmNotchFilter_t* currentFilter = &filters[0];
+FAST_RAM_ZERO_INIT static rpmNotchBank_t filters[2];
+FAST_RAM_ZERO_INIT static rpmNotchBank_t* gyroFilter;
+FAST_RAM_ZERO_INIT static rpmNotchBank_t* dtermFilter;
 
 
 
@@ -96,87 +107,133 @@ void pgResetFn_rpmFilterConfig(rpmFilterConfig_t *config)
     config->rpm_lpf = 150;
 }
 
-static void rpmNotchFilterInit(rpmNotchFilter_t* filter, int harmonics, int minHz, int q, float looptime)
+// same coefficients as biquadFilterInit with FILTER_NOTCH, from the sin and cos of omega
+static FAST_CODE void rpmNotchSetCoefficients(rpmNotchBank_t *bank, int notch, float sn, float cs)
 {
-    filter->harmonics = harmonics;
-    filter->minHz = minHz;
-    filter->q = q / 100.0f;
-    filter->loopTime = looptime;
+    const float alpha = sn * bank->alphaScale;
+    const float a0Inv = 1.0f / (1.0f + alpha);
+    bank->b0[notch] = a0Inv;
+    bank->b1[notch] = -2.0f * cs * a0Inv;
+    bank->a2[notch] = (1.0f - alpha) * a0Inv;
+}
 
-    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-        for (int motor = 0; motor < getMotorCount(); motor++) {
-            for (int i = 0; i < harmonics; i++) {
-                biquadFilterInit(
-                    &filter->notch[axis][motor][i], minHz * i, looptime, filter->q, FILTER_NOTCH);
-            }
+static FAST_CODE void rpmNotchBankUpdateMotor(rpmNotchBank_t *bank, int motor, float frequency)
+{
+    // the harmonics follow from the fundamental with the angle addition theorem,
+    // so each motor costs a single sin/cos evaluation
+    const float omega = bank->omegaPerHz * frequency;
+    const float sn1 = sin_approx(omega);
+    const float cs1 = cos_approx(omega);
+    float sn = sn1;
+    float cs = cs1;
+
+    for (int i = 0; i < bank->harmonics; i++) {
+        const int notch = motor * bank->harmonics + i;
+        const float harmonicHz = (i + 1) * frequency;
+        if (harmonicHz <= bank->minHz) {
+            rpmNotchSetCoefficients(bank, notch, bank->minHzSin, bank->minHzCos);
+        } else if (harmonicHz >= bank->maxHz) {
+            rpmNotchSetCoefficients(bank, notch, bank->maxHzSin, bank->maxHzCos);
+        } else {
+            rpmNotchSetCoefficients(bank, notch, sn, cs);
         }
+
+        const float snNext = sn * cs1 + cs * sn1;
+        cs = cs * cs1 - sn * sn1;
+        sn = snNext;
     }
 }
 
-void rpmFilterInit(const rpmFilterConfig_t *config)
+static void rpmNotchBankInit(rpmNotchBank_t* bank, int harmonics, int minHz, int q, float looptime)
 {
-    currentFilter = &filters[0];
-    currentMotor = currentHarmonic = currentFilterNumber = 0;
+    memset(bank, 0, sizeof(*bank));
+
+    bank->harmonics = harmonics;
+    bank->notchCount = getMotorCount() * harmonics;
+    bank->minHz = minHz;
+    // don't go quite to nyquist to avoid oscillations
+    bank->maxHz = 0.48f / (looptime * 1e-6f);
+    bank->omegaPerHz = 2.0f * M_PIf * looptime * 1e-6f;
+    bank->alphaScale = 1.0f / (2.0f * (q / 100.0f));
+
+    bank->minHzSin = sin_approx(bank->omegaPerHz * bank->minHz);
+    bank->minHzCos = cos_approx(bank->omegaPerHz * bank->minHz);
+    bank->maxHzSin = sin_approx(bank->omegaPerHz * bank->maxHz);
+    bank->maxHzCos = cos_approx(bank->omegaPerHz * bank->maxHz);
+
+    for (int motor = 0; motor < getMotorCount(); motor++) {
+        rpmNotchBankUpdateMotor(bank, motor, 0.0f);
+    }
+}
 
-    numberRpmNotchFilters = 0;
+void rpmFilterInit(const rpmFilterConfig_t *config)
+{
+    minMotorFrequency = 0.0f;
+    gyroFilter = dtermFilter = NULL;
     if (!motorConfig()->dev.useDshotTelemetry) {
-        gyroFilter = dtermFilter = NULL;
         return;
     }
 
     pidLooptime = gyro.targetLooptime * pidConfig()->pid_process_denom;
     if (config->gyro_rpm_notch_harmonics) {
-        gyroFilter = &filters[numberRpmNotchFilters++];
-        rpmNotchFilterInit(gyroFilter, config->gyro_rpm_notch_harmonics,
-                           config->gyro_rpm_notch_min, config->gyro_rpm_notch_q, gyro.targetLooptime);
-        // don't go quite to nyquist to avoid oscillations
-        gyroFilter->maxHz = 0.48f / (gyro.targetLooptime * 1e-6f);
-    } else {
-        gyroFilter = NULL;
+        gyroFilter = &filters[0];
+        rpmNotchBankInit(gyroFilter, config->gyro_rpm_notch_harmonics,
+                         config->gyro_rpm_notch_min, config->gyro_rpm_notch_q, gyro.targetLooptime);
     }
     if (config->dterm_rpm_notch_harmonics) {
-        dtermFilter = &filters[numberRpmNotchFilters++];
-        rpmNotchFilterInit(dtermFilter, config->dterm_rpm_notch_harmonics,
-                           config->dterm_rpm_notch_min, config->dterm_rpm_notch_q, pidLooptime);
-        // don't go quite to nyquist to avoid oscillations
-        dtermFilter->maxHz = 0.48f / (pidLooptime * 1e-6f);
-    } else {
-        dtermFilter = NULL;
+        dtermFilter = &filters[1];
+        rpmNotchBankInit(dtermFilter, config->dterm_rpm_notch_harmonics,
+                         config->dterm_rpm_notch_min, config->dterm_rpm_notch_q, pidLooptime);
     }
 
     for (int i = 0; i < getMotorCount(); i++) {
         pt1FilterInit(&rpmFilters[i], pt1FilterGain(config->rpm_lpf, pidLooptime * 1e-6f));
+        filteredMotorErpm[i] = 0.0f;
     }
 
     erpmToHz = ERPM_PER_LSB / SECONDS_PER_MINUTE  / (motorConfig()->motorPoleCount / 2.0f);
-
-    const float loopIterationsPerUpdate = MIN_UPDATE_T / (pidLooptime * 1e-6f);
-    numberFilters = getMotorCount() * (filters[0].harmonics + filters[1].harmonics);
-    const float filtersPerLoopIteration = numberFilters / loopIterationsPerUpdate;
-    filterUpdatesPerIteration = rintf(filtersPerLoopIteration + 0.49f);
 }
 
-static float applyFilter(rpmNotchFilter_t* filter, int axis, float value)
+static FAST_CODE void applyFilter(rpmNotchBank_t* bank, float *values)
 {
-    if (filter == NULL) {
-        return value;
+    if (bank == NULL) {
+        return;
     }
-    for (int motor = 0; motor < getMotorCount(); motor++) {
-        for (int i = 0; i < filter->harmonics; i++) {
-            value = biquadFilterApplyDF1(&filter->notch[axis][motor][i], value);
+
+    float *x1 = bank->history1[0];
+    float *x2 = bank->history2[0];
+    for (int notch = 0; notch < bank->notchCount; notch++) {
+        const float b0 = bank->b0[notch];
+        const float b1 = bank->b1[notch];
+        const float a2 = bank->a2[notch];
+        float *y1 = bank->history1[notch + 1];
+        float *y2 = bank->history2[notch + 1];
+
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            const float input = values[axis];
+            const float result = b0 * (input + x2[axis]) + b1 * (x1[axis] - y1[axis]) - a2 * y2[axis];
+            x2[axis] = x1[axis];
+            x1[axis] = input;
+            values[axis] = result;
         }
+
+        x1 = y1;
+        x2 = y2;
+    }
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        x2[axis] = x1[axis];
+        x1[axis] = values[axis];
     }
-    return value;
 }
 
-float rpmFilterGyro(int axis, float value)
+void rpmFilterGyro(float *values)
 {
-    return applyFilter(gyroFilter, axis, value);
+    applyFilter(gyroFilter, values);
 }
 
-float rpmFilterDterm(int axis, float value)
+void rpmFilterDterm(float *values)
 {
-    return applyFilter(dtermFilter, axis, value);
+    applyFilter(dtermFilter, values);
 }
 
 FAST_RAM_ZERO_INIT static float motorFrequency[MAX_SUPPORTED_MOTORS];
@@ -187,47 +244,22 @@ FAST_CODE_NOINLINE void rpmFilterUpdate()
         return;
     }
 
+    // every notch follows its motor on every PID loop
     for (int motor = 0; motor < getMotorCount(); motor++) {
         filteredMotorErpm[motor] = pt1FilterApply(&rpmFilters[motor], getDshotTelemetry(motor));
+        motorFrequency[motor] = erpmToHz * filteredMotorErpm[motor];
         if (motor < 4) {
             DEBUG_SET(DEBUG_RPM_FILTER, motor, motorFrequency[motor]);
         }
-    }
 
-    for (int i = 0; i < filterUpdatesPerIteration; i++) {
-        float frequency = constrainf(
-            (currentHarmonic + 1) * motorFrequency[currentMotor], currentFilter->minHz, currentFilter->maxHz);
-        biquadFilter_t* template = &currentFilter->notch[0][currentMotor][currentHarmonic];
-        // uncomment below to debug filter stepping. Need to also comment out motor rpm DEBUG_SET above
-        /* DEBUG_SET(DEBUG_RPM_FILTER, 0, harmonic); */
-        /* DEBUG_SET(DEBUG_RPM_FILTER, 1, motor); */
-        /* DEBUG_SET(DEBUG_RPM_FILTER, 2, currentFilter == &gyroFilter); */
-        /* DEBUG_SET(DEBUG_RPM_FILTER, 3, frequency) */
-        biquadFilterUpdate(
-            template, frequency, currentFilter->loopTime, currentFilter->q, FILTER_NOTCH);
-        for (int axis = 1; axis < XYZ_AXIS_COUNT; axis++) {
-            biquadFilter_t* clone = &currentFilter->notch[axis][currentMotor][currentHarmonic];
-            clone->b0 = template->b0;
-            clone->b1 = template->b1;
-            clone->b2 = template->b2;
-            clone->a1 = template->a1;
-            clone->a2 = template->a2;
+        if (gyroFilter) {
+            rpmNotchBankUpdateMotor(gyroFilter, motor, motorFrequency[motor]);
         }
-
-        if (++currentHarmonic == currentFilter->harmonics) {
-            currentHarmonic = 0;
-            if (++currentFilterNumber == numberRpmNotchFilters) {
-                currentFilterNumber = 0;
-                if (++currentMotor == getMotorCount()) {
-                    currentMotor = 0;
-                }
-                motorFrequency[currentMotor] = erpmToHz * filteredMotorErpm[currentMotor];
-                minMotorFrequency = 0.0f;
-            }
-            currentFilter = &filters[currentFilterNumber];
+        if (dtermFilter) {
+            rpmNotchBankUpdateMotor(dtermFilter, motor, motorFrequency[motor]);
         }
-
     }
+    minMotorFrequency = 0.0f;
 }
 
 bool isRpmFilterEnabled(void)
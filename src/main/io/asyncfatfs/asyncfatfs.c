@@ -58,7 +58,10 @@
     #define ONLY_EXPOSE_FOR_TESTING static
 #endif
 
+// Targets with RAM to spare raise this so logging can ride out longer card stalls
+#ifndef AFATFS_NUM_CACHE_SECTORS
 #define AFATFS_NUM_CACHE_SECTORS 10
+#endif
 
 // FAT filesystems are allowed to differ from these parameters, but we choose not to support those weird filesystems:
 #define AFATFS_SECTOR_SIZE  512
@@ -75,6 +78,9 @@
  */
 #define AFATFS_MIN_MULTIPLE_BLOCK_WRITE_COUNT 4
 
+// How far ahead of the cursor fread() will ask the card for sectors of the file
+#define AFATFS_READ_AHEAD_SECTORS 2
+
 #define AFATFS_FILES_PER_DIRECTORY_SECTOR (AFATFS_SECTOR_SIZE / sizeof(fatDirectoryEntry_t))
 
 #define AFATFS_FAT32_FAT_ENTRIES_PER_SECTOR  (AFATFS_SECTOR_SIZE / sizeof(uint32_t))
@@ -517,6 +523,9 @@ static DMA_RW_AXI uint8_t afatfs_cache[AFATFS_SECTOR_SIZE * AFATFS_NUM_CACHE_SEC
 
 static afatfs_t afatfs;
 
+// Files remember their locked cache entry as an int8_t
+STATIC_ASSERT(AFATFS_NUM_CACHE_SECTORS <= INT8_MAX, afatfs_cache_sectors_too_many);
+
 static void afatfs_fileOperationContinue(afatfsFile_t *file);
 static uint8_t* afatfs_fileLockCursorSectorForWrite(afatfsFilePtr_t file);
 static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file);
@@ -1812,6 +1821,36 @@ static bool afatfs_isEndOfAllocatedFile(afatfsFilePtr_t file)
     }
 }
 
+/**
+ * Start reading the first of the next few sectors after the cursor (within the cursor's cluster) that isn't cached
+ * yet, so sequential reads find them ready. Only one read can be in flight, so at most one is started per call.
+ */
+static void afatfs_fileReadAhead(afatfsFilePtr_t file)
+{
+    if (file->type == AFATFS_FILE_TYPE_FAT16_ROOT_DIRECTORY) {
+        return;
+    }
+
+    uint32_t physicalSector = afatfs_fileGetCursorPhysicalSector(file);
+    uint32_t sectorInCluster = afatfs_sectorIndexInCluster(file->cursorOffset);
+    uint32_t offsetOfStartOfSector = file->cursorOffset & ~((uint32_t) AFATFS_SECTOR_SIZE - 1);
+
+    for (uint32_t i = 1; i <= AFATFS_READ_AHEAD_SECTORS; i++) {
+        if (sectorInCluster + i >= afatfs.sectorsPerCluster || offsetOfStartOfSector + i * AFATFS_SECTOR_SIZE >= file->logicalSize) {
+            return;
+        }
+
+        afatfsCacheBlockDescriptor_t *descriptor = afatfs_findCacheSector(physicalSector + i);
+
+        if (descriptor == NULL || descriptor->state == AFATFS_CACHE_STATE_EMPTY) {
+            uint8_t *buffer;
+
+            afatfs_cacheSector(physicalSector + i, &buffer, AFATFS_CACHE_READ, 0);
+            return;
+        }
+    }
+}
+
 /**
  * Take a lock on the sector at the current file cursor position.
  *
@@ -1853,6 +1892,8 @@ static uint8_t* afatfs_fileRetainCursorSectorForRead(afatfsFilePtr_t file)
         }
 
         file->readRetainCacheIndex = afatfs_getCacheDescriptorIndexForBuffer(result);
+
+        afatfs_fileReadAhead(file);
     }
 
     return result;
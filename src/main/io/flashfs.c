@@ -32,12 +32,15 @@
  * and make calls through that, at the moment flashfs just calls m25p16_* routines explicitly.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 
 #include "platform.h"
 
+#include "common/crc.h"
+#include "common/maths.h"
 #include "common/printf.h"
 #include "drivers/flash.h"
 
@@ -47,33 +50,237 @@ static const flashPartition_t *flashPartition = NULL;
 static const flashGeometry_t *flashGeometry = NULL;
 static uint32_t flashfsSize = 0;
 
-static uint8_t flashWriteBuffer[FLASHFS_WRITE_BUFFER_SIZE];
+/*
+ * Writes are collected in two page buffers. One takes new data while the other holds a completed page that waits
+ * for the flash to finish its previous operation, so the flash is programmed a whole page at a time unless a flush
+ * is forced. Buffers end on page boundaries, the first one after a seek is short so that the ones after it are
+ * aligned.
+ */
+typedef struct flashfsPageBuffer_s {
+    uint8_t data[FLASHFS_WRITE_BUFFER_SIZE];
+    uint32_t address;   // flash address of data[0]
+    uint16_t length;    // bytes buffered
+    uint16_t size;      // bytes up to the end of the page
+} flashfsPageBuffer_t;
+
+static flashfsPageBuffer_t pageBuffers[2];
+static flashfsPageBuffer_t *fillBuffer = &pageBuffers[0];
+static flashfsPageBuffer_t *pendingBuffer = NULL;   // full page waiting to be programmed, if any
+
+static flashfsWriteStats_t writeStats;
 
-/* The position of our head and tail in the circular flash write buffer.
+// The position of the oldest byte that has yet to be written to flash:
+static uint32_t tailAddress = 0;
+
+/*
+ * Log index. The last sector of the volume is kept out of the data area and holds a record for the start and the
+ * end of every log, STARTs in the even slots and ENDs in the odd ones, programmed one after the other. The first
+ * erased slot is found with a binary search over the sector and the END in front of it gives the write head, so
+ * startup no longer depends on the size of the chip.
  *
- * The head is the index that a byte would be inserted into on writing, while the tail is the index of the
- * oldest byte that has yet to be written to flash.
+ * A record torn by a power loss fails its CRC and the record after it stands in for it. A log that never got its
+ * END is closed at the next startup at the start of the free space found behind its START.
  *
- * When the circular buffer is empty, head == tail
+ * NOR slots are one record long, NAND slots a page so that every record gets a program of its own.
  */
-static uint8_t bufferHead = 0, bufferTail = 0;
-
-// The position of the buffer's tail in the overall flash address space:
-static uint32_t tailAddress = 0;
+#define FLASHFS_INDEX_MAGIC 0xB10C
+
+typedef enum {
+    FLASHFS_INDEX_START = 'S',
+    FLASHFS_INDEX_END = 'E'
+} flashfsIndexRecordType_e;
+
+typedef struct flashfsIndexRecord_s {
+    uint32_t address;
+    uint16_t magic;
+    uint8_t type;
+    uint8_t crc;
+} flashfsIndexRecord_t;
+
+typedef enum {
+    FLASHFS_INDEX_SLOT_ERASED,
+    FLASHFS_INDEX_SLOT_VALID,
+    FLASHFS_INDEX_SLOT_TORN
+} flashfsIndexSlotState_e;
+
+static struct {
+    uint32_t address;       // of the index sector
+    uint32_t slotSize;
+    uint32_t slotCount;     // 0 if there is no index
+    uint32_t nextSlot;      // first erased slot, a log is open while it is odd
+} logIndex;
+
+static uint16_t flashfsPageUnit(void)
+{
+    // Larger (NAND) pages are gathered in the chip's own page buffer
+    if (flashGeometry && flashGeometry->pageSize > 0 && flashGeometry->pageSize < FLASHFS_WRITE_BUFFER_SIZE) {
+        return flashGeometry->pageSize;
+    }
+    return FLASHFS_WRITE_BUFFER_SIZE;
+}
 
-static void flashfsClearBuffer(void)
+static void flashfsStartBuffer(flashfsPageBuffer_t *buffer, uint32_t address)
 {
-    bufferTail = bufferHead = 0;
+    buffer->address = address;
+    buffer->length = 0;
+    buffer->size = flashfsPageUnit() - address % flashfsPageUnit();
 }
 
 static bool flashfsBufferIsEmpty(void)
 {
-    return bufferTail == bufferHead;
+    return !pendingBuffer && fillBuffer->length == 0;
 }
 
+/**
+ * Move the tail to the given address, throwing away any buffered data.
+ */
 static void flashfsSetTailAddress(uint32_t address)
 {
     tailAddress = address;
+    pendingBuffer = NULL;
+    flashfsStartBuffer(fillBuffer, address);
+}
+
+static bool flashfsIndexIsEnabled(void)
+{
+    return logIndex.slotCount > 0;
+}
+
+/**
+ * Take the last sector of the partition for the index, if there is more than one, and assume it is erased.
+ */
+static void flashfsIndexReset(void)
+{
+    memset(&logIndex, 0, sizeof(logIndex));
+
+    const uint32_t sectorCount = FLASH_PARTITION_SECTOR_COUNT(flashPartition);
+    flashfsSize = sectorCount * flashGeometry->sectorSize;
+
+    if (sectorCount > 1) {
+        flashfsSize -= flashGeometry->sectorSize;
+
+        logIndex.address = flashfsSize;
+        logIndex.slotSize = flashGeometry->flashType == FLASH_TYPE_NAND ? flashGeometry->pageSize : sizeof(flashfsIndexRecord_t);
+        logIndex.slotCount = flashGeometry->sectorSize / logIndex.slotSize;
+    }
+}
+
+static void flashfsIndexDisable(void)
+{
+    flashfsSize += flashGeometry->sectorSize;
+    logIndex.slotCount = 0;
+}
+
+static uint8_t flashfsIndexRecordCrc(const flashfsIndexRecord_t *record)
+{
+    return crc8_dvb_s2_update(0, record, offsetof(flashfsIndexRecord_t, crc));
+}
+
+static flashfsIndexSlotState_e flashfsIndexRead(uint32_t slot, flashfsIndexRecord_t *record)
+{
+    if (flashReadBytes(logIndex.address + slot * logIndex.slotSize, (uint8_t *)record, sizeof(*record)) < (int)sizeof(*record)) {
+        return FLASHFS_INDEX_SLOT_TORN;
+    }
+
+    const uint8_t *bytes = (const uint8_t *)record;
+    bool erased = true;
+    for (unsigned i = 0; i < sizeof(*record); i++) {
+        if (bytes[i] != 0xFF) {
+            erased = false;
+            break;
+        }
+    }
+    if (erased) {
+        return FLASHFS_INDEX_SLOT_ERASED;
+    }
+
+    const uint8_t type = (slot & 1) ? FLASHFS_INDEX_END : FLASHFS_INDEX_START;
+    if (record->magic == FLASHFS_INDEX_MAGIC && record->type == type && record->crc == flashfsIndexRecordCrc(record)) {
+        return FLASHFS_INDEX_SLOT_VALID;
+    }
+    return FLASHFS_INDEX_SLOT_TORN;
+}
+
+/**
+ * Program the next slot, synchronously.
+ */
+static void flashfsIndexProgram(flashfsIndexRecordType_e type, uint32_t address)
+{
+    flashfsIndexRecord_t record = {
+        .address = address,
+        .magic = FLASHFS_INDEX_MAGIC,
+        .type = type,
+    };
+    record.crc = flashfsIndexRecordCrc(&record);
+
+    flashPageProgramBegin(logIndex.address + logIndex.nextSlot * logIndex.slotSize);
+    flashPageProgramContinue((const uint8_t *)&record, sizeof(record));
+    flashPageProgramFinish();
+
+    if (flashGeometry->flashType == FLASH_TYPE_NAND) {
+        flashFlush();
+    }
+
+    logIndex.nextSlot++;
+}
+
+static uint32_t flashfsIndexFindNextSlot(void)
+{
+    flashfsIndexRecord_t record;
+    uint32_t left = 0;
+    uint32_t right = logIndex.slotCount;
+
+    // Slots are programmed in order, the ones that follow the first erased slot are all erased too
+    while (left < right) {
+        const uint32_t mid = (left + right) / 2;
+
+        if (flashfsIndexRead(mid, &record) == FLASHFS_INDEX_SLOT_ERASED) {
+            right = mid;
+        } else {
+            left = mid + 1;
+        }
+    }
+
+    return left;
+}
+
+/**
+ * The address recorded in the given slot, or in the first valid slot after it if that one is torn. Slots that
+ * aren't programmed yet stand for the current offset.
+ */
+static uint32_t flashfsIndexAddressAt(uint32_t slot)
+{
+    flashfsIndexRecord_t record;
+
+    for (; slot < logIndex.nextSlot; slot++) {
+        if (flashfsIndexRead(slot, &record) == FLASHFS_INDEX_SLOT_VALID) {
+            return record.address;
+        }
+    }
+
+    return flashfsGetOffset();
+}
+
+/**
+ * The address in the last valid record, the volume holds no data behind it that the index doesn't know about
+ * except for the log that record may have started.
+ */
+static uint32_t flashfsIndexLastAddress(void)
+{
+    flashfsIndexRecord_t record;
+
+    for (uint32_t slot = logIndex.nextSlot; slot-- > 0;) {
+        if (flashfsIndexRead(slot, &record) == FLASHFS_INDEX_SLOT_VALID) {
+            return record.address;
+        }
+    }
+
+    return 0;
+}
+
+static bool flashfsIndexIsFull(void)
+{
+    return logIndex.nextSlot + 2 > logIndex.slotCount;
 }
 
 void flashfsEraseCompletely(void)
@@ -98,7 +305,9 @@ void flashfsEraseCompletely(void)
         }
     }
 
-    flashfsClearBuffer();
+    if (flashPartition) {
+        flashfsIndexReset();
+    }
 
     flashfsSetTailAddress(0);
 }
@@ -149,20 +358,12 @@ uint32_t flashfsGetSize(void)
     return flashfsSize;
 }
 
-static uint32_t flashfsTransmitBufferUsed(void)
-{
-    if (bufferHead >= bufferTail)
-        return bufferHead - bufferTail;
-
-    return FLASHFS_WRITE_BUFFER_SIZE - bufferTail + bufferHead;
-}
-
 /**
  * Get the size of the largest single write that flashfs could ever accept without blocking or data loss.
  */
 uint32_t flashfsGetWriteBufferSize(void)
 {
-    return FLASHFS_WRITE_BUFFER_USABLE;
+    return flashfsPageUnit();
 }
 
 /**
@@ -170,184 +371,120 @@ uint32_t flashfsGetWriteBufferSize(void)
  */
 uint32_t flashfsGetWriteBufferFreeSpace(void)
 {
-    return flashfsGetWriteBufferSize() - flashfsTransmitBufferUsed();
+    uint32_t freeSpace = fillBuffer->size - fillBuffer->length;
+
+    if (!pendingBuffer) {
+        // The other buffer can take the next page
+        freeSpace += flashfsPageUnit();
+    }
+
+    return freeSpace;
+}
+
+const flashfsWriteStats_t *flashfsGetWriteStats(void)
+{
+    return &writeStats;
 }
 
 /**
- * Write the given buffers to flash sequentially at the current tail address, advancing the tail address after
- * each write.
- *
- * In synchronous mode, waits for the flash to become ready before writing so that every byte requested can be written.
+ * Program the buffered data at the buffer's address and empty the buffer, advancing the tail address to match.
  *
- * In asynchronous mode, if the flash is busy, then the write is aborted and the routine returns immediately.
- * In this case the returned number of bytes written will be less than the total amount requested.
- *
- * Modifies the supplied buffer pointers and sizes to reflect how many bytes remain in each of them.
- *
- * bufferCount: the number of buffers provided
- * buffers: an array of pointers to the beginning of buffers
- * bufferSizes: an array of the sizes of those buffers
- * sync: true if we should wait for the device to be idle before writes, otherwise if the device is busy the
- *       write will be aborted and this routine will return immediately.
- *
- * Returns the number of bytes written
+ * In synchronous mode, waits for the flash to become ready first. In asynchronous mode, if the flash is busy,
+ * nothing is written and false is returned.
  */
-static uint32_t flashfsWriteBuffers(uint8_t const **buffers, uint32_t *bufferSizes, int bufferCount, bool sync)
+static bool flashfsProgramBuffer(flashfsPageBuffer_t *buffer, bool sync)
 {
-    uint32_t bytesTotal = 0;
-
-    int i;
-
-    for (i = 0; i < bufferCount; i++) {
-        bytesTotal += bufferSizes[i];
-    }
-
     if (!sync && !flashIsReady()) {
-        return 0;
+        return false;
     }
 
-    uint32_t bytesTotalRemaining = bytesTotal;
-
-    uint16_t pageSize = flashGeometry->pageSize;
-
-    while (bytesTotalRemaining > 0) {
-        uint32_t bytesTotalThisIteration;
-        uint32_t bytesRemainThisIteration;
-
-        /*
-         * Each page needs to be saved in a separate program operation, so
-         * if we would cross a page boundary, only write up to the boundary in this iteration:
-         */
-        if (tailAddress % pageSize + bytesTotalRemaining > pageSize) {
-            bytesTotalThisIteration = pageSize - tailAddress % pageSize;
-        } else {
-            bytesTotalThisIteration = bytesTotalRemaining;
-        }
-
-        // Are we at EOF already? Abort.
-        if (flashfsIsEOF()) {
-            // May as well throw away any buffered data
-            flashfsClearBuffer();
+    if (buffer->address >= flashfsSize) {
+        // At EOF, may as well throw away the data
+        writeStats.bytesDropped += buffer->length;
+    } else {
+        flashPageProgramBegin(buffer->address);
+        flashPageProgramContinue(buffer->data, buffer->length);
+        flashPageProgramFinish();
 
-            break;
+        writeStats.pagePrograms++;
+        if (buffer->length < buffer->size) {
+            writeStats.partialPrograms++;
         }
+    }
 
-        flashPageProgramBegin(tailAddress);
-
-        bytesRemainThisIteration = bytesTotalThisIteration;
-
-        for (i = 0; i < bufferCount; i++) {
-            if (bufferSizes[i] > 0) {
-                // Is buffer larger than our write limit? Write our limit out of it
-                if (bufferSizes[i] >= bytesRemainThisIteration) {
-                    flashPageProgramContinue(buffers[i], bytesRemainThisIteration);
-
-                    buffers[i] += bytesRemainThisIteration;
-                    bufferSizes[i] -= bytesRemainThisIteration;
-
-                    bytesRemainThisIteration = 0;
-                    break;
-                } else {
-                    // We'll still have more to write after finishing this buffer off
-                    flashPageProgramContinue(buffers[i], bufferSizes[i]);
-
-                    bytesRemainThisIteration -= bufferSizes[i];
-
-                    buffers[i] += bufferSizes[i];
-                    bufferSizes[i] = 0;
-                }
-            }
-        }
-
-        flashPageProgramFinish();
-
-        bytesTotalRemaining -= bytesTotalThisIteration;
+    tailAddress = buffer->address + buffer->length;
+    buffer->length = 0;
 
-        // Advance the cursor in the file system to match the bytes we wrote
-        flashfsSetTailAddress(tailAddress + bytesTotalThisIteration);
+    return true;
+}
 
-        /*
-         * We'll have to wait for that write to complete before we can issue the next one, so if
-         * the user requested asynchronous writes, break now.
-         */
-        if (!sync)
-            break;
+static void flashfsProgramPending(bool sync)
+{
+    if (pendingBuffer && flashfsProgramBuffer(pendingBuffer, sync)) {
+        pendingBuffer = NULL;
     }
-
-    return bytesTotal - bytesTotalRemaining;
 }
 
-/*
- * Since the buffered data might wrap around the end of the circular buffer, we can have two segments of data to write,
- * an initial portion and a possible wrapped portion.
- *
- * This routine will fill the details of those buffers into the provided arrays, which must be at least 2 elements long.
+/**
+ * Program whatever is in the fill buffer, even if it isn't a whole page. Only once the pending page is written.
  */
-static void flashfsGetDirtyDataBuffers(uint8_t const *buffers[], uint32_t bufferSizes[])
+static void flashfsProgramFillBuffer(bool sync)
 {
-    buffers[0] = flashWriteBuffer + bufferTail;
-    buffers[1] = flashWriteBuffer + 0;
+    if (!pendingBuffer && fillBuffer->length > 0) {
+        const uint32_t address = fillBuffer->address + fillBuffer->length;
 
-    if (bufferHead >= bufferTail) {
-        bufferSizes[0] = bufferHead - bufferTail;
-        bufferSizes[1] = 0;
-    } else {
-        bufferSizes[0] = FLASHFS_WRITE_BUFFER_SIZE - bufferTail;
-        bufferSizes[1] = bufferHead;
+        if (flashfsProgramBuffer(fillBuffer, sync)) {
+            flashfsStartBuffer(fillBuffer, address);
+        }
     }
 }
 
 /**
- * Get the current offset of the file pointer within the volume.
+ * The fill buffer holds a whole page, queue it to be programmed and carry on in the other buffer.
+ *
+ * Returns false if the other buffer still holds a page the flash was too busy to take.
  */
-uint32_t flashfsGetOffset(void)
+static bool flashfsQueueFullPage(bool sync)
 {
-    uint8_t const * buffers[2];
-    uint32_t bufferSizes[2];
+    flashfsProgramPending(sync);
 
-    // Dirty data in the buffers contributes to the offset
+    if (pendingBuffer) {
+        return false;
+    }
+
+    pendingBuffer = fillBuffer;
+    fillBuffer = (fillBuffer == &pageBuffers[0]) ? &pageBuffers[1] : &pageBuffers[0];
+    flashfsStartBuffer(fillBuffer, pendingBuffer->address + pendingBuffer->length);
 
-    flashfsGetDirtyDataBuffers(buffers, bufferSizes);
+    // Start on it right away if the flash is idle
+    flashfsProgramPending(sync);
 
-    return tailAddress + bufferSizes[0] + bufferSizes[1];
+    return true;
 }
 
 /**
- * Called after bytes have been written from the buffer to advance the position of the tail by the given amount.
+ * Get the current offset of the file pointer within the volume.
  */
-static void flashfsAdvanceTailInBuffer(uint32_t delta)
+uint32_t flashfsGetOffset(void)
 {
-    bufferTail += delta;
-
-    // Wrap tail around the end of the buffer
-    if (bufferTail >= FLASHFS_WRITE_BUFFER_SIZE) {
-        bufferTail -= FLASHFS_WRITE_BUFFER_SIZE;
-    }
-
-    if (flashfsBufferIsEmpty()) {
-        flashfsClearBuffer(); // Bring buffer pointers back to the start to be tidier
-    }
+    // Dirty data in the buffers contributes to the offset
+    return fillBuffer->address + fillBuffer->length;
 }
 
 /**
- * If the flash is ready to accept writes, flush the buffer to it.
+ * If the flash is ready to accept writes, write a completed page to it. With `force` a partly filled page is
+ * written as well, which costs a whole program operation for the bytes in it.
  *
- * Returns true if all data in the buffer has been flushed to the device, or false if
+ * Returns true if all data in the buffers has been flushed to the device, or false if
  * there is still data to be written (call flush again later).
  */
-bool flashfsFlushAsync(void)
+bool flashfsFlushAsync(bool force)
 {
-    if (flashfsBufferIsEmpty()) {
-        return true; // Nothing to flush
-    }
+    flashfsProgramPending(false);
 
-    uint8_t const * buffers[2];
-    uint32_t bufferSizes[2];
-    uint32_t bytesWritten;
-
-    flashfsGetDirtyDataBuffers(buffers, bufferSizes);
-    bytesWritten = flashfsWriteBuffers(buffers, bufferSizes, 2, false);
-    flashfsAdvanceTailInBuffer(bytesWritten);
+    if (force) {
+        flashfsProgramFillBuffer(false);
+    }
 
     return flashfsBufferIsEmpty();
 }
@@ -360,18 +497,8 @@ bool flashfsFlushAsync(void)
  */
 void flashfsFlushSync(void)
 {
-    if (flashfsBufferIsEmpty()) {
-        return; // Nothing to flush
-    }
-
-    uint8_t const * buffers[2];
-    uint32_t bufferSizes[2];
-
-    flashfsGetDirtyDataBuffers(buffers, bufferSizes);
-    flashfsWriteBuffers(buffers, bufferSizes, 2, true);
-
-    // We've written our entire buffer now:
-    flashfsClearBuffer();
+    flashfsProgramPending(true);
+    flashfsProgramFillBuffer(true);
 }
 
 void flashfsSeekAbs(uint32_t offset)
@@ -389,102 +516,41 @@ void flashfsSeekRel(int32_t offset)
 }
 
 /**
- * Write the given byte asynchronously to the flash. If the buffer overflows, data is silently discarded.
+ * Write the given byte asynchronously to the flash. If the buffers overflow, data is discarded.
  */
 void flashfsWriteByte(uint8_t byte)
 {
-    flashWriteBuffer[bufferHead++] = byte;
-
-    if (bufferHead >= FLASHFS_WRITE_BUFFER_SIZE) {
-        bufferHead = 0;
-    }
-
-    if (flashfsTransmitBufferUsed() >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
-        flashfsFlushAsync();
-    }
+    flashfsWrite(&byte, 1, false);
 }
 
 /**
  * Write the given buffer to the flash either synchronously or asynchronously depending on the 'sync' parameter.
  *
- * If writing asynchronously, data will be silently discarded if the buffer overflows.
+ * If writing asynchronously, data that doesn't fit in the buffers while the flash is busy is discarded and
+ * counted in the write stats.
  * If writing synchronously, the routine will block waiting for the flash to become ready so will never drop data.
  */
 void flashfsWrite(const uint8_t *data, unsigned int len, bool sync)
 {
-    uint8_t const * buffers[3];
-    uint32_t bufferSizes[3];
-
-    // There could be two dirty buffers to write out already:
-    flashfsGetDirtyDataBuffers(buffers, bufferSizes);
-
-    // Plus the buffer the user supplied:
-    buffers[2] = data;
-    bufferSizes[2] = len;
-
-    /*
-     * Would writing this data to our buffer cause our buffer to reach the flush threshold? If so try to write through
-     * to the flash now
-     */
-    if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] >= FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN) {
-        uint32_t bytesWritten;
-
-        // Attempt to write all three buffers through to the flash asynchronously
-        bytesWritten = flashfsWriteBuffers(buffers, bufferSizes, 3, false);
-
-        if (bufferSizes[0] == 0 && bufferSizes[1] == 0) {
-            // We wrote all the data that was previously buffered
-            flashfsClearBuffer();
-
-            if (bufferSizes[2] == 0) {
-                // And we wrote all the data the user supplied! Job done!
-                return;
-            }
-        } else {
-            // We only wrote a portion of the old data, so advance the tail to remove the bytes we did write from the buffer
-            flashfsAdvanceTailInBuffer(bytesWritten);
-        }
-
-        // Is the remainder of the data to be written too big to fit in the buffers?
-        if (bufferSizes[0] + bufferSizes[1] + bufferSizes[2] > FLASHFS_WRITE_BUFFER_USABLE) {
-            if (sync) {
-                // Write it through synchronously
-                flashfsWriteBuffers(buffers, bufferSizes, 3, true);
-                flashfsClearBuffer();
-            } else {
-                /*
-                 * Silently drop the data the user asked to write (i.e. no-op) since we can't buffer it and they
-                 * requested async.
-                 */
-            }
-
+    while (len > 0) {
+        if (fillBuffer->length == fillBuffer->size && !flashfsQueueFullPage(sync)) {
+            writeStats.stalls++;
+            writeStats.bytesDropped += len;
             return;
         }
 
-        // Fall through and add the remainder of the incoming data to our buffer
-        data = buffers[2];
-        len = bufferSizes[2];
-    }
-
-    // Buffer up the data the user supplied instead of writing it right away
-
-    // First write the portion before we wrap around the end of the circular buffer
-    unsigned int bufferBytesBeforeWrap = FLASHFS_WRITE_BUFFER_SIZE - bufferHead;
-
-    unsigned int firstPortion = len < bufferBytesBeforeWrap ? len : bufferBytesBeforeWrap;
-
-    memcpy(flashWriteBuffer + bufferHead, data, firstPortion);
+        const unsigned int chunk = MIN(len, (unsigned int)(fillBuffer->size - fillBuffer->length));
 
-    bufferHead += firstPortion;
+        memcpy(fillBuffer->data + fillBuffer->length, data, chunk);
+        fillBuffer->length += chunk;
 
-    data += firstPortion;
-    len -= firstPortion;
-
-    // If we wrap the head around, write the remainder to the start of the buffer (if any)
-    if (bufferHead == FLASHFS_WRITE_BUFFER_SIZE) {
-        memcpy(flashWriteBuffer + 0, data, len);
+        data += chunk;
+        len -= chunk;
+    }
 
-        bufferHead = len;
+    // Hand a completed page over straight away so the flash gets the most time to program it
+    if (fillBuffer->length == fillBuffer->size) {
+        flashfsQueueFullPage(sync);
     }
 }
 
@@ -512,9 +578,10 @@ int flashfsReadAbs(uint32_t address, uint8_t *buffer, unsigned int len)
 }
 
 /**
- * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ * Find the offset of the start of the free space behind the given address, which must lie in written data (or the
+ * size of the device if it is full).
  */
-int flashfsIdentifyStartOfFreeSpace(void)
+static uint32_t flashfsFindFreeSpaceFrom(uint32_t address)
 {
     /* Find the start of the free space on the device by examining the beginning of blocks with a binary search,
      * looking for ones that appear to be erased. We can achieve this with good accuracy because an erased block
@@ -543,7 +610,7 @@ int flashfsIdentifyStartOfFreeSpace(void)
         uint32_t ints[FREE_BLOCK_TEST_SIZE_INTS];
     } testBuffer;
 
-    int left = 0; // Smallest block index in the search region
+    int left = (address + FREE_BLOCK_SIZE - 1) / FREE_BLOCK_SIZE; // Smallest block index in the search region
     int right = flashfsSize / FREE_BLOCK_SIZE; // One past the largest block index in the search region
     int mid;
     int result = right;
@@ -582,6 +649,121 @@ int flashfsIdentifyStartOfFreeSpace(void)
     return result * FREE_BLOCK_SIZE;
 }
 
+/**
+ * Find the offset of the start of the free space on the device (or the size of the device if it is full).
+ */
+int flashfsIdentifyStartOfFreeSpace(void)
+{
+    return flashfsFindFreeSpaceFrom(0);
+}
+
+/**
+ * Record the start of a log at the current offset. Keep calling until this returns true, it waits for the
+ * buffered data to be written and for the flash to be ready.
+ *
+ * Once the index is full, logs are still written but aren't recorded.
+ */
+bool flashfsBeginLog(void)
+{
+    if (!flashfsIndexIsEnabled() || (logIndex.nextSlot & 1) || flashfsIndexIsFull()) {
+        return true;
+    }
+
+    if (!flashfsFlushAsync(true) || !flashIsReady()) {
+        return false;
+    }
+
+    flashfsIndexProgram(FLASHFS_INDEX_START, flashfsGetOffset());
+
+    return true;
+}
+
+/**
+ * The number of logs on the volume, including the one being written. 0 if the volume has no index.
+ */
+int flashfsGetLogCount(void)
+{
+    if (!flashfsIndexIsEnabled()) {
+        return 0;
+    }
+
+    int count = (logIndex.nextSlot + 1) / 2;
+
+    if (flashfsIndexIsFull() && !(logIndex.nextSlot & 1) && flashfsGetOffset() > flashfsIndexAddressAt(logIndex.nextSlot - 1)) {
+        // Whatever was written after the index filled up
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Get the range of addresses [start...end) holding the log with the given index, counting from the oldest one.
+ */
+bool flashfsGetLog(int index, uint32_t *start, uint32_t *end)
+{
+    if (index < 0 || index >= flashfsGetLogCount()) {
+        return false;
+    }
+
+    const uint32_t slot = index * 2;
+
+    if (slot >= logIndex.nextSlot) {
+        *start = flashfsIndexAddressAt(logIndex.nextSlot - 1);
+        *end = flashfsGetOffset();
+    } else {
+        // A torn START leaves the log empty, a torn END makes it run up to the next log
+        *end = flashfsIndexAddressAt(slot + 1);
+        *start = MIN(flashfsIndexAddressAt(slot), *end);
+    }
+
+    return true;
+}
+
+/**
+ * Find the write head from the index, closing a log that was cut short by a power loss or adopting data written
+ * without an index. Falls back to searching for the free space if the last sector doesn't hold an index.
+ */
+static uint32_t flashfsIndexLoad(void)
+{
+    flashfsIndexReset();
+
+    if (!flashfsIndexIsEnabled()) {
+        return flashfsIdentifyStartOfFreeSpace();
+    }
+
+    logIndex.nextSlot = flashfsIndexFindNextSlot();
+
+    flashfsIndexRecord_t record;
+    if (logIndex.nextSlot >= 1 && flashfsIndexRead(0, &record) != FLASHFS_INDEX_SLOT_VALID) {
+        // Logs from before there was an index, leave the sector to them until the next erase
+        flashfsIndexDisable();
+        return flashfsIdentifyStartOfFreeSpace();
+    }
+
+    uint32_t head;
+
+    if (logIndex.nextSlot > 0 && !(logIndex.nextSlot & 1) && !flashfsIndexIsFull()
+        && flashfsIndexRead(logIndex.nextSlot - 1, &record) == FLASHFS_INDEX_SLOT_VALID) {
+        head = record.address;
+    } else {
+        head = flashfsFindFreeSpaceFrom(flashfsIndexLastAddress());
+
+        if (logIndex.nextSlot == 0 && head > 0) {
+            flashfsIndexProgram(FLASHFS_INDEX_START, 0);
+        }
+        if (logIndex.nextSlot & 1) {
+            flashfsIndexProgram(FLASHFS_INDEX_END, head);
+        }
+    }
+
+    if (flashGeometry->flashType == FLASH_TYPE_NAND) {
+        head = (head + flashGeometry->pageSize - 1) & ~(flashGeometry->pageSize - 1);
+    }
+
+    return head;
+}
+
 /**
  * Returns true if the file pointer is at the end of the device.
  */
@@ -592,6 +774,8 @@ bool flashfsIsEOF(void)
 
 void flashfsClose(void)
 {
+    const uint32_t end = flashfsGetOffset();
+
     switch(flashGeometry->flashType) {
     case FLASH_TYPE_NOR:
         break;
@@ -605,6 +789,12 @@ void flashfsClose(void)
 
         break;
     }
+
+    if (logIndex.nextSlot & 1) {
+        // The END goes after the data so that it never points past what made it to the flash
+        flashfsFlushSync();
+        flashfsIndexProgram(FLASHFS_INDEX_END, end);
+    }
 }
 
 /**
@@ -613,18 +803,22 @@ void flashfsClose(void)
 void flashfsInit(void)
 {
     flashfsSize = 0;
+    memset(&writeStats, 0, sizeof(writeStats));
 
     flashPartition = flashPartitionFindByType(FLASH_PARTITION_TYPE_FLASHFS);
     flashGeometry = flashGetGeometry();
 
+    memset(&logIndex, 0, sizeof(logIndex));
+
     if (!flashPartition) {
         return;
     }
 
-    flashfsSize = FLASH_PARTITION_SECTOR_COUNT(flashPartition) * flashGeometry->sectorSize;
+    // Nothing buffered before now belongs to the volume as it is found
+    flashfsSetTailAddress(0);
 
     // Start the file pointer off at the beginning of free space so caller can start writing immediately
-    flashfsSeekAbs(flashfsIdentifyStartOfFreeSpace());
+    flashfsSeekAbs(flashfsIndexLoad());
 }
 
 #ifdef USE_FLASH_TOOLS
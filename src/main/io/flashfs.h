@@ -20,11 +20,15 @@
 
 #pragma once
 
-#define FLASHFS_WRITE_BUFFER_SIZE 128
-#define FLASHFS_WRITE_BUFFER_USABLE (FLASHFS_WRITE_BUFFER_SIZE - 1)
+// Size of each of the two page buffers, a NOR flash page
+#define FLASHFS_WRITE_BUFFER_SIZE 256
 
-// Automatically trigger a flush when this much data is in the buffer
-#define FLASHFS_WRITE_BUFFER_AUTO_FLUSH_LEN 64
+typedef struct flashfsWriteStats_s {
+    uint32_t pagePrograms;      // program operations issued
+    uint32_t partialPrograms;   // of those, ones for less than a page, from forced flushes
+    uint32_t stalls;            // async writes that found both buffers full while the flash was busy
+    uint32_t bytesDropped;      // data thrown away by those writes, or written past the end of the volume
+} flashfsWriteStats_t;
 
 void flashfsEraseCompletely(void);
 void flashfsEraseRange(uint32_t start, uint32_t end);
@@ -33,6 +37,7 @@ uint32_t flashfsGetSize(void);
 uint32_t flashfsGetOffset(void);
 uint32_t flashfsGetWriteBufferFreeSpace(void);
 uint32_t flashfsGetWriteBufferSize(void);
+const flashfsWriteStats_t *flashfsGetWriteStats(void);
 int flashfsIdentifyStartOfFreeSpace(void);
 struct flashGeometry_s;
 const struct flashGeometry_s* flashfsGetGeometry(void);
@@ -45,10 +50,13 @@ void flashfsWrite(const uint8_t *data, unsigned int len, bool sync);
 
 int flashfsReadAbs(uint32_t offset, uint8_t *data, unsigned int len);
 
-bool flashfsFlushAsync(void);
+bool flashfsFlushAsync(bool force);
 void flashfsFlushSync(void);
 
+bool flashfsBeginLog(void);
 void flashfsClose(void);
+int flashfsGetLogCount(void);
+bool flashfsGetLog(int index, uint32_t *start, uint32_t *end);
 void flashfsInit(void);
 bool flashfsIsSupported(void);
 
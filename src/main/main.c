@@ -41,10 +41,14 @@ int main(void)
 void FAST_CODE FAST_CODE_NOINLINE run(void)
 {
     while (true) {
+#if defined(SIMULATOR_BUILD) && defined(SIMULATOR_LOCKSTEP)
+        simulatorLockstepStep();
+#else
         scheduler();
         processLoopback();
 #ifdef SIMULATOR_BUILD
         delayMicroseconds_real(50); // max rate 20kHz
+#endif
 #endif
     }
 }
@@ -300,27 +300,116 @@ static void emfat_add_log(emfat_entry_t *entry, int number, uint32_t offset, uin
     entry->cma_time[2] = entry->cma_time[0];
 }
 
+static const char logHeader[] = "H Product:Blackbox";
+#define LOG_HEADER_LENGTH (sizeof(logHeader) - 1)
+
+/**
+ * Set the creation time of the entry from the header of the log at `offset`, whose first HDR_BUF_SIZE bytes are in
+ * `buffer` already.
+ */
+static void emfat_read_log_time(emfat_entry_t *entry, uint8_t *buffer, int offset, int limit)
+{
+    const char *timeHeader = "H Log start datetime:";
+    const int lenTimeHeader = strlen(timeHeader);
+    int timeHeaderMatched = 0;
+
+    // Find the "Log start datetime" entry, example encoding "H Log start datetime:2019-08-15T13:18:22.199+00:00"
+
+    int buffOffset = LOG_HEADER_LENGTH;
+    int hdrOffset = offset;
+
+    // Set the default timestamp for this log entry in case the timestamp is not found
+    entry->cma_time[0] = cmaTime;
+
+    // Search for the timestamp record
+    while (true) {
+        if (buffer[buffOffset++] == timeHeader[timeHeaderMatched]) {
+            // This matches the header we're looking for so far
+            if (++timeHeaderMatched == lenTimeHeader) {
+                // Complete match so read date/time into buffer
+                flashfsReadAbs(hdrOffset + buffOffset, buffer, HDR_BUF_SIZE);
+
+                // Extract the time values to create the CMA time
+                char *nextToken = (char *)buffer;
+                int year = strtoul(nextToken, &nextToken, 10);
+                int month = strtoul(++nextToken, &nextToken, 10);
+                int day = strtoul(++nextToken, &nextToken, 10);
+                int hour = strtoul(++nextToken, &nextToken, 10);
+                int min = strtoul(++nextToken, &nextToken, 10);
+                int sec = strtoul(++nextToken, NULL, 10);
+
+                // Set the file creation time
+                if (year) {
+                    entry->cma_time[0] = EMFAT_ENCODE_CMA_TIME(day, month, year, hour, min, sec);
+                }
+
+                break;
+            }
+        } else {
+            timeHeaderMatched = 0;
+        }
+
+        if (buffOffset == HDR_BUF_SIZE) {
+            // Read the next portion of the header
+            hdrOffset += HDR_BUF_SIZE;
+
+            // Check for flash overflow
+            if (hdrOffset > limit) {
+                break;
+            }
+
+            flashfsReadAbs(hdrOffset, buffer, HDR_BUF_SIZE);
+            buffOffset = 0;
+        }
+    }
+}
+
+/**
+ * Create an entry for every log in the flashfs index, the logs can start anywhere.
+ */
+static int emfat_find_indexed_log(emfat_entry_t *entry, int maxCount)
+{
+    uint8_t buffer[HDR_BUF_SIZE];
+    uint32_t start;
+    uint32_t end;
+    int logCount = 0;
+
+    for (int i = 0; logCount < maxCount && flashfsGetLog(i, &start, &end); i++) {
+        if (start == end) {
+            continue;
+        }
+
+        flashfsReadAbs(start, buffer, HDR_BUF_SIZE);
+        if (strncmp((char *)buffer, logHeader, LOG_HEADER_LENGTH) == 0) {
+            emfat_read_log_time(entry, buffer, start, end);
+        } else {
+            entry->cma_time[0] = cmaTime;
+        }
+
+        emfat_add_log(entry++, logCount++, start, end - start);
+    }
+
+    return logCount;
+}
+
 static int emfat_find_log(emfat_entry_t *entry, int maxCount)
 {
-    int limit = flashfsIdentifyStartOfFreeSpace();
+    if (flashfsGetLogCount() > 0) {
+        return emfat_find_indexed_log(entry, maxCount);
+    }
+
+    int limit = flashfsGetOffset();
     int lastOffset = 0;
     int currOffset = 0;
-    int buffOffset;
-    int hdrOffset;
     int fileNumber = 0;
     uint8_t buffer[HDR_BUF_SIZE];
     int logCount = 0;
-    char *logHeader = "H Product:Blackbox";
-    int lenLogHeader = strlen(logHeader);
-    char *timeHeader = "H Log start datetime:";
-    int lenTimeHeader = strlen(timeHeader);
-    int timeHeaderMatched = 0;
 
     for ( ; currOffset < limit ; currOffset += 2048) { // XXX 2048 = FREE_BLOCK_SIZE in io/flashfs.c
 
         flashfsReadAbs(currOffset, buffer, HDR_BUF_SIZE);
 
-        if (strncmp((char *)buffer, logHeader, lenLogHeader)) {
+        if (strncmp((char *)buffer, logHeader, LOG_HEADER_LENGTH)) {
             continue;
         }
 
@@ -332,55 +421,7 @@ static int emfat_find_log(emfat_entry_t *entry, int maxCount)
             logCount++;
         }
 
-        // Find the "Log start datetime" entry, example encoding "H Log start datetime:2019-08-15T13:18:22.199+00:00"
-
-        buffOffset = lenLogHeader;
-        hdrOffset = currOffset;
-
-        // Set the default timestamp for this log entry in case the timestamp is not found
-        entry->cma_time[0] = cmaTime;
-
-        // Search for the timestamp record
-        while (true) {
-            if (buffer[buffOffset++] == timeHeader[timeHeaderMatched]) {
-                // This matches the header we're looking for so far
-                if (++timeHeaderMatched == lenTimeHeader) {
-                    // Complete match so read date/time into buffer
-                    flashfsReadAbs(hdrOffset + buffOffset, buffer, HDR_BUF_SIZE);
-
-                    // Extract the time values to create the CMA time
-                    char *nextToken = (char *)buffer;
-                    int year = strtoul(nextToken, &nextToken, 10);
-                    int month = strtoul(++nextToken, &nextToken, 10);
-                    int day = strtoul(++nextToken, &nextToken, 10);
-                    int hour = strtoul(++nextToken, &nextToken, 10);
-                    int min = strtoul(++nextToken, &nextToken, 10);
-                    int sec = strtoul(++nextToken, NULL, 10);
-
-                    // Set the file creation time
-                    if (year) {
-                        entry->cma_time[0] = EMFAT_ENCODE_CMA_TIME(day, month, year, hour, min, sec);
-                    }
-
-                    break;
-                }
-            } else {
-                timeHeaderMatched = 0;
-            }
-
-            if (buffOffset == HDR_BUF_SIZE) {
-                // Read the next portion of the header
-                hdrOffset += HDR_BUF_SIZE;
-
-                // Check for flash overflow
-                if (hdrOffset > limit) {
-                    break;
-                }
-
-                flashfsReadAbs(hdrOffset, buffer, HDR_BUF_SIZE);
-                buffOffset = 0;
-            }
-        }
+        emfat_read_log_time(entry, buffer, currOffset, limit);
 
         if (fileNumber == maxCount) {
             break;
@@ -427,7 +468,7 @@ void emfat_init_files(void)
         // allow downloading the entire log in one file
         entries[entryIndex] = entriesPredefined[PREDEFINED_ENTRY_COUNT];
         entry = &entries[entryIndex];
-        entry->curr_size = flashfsIdentifyStartOfFreeSpace();
+        entry->curr_size = flashfsGetOffset();
         entry->max_size = entry->curr_size;
         // This entry has timestamps corresponding to when the filesystem is mounted
         emfat_set_entry_cma(entry);
@@ -438,7 +479,7 @@ void emfat_init_files(void)
     entries[entryIndex] = entriesPredefined[PREDEFINED_ENTRY_COUNT + 1];
     entry = &entries[entryIndex];
     // used space is doubled because of the individual files plus the single complete file
-    entry->curr_size = (FILESYSTEM_SIZE_MB * 1024 * 1024) - (flashfsIdentifyStartOfFreeSpace() * 2);
+    entry->curr_size = (FILESYSTEM_SIZE_MB * 1024 * 1024) - (flashfsGetOffset() * 2);
     entry->max_size = entry->curr_size;
     // This entry has timestamps corresponding to when the filesystem is mounted
     emfat_set_entry_cma(entry);
@@ -172,6 +172,8 @@ typedef enum {
     MSP_FLASHFS_FLAG_SUPPORTED  = 2
 } mspFlashFsFlags_e;
 
+#define MSP_DATAFLASH_LOGS_PER_REPLY 32
+
 #define RATEPROFILE_MASK (1 << 7)
 
 #define RTC_NOT_SUPPORTED 0xff
@@ -1438,6 +1440,19 @@ static bool mspProcessOutCommand(uint8_t cmdMSP, sbuf_t *dst)
         serializeDataflashSummaryReply(dst);
         break;
 
+#ifdef USE_FLASHFS
+    case MSP_DATAFLASH_WRITE_STATS:
+        {
+            const flashfsWriteStats_t *writeStats = flashfsGetWriteStats();
+
+            sbufWriteU32(dst, writeStats->pagePrograms);
+            sbufWriteU32(dst, writeStats->partialPrograms);
+            sbufWriteU32(dst, writeStats->stalls);
+            sbufWriteU32(dst, writeStats->bytesDropped);
+        }
+        break;
+#endif
+
     case MSP_BLACKBOX_CONFIG:
 #ifdef USE_BLACKBOX
         sbufWriteU8(dst, 1); //Blackbox supported
@@ -1872,6 +1887,51 @@ static mspResult_e mspFcProcessOutCommandWithArg(uint8_t cmdMSP, sbuf_t *src, sb
         break;
 #endif // USE_VTX_TABLE
 
+#if defined(USE_TASK_HISTOGRAMS)
+    case MSP_TASK_HISTOGRAM:
+        {
+            const uint8_t taskId = sbufBytesRemaining(src) ? sbufReadU8(src) : TASK_COUNT;
+            if (taskId >= TASK_COUNT) {
+                return MSP_RESULT_ERROR;
+            }
+            cfTaskInfo_t taskInfo;
+            getTaskInfo(taskId, &taskInfo);
+            cfTaskHistogramInfo_t histogramInfo;
+            getTaskHistogramInfo(taskId, &histogramInfo);
+
+            sbufWriteU8(dst, taskId);  // task id (same as request)
+            sbufWriteU8(dst, taskInfo.isEnabled);
+            sbufWriteU32(dst, histogramInfo.sampleCount);
+            for (int i = 0; i < TASK_PERCENTILE_COUNT; i++) { // p50, p99 and p99.9 in us
+                sbufWriteU32(dst, histogramInfo.executionTime[i]);
+            }
+            for (int i = 0; i < TASK_PERCENTILE_COUNT; i++) {
+                sbufWriteU32(dst, histogramInfo.lateness[i]);
+            }
+        }
+        break;
+#endif
+
+#ifdef USE_FLASHFS
+    case MSP_DATAFLASH_LOGS:
+        {
+            const int firstLog = sbufBytesRemaining(src) >= 2 ? sbufReadU16(src) : 0;
+            const int logCount = flashfsGetLogCount();
+            uint32_t start;
+            uint32_t end;
+
+            sbufWriteU16(dst, logCount);
+            sbufWriteU16(dst, firstLog);
+            // The rest of the list is fetched by asking again from the first log that was left out
+            for (int i = firstLog; i < logCount && i < firstLog + MSP_DATAFLASH_LOGS_PER_REPLY; i++) {
+                flashfsGetLog(i, &start, &end);
+                sbufWriteU32(dst, start);
+                sbufWriteU32(dst, end);
+            }
+        }
+        break;
+#endif
+
     case MSP_RESET_CONF:
         {
 #if defined(USE_CUSTOM_DEFAULTS)
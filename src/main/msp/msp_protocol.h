@@ -284,6 +284,9 @@
 #define MSP_VTXTABLE_BAND        137    //out message         vtxTable band/channel data
 #define MSP_VTXTABLE_POWERLEVEL  138    //out message         vtxTable powerLevel data
 #define MSP_MOTOR_TELEMETRY      139    //out message         Per-motor telemetry data (RPM, packet stats, ESC temp, etc.)
+#define MSP_TASK_HISTOGRAM       140    //out message         Execution time and start lateness percentiles of a scheduler task
+#define MSP_DATAFLASH_WRITE_STATS 141   //out message         Dataflash page program and back-pressure counters
+#define MSP_DATAFLASH_LOGS       142    //out message         Start and end addresses of the logs in the dataflash index
 
 #define MSP_SET_RAW_RC           200    //in message          8 rc chan
 #define MSP_SET_RAW_GPS          201    //in message          fix, numsat, lat, lon, alt, speed
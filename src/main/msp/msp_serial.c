@@ -208,6 +208,10 @@ static bool mspSerialProcessReceivedData(mspPort_t *mspPort, uint8_t c)
             mspPort->checksum2 = crc8_dvb_s2(mspPort->checksum2, c);
             if (mspPort->offset == (sizeof(mspHeaderV2_t) + sizeof(mspHeaderV1_t))) {
                 mspHeaderV2_t * hdrv2 = (mspHeaderV2_t *)&mspPort->inBuf[sizeof(mspHeaderV1_t)];
+                if (hdrv2->size > MSP_PORT_INBUF_SIZE) {
+                    mspPort->c_state = MSP_IDLE;
+                    break;
+                }
                 mspPort->dataSize = hdrv2->size;
                 mspPort->cmdMSP = hdrv2->cmd;
                 mspPort->cmdFlags = hdrv2->flags;
@@ -240,6 +244,10 @@ static bool mspSerialProcessReceivedData(mspPort_t *mspPort, uint8_t c)
             mspPort->checksum2 = crc8_dvb_s2(mspPort->checksum2, c);
             if (mspPort->offset == sizeof(mspHeaderV2_t)) {
                 mspHeaderV2_t * hdrv2 = (mspHeaderV2_t *)&mspPort->inBuf[0];
+                if (hdrv2->size > MSP_PORT_INBUF_SIZE) {
+                    mspPort->c_state = MSP_IDLE;
+                    break;
+                }
                 mspPort->dataSize = hdrv2->size;
                 mspPort->cmdMSP = hdrv2->cmd;
                 mspPort->cmdFlags = hdrv2->flags;
@@ -271,43 +279,86 @@ static bool mspSerialProcessReceivedData(mspPort_t *mspPort, uint8_t c)
 
 static uint8_t mspSerialChecksumBuf(uint8_t checksum, const uint8_t *data, int len)
 {
-    while (len-- > 0) {
-        checksum ^= *data++;
+    return crc8_xor_update(checksum, data, len);
+}
+
+static bool mspSerialIsReceivingPayload(const mspPort_t *mspPort)
+{
+    return mspPort->c_state == MSP_PAYLOAD_V1
+        || mspPort->c_state == MSP_PAYLOAD_V2_OVER_V1
+        || mspPort->c_state == MSP_PAYLOAD_V2_NATIVE;
+}
+
+// Once the header is in, take as much of the payload as is waiting in one go and checksum it as a block.
+static void mspSerialReceivePayload(mspPort_t *mspPort)
+{
+    uint8_t *data = &mspPort->inBuf[mspPort->offset];
+    const uint32_t count = serialReadBuf(mspPort->port, data, mspPort->dataSize - mspPort->offset);
+
+    mspPort->offset += count;
+    const bool complete = mspPort->offset == mspPort->dataSize;
+
+    switch (mspPort->c_state) {
+        default:
+        case MSP_PAYLOAD_V1:
+            mspPort->checksum1 = mspSerialChecksumBuf(mspPort->checksum1, data, count);
+            if (complete) {
+                mspPort->c_state = MSP_CHECKSUM_V1;
+            }
+            break;
+
+        case MSP_PAYLOAD_V2_OVER_V1:
+            mspPort->checksum2 = crc8_dvb_s2_update(mspPort->checksum2, data, count);
+            mspPort->checksum1 = mspSerialChecksumBuf(mspPort->checksum1, data, count);
+            if (complete) {
+                mspPort->c_state = MSP_CHECKSUM_V2_OVER_V1;
+            }
+            break;
+
+        case MSP_PAYLOAD_V2_NATIVE:
+            mspPort->checksum2 = crc8_dvb_s2_update(mspPort->checksum2, data, count);
+            if (complete) {
+                mspPort->c_state = MSP_CHECKSUM_V2_NATIVE;
+            }
+            break;
     }
-    return checksum;
 }
 
 #define JUMBO_FRAME_SIZE_LIMIT 255
-static int mspSerialSendFrame(mspPort_t *msp, const uint8_t * hdr, int hdrLen, const uint8_t * data, int dataLen, const uint8_t * crc, int crcLen)
+static int mspSerialSendFrame(mspPort_t *msp, const mspFrame_t *frame)
 {
     // We are allowed to send out the response if
     //  a) TX buffer is completely empty (we are talking to well-behaving party that follows request-response scheduling;
     //     this allows us to transmit jumbo frames bigger than TX buffer (serialWriteBuf will block, but for jumbo frames we don't care)
     //  b) Response fits into TX buffer
-    const int totalFrameLength = hdrLen + dataLen + crcLen;
+    const int totalFrameLength = frame->hdrLen + frame->dataLen + frame->crcLen;
     if (!isSerialTransmitBufferEmpty(msp->port) && ((int)serialTxBytesFree(msp->port) < totalFrameLength))
         return 0;
 
     // Transmit frame
     serialBeginWrite(msp->port);
-    serialWriteBuf(msp->port, hdr, hdrLen);
-    serialWriteBuf(msp->port, data, dataLen);
-    serialWriteBuf(msp->port, crc, crcLen);
+    serialWriteBuf(msp->port, frame->hdr, frame->hdrLen);
+    serialWriteBuf(msp->port, frame->data, frame->dataLen);
+    serialWriteBuf(msp->port, frame->crc, frame->crcLen);
     serialEndWrite(msp->port);
 
     return totalFrameLength;
 }
 
-static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e mspVersion)
+static bool mspSerialEncode(mspFrame_t *frame, mspPacket_t *packet, mspVersion_e mspVersion)
 {
     static const uint8_t mspMagic[MSP_VERSION_COUNT] = MSP_VERSION_MAGIC_INITIALIZER;
     const int dataLen = sbufBytesRemaining(&packet->buf);
-    uint8_t hdrBuf[16] = { '$', mspMagic[mspVersion], packet->result == MSP_RESULT_ERROR ? '!' : '>'};
-    uint8_t crcBuf[2];
+    uint8_t *hdrBuf = frame->hdr;
+    uint8_t *crcBuf = frame->crc;
     uint8_t checksum;
     int hdrLen = 3;
     int crcLen = 0;
 
+    hdrBuf[0] = '$';
+    hdrBuf[1] = mspMagic[mspVersion];
+    hdrBuf[2] = packet->result == MSP_RESULT_ERROR ? '!' : '>';
+
     #define V1_CHECKSUM_STARTPOS 3
     if (mspVersion == MSP_V1) {
         mspHeaderV1_t * hdrV1 = (mspHeaderV1_t *)&hdrBuf[hdrLen];
@@ -384,21 +435,33 @@ static int mspSerialEncode(mspPort_t *msp, mspPacket_t *packet, mspVersion_e msp
     }
     else {
         // Shouldn't get here
-        return 0;
+        return false;
     }
 
-    // Send the frame
-    return mspSerialSendFrame(msp, hdrBuf, hdrLen, sbufPtr(&packet->buf), dataLen, crcBuf, crcLen);
+    frame->hdrLen = hdrLen;
+    frame->crcLen = crcLen;
+    frame->data = sbufPtr(&packet->buf);
+    frame->dataLen = dataLen;
+
+    return true;
+}
+
+static void mspSerialSendPendingReply(mspPort_t *msp)
+{
+    if (msp->replyPending && mspSerialSendFrame(msp, &msp->pendingReply)) {
+        msp->replyPending = false;
+    }
 }
 
 static mspPostProcessFnPtr mspSerialProcessReceivedCommand(mspPort_t *msp, mspProcessCommandFnPtr mspProcessCommandFn)
 {
     static uint8_t outBuf[MSP_PORT_OUTBUF_SIZE];
 
+    // The flags of an MSPv2 request are echoed, a client pipelining requests can use them as a sequence tag
     mspPacket_t reply = {
         .buf = { .ptr = outBuf, .end = ARRAYEND(outBuf), },
         .cmd = -1,
-        .flags = 0,
+        .flags = msp->cmdFlags,
         .result = 0,
         .direction = MSP_DIRECTION_REPLY,
     };
@@ -417,7 +480,15 @@ static mspPostProcessFnPtr mspSerialProcessReceivedCommand(mspPort_t *msp, mspPr
 
     if (status != MSP_RESULT_NO_REPLY) {
         sbufSwitchToReader(&reply.buf, outBufHead); // change streambuf direction
-        mspSerialEncode(msp, &reply, msp->mspVersion);
+        mspFrame_t *frame = &msp->pendingReply;
+        if (mspSerialEncode(frame, &reply, msp->mspVersion) && !mspSerialSendFrame(msp, frame) && frame->dataLen <= sizeof(msp->inBuf)) {
+            // A reply that doesn't fit yet is held back rather than dropped, so a pipelining client gets one for every
+            // request. Its payload moves to the input buffer, which isn't needed again before the reply is out. Replies
+            // too big for it are only asked for by clients that wait for them.
+            memcpy(msp->inBuf, frame->data, frame->dataLen);
+            frame->data = msp->inBuf;
+            msp->replyPending = true;
+        }
     }
 
     return mspPostProcessFn;
@@ -498,17 +569,28 @@ void mspSerialProcess(mspEvaluateNonMspData_e evaluateNonMspData, mspProcessComm
 
         mspPostProcessFnPtr mspPostProcessFn = NULL;
 
+        // Requests that follow wait in the receive buffer until the last reply is out
+        mspSerialSendPendingReply(mspPort);
+        if (mspPort->replyPending) {
+            continue;
+        }
+
         if (serialRxBytesWaiting(mspPort->port)) {
             // There are bytes incoming - abort pending request
             mspPort->lastActivityMs = millis();
             mspPort->pendingRequest = MSP_PENDING_NONE;
 
+            int commandCount = 0;
             while (serialRxBytesWaiting(mspPort->port)) {
-                const uint8_t c = serialRead(mspPort->port);
-                const bool consumed = mspSerialProcessReceivedData(mspPort, c);
-
-                if (!consumed && evaluateNonMspData == MSP_EVALUATE_NON_MSP_DATA) {
-                    mspEvaluateNonMspData(mspPort, c);
+                if (mspSerialIsReceivingPayload(mspPort)) {
+                    mspSerialReceivePayload(mspPort);
+                } else {
+                    const uint8_t c = serialRead(mspPort->port);
+                    const bool consumed = mspSerialProcessReceivedData(mspPort, c);
+
+                    if (!consumed && evaluateNonMspData == MSP_EVALUATE_NON_MSP_DATA) {
+                        mspEvaluateNonMspData(mspPort, c);
+                    }
                 }
 
                 if (mspPort->c_state == MSP_COMMAND_RECEIVED) {
@@ -519,11 +601,17 @@ void mspSerialProcess(mspEvaluateNonMspData_e evaluateNonMspData, mspProcessComm
                     }
 
                     mspPort->c_state = MSP_IDLE;
-                    break; // process one command at a time so as not to block.
+                    // Carry on with pipelined requests as long as their replies go straight out, but not for too long
+                    if (mspPostProcessFn || mspPort->replyPending || ++commandCount == MSP_PORT_COMMANDS_PER_PROCESS) {
+                        break;
+                    }
                 }
             }
 
             if (mspPostProcessFn) {
+                waitForSerialPortToFinishTransmitting(mspPort->port);
+                // The transmit buffer is empty, so a reply that was held back goes out now
+                mspSerialSendPendingReply(mspPort);
                 waitForSerialPortToFinishTransmitting(mspPort->port);
                 mspPostProcessFn(mspPort->port);
             }
@@ -577,7 +665,9 @@ int mspSerialPush(uint8_t cmd, uint8_t *data, int datalen, mspDirection_e direct
             .direction = direction,
         };
 
-        ret = mspSerialEncode(mspPort, &push, MSP_V1);
+        mspFrame_t frame;
+        mspSerialEncode(&frame, &push, MSP_V1);
+        ret = mspSerialSendFrame(mspPort, &frame);
     }
     return ret; // return the number of bytes written
 }
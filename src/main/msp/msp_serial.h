@@ -65,6 +65,8 @@ typedef enum {
 } mspPendingSystemRequest_e;
 
 #define MSP_PORT_INBUF_SIZE 192
+// Pipelined requests handled per call, enough to keep up with replies of a few bytes at 115200 baud
+#define MSP_PORT_COMMANDS_PER_PROCESS 8
 #ifdef USE_FLASHFS
 #ifdef STM32F1
 #define MSP_PORT_DATAFLASH_BUFFER_SIZE 1024
@@ -94,6 +96,15 @@ typedef struct __attribute__((packed)) {
 
 #define MSP_MAX_HEADER_SIZE     9
 
+typedef struct mspFrame_s {
+    uint8_t hdr[16];
+    uint8_t hdrLen;
+    uint8_t crc[2];
+    uint8_t crcLen;
+    const uint8_t *data;
+    uint16_t dataLen;
+} mspFrame_t;
+
 struct serialPort_s;
 typedef struct mspPort_s {
     struct serialPort_s *port; // null when port unused.
@@ -110,6 +121,8 @@ typedef struct mspPort_s {
     uint8_t checksum1;
     uint8_t checksum2;
     bool sharedWithTelemetry;
+    bool replyPending;
+    mspFrame_t pendingReply;    // waiting for room in the transmit buffer
 } mspPort_t;
 
 void mspSerialInit(void);
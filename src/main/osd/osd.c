@@ -221,16 +221,18 @@ void changeOsdProfileIndex(uint8_t profileIndex)
 }
 #endif
 
-static void osdDrawElements(timeUs_t currentTimeUs)
+// Returns true if there are elements to be drawn
+static bool osdDrawElementsBegin(timeUs_t currentTimeUs)
 {
     displayClearScreen(osdDisplayPort);
 
     // Hide OSD when OSDSW mode is active
     if (IS_RC_MODE_ACTIVE(BOXOSD)) {
-        return;
+        return false;
     }
 
-    osdDrawActiveElements(osdDisplayPort, currentTimeUs);
+    osdDrawActiveElementsBegin(currentTimeUs);
+    return true;
 }
 
 const uint16_t osdTimerDefault[OSD_TIMER_COUNT] = {
@@ -775,7 +777,10 @@ static void osdShowArmed(void)
     displayWrite(osdDisplayPort, 12, 7, "ARMED");
 }
 
-STATIC_UNIT_TESTED void osdRefresh(timeUs_t currentTimeUs)
+/*
+ * Updates the OSD state, returns true if the elements have to be drawn to complete the refresh
+ */
+static bool osdRefreshBegin(timeUs_t currentTimeUs)
 {
     static timeUs_t lastTimeUs = 0;
     static bool osdStatsEnabled = false;
@@ -839,7 +844,7 @@ STATIC_UNIT_TESTED void osdRefresh(timeUs_t currentTimeUs)
                 resumeRefreshAt = currentTimeUs;
             }
             displayHeartbeat(osdDisplayPort);
-            return;
+            return false;
         } else {
             displayClearScreen(osdDisplayPort);
             resumeRefreshAt = 0;
@@ -867,11 +872,23 @@ STATIC_UNIT_TESTED void osdRefresh(timeUs_t currentTimeUs)
 #endif
 
 #ifdef USE_CMS
-    if (!displayIsGrabbed(osdDisplayPort))
+    if (displayIsGrabbed(osdDisplayPort)) {
+        return false;
+    }
 #endif
-    {
-        osdUpdateAlarms();
-        osdDrawElements(currentTimeUs);
+
+    osdUpdateAlarms();
+    if (!osdDrawElementsBegin(currentTimeUs)) {
+        displayHeartbeat(osdDisplayPort);
+        return false;
+    }
+    return true;
+}
+
+STATIC_UNIT_TESTED void osdRefresh(timeUs_t currentTimeUs)
+{
+    if (osdRefreshBegin(currentTimeUs)) {
+        osdDrawNextActiveElements(osdDisplayPort, OSD_ITEM_COUNT);
         displayHeartbeat(osdDisplayPort);
     }
 }
@@ -882,6 +899,7 @@ STATIC_UNIT_TESTED void osdRefresh(timeUs_t currentTimeUs)
 void osdUpdate(timeUs_t currentTimeUs)
 {
     static uint32_t counter = 0;
+    static bool drawingElements = false;
 
     if (isBeeperOn()) {
         showVisualBeeper = true;
@@ -910,10 +928,35 @@ void osdUpdate(timeUs_t currentTimeUs)
 #define DRAW_FREQ_DENOM 10 // MWOSD @ 115200 baud (
 #endif
 #define STATS_FREQ_DENOM    50
+#define DRAW_ELEMENTS_PER_STEP  8 // draw the elements over several calls so a single call does not hold up the PID loop
+
+    if (drawingElements) {
+        // finish the refresh before anything is pushed to the display, the steps leave the counter alone so all the
+        // pushes between two refreshes still happen and a refresh drawn in n steps is n - 1 calls later
+#ifdef USE_CMS
+        if (displayIsGrabbed(osdDisplayPort)) {
+            drawingElements = false;
+            return;
+        }
+#endif
+        if (osdDrawNextActiveElements(osdDisplayPort, DRAW_ELEMENTS_PER_STEP)) {
+            drawingElements = false;
+            displayHeartbeat(osdDisplayPort);
+            showVisualBeeper = false;
+        }
+        return;
+    }
 
     if (counter % DRAW_FREQ_DENOM == 0) {
-        osdRefresh(currentTimeUs);
-        showVisualBeeper = false;
+        if (osdRefreshBegin(currentTimeUs)) {
+            drawingElements = !osdDrawNextActiveElements(osdDisplayPort, DRAW_ELEMENTS_PER_STEP);
+            if (!drawingElements) {
+                displayHeartbeat(osdDisplayPort);
+            }
+        }
+        if (!drawingElements) {
+            showVisualBeeper = false;
+        }
     } else {
         // rest of time redraw screen 10 chars per idle so it doesn't lock the main idle
         displayDrawScreen(osdDisplayPort);
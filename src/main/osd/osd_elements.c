@@ -150,6 +150,7 @@ static const char compassBar[] = {
 
 static unsigned activeOsdElementCount = 0;
 static uint8_t activeOsdElementArray[OSD_ITEM_COUNT];
+static unsigned activeOsdElementDrawIndex = 0;
 
 // Blink control
 static bool blinkState = true;
@@ -1642,7 +1643,10 @@ static bool osdDrawSingleElement(displayPort_t *osdDisplayPort, uint8_t item)
     return true;
 }
 
-void osdDrawActiveElements(displayPort_t *osdDisplayPort, timeUs_t currentTimeUs)
+/*
+ * Starts drawing the active elements, the elements are then drawn by one or more calls to osdDrawNextActiveElements
+ */
+void osdDrawActiveElementsBegin(timeUs_t currentTimeUs)
 {
 #ifdef USE_GPS
     static bool lastGpsSensorState;
@@ -1657,9 +1661,19 @@ void osdDrawActiveElements(displayPort_t *osdDisplayPort, timeUs_t currentTimeUs
 
     blinkState = (currentTimeUs / 200000) % 2;
 
-    for (unsigned i = 0; i < activeOsdElementCount; i++) {
-        osdDrawSingleElement(osdDisplayPort, activeOsdElementArray[i]);
+    activeOsdElementDrawIndex = 0;
+}
+
+/*
+ * Draws up to elementCount of the remaining active elements, returns true once all of them have been drawn
+ */
+bool osdDrawNextActiveElements(displayPort_t *osdDisplayPort, unsigned elementCount)
+{
+    for (; elementCount > 0 && activeOsdElementDrawIndex < activeOsdElementCount; elementCount--) {
+        osdDrawSingleElement(osdDisplayPort, activeOsdElementArray[activeOsdElementDrawIndex++]);
     }
+
+    return activeOsdElementDrawIndex >= activeOsdElementCount;
 }
 
 void osdResetAlarms(void)
@@ -46,6 +46,7 @@ int32_t osdGetSpeedToSelectedUnit(int32_t value);
 char osdGetSpeedToSelectedUnitSymbol(void);
 char osdGetTemperatureSymbolForSelectedUnit(void);
 void osdAnalyzeActiveElements(void);
-void osdDrawActiveElements(displayPort_t *osdDisplayPort, timeUs_t currentTimeUs);
+void osdDrawActiveElementsBegin(timeUs_t currentTimeUs);
+bool osdDrawNextActiveElements(displayPort_t *osdDisplayPort, unsigned elementCount);
 void osdResetAlarms(void);
 void osdUpdateAlarms(void);
@@ -28,11 +28,53 @@
 
 #include "pg.h"
 
+// Registry positions in PGN order, built by the first pgFind()
+static uint8_t pgSortedIndex[PG_REGISTRY_MAX];
+static bool pgSortedIndexBuilt = false;
+
+static void pgBuildSortedIndex(void)
+{
+    // Insertion sort, the registry is short and this runs once
+    for (int i = 0; i < PG_REGISTRY_SIZE; i++) {
+        const pgn_t pgn = pgN(&__pg_registry_start[i]);
+        int j = i;
+        while (j > 0 && pgN(&__pg_registry_start[pgSortedIndex[j - 1]]) > pgn) {
+            pgSortedIndex[j] = pgSortedIndex[j - 1];
+            j--;
+        }
+        pgSortedIndex[j] = i;
+    }
+
+    pgSortedIndexBuilt = true;
+}
+
 const pgRegistry_t* pgFind(pgn_t pgn)
 {
-    PG_FOREACH(reg) {
+    if (PG_REGISTRY_SIZE > PG_REGISTRY_MAX) {
+        PG_FOREACH(reg) {
+            if (pgN(reg) == pgn) {
+                return reg;
+            }
+        }
+        return NULL;
+    }
+
+    if (!pgSortedIndexBuilt) {
+        pgBuildSortedIndex();
+    }
+
+    int left = 0;
+    int right = PG_REGISTRY_SIZE;
+    while (left < right) {
+        const int mid = (left + right) / 2;
+        const pgRegistry_t *reg = &__pg_registry_start[pgSortedIndex[mid]];
+
         if (pgN(reg) == pgn) {
             return reg;
+        } else if (pgN(reg) < pgn) {
+            left = mid + 1;
+        } else {
+            right = mid;
         }
     }
     return NULL;
@@ -83,6 +83,12 @@ extern const uint8_t __pg_resetdata_end[];
 
 #define PG_REGISTRY_SIZE (__pg_registry_end - __pg_registry_start)
 
+// Largest registry pgFind() keeps a sorted index for, it falls back to a linear search beyond that
+#define PG_REGISTRY_MAX 160
+
+// Position of a group in the registry, from 0 to PG_REGISTRY_SIZE - 1
+static inline int pgRegistryIndex(const pgRegistry_t *reg) {return reg - __pg_registry_start;}
+
 // Helper to iterate over the PG register.  Cheaper than a visitor style callback.
 #define PG_FOREACH(_name) \
     for (const pgRegistry_t *(_name) = __pg_registry_start; (_name) < __pg_registry_end; _name++)
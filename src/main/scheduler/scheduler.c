@@ -33,6 +33,7 @@
 
 #include "config/config_unittest.h"
 
+#include "common/histogram.h"
 #include "common/maths.h"
 #include "common/time.h"
 #include "common/utils.h"
@@ -62,11 +63,151 @@ static FAST_RAM int periodCalculationBasisOffset = offsetof(cfTask_t, lastExecut
 
 STATIC_UNIT_TESTED FAST_RAM_ZERO_INIT cfTask_t* taskQueueArray[TASK_COUNT + 1]; // extra item for NULL pointer at end of queue
 
+// Deadline queue mode: time-driven tasks are additionally kept in a binary min-heap ordered by the time at which
+// they next become due, so that a scheduler pass only has to look at the tasks that are actually due.
+// Event-driven tasks are kept in a separate list, since their checkFunc has to be called on every pass.
+
+static FAST_RAM_ZERO_INIT bool useDeadlineQueue;
+
+STATIC_UNIT_TESTED FAST_RAM_ZERO_INIT cfTask_t* deadlineQueueArray[TASK_COUNT];
+STATIC_UNIT_TESTED FAST_RAM_ZERO_INIT int deadlineQueueSize = 0;
+
+static FAST_RAM_ZERO_INIT cfTask_t* eventQueueArray[TASK_COUNT];
+static FAST_RAM_ZERO_INIT int eventQueueSize = 0;
+
+// Deadline guard: every task learns its anticipated execution time as a slowly decaying peak of its measured
+// execution times, and a task that is not anticipated to finish before the next realtime task becomes due is
+// passed over in favour of one that is. A task that has been passed over for DEADLINE_GUARD_MAX_AGE_CYCLES of its
+// periods is run regardless, so tasks that never fit into the gap between two realtime cycles are not starved.
+
+#define TASK_EXECUTION_TIME_SHIFT           7   // anticipated execution time is held in 1/128us
+#define TASK_EXECUTION_TIME_DECAY_SHIFT     6   // decays towards the measured execution time by 1/64 per execution
+#define DEADLINE_GUARD_MAX_AGE_CYCLES       4
+
+static FAST_RAM_ZERO_INIT bool useDeadlineGuard;
+
+inline static timeUs_t getPeriodCalculationBasis(const cfTask_t* task)
+{
+    if (task->staticPriority == TASK_PRIORITY_REALTIME) {
+        return *(timeUs_t*)((uint8_t*)task + periodCalculationBasisOffset);
+    } else {
+        return task->lastExecutedAt;
+    }
+}
+
+inline static timeUs_t getNextDueAt(const cfTask_t* task)
+{
+    return getPeriodCalculationBasis(task) + task->desiredPeriod;
+}
+
+inline static bool deadlineQueueIsEarlier(const cfTask_t *task, const cfTask_t *other)
+{
+    return cmpTimeUs(getNextDueAt(task), getNextDueAt(other)) < 0;
+}
+
+static FAST_CODE void deadlineQueueSiftUp(int pos)
+{
+    cfTask_t *task = deadlineQueueArray[pos];
+    while (pos > 0) {
+        const int parentPos = (pos - 1) / 2;
+        if (!deadlineQueueIsEarlier(task, deadlineQueueArray[parentPos])) {
+            break;
+        }
+        deadlineQueueArray[pos] = deadlineQueueArray[parentPos];
+        pos = parentPos;
+    }
+    deadlineQueueArray[pos] = task;
+}
+
+static FAST_CODE void deadlineQueueSiftDown(int pos)
+{
+    cfTask_t *task = deadlineQueueArray[pos];
+    while (true) {
+        int childPos = 2 * pos + 1;
+        if (childPos >= deadlineQueueSize) {
+            break;
+        }
+        if (childPos + 1 < deadlineQueueSize && deadlineQueueIsEarlier(deadlineQueueArray[childPos + 1], deadlineQueueArray[childPos])) {
+            ++childPos;
+        }
+        if (!deadlineQueueIsEarlier(deadlineQueueArray[childPos], task)) {
+            break;
+        }
+        deadlineQueueArray[pos] = deadlineQueueArray[childPos];
+        pos = childPos;
+    }
+    deadlineQueueArray[pos] = task;
+}
+
+static int deadlineQueueFind(const cfTask_t *task)
+{
+    for (int ii = 0; ii < deadlineQueueSize; ++ii) {
+        if (deadlineQueueArray[ii] == task) {
+            return ii;
+        }
+    }
+    return -1;
+}
+
+static void deadlineQueueAdd(cfTask_t *task)
+{
+    deadlineQueueArray[deadlineQueueSize] = task;
+    deadlineQueueSiftUp(deadlineQueueSize++);
+}
+
+static void deadlineQueueRemove(cfTask_t *task)
+{
+    const int pos = deadlineQueueFind(task);
+    if (pos < 0) {
+        return;
+    }
+    deadlineQueueArray[pos] = deadlineQueueArray[--deadlineQueueSize];
+    deadlineQueueArray[deadlineQueueSize] = NULL;
+    if (pos < deadlineQueueSize) {
+        deadlineQueueSiftUp(pos);
+        deadlineQueueSiftDown(pos);
+    }
+}
+
+// Must be called whenever the due time of a task changes other than by the task being executed
+static void deadlineQueueUpdate(cfTask_t *task)
+{
+    const int pos = deadlineQueueFind(task);
+    if (pos >= 0) {
+        deadlineQueueSiftUp(pos);
+        deadlineQueueSiftDown(deadlineQueueFind(task));
+    }
+}
+
+static void deadlineQueueRebuild(void)
+{
+    for (int ii = deadlineQueueSize / 2 - 1; ii >= 0; --ii) {
+        deadlineQueueSiftDown(ii);
+    }
+}
+
+// Keeps the queue positions and the event-driven task list in step with the task queue
+static void queueUpdatePositions(void)
+{
+    eventQueueSize = 0;
+    for (int ii = 0; ii < taskQueueSize; ++ii) {
+        cfTask_t *task = taskQueueArray[ii];
+        task->queuePos = ii;
+        if (task->checkFunc) {
+            eventQueueArray[eventQueueSize++] = task;
+        }
+    }
+}
+
 void queueClear(void)
 {
     memset(taskQueueArray, 0, sizeof(taskQueueArray));
     taskQueuePos = 0;
     taskQueueSize = 0;
+
+    memset(deadlineQueueArray, 0, sizeof(deadlineQueueArray));
+    deadlineQueueSize = 0;
+    eventQueueSize = 0;
 }
 
 bool queueContains(cfTask_t *task)
@@ -89,6 +230,10 @@ bool queueAdd(cfTask_t *task)
             memmove(&taskQueueArray[ii+1], &taskQueueArray[ii], sizeof(task) * (taskQueueSize - ii));
             taskQueueArray[ii] = task;
             ++taskQueueSize;
+            queueUpdatePositions();
+            if (!task->checkFunc) {
+                deadlineQueueAdd(task);
+            }
             return true;
         }
     }
@@ -101,6 +246,10 @@ bool queueRemove(cfTask_t *task)
         if (taskQueueArray[ii] == task) {
             memmove(&taskQueueArray[ii], &taskQueueArray[ii+1], sizeof(task) * (taskQueueSize - ii));
             --taskQueueSize;
+            queueUpdatePositions();
+            if (!task->checkFunc) {
+                deadlineQueueRemove(task);
+            }
             return true;
         }
     }
@@ -155,6 +304,34 @@ void getCheckFuncInfo(cfCheckFuncInfo_t *checkFuncInfo)
 }
 #endif
 
+#if defined(USE_TASK_HISTOGRAMS)
+typedef struct taskHistograms_s {
+    logHistogram_t executionTime;
+    logHistogram_t lateness;        // time from when the task became due or was signaled until it was started
+} taskHistograms_t;
+
+static taskHistograms_t taskHistograms[TASK_COUNT];
+
+static const uint16_t taskPercentiles[TASK_PERCENTILE_COUNT] = { 5000, 9900, 9990 };
+
+void getTaskHistogramInfo(cfTaskId_e taskId, cfTaskHistogramInfo_t *taskHistogramInfo)
+{
+    const taskHistograms_t *histograms = &taskHistograms[taskId];
+
+    taskHistogramInfo->sampleCount = histograms->executionTime.count;
+    for (int i = 0; i < TASK_PERCENTILE_COUNT; i++) {
+        taskHistogramInfo->executionTime[i] = logHistogramPercentile(&histograms->executionTime, taskPercentiles[i]);
+        taskHistogramInfo->lateness[i] = logHistogramPercentile(&histograms->lateness, taskPercentiles[i]);
+    }
+}
+
+static void resetTaskHistograms(const cfTask_t *task)
+{
+    logHistogramReset(&taskHistograms[task - cfTasks].executionTime);
+    logHistogramReset(&taskHistograms[task - cfTasks].lateness);
+}
+#endif
+
 void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t * taskInfo)
 {
     taskInfo->isEnabled = queueContains(&cfTasks[taskId]);
@@ -177,9 +354,11 @@ void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros)
     if (taskId == TASK_SELF) {
         cfTask_t *task = currentTask;
         task->desiredPeriod = MAX(SCHEDULER_DELAY_LIMIT, (timeDelta_t)newPeriodMicros);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+        deadlineQueueUpdate(task);
     } else if (taskId < TASK_COUNT) {
         cfTask_t *task = &cfTasks[taskId];
         task->desiredPeriod = MAX(SCHEDULER_DELAY_LIMIT, (timeDelta_t)newPeriodMicros);  // Limit delay to 100us (10 kHz) to prevent scheduler clogging
+        deadlineQueueUpdate(task);
     }
 }
 
@@ -206,6 +385,12 @@ timeDelta_t getTaskDeltaTime(cfTaskId_e taskId)
     }
 }
 
+// True if the last call to scheduler() found no task ready to run
+bool schedulerIsIdle(void)
+{
+    return currentTask == NULL;
+}
+
 void schedulerSetCalulateTaskStatistics(bool calculateTaskStatisticsToUse)
 {
     calculateTaskStatistics = calculateTaskStatisticsToUse;
@@ -219,11 +404,17 @@ void schedulerResetTaskStatistics(cfTaskId_e taskId)
         currentTask->movingSumDeltaTime = 0;
         currentTask->totalExecutionTime = 0;
         currentTask->maxExecutionTime = 0;
+#if defined(USE_TASK_HISTOGRAMS)
+        resetTaskHistograms(currentTask);
+#endif
     } else if (taskId < TASK_COUNT) {
         cfTasks[taskId].movingSumExecutionTime = 0;
         cfTasks[taskId].movingSumDeltaTime = 0;
         cfTasks[taskId].totalExecutionTime = 0;
         cfTasks[taskId].maxExecutionTime = 0;
+#if defined(USE_TASK_HISTOGRAMS)
+        resetTaskHistograms(&cfTasks[taskId]);
+#endif
     }
 #else
     UNUSED(taskId);
@@ -253,14 +444,85 @@ void schedulerInit(void)
 void schedulerOptimizeRate(bool optimizeRate)
 {
     periodCalculationBasisOffset = optimizeRate ? offsetof(cfTask_t, lastDesiredAt) : offsetof(cfTask_t, lastExecutedAt);
+    deadlineQueueRebuild();
 }
 
-inline static timeUs_t getPeriodCalculationBasis(const cfTask_t* task)
+void schedulerUseDeadlineQueue(bool useDeadlineQueueToUse)
+{
+    useDeadlineQueue = useDeadlineQueueToUse;
+    deadlineQueueRebuild();
+}
+
+void schedulerUseDeadlineGuard(bool useDeadlineGuardToUse)
+{
+    useDeadlineGuard = useDeadlineGuardToUse;
+}
+
+inline static bool taskIsPreferred(const cfTask_t *task, const cfTask_t *selectedTask, uint16_t selectedTaskDynamicPriority)
+{
+    // Ties are resolved in queue order, as they are when the whole queue is walked
+    return task->dynamicPriority > selectedTaskDynamicPriority
+        || (selectedTask && task->dynamicPriority == selectedTaskDynamicPriority && task->queuePos < selectedTask->queuePos);
+}
+
+inline static bool taskFitsBeforeRealtimeDeadline(const cfTask_t *task, timeDelta_t timeToNextRealtimeTask)
+{
+    return (!useDeadlineGuard) ||
+        (task->taskAgeCycles >= DEADLINE_GUARD_MAX_AGE_CYCLES) ||
+        ((timeDelta_t)(task->anticipatedExecutionTime >> TASK_EXECUTION_TIME_SHIFT) <= timeToNextRealtimeTask);
+}
+
+inline static bool taskCanBeChosenForScheduling(const cfTask_t *task, bool outsideRealtimeGuardInterval, timeDelta_t timeToNextRealtimeTask)
 {
     if (task->staticPriority == TASK_PRIORITY_REALTIME) {
-        return *(timeUs_t*)((uint8_t*)task + periodCalculationBasisOffset);
+        return true;
+    }
+    return (outsideRealtimeGuardInterval || task->taskAgeCycles > 1) && taskFitsBeforeRealtimeDeadline(task, timeToNextRealtimeTask);
+}
+
+static void updateAnticipatedExecutionTime(cfTask_t *task, timeUs_t taskExecutionTime)
+{
+    const uint32_t executionTime = taskExecutionTime << TASK_EXECUTION_TIME_SHIFT;
+    if (executionTime > task->anticipatedExecutionTime) {
+        task->anticipatedExecutionTime = executionTime;
     } else {
-        return task->lastExecutedAt;
+        task->anticipatedExecutionTime -= (task->anticipatedExecutionTime - executionTime) >> TASK_EXECUTION_TIME_DECAY_SHIFT;
+    }
+}
+
+// Returns true if the task is waiting to be executed
+static FAST_CODE bool updateEventDrivenTask(cfTask_t *task, timeUs_t currentTimeUs)
+{
+#if defined(SCHEDULER_DEBUG)
+    const timeUs_t currentTimeBeforeCheckFuncCall = micros();
+#else
+    const timeUs_t currentTimeBeforeCheckFuncCall = currentTimeUs;
+#endif
+    // Increase priority for event driven tasks
+    if (task->dynamicPriority > 0) {
+        task->taskAgeCycles = 1 + ((currentTimeUs - task->lastSignaledAt) / task->desiredPeriod);
+        task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+        return true;
+    } else if (task->checkFunc(currentTimeBeforeCheckFuncCall, currentTimeBeforeCheckFuncCall - task->lastExecutedAt)) {
+#if defined(SCHEDULER_DEBUG)
+        DEBUG_SET(DEBUG_SCHEDULER, 3, micros() - currentTimeBeforeCheckFuncCall);
+#endif
+#if defined(USE_TASK_STATISTICS)
+        if (calculateTaskStatistics) {
+            const uint32_t checkFuncExecutionTime = micros() - currentTimeBeforeCheckFuncCall;
+            checkFuncMovingSumExecutionTime += checkFuncExecutionTime - checkFuncMovingSumExecutionTime / MOVING_SUM_COUNT;
+            checkFuncMovingSumDeltaTime += task->taskLatestDeltaTime - checkFuncMovingSumDeltaTime / MOVING_SUM_COUNT;
+            checkFuncTotalExecutionTime += checkFuncExecutionTime;   // time consumed by scheduler + task
+            checkFuncMaxExecutionTime = MAX(checkFuncMaxExecutionTime, checkFuncExecutionTime);
+        }
+#endif
+        task->lastSignaledAt = currentTimeBeforeCheckFuncCall;
+        task->taskAgeCycles = 1;
+        task->dynamicPriority = 1 + task->staticPriority;
+        return true;
+    } else {
+        task->taskAgeCycles = 0;
+        return false;
     }
 }
 
@@ -271,12 +533,15 @@ FAST_CODE void scheduler(void)
 
     // Check for realtime tasks
     bool outsideRealtimeGuardInterval = true;
+    timeDelta_t timeToNextRealtimeTask = INT32_MAX;
     for (const cfTask_t *task = queueFirst(); task != NULL && task->staticPriority >= TASK_PRIORITY_REALTIME; task = queueNext()) {
-        const timeUs_t nextExecuteAt = getPeriodCalculationBasis(task) + task->desiredPeriod;
-        if ((timeDelta_t)(currentTimeUs - nextExecuteAt) >= 0) {
+        const timeDelta_t timeToExecute = cmpTimeUs(getNextDueAt(task), currentTimeUs);
+        if (timeToExecute <= 0) {
             outsideRealtimeGuardInterval = false;
+            timeToNextRealtimeTask = 0;
             break;
         }
+        timeToNextRealtimeTask = MIN(timeToNextRealtimeTask, timeToExecute);
     }
 
     // The task to be invoked
@@ -285,55 +550,69 @@ FAST_CODE void scheduler(void)
 
     // Update task dynamic priorities
     uint16_t waitingTasks = 0;
-    for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
-        // Task has checkFunc - event driven
-        if (task->checkFunc) {
-#if defined(SCHEDULER_DEBUG)
-            const timeUs_t currentTimeBeforeCheckFuncCall = micros();
-#else
-            const timeUs_t currentTimeBeforeCheckFuncCall = currentTimeUs;
-#endif
-            // Increase priority for event driven tasks
-            if (task->dynamicPriority > 0) {
-                task->taskAgeCycles = 1 + ((currentTimeUs - task->lastSignaledAt) / task->desiredPeriod);
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
-            } else if (task->checkFunc(currentTimeBeforeCheckFuncCall, currentTimeBeforeCheckFuncCall - task->lastExecutedAt)) {
-#if defined(SCHEDULER_DEBUG)
-                DEBUG_SET(DEBUG_SCHEDULER, 3, micros() - currentTimeBeforeCheckFuncCall);
-#endif
-#if defined(USE_TASK_STATISTICS)
-                if (calculateTaskStatistics) {
-                    const uint32_t checkFuncExecutionTime = micros() - currentTimeBeforeCheckFuncCall;
-                    checkFuncMovingSumExecutionTime += checkFuncExecutionTime - checkFuncMovingSumExecutionTime / MOVING_SUM_COUNT;
-                    checkFuncMovingSumDeltaTime += task->taskLatestDeltaTime - checkFuncMovingSumDeltaTime / MOVING_SUM_COUNT;
-                    checkFuncTotalExecutionTime += checkFuncExecutionTime;   // time consumed by scheduler + task
-                    checkFuncMaxExecutionTime = MAX(checkFuncMaxExecutionTime, checkFuncExecutionTime);
-                }
-#endif
-                task->lastSignaledAt = currentTimeBeforeCheckFuncCall;
-                task->taskAgeCycles = 1;
-                task->dynamicPriority = 1 + task->staticPriority;
+    int selectedTaskDeadlineQueuePos = -1;
+    if (useDeadlineQueue) {
+        for (int ii = 0; ii < eventQueueSize; ++ii) {
+            cfTask_t *task = eventQueueArray[ii];
+            if (updateEventDrivenTask(task, currentTimeUs)) {
                 waitingTasks++;
-            } else {
-                task->taskAgeCycles = 0;
             }
-        } else {
-            // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
-            // Task age is calculated from last execution
+            if (taskIsPreferred(task, selectedTask, selectedTaskDynamicPriority) && taskCanBeChosenForScheduling(task, outsideRealtimeGuardInterval, timeToNextRealtimeTask)) {
+                selectedTaskDynamicPriority = task->dynamicPriority;
+                selectedTask = task;
+            }
+        }
+
+        // A task in the heap never becomes due before its parent, so the walk stops at the first task on each branch
+        // that is not due yet, and a pass in which no time-driven task is due only looks at the root
+        int pendingPos[TASK_COUNT];
+        int pendingCount = 0;
+        if (deadlineQueueSize > 0) {
+            pendingPos[pendingCount++] = 0;
+        }
+        while (pendingCount > 0) {
+            const int pos = pendingPos[--pendingCount];
+            cfTask_t *task = deadlineQueueArray[pos];
+            if (cmpTimeUs(currentTimeUs, getNextDueAt(task)) < 0) {
+                continue;
+            }
+
             task->taskAgeCycles = ((currentTimeUs - getPeriodCalculationBasis(task)) / task->desiredPeriod);
-            if (task->taskAgeCycles > 0) {
-                task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
-                waitingTasks++;
+            task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+            waitingTasks++;
+
+            if (taskIsPreferred(task, selectedTask, selectedTaskDynamicPriority) && taskCanBeChosenForScheduling(task, outsideRealtimeGuardInterval, timeToNextRealtimeTask)) {
+                selectedTaskDynamicPriority = task->dynamicPriority;
+                selectedTask = task;
+                selectedTaskDeadlineQueuePos = pos;
+            }
+
+            const int childPos = 2 * pos + 1;
+            if (childPos < deadlineQueueSize) {
+                pendingPos[pendingCount++] = childPos;
+            }
+            if (childPos + 1 < deadlineQueueSize) {
+                pendingPos[pendingCount++] = childPos + 1;
             }
         }
+    } else {
+        for (cfTask_t *task = queueFirst(); task != NULL; task = queueNext()) {
+            if (task->checkFunc) {
+                // Task has checkFunc - event driven
+                if (updateEventDrivenTask(task, currentTimeUs)) {
+                    waitingTasks++;
+                }
+            } else {
+                // Task is time-driven, dynamicPriority is last execution age (measured in desiredPeriods)
+                // Task age is calculated from last execution
+                task->taskAgeCycles = ((currentTimeUs - getPeriodCalculationBasis(task)) / task->desiredPeriod);
+                if (task->taskAgeCycles > 0) {
+                    task->dynamicPriority = 1 + task->staticPriority * task->taskAgeCycles;
+                    waitingTasks++;
+                }
+            }
 
-        if (task->dynamicPriority > selectedTaskDynamicPriority) {
-            const bool taskCanBeChosenForScheduling =
-                (outsideRealtimeGuardInterval) ||
-                (task->taskAgeCycles > 1) ||
-                (task->staticPriority == TASK_PRIORITY_REALTIME);
-            if (taskCanBeChosenForScheduling) {
+            if (task->dynamicPriority > selectedTaskDynamicPriority && taskCanBeChosenForScheduling(task, outsideRealtimeGuardInterval, timeToNextRealtimeTask)) {
                 selectedTaskDynamicPriority = task->dynamicPriority;
                 selectedTask = task;
             }
@@ -350,10 +629,18 @@ FAST_CODE void scheduler(void)
         selectedTask->taskLatestDeltaTime = currentTimeUs - selectedTask->lastExecutedAt;
 #if defined(USE_TASK_STATISTICS)
         float period = currentTimeUs - selectedTask->lastExecutedAt;
+#endif
+#if defined(USE_TASK_HISTOGRAMS)
+        const timeDelta_t taskLateness = cmpTimeUs(currentTimeUs, selectedTask->checkFunc ? selectedTask->lastSignaledAt : getNextDueAt(selectedTask));
 #endif
         selectedTask->lastExecutedAt = currentTimeUs;
         selectedTask->lastDesiredAt += (cmpTimeUs(currentTimeUs, selectedTask->lastDesiredAt) / selectedTask->desiredPeriod) * selectedTask->desiredPeriod;
         selectedTask->dynamicPriority = 0;
+        if (selectedTaskDeadlineQueuePos >= 0) {
+            // The task is no longer due, so it moves down the heap before anything else can look at it
+            selectedTask->taskAgeCycles = 0;
+            deadlineQueueSiftDown(selectedTaskDeadlineQueuePos);
+        }
 
         // Execute task
 #if defined(USE_TASK_STATISTICS)
@@ -366,9 +653,19 @@ FAST_CODE void scheduler(void)
             selectedTask->totalExecutionTime += taskExecutionTime;   // time consumed by scheduler + task
             selectedTask->maxExecutionTime = MAX(selectedTask->maxExecutionTime, taskExecutionTime);
             selectedTask->movingAverageCycleTime += 0.05f * (period - selectedTask->movingAverageCycleTime);
+#if defined(USE_TASK_HISTOGRAMS)
+            taskHistograms_t *histograms = &taskHistograms[selectedTask - cfTasks];
+            logHistogramAdd(&histograms->executionTime, taskExecutionTime);
+            logHistogramAdd(&histograms->lateness, MAX(taskLateness, 0));
+#endif
+            updateAnticipatedExecutionTime(selectedTask, taskExecutionTime);
         } else
 #endif
-        {
+        if (useDeadlineGuard) {
+            const timeUs_t currentTimeBeforeTaskCall = micros();
+            selectedTask->taskFunc(currentTimeBeforeTaskCall);
+            updateAnticipatedExecutionTime(selectedTask, micros() - currentTimeBeforeTaskCall);
+        } else {
             selectedTask->taskFunc(currentTimeUs);
         }
 
@@ -59,6 +59,19 @@ typedef struct {
     float        movingAverageCycleTime;
 } cfTaskInfo_t;
 
+typedef enum {
+    TASK_PERCENTILE_50 = 0,
+    TASK_PERCENTILE_99,
+    TASK_PERCENTILE_99_9,
+    TASK_PERCENTILE_COUNT
+} cfTaskPercentile_e;
+
+typedef struct {
+    uint32_t     sampleCount;
+    timeUs_t     executionTime[TASK_PERCENTILE_COUNT];
+    timeUs_t     lateness[TASK_PERCENTILE_COUNT];
+} cfTaskHistogramInfo_t;
+
 typedef enum {
     /* Actual tasks */
     TASK_SYSTEM = 0,
@@ -158,10 +171,12 @@ typedef struct {
     // Scheduling
     uint16_t dynamicPriority;       // measurement of how old task was last executed, used to avoid task starvation
     uint16_t taskAgeCycles;
+    uint8_t queuePos;               // position in the priority ordered task queue, breaks ties when the deadline queue is used
     timeDelta_t taskLatestDeltaTime;
     timeUs_t lastExecutedAt;        // last time of invocation
     timeUs_t lastSignaledAt;        // time of invocation event for event-driven tasks
     timeUs_t lastDesiredAt;         // time of last desired execution
+    uint32_t anticipatedExecutionTime;  // decaying peak of the execution time in 1/128us, used by the deadline guard
 
 #if defined(USE_TASK_STATISTICS)
     // Statistics
@@ -178,6 +193,7 @@ extern uint16_t averageSystemLoadPercent;
 
 void getCheckFuncInfo(cfCheckFuncInfo_t *checkFuncInfo);
 void getTaskInfo(cfTaskId_e taskId, cfTaskInfo_t *taskInfo);
+void getTaskHistogramInfo(cfTaskId_e taskId, cfTaskHistogramInfo_t *taskHistogramInfo);
 void rescheduleTask(cfTaskId_e taskId, uint32_t newPeriodMicros);
 void setTaskEnabled(cfTaskId_e taskId, bool newEnabledState);
 timeDelta_t getTaskDeltaTime(cfTaskId_e taskId);
@@ -187,8 +203,11 @@ void schedulerResetTaskMaxExecutionTime(cfTaskId_e taskId);
 
 void schedulerInit(void);
 void scheduler(void);
+bool schedulerIsIdle(void);
 void taskSystemLoad(timeUs_t currentTime);
 void schedulerOptimizeRate(bool optimizeRate);
+void schedulerUseDeadlineQueue(bool useDeadlineQueue);
+void schedulerUseDeadlineGuard(bool useDeadlineGuard);
 
 #define LOAD_PERCENTAGE_ONE 100
 
@@ -155,7 +155,7 @@ static void gyroInitLowpassFilterLpf(int slot, int type, uint16_t lpfHz);
 #define GYRO_OVERFLOW_TRIGGER_THRESHOLD 31980  // 97.5% full scale (1950dps for 2000dps gyro)
 #define GYRO_OVERFLOW_RESET_THRESHOLD 30340    // 92.5% full scale (1850dps for 2000dps gyro)
 
-PG_REGISTER_WITH_RESET_FN(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 7);
+PG_REGISTER_WITH_RESET_FN(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 8);
 
 #ifndef GYRO_CONFIG_USE_GYRO_DEFAULT
 #define GYRO_CONFIG_USE_GYRO_DEFAULT GYRO_CONFIG_USE_GYRO_1
@@ -195,6 +195,8 @@ void pgResetFn_gyroConfig(gyroConfig_t *gyroConfig)
     gyroConfig->dyn_notch_width_percent = 8;
     gyroConfig->dyn_notch_q = 120;
     gyroConfig->dyn_notch_min_hz = 150;
+    gyroConfig->dyn_notch_engine = DYN_NOTCH_ENGINE_FFT;
+    gyroConfig->dyn_notch_peak_track = false;
     gyroConfig->gyro_filter_debug_axis = FD_ROLL;
 }
 
@@ -592,20 +594,84 @@ static void dynLpfFilterInit()
 }
 #endif
 
+/*
+ * Static filter pipeline
+ *
+ * The static notch and lowpass stages are applied to all three axes together, one stage at a time. A pipeline is
+ * compiled for every combination of lowpass stage types and gyroInitFilters() selects the one matching the
+ * configuration, so a disabled stage costs nothing. The static notches are always biquads and are applied from a
+ * list holding only the enabled ones.
+ */
+
+static FAST_CODE void gyroApplyLowpassStagePT1(gyroLowpassFilter_t *filter, float *gyroADCf)
+{
+    pt1FilterApply3(&filter->pt1FilterState, gyroADCf);
+}
+
+static FAST_CODE void gyroApplyLowpassStageBIQUAD(gyroLowpassFilter_t *filter, float *gyroADCf)
+{
+#ifdef USE_DYN_LPF
+    // the dynamic lowpass changes the coefficients while running, which needs direct form 1
+    biquadFilterApply3DF1(&filter->biquadFilterState, gyroADCf);
+#else
+    biquadFilterApply3(&filter->biquadFilterState, gyroADCf);
+#endif
+}
+
+#define gyroApplyLowpassStageNONE(filter, gyroADCf) { UNUSED(filter); UNUSED(gyroADCf); }
+
+#define GYRO_FILTER_PIPELINE(lowpassStage, lowpass2Stage) \
+static FAST_CODE void gyroFilterPipeline_ ## lowpassStage ## _ ## lowpass2Stage(float *gyroADCf) \
+{ \
+    for (int i = 0; i < gyro.staticNotchCount; i++) { \
+        biquadFilterApply3(gyro.staticNotchFilter[i], gyroADCf); \
+    } \
+    gyroApplyLowpassStage ## lowpassStage(&gyro.lowpassFilter, gyroADCf); \
+    gyroApplyLowpassStage ## lowpass2Stage(&gyro.lowpass2Filter, gyroADCf); \
+}
+
+GYRO_FILTER_PIPELINE(NONE, NONE)
+GYRO_FILTER_PIPELINE(NONE, PT1)
+GYRO_FILTER_PIPELINE(NONE, BIQUAD)
+GYRO_FILTER_PIPELINE(PT1, NONE)
+GYRO_FILTER_PIPELINE(PT1, PT1)
+GYRO_FILTER_PIPELINE(PT1, BIQUAD)
+GYRO_FILTER_PIPELINE(BIQUAD, NONE)
+GYRO_FILTER_PIPELINE(BIQUAD, PT1)
+GYRO_FILTER_PIPELINE(BIQUAD, BIQUAD)
+
+static const gyroFilterPipelineFnPtr gyroFilterPipelines[GYRO_LOWPASS_STAGE_COUNT][GYRO_LOWPASS_STAGE_COUNT] = {
+    [GYRO_LOWPASS_STAGE_NONE] = {
+        [GYRO_LOWPASS_STAGE_NONE] = gyroFilterPipeline_NONE_NONE,
+        [GYRO_LOWPASS_STAGE_PT1] = gyroFilterPipeline_NONE_PT1,
+        [GYRO_LOWPASS_STAGE_BIQUAD] = gyroFilterPipeline_NONE_BIQUAD,
+    },
+    [GYRO_LOWPASS_STAGE_PT1] = {
+        [GYRO_LOWPASS_STAGE_NONE] = gyroFilterPipeline_PT1_NONE,
+        [GYRO_LOWPASS_STAGE_PT1] = gyroFilterPipeline_PT1_PT1,
+        [GYRO_LOWPASS_STAGE_BIQUAD] = gyroFilterPipeline_PT1_BIQUAD,
+    },
+    [GYRO_LOWPASS_STAGE_BIQUAD] = {
+        [GYRO_LOWPASS_STAGE_NONE] = gyroFilterPipeline_BIQUAD_NONE,
+        [GYRO_LOWPASS_STAGE_PT1] = gyroFilterPipeline_BIQUAD_PT1,
+        [GYRO_LOWPASS_STAGE_BIQUAD] = gyroFilterPipeline_BIQUAD_BIQUAD,
+    },
+};
+
 void gyroInitLowpassFilterLpf(int slot, int type, uint16_t lpfHz)
 {
-    filterApplyFnPtr *lowpassFilterApplyFn;
+    uint8_t *lowpassStage;
     gyroLowpassFilter_t *lowpassFilter = NULL;
 
     switch (slot) {
     case FILTER_LOWPASS:
-        lowpassFilterApplyFn = &gyro.lowpassFilterApplyFn;
-        lowpassFilter = gyro.lowpassFilter;
+        lowpassStage = &gyro.lowpassStage;
+        lowpassFilter = &gyro.lowpassFilter;
         break;
 
     case FILTER_LOWPASS2:
-        lowpassFilterApplyFn = &gyro.lowpass2FilterApplyFn;
-        lowpassFilter = gyro.lowpass2Filter;
+        lowpassStage = &gyro.lowpass2Stage;
+        lowpassFilter = &gyro.lowpass2Filter;
         break;
 
     default:
@@ -619,28 +685,20 @@ void gyroInitLowpassFilterLpf(int slot, int type, uint16_t lpfHz)
     // Gain could be calculated a little later as it is specific to the pt1/bqrcf2/fkf branches
     const float gain = pt1FilterGain(lpfHz, gyroDt);
 
-    // Dereference the pointer to null before checking valid cutoff and filter
+    // Disable the stage before checking valid cutoff and filter
     // type. It will be overridden for positive cases.
-    *lowpassFilterApplyFn = nullFilterApply;
+    *lowpassStage = GYRO_LOWPASS_STAGE_NONE;
 
     // If lowpass cutoff has been specified and is less than the Nyquist frequency
     if (lpfHz && lpfHz <= gyroFrequencyNyquist) {
         switch (type) {
         case FILTER_PT1:
-            *lowpassFilterApplyFn = (filterApplyFnPtr) pt1FilterApply;
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                pt1FilterInit(&lowpassFilter[axis].pt1FilterState, gain);
-            }
+            *lowpassStage = GYRO_LOWPASS_STAGE_PT1;
+            pt1Filter3Init(&lowpassFilter->pt1FilterState, gain);
             break;
         case FILTER_BIQUAD:
-#ifdef USE_DYN_LPF
-            *lowpassFilterApplyFn = (filterApplyFnPtr) biquadFilterApplyDF1;
-#else
-            *lowpassFilterApplyFn = (filterApplyFnPtr) biquadFilterApply;
-#endif
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                biquadFilterInitLPF(&lowpassFilter[axis].biquadFilterState, lpfHz, gyro.targetLooptime);
-            }
+            *lowpassStage = GYRO_LOWPASS_STAGE_BIQUAD;
+            biquadFilter3InitLPF(&lowpassFilter->biquadFilterState, lpfHz, gyro.targetLooptime);
             break;
         }
     }
@@ -671,31 +729,23 @@ void gyroInitSlewLimiter(gyroSensor_t *gyroSensor) {
 
 static void gyroInitFilterNotch1(uint16_t notchHz, uint16_t notchCutoffHz)
 {
-    gyro.notchFilter1ApplyFn = nullFilterApply;
-
     notchHz = calculateNyquistAdjustedNotchHz(notchHz, notchCutoffHz);
 
     if (notchHz != 0 && notchCutoffHz != 0) {
-        gyro.notchFilter1ApplyFn = (filterApplyFnPtr)biquadFilterApply;
+        gyro.staticNotchFilter[gyro.staticNotchCount++] = &gyro.notchFilter1;
         const float notchQ = filterGetNotchQ(notchHz, notchCutoffHz);
-        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-            biquadFilterInit(&gyro.notchFilter1[axis], notchHz, gyro.targetLooptime, notchQ, FILTER_NOTCH);
-        }
+        biquadFilter3Init(&gyro.notchFilter1, notchHz, gyro.targetLooptime, notchQ, FILTER_NOTCH);
     }
 }
 
 static void gyroInitFilterNotch2(uint16_t notchHz, uint16_t notchCutoffHz)
 {
-    gyro.notchFilter2ApplyFn = nullFilterApply;
-
     notchHz = calculateNyquistAdjustedNotchHz(notchHz, notchCutoffHz);
 
     if (notchHz != 0 && notchCutoffHz != 0) {
-        gyro.notchFilter2ApplyFn = (filterApplyFnPtr)biquadFilterApply;
+        gyro.staticNotchFilter[gyro.staticNotchCount++] = &gyro.notchFilter2;
         const float notchQ = filterGetNotchQ(notchHz, notchCutoffHz);
-        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-            biquadFilterInit(&gyro.notchFilter2[axis], notchHz, gyro.targetLooptime, notchQ, FILTER_NOTCH);
-        }
+        biquadFilter3Init(&gyro.notchFilter2, notchHz, gyro.targetLooptime, notchQ, FILTER_NOTCH);
     }
 }
 
@@ -707,19 +757,14 @@ static bool isDynamicFilterActive(void)
 
 static void gyroInitFilterDynamicNotch()
 {
-    gyro.notchFilterDynApplyFn = nullFilterApply;
-    gyro.notchFilterDynApplyFn2 = nullFilterApply;
+    gyro.notchFilterDyn2Active = false;
 
     if (isDynamicFilterActive()) {
-        gyro.notchFilterDynApplyFn = (filterApplyFnPtr)biquadFilterApplyDF1; // must be this function, not DF2
-        if(gyroConfig()->dyn_notch_width_percent != 0) {
-            gyro.notchFilterDynApplyFn2 = (filterApplyFnPtr)biquadFilterApplyDF1; // must be this function, not DF2
-        }
+        // the dynamic notches are applied with biquadFilterApply3DF1, as their coefficients change while running
+        gyro.notchFilterDyn2Active = gyroConfig()->dyn_notch_width_percent != 0;
         const float notchQ = filterGetNotchQ(DYNAMIC_NOTCH_DEFAULT_CENTER_HZ, DYNAMIC_NOTCH_DEFAULT_CUTOFF_HZ); // any defaults OK here
-        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-            biquadFilterInit(&gyro.notchFilterDyn[axis], DYNAMIC_NOTCH_DEFAULT_CENTER_HZ, gyro.targetLooptime, notchQ, FILTER_NOTCH);
-            biquadFilterInit(&gyro.notchFilterDyn2[axis], DYNAMIC_NOTCH_DEFAULT_CENTER_HZ, gyro.targetLooptime, notchQ, FILTER_NOTCH);
-        }
+        biquadFilter3Init(&gyro.notchFilterDyn, DYNAMIC_NOTCH_DEFAULT_CENTER_HZ, gyro.targetLooptime, notchQ, FILTER_NOTCH);
+        biquadFilter3Init(&gyro.notchFilterDyn2, DYNAMIC_NOTCH_DEFAULT_CENTER_HZ, gyro.targetLooptime, notchQ, FILTER_NOTCH);
     }
 }
 #endif
@@ -755,8 +800,11 @@ void gyroInitFilters(void)
       gyroConfig()->gyro_lowpass2_hz
     );
 
+    gyro.staticNotchCount = 0;
     gyroInitFilterNotch1(gyroConfig()->gyro_soft_notch_hz_1, gyroConfig()->gyro_soft_notch_cutoff_1);
     gyroInitFilterNotch2(gyroConfig()->gyro_soft_notch_hz_2, gyroConfig()->gyro_soft_notch_cutoff_2);
+
+    gyro.filterPipelineApplyFn = gyroFilterPipelines[gyro.lowpassStage][gyro.lowpass2Stage];
 #ifdef USE_GYRO_DATA_ANALYSE
     gyroInitFilterDynamicNotch();
 #endif
@@ -1086,7 +1134,7 @@ FAST_CODE void gyroUpdate(timeUs_t currentTimeUs)
 
 #ifdef USE_GYRO_DATA_ANALYSE
     if (isDynamicFilterActive()) {
-        gyroDataAnalyse(&gyro.gyroAnalyseState, gyro.notchFilterDyn, gyro.notchFilterDyn2);
+        gyroDataAnalyse(&gyro.gyroAnalyseState, &gyro.notchFilterDyn, &gyro.notchFilterDyn2);
     }
 #endif
 
@@ -1248,14 +1296,10 @@ void dynLpfGyroUpdate(float throttle)
         if (dynLpfFilter == DYN_LPF_PT1) {
             DEBUG_SET(DEBUG_DYN_LPF, 2, cutoffFreq);
             const float gyroDt = gyro.targetLooptime * 1e-6f;
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                pt1FilterUpdateCutoff(&gyro.lowpassFilter[axis].pt1FilterState, pt1FilterGain(cutoffFreq, gyroDt));
-            }
+            pt1Filter3UpdateCutoff(&gyro.lowpassFilter.pt1FilterState, pt1FilterGain(cutoffFreq, gyroDt));
         } else if (dynLpfFilter == DYN_LPF_BIQUAD) {
             DEBUG_SET(DEBUG_DYN_LPF, 2, cutoffFreq);
-            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
-                biquadFilterUpdateLPF(&gyro.lowpassFilter[axis].biquadFilterState, cutoffFreq, gyro.targetLooptime);
-            }
+            biquadFilter3UpdateLPF(&gyro.lowpassFilter.biquadFilterState, cutoffFreq, gyro.targetLooptime);
         }
     }
 }
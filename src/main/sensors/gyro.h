@@ -37,10 +37,21 @@
 #define FILTER_FREQUENCY_MAX 4000 // maximum frequency for filter cutoffs (nyquist limit of 8K max sampling)
 
 typedef union gyroLowpassFilter_u {
-    pt1Filter_t pt1FilterState;
-    biquadFilter_t biquadFilterState;
+    pt1Filter3_t pt1FilterState;
+    biquadFilter3_t biquadFilterState;
 } gyroLowpassFilter_t;
 
+typedef enum {
+    GYRO_LOWPASS_STAGE_NONE = 0,
+    GYRO_LOWPASS_STAGE_PT1,
+    GYRO_LOWPASS_STAGE_BIQUAD,
+    GYRO_LOWPASS_STAGE_COUNT
+} gyroLowpassStage_e;
+
+#define GYRO_STATIC_NOTCH_COUNT 2
+
+typedef void (*gyroFilterPipelineFnPtr)(float *gyroADCf);
+
 typedef struct gyro_s {
     uint32_t targetLooptime;
     float scale;
@@ -49,25 +60,26 @@ typedef struct gyro_s {
 
     gyroDev_t *rawSensorDev;           // pointer to the sensor providing the raw data for DEBUG_GYRO_RAW
 
+    // static notch and lowpass filters, applied to all axes by the pipeline selected for the enabled stages
+    gyroFilterPipelineFnPtr filterPipelineApplyFn;
+    uint8_t staticNotchCount;
+    biquadFilter3_t *staticNotchFilter[GYRO_STATIC_NOTCH_COUNT];
+
     // lowpass gyro soft filter
-    filterApplyFnPtr lowpassFilterApplyFn;
-    gyroLowpassFilter_t lowpassFilter[XYZ_AXIS_COUNT];
+    uint8_t lowpassStage;
+    gyroLowpassFilter_t lowpassFilter;
 
     // lowpass2 gyro soft filter
-    filterApplyFnPtr lowpass2FilterApplyFn;
-    gyroLowpassFilter_t lowpass2Filter[XYZ_AXIS_COUNT];
+    uint8_t lowpass2Stage;
+    gyroLowpassFilter_t lowpass2Filter;
 
     // notch filters
-    filterApplyFnPtr notchFilter1ApplyFn;
-    biquadFilter_t notchFilter1[XYZ_AXIS_COUNT];
-
-    filterApplyFnPtr notchFilter2ApplyFn;
-    biquadFilter_t notchFilter2[XYZ_AXIS_COUNT];
+    biquadFilter3_t notchFilter1;
+    biquadFilter3_t notchFilter2;
 
-    filterApplyFnPtr notchFilterDynApplyFn;
-    filterApplyFnPtr notchFilterDynApplyFn2;
-    biquadFilter_t notchFilterDyn[XYZ_AXIS_COUNT];
-    biquadFilter_t notchFilterDyn2[XYZ_AXIS_COUNT];
+    bool notchFilterDyn2Active;
+    biquadFilter3_t notchFilterDyn;
+    biquadFilter3_t notchFilterDyn2;
 
 #ifdef USE_GYRO_DATA_ANALYSE
     gyroAnalyseState_t gyroAnalyseState;
@@ -93,6 +105,11 @@ enum {
 #define DYN_NOTCH_RANGE_HZ_MEDIUM 1333
 #define DYN_NOTCH_RANGE_HZ_LOW 1000
 
+typedef enum {
+    DYN_NOTCH_ENGINE_FFT = 0,
+    DYN_NOTCH_ENGINE_SDFT
+} dynNotchEngine_e;
+
 enum {
     DYN_LPF_NONE = 0,
     DYN_LPF_PT1,
@@ -152,6 +169,8 @@ typedef struct gyroConfig_s {
     uint16_t dyn_notch_q;
     uint16_t dyn_notch_min_hz;
     uint8_t  gyro_filter_debug_axis;
+    uint8_t  dyn_notch_engine;           // FFT or sliding DFT spectrum, see dynNotchEngine_e
+    uint8_t  dyn_notch_peak_track;       // place the dynamic notches on the two tallest interpolated peaks
 } gyroConfig_t;
 
 PG_DECLARE(gyroConfig_t, gyroConfig);
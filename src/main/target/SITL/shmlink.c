@@ -0,0 +1,162 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "shmlink.h"
+
+#define SHM_CACHE_LINE      64
+#define SHM_SPIN_COUNT      2000    // polls before the receiver starts to sleep
+#define SHM_SLEEP_NS        20000
+
+typedef struct shmSlot_s {
+    uint32_t size;
+    uint8_t data[SHM_LINK_SLOT_SIZE];
+} shmSlot_t;
+
+// head is only written by the producer and tail only by the consumer, each on its own
+// cache line so the two processes don't fight over it
+struct shmRing_s {
+    _Alignas(SHM_CACHE_LINE) atomic_uint head;
+    _Alignas(SHM_CACHE_LINE) atomic_uint tail;
+    _Alignas(SHM_CACHE_LINE) shmSlot_t slots[SHM_LINK_SLOT_COUNT];
+};
+
+_Static_assert((SHM_LINK_SLOT_COUNT & (SHM_LINK_SLOT_COUNT - 1)) == 0, "SHM_LINK_SLOT_COUNT must be a power of two");
+
+int shmInit(shmLink_t *link, const char *name, bool isServer)
+{
+    memset(link, 0, sizeof(*link));
+    if (strlen(name) >= sizeof(link->name)) {
+        return -1;
+    }
+    strcpy(link->name, name);
+    link->isServer = isServer;
+
+    int fd;
+    if (isServer) {
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            return -2;
+        }
+        if (ftruncate(fd, sizeof(shmRing_t)) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return -3;
+        }
+    } else {
+        fd = shm_open(name, O_RDWR, 0);
+        if (fd < 0) {
+            return -2;
+        }
+    }
+
+    void *ring = mmap(NULL, sizeof(shmRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return -4;
+    }
+    link->ring = ring;
+
+    // a new object reads as zeros, which is an empty ring
+    return 0;
+}
+
+void shmClose(shmLink_t *link)
+{
+    if (link->ring) {
+        munmap(link->ring, sizeof(shmRing_t));
+        link->ring = NULL;
+    }
+    if (link->isServer) {
+        shm_unlink(link->name);
+    }
+}
+
+int shmSend(shmLink_t *link, const void *data, size_t size)
+{
+    shmRing_t *ring = link->ring;
+    if (size > SHM_LINK_SLOT_SIZE) {
+        return -1;
+    }
+
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == SHM_LINK_SLOT_COUNT) {
+        // full, dropped like a datagram nobody reads
+        return -1;
+    }
+
+    shmSlot_t *slot = &ring->slots[head & (SHM_LINK_SLOT_COUNT - 1)];
+    slot->size = size;
+    memcpy(slot->data, data, size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return size;
+}
+
+static uint64_t nanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int shmRecv(shmLink_t *link, void *data, size_t size, uint32_t timeout_ms)
+{
+    shmRing_t *ring = link->ring;
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    // the other side answers within microseconds while it is running, spin before sleeping
+    uint64_t deadline = 0;
+    for (int poll = 0; atomic_load_explicit(&ring->head, memory_order_acquire) == tail; poll++) {
+        if (timeout_ms == 0) {
+            return -1;
+        }
+        if (poll < SHM_SPIN_COUNT) {
+            sched_yield();
+            continue;
+        }
+        const uint64_t now = nanos();
+        if (deadline == 0) {
+            deadline = now + (uint64_t)timeout_ms * 1000000;
+        }
+        if (now >= deadline) {
+            return -1;
+        }
+        const struct timespec sleep = { 0, SHM_SLEEP_NS };
+        nanosleep(&sleep, NULL);
+    }
+
+    const shmSlot_t *slot = &ring->slots[tail & (SHM_LINK_SLOT_COUNT - 1)];
+    const size_t packetSize = slot->size;
+    memcpy(data, slot->data, packetSize < size ? packetSize : size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return packetSize < size ? packetSize : size;
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Packet link over POSIX shared memory, a drop in for udplink between two processes on the
+// same machine. Every link is one single producer single consumer ring of fixed size slots,
+// packets are copied once into the ring and once out of it, no system call on the way.
+
+#define SHM_LINK_SLOT_COUNT 16          // power of two
+#define SHM_LINK_SLOT_SIZE  256         // largest packet
+#define SHM_LINK_NAME_SIZE  64
+
+typedef struct shmRing_s shmRing_t;
+
+typedef struct shmLink_s {
+    shmRing_t *ring;
+    char name[SHM_LINK_NAME_SIZE];
+    bool isServer;
+} shmLink_t;
+
+// The server creates the ring, replacing a stale one of the same name, the client maps the
+// ring of a running server. Names follow shm_open(), "/name".
+int shmInit(shmLink_t *link, const char *name, bool isServer);
+void shmClose(shmLink_t *link);
+// returns size, or -1 when the ring is full
+int shmSend(shmLink_t *link, const void *data, size_t size);
+// returns the size of the packet, or -1 when none arrived within timeout_ms
+int shmRecv(shmLink_t *link, void *data, size_t size, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
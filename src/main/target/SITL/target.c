@@ -25,6 +25,7 @@
 #include <string.h>
 
 #include <errno.h>
+#include <stdatomic.h>
 #include <time.h>
 
 #include "common/maths.h"
@@ -47,14 +48,19 @@ const timerHardware_t timerHardware[1]; // unused
 
 #include "config/feature.h"
 #include "fc/config.h"
+#include "fc/init.h"
+#include "flight/pid.h"
 #include "scheduler/scheduler.h"
+#include "sensors/gyro.h"
 
 #include "pg/rx.h"
 #include "pg/motor.h"
 
 #include "rx/rx.h"
+#include "rx/msp.h"
 
 #include "dyad.h"
+#include "target/SITL/shmlink.h"
 #include "target/SITL/udplink.h"
 
 uint32_t SystemCoreClock;
@@ -64,44 +70,72 @@ static servo_packet pwmPkt;
 
 static struct timespec start_time;
 static double simRate = 1.0;
-static pthread_t tcpWorker, udpWorker;
+static pthread_t tcpWorker;
+#if !defined(SIMULATOR_LOCKSTEP)
+static pthread_t udpWorker;
+#endif
 static bool workerRunning = true;
-static udpLink_t stateLink, pwmLink;
-static pthread_mutex_t updateLock;
-static pthread_mutex_t mainLoopLock;
+
+// the simulator talks UDP, or shared memory when SITL_SHM names the rings at startup
+typedef struct simLink_s {
+    udpLink_t udp;
+    shmLink_t shm;
+} simLink_t;
+
+static bool shmTransport;
+static simLink_t stateLink, pwmLink;
+#if defined(SIMULATOR_LOCKSTEP)
+static simLink_t rcLink;
+static rc_packet rcPkt;
+#endif
+static atomic_bool motorUpdateAllowed = true;   // one servo_packet per fdm_packet
+static atomic_bool mainLoopAllowed = true;
+#if defined(SIMULATOR_LOCKSTEP)
+static uint64_t simTimeUs;          // virtual clock, only moved by fdm_packet timestamps, PID loops and delays
+static int64_t simTimeOffsetUs;     // simulator time to firmware time, changes when the simulator restarts
+static double lockstepLastTimestamp = -1;
+#endif
 
 int timeval_sub(struct timespec *result, struct timespec *x, struct timespec *y);
 
 int lockMainPID(void) {
-    return pthread_mutex_trylock(&mainLoopLock);
+    return atomic_exchange(&mainLoopAllowed, false) ? 0 : -1;
+}
+
+static int simLinkInit(simLink_t *link, const char *shmPrefix, const char *shmName, const char *addr, int port, bool isServer)
+{
+    if (shmTransport) {
+        char name[SHM_LINK_NAME_SIZE];
+        snprintf(name, sizeof(name), "%s_%s", shmPrefix, shmName);
+        const int ret = shmInit(&link->shm, name, isServer);
+        if (ret < 0) {
+            // a simulator asked for shared memory doesn't listen on UDP, so there is nothing to fall back to
+            printf("Shared memory link %s error %d!\n", name, ret);
+            exit(1);
+        }
+        return ret;
+    }
+    return udpInit(&link->udp, addr, port, isServer);
+}
+
+static int simLinkSend(simLink_t *link, const void *data, size_t size)
+{
+    return shmTransport ? shmSend(&link->shm, data, size) : udpSend(&link->udp, data, size);
+}
+
+static int simLinkRecv(simLink_t *link, void *data, size_t size, uint32_t timeout_ms)
+{
+    return shmTransport ? shmRecv(&link->shm, data, size, timeout_ms) : udpRecv(&link->udp, data, size, timeout_ms);
 }
 
 #define RAD2DEG (180.0 / M_PI)
 #define ACC_SCALE (256 / 9.80665)
 #define GYRO_SCALE (16.4)
 void sendMotorUpdate() {
-    udpSend(&pwmLink, &pwmPkt, sizeof(servo_packet));
+    simLinkSend(&pwmLink, &pwmPkt, sizeof(servo_packet));
 }
-void updateState(const fdm_packet* pkt) {
-    static double last_timestamp = 0; // in seconds
-    static uint64_t last_realtime = 0; // in uS
-    static struct timespec last_ts; // last packet
-
-    struct timespec now_ts;
-    clock_gettime(CLOCK_MONOTONIC, &now_ts);
-
-    const uint64_t realtime_now = micros64_real();
-    if (realtime_now > last_realtime + 500*1e3) { // 500ms timeout
-        last_timestamp = pkt->timestamp;
-        last_realtime = realtime_now;
-        sendMotorUpdate();
-        return;
-    }
-
-    const double deltaSim = pkt->timestamp - last_timestamp;  // in seconds
-    if (deltaSim < 0) { // don't use old packet
-        return;
-    }
+static void updateSensors(const fdm_packet* pkt, double deltaSim) {
+    UNUSED(deltaSim);
 
     int16_t x,y,z;
     x = constrain(-pkt->imu_linear_acceleration_xyz[0] * ACC_SCALE, -32767, 32767);
@@ -151,7 +185,30 @@ void updateState(const fdm_packet* pkt) {
     imuSetHasNewData(deltaSim*1e6);
     imuUpdateAttitude(micros());
 #endif
+}
 
+void updateState(const fdm_packet* pkt) {
+    static double last_timestamp = 0; // in seconds
+    static uint64_t last_realtime = 0; // in uS
+    static struct timespec last_ts; // last packet
+
+    struct timespec now_ts;
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+
+    const uint64_t realtime_now = micros64_real();
+    if (realtime_now > last_realtime + 500*1e3) { // 500ms timeout
+        last_timestamp = pkt->timestamp;
+        last_realtime = realtime_now;
+        sendMotorUpdate();
+        return;
+    }
+
+    const double deltaSim = pkt->timestamp - last_timestamp;  // in seconds
+    if (deltaSim < 0) { // don't use old packet
+        return;
+    }
+
+    updateSensors(pkt, deltaSim);
 
     if (deltaSim < 0.02 && deltaSim > 0) { // simulator should run faster than 50Hz
 //        simRate = simRate * 0.5 + (1e6 * deltaSim / (realtime_now - last_realtime)) * 0.5;
@@ -167,19 +224,65 @@ void updateState(const fdm_packet* pkt) {
     last_ts.tv_sec = now_ts.tv_sec;
     last_ts.tv_nsec = now_ts.tv_nsec;
 
-    pthread_mutex_unlock(&updateLock); // can send PWM output now
+    atomic_store(&motorUpdateAllowed, true); // can send PWM output now
 
 #if defined(SIMULATOR_GYROPID_SYNC)
-    pthread_mutex_unlock(&mainLoopLock); // can run main loop
+    atomic_store(&mainLoopAllowed, true); // can run main loop
 #endif
 }
 
+#if defined(SIMULATOR_LOCKSTEP)
+// Waits for the next fdm_packet, runs exactly SIMULATOR_LOCKSTEP_LOOPS PID loops on the virtual
+// clock and answers with one servo_packet. Nothing depends on wall clock time, so a run only
+// depends on the packets received and goes as fast as the simulator steps.
+void simulatorLockstepStep(void) {
+    while (simLinkRecv(&stateLink, &fdmPkt, sizeof(fdm_packet), 100) != sizeof(fdm_packet)) {
+        if (!workerRunning) {
+            return;
+        }
+    }
+
+    const int64_t packetUs = llround(fdmPkt.timestamp * 1e6);
+    if (fdmPkt.timestamp < lockstepLastTimestamp) {
+        // simulator was restarted, keep the firmware clock monotonic
+        simTimeOffsetUs = (int64_t)simTimeUs - packetUs;
+    }
+    const double deltaSim = lockstepLastTimestamp < 0 ? 0 : fdmPkt.timestamp - lockstepLastTimestamp;
+    lockstepLastTimestamp = fdmPkt.timestamp;
+    if (packetUs + simTimeOffsetUs > (int64_t)simTimeUs) {
+        simTimeUs = packetUs + simTimeOffsetUs;
+    }
+
+    updateSensors(&fdmPkt, MAX(deltaSim, 0));
+
+    // sticks sent before the fdm_packet are applied before its PID loops, through the MSP receiver
+    while (simLinkRecv(&rcLink, &rcPkt, sizeof(rc_packet), 0) == sizeof(rc_packet)) {
+        rxMspFrameReceive(rcPkt.channels, SIMULATOR_MAX_RC_CHANNELS);
+    }
+
+    const int gyroLoops = SIMULATOR_LOCKSTEP_LOOPS * pidConfig()->pid_process_denom;
+    for (int loop = 0; loop < gyroLoops; loop++) {
+        simTimeUs += gyro.targetLooptime;
+        // run everything that became due, event driven tasks may stay signalled so the passes are bounded
+        for (int pass = 0; pass < TASK_COUNT; pass++) {
+            scheduler();
+            processLoopback();
+            if (schedulerIsIdle()) {
+                break;
+            }
+        }
+    }
+
+    sendMotorUpdate();
+}
+#endif
+
 static void* udpThread(void* data) {
     UNUSED(data);
     int n = 0;
 
     while (workerRunning) {
-        n = udpRecv(&stateLink, &fdmPkt, sizeof(fdm_packet), 100);
+        n = simLinkRecv(&stateLink, &fdmPkt, sizeof(fdm_packet), 100);
         if (n == sizeof(fdm_packet)) {
 //            printf("[data]new fdm %d\n", n);
             updateState(&fdmPkt);
@@ -215,33 +318,39 @@ void systemInit(void) {
 
     SystemCoreClock = 500 * 1e6; // fake 500MHz
 
-    if (pthread_mutex_init(&updateLock, NULL) != 0) {
-        printf("Create updateLock error!\n");
-        exit(1);
-    }
-
-    if (pthread_mutex_init(&mainLoopLock, NULL) != 0) {
-        printf("Create mainLoopLock error!\n");
-        exit(1);
-    }
-
     ret = pthread_create(&tcpWorker, NULL, tcpThread, NULL);
     if (ret != 0) {
         printf("Create tcpWorker error!\n");
         exit(1);
     }
 
-    ret = udpInit(&pwmLink, "127.0.0.1", 9002, false);
-    printf("init PwnOut UDP link...%d\n", ret);
+    // the firmware creates all rings, the simulator attaches to them
+    const char *shmPrefix = getenv("SITL_SHM");
+    shmTransport = shmPrefix && shmPrefix[0];
+    if (shmTransport) {
+        printf("shared memory transport, rings %s_*\n", shmPrefix);
+    }
 
-    ret = udpInit(&stateLink, NULL, 9003, true);
-    printf("start UDP server...%d\n", ret);
+    ret = simLinkInit(&pwmLink, shmPrefix, "servo", "127.0.0.1", 9002, shmTransport);
+    printf("init PwnOut link...%d\n", ret);
 
+    ret = simLinkInit(&stateLink, shmPrefix, "fdm", NULL, 9003, true);
+    printf("start state server...%d\n", ret);
+
+#if defined(SIMULATOR_LOCKSTEP)
+    ret = simLinkInit(&rcLink, shmPrefix, "rc", NULL, 9004, true);
+    printf("start RC server...%d\n", ret);
+
+    // fdm packets are read by the main loop, see simulatorLockstepStep()
+    printf("lock-step mode, %d PID loops per fdm packet\n", SIMULATOR_LOCKSTEP_LOOPS);
+    UNUSED(udpThread);
+#else
     ret = pthread_create(&udpWorker, NULL, udpThread, NULL);
     if (ret != 0) {
         printf("Create udpWorker error!\n");
         exit(1);
     }
+#endif
 
     // serial can't been slow down
     rescheduleTask(TASK_SERIAL, 1);
@@ -251,7 +360,9 @@ void systemReset(void){
     printf("[system]Reset!\n");
     workerRunning = false;
     pthread_join(tcpWorker, NULL);
+#if !defined(SIMULATOR_LOCKSTEP)
     pthread_join(udpWorker, NULL);
+#endif
     exit(0);
 }
 void systemResetToBootloader(bootloaderRequestType_e requestType) {
@@ -260,7 +371,9 @@ void systemResetToBootloader(bootloaderRequestType_e requestType) {
     printf("[system]ResetToBootloader!\n");
     workerRunning = false;
     pthread_join(tcpWorker, NULL);
+#if !defined(SIMULATOR_LOCKSTEP)
     pthread_join(udpWorker, NULL);
+#endif
     exit(0);
 }
 
@@ -303,6 +416,9 @@ uint64_t millis64_real() {
 }
 
 uint64_t micros64() {
+#if defined(SIMULATOR_LOCKSTEP)
+    return simTimeUs;
+#else
     static uint64_t last = 0;
     static uint64_t out = 0;
     uint64_t now = nanos64_real();
@@ -312,9 +428,13 @@ uint64_t micros64() {
 
     return out*1e-3;
 //    return micros64_real();
+#endif
 }
 
 uint64_t millis64() {
+#if defined(SIMULATOR_LOCKSTEP)
+    return simTimeUs / 1000;
+#else
     static uint64_t last = 0;
     static uint64_t out = 0;
     uint64_t now = nanos64_real();
@@ -324,6 +444,7 @@ uint64_t millis64() {
 
     return out*1e-6;
 //    return millis64_real();
+#endif
 }
 
 uint32_t micros(void) {
@@ -342,7 +463,11 @@ void microsleep(uint32_t usec) {
 }
 
 void delayMicroseconds(uint32_t us) {
+#if defined(SIMULATOR_LOCKSTEP)
+    simTimeUs += us;
+#else
     microsleep(us / simRate);
+#endif
 }
 
 void delayMicroseconds_real(uint32_t us) {
@@ -350,11 +475,15 @@ void delayMicroseconds_real(uint32_t us) {
 }
 
 void delay(uint32_t ms) {
+#if defined(SIMULATOR_LOCKSTEP)
+    simTimeUs += (uint64_t)ms * 1000;
+#else
     uint64_t start = millis64();
 
     while ((millis64() - start) < ms) {
         microsleep(1000);
     }
+#endif
 }
 
 // Subtract the ‘struct timespec’ values X and Y,  storing the result in RESULT.
@@ -424,6 +553,11 @@ static bool pwmEnableMotors(void)
     return true;
 }
 
+static bool pwmIsMotorEnabled(uint8_t index)
+{
+    return motors[index].enabled;
+}
+
 static void pwmWriteMotor(uint8_t index, float value)
 {
     motorsPwm[index] = value - idlePulse;
@@ -454,9 +588,14 @@ static void pwmCompleteMotorUpdate(void)
     pwmPkt.motor_speed[1] = motorsPwm[2] / outScale;
     pwmPkt.motor_speed[2] = motorsPwm[3] / outScale;
 
+#if defined(SIMULATOR_LOCKSTEP)
+    // sent once per fdm_packet by simulatorLockstepStep()
+    return;
+#endif
+
     // get one "fdm_packet" can only send one "servo_packet"!!
-    if (pthread_mutex_trylock(&updateLock) != 0) return;
-    udpSend(&pwmLink, &pwmPkt, sizeof(servo_packet));
+    if (!atomic_exchange(&motorUpdateAllowed, false)) return;
+    simLinkSend(&pwmLink, &pwmPkt, sizeof(servo_packet));
 //    printf("[pwm]%u:%u,%u,%u,%u\n", idlePulse, motorsPwm[0], motorsPwm[1], motorsPwm[2], motorsPwm[3]);
 }
 
@@ -466,10 +605,12 @@ void pwmWriteServo(uint8_t index, float value) {
 
 static motorDevice_t motorPwmDevice = {
     .vTable = {
+        .postInit = motorPostInitNull,
         .convertExternalToMotor = pwmConvertFromExternal,
         .convertMotorToExternal = pwmConvertToExternal,
         .enable = pwmEnableMotors,
         .disable = pwmDisableMotors,
+        .isMotorEnabled = pwmIsMotorEnabled,
         .updateStart = motorUpdateStartNull,
         .write = pwmWriteMotor,
         .writeInt = pwmWriteMotorInt,
@@ -559,13 +700,20 @@ void FLASH_Lock(void) {
 }
 
 FLASH_Status FLASH_ErasePage(uintptr_t Page_Address) {
-    UNUSED(Page_Address);
 //    printf("[FLASH_ErasePage]%x\n", Page_Address);
+    if ((Page_Address >= (uintptr_t)eepromData) && (Page_Address < (uintptr_t)ARRAYEND(eepromData))) {
+        memset((void *)Page_Address, 0xFF, MIN((uintptr_t)FLASH_PAGE_SIZE, (uintptr_t)ARRAYEND(eepromData) - Page_Address));
+    }
     return FLASH_COMPLETE;
 }
 
 FLASH_Status FLASH_ProgramWord(uintptr_t addr, uint32_t value) {
     if ((addr >= (uintptr_t)eepromData) && (addr < (uintptr_t)ARRAYEND(eepromData))) {
+        if (*((uint32_t*)addr) != 0xFFFFFFFF) {
+            // like the flash, a word has to be erased first
+            printf("[FLASH_ProgramWord]%p is not erased\n", (void*)addr);
+            return FLASH_ERROR_PG;
+        }
         *((uint32_t*)addr) = value;
         printf("[FLASH_ProgramWord]%p = %08x\n", (void*)addr, *((uint32_t*)addr));
     } else {
@@ -40,10 +40,22 @@
 //#define SIMULATOR_IMU_SYNC
 //#define SIMULATOR_GYROPID_SYNC
 
+// run on a virtual clock driven by the fdm_packet timestamps, SIMULATOR_LOCKSTEP_LOOPS PID loops per packet
+//#define SIMULATOR_LOCKSTEP
+#if defined(SIMULATOR_LOCKSTEP)
+#if defined(SIMULATOR_GYROPID_SYNC)
+#error "SIMULATOR_LOCKSTEP and SIMULATOR_GYROPID_SYNC are exclusive"
+#endif
+#ifndef SIMULATOR_LOCKSTEP_LOOPS
+#define SIMULATOR_LOCKSTEP_LOOPS 8
+#endif
+#endif
+
 // file name to save config
 #define EEPROM_FILENAME "eeprom.bin"
 #define CONFIG_IN_FILE
 #define EEPROM_SIZE     32768
+#define FLASH_PAGE_SIZE (0x400)
 
 #define U_ID_0 0
 #define U_ID_1 1
@@ -69,6 +81,11 @@
 #define USE_BARO
 #define USE_FAKE_BARO
 
+// blackbox_device = STREAM sends the log to TCP port 5770, support/bbcapture records it
+#define USE_BLACKBOX_STREAM
+#define USE_BLACKBOX_CAPTURE
+#define BLACKBOX_CAPTURE_BUFFER_SIZE (1024 * 1024)
+
 #define USABLE_TIMER_CHANNEL_COUNT 0
 
 #define USE_UART1
@@ -229,18 +246,6 @@ typedef enum
   FLASH_TIMEOUT
 } FLASH_Status;
 
-typedef struct {
-    double timestamp;                   // in seconds
-    double imu_angular_velocity_rpy[3]; // rad/s -> range: +/- 8192; +/- 2000 deg/se
-    double imu_linear_acceleration_xyz[3];    // m/s/s NED, body frame -> sim 1G = 9.80665, FC 1G = 256
-    double imu_orientation_quat[4];     //w, x, y, z
-    double velocity_xyz[3];             // m/s, earth frame
-    double position_xyz[3];             // meters, NED from origin
-} fdm_packet;
-typedef struct {
-    float motor_speed[4];   // normal: [0.0, 1.0], 3D: [-1.0, 1.0]
-} servo_packet;
-
 void FLASH_Unlock(void);
 void FLASH_Lock(void);
 FLASH_Status FLASH_ErasePage(uintptr_t Page_Address);
@@ -254,5 +259,6 @@ uint64_t micros64(void);
 uint64_t millis64(void);
 
 int lockMainPID(void);
+void simulatorLockstepStep(void);
 
 
@@ -28,6 +28,25 @@ typedef struct {
     bool isServer;
 } udpLink_t;
 
+// packets exchanged with the simulator, shared with support/sitlsim
+typedef struct {
+    double timestamp;                   // in seconds
+    double imu_angular_velocity_rpy[3]; // rad/s -> range: +/- 8192; +/- 2000 deg/se
+    double imu_linear_acceleration_xyz[3];    // m/s/s NED, body frame -> sim 1G = 9.80665, FC 1G = 256
+    double imu_orientation_quat[4];     //w, x, y, z
+    double velocity_xyz[3];             // m/s, earth frame
+    double position_xyz[3];             // meters, NED from origin
+} fdm_packet;
+typedef struct {
+    float motor_speed[4];   // normal: [0.0, 1.0], 3D: [-1.0, 1.0]
+} servo_packet;
+
+#define SIMULATOR_MAX_RC_CHANNELS 8
+typedef struct {
+    double timestamp;                                   // in seconds
+    uint16_t channels[SIMULATOR_MAX_RC_CHANNELS];       // RC channels, 1000 - 2000
+} rc_packet;
+
 int udpInit(udpLink_t* link, const char* addr, int port, bool isServer);
 int udpRecv(udpLink_t* link, void* data, size_t size, uint32_t timeout_ms);
 int udpSend(udpLink_t* link, const void* data, size_t size);
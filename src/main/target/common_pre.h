@@ -129,6 +129,10 @@
 #define SCHEDULER_DELAY_LIMIT           100
 #endif
 
+#if defined(STM32F7) || defined(STM32H7)
+#define AFATFS_NUM_CACHE_SECTORS        32 // 16kB, rides out longer SD card write stalls
+#endif
+
 #if (__FPU_PRESENT == 1) && (__FPU_USED == 1)
 #define DEFAULT_AUX_CHANNEL_COUNT       MAX_AUX_CHANNEL_COUNT
 #else
@@ -211,6 +215,7 @@
 #endif
 
 #if (FLASH_SIZE > 128)
+#define USE_CRC_TABLE           // 768 bytes of CRC tables, a lookup per byte
 #define USE_GYRO_OVERFLOW_CHECK
 #define USE_YAW_SPIN_RECOVERY
 #define USE_DSHOT_DMAR
@@ -308,6 +313,7 @@
 
 #if (FLASH_SIZE > 256)
 #define USE_AIRMODE_LPF
+#define USE_CRC_SLICE_BY_4      // another 2.25kB of CRC tables, four bytes per round of lookups
 #define USE_DASHBOARD
 #define USE_GPS
 #define USE_GPS_NMEA
@@ -341,6 +347,7 @@
 #define USE_TELEMETRY_SENSORS_DISABLED_DETAILS
 #define USE_VTX_TABLE
 #define USE_PERSISTENT_STATS
+#define USE_TASK_HISTOGRAMS
 #define USE_PROFILE_NAMES
 #define USE_SERIALRX_SRXL2     // Spektrum SRXL2 protocol
 #define USE_INTERPOLATED_SP
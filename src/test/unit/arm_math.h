@@ -0,0 +1,47 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// Host stand-in for the CMSIS DSP header, declares only what the dynamic notch
+// analyser uses. Tests provide the implementations.
+
+#include <stdint.h>
+
+typedef float float32_t;
+
+typedef enum {
+    ARM_MATH_SUCCESS = 0,
+    ARM_MATH_ARGUMENT_ERROR = -1
+} arm_status;
+
+typedef struct {
+    uint16_t fftLen;
+    const float32_t *pTwiddle;
+    const uint16_t *pBitRevTable;
+    uint16_t bitRevLength;
+} arm_cfft_instance_f32;
+
+typedef struct {
+    arm_cfft_instance_f32 Sint;
+    uint16_t fftLenRFFT;
+    float32_t *pTwiddleRFFT;
+} arm_rfft_fast_instance_f32;
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen);
+void arm_mult_f32(float32_t *pSrcA, float32_t *pSrcB, float32_t *pDst, uint32_t blockSize);
+void arm_cmplx_mag_f32(float32_t *pSrc, float32_t *pDst, uint32_t numSamples);
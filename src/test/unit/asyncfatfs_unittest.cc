@@ -0,0 +1,449 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/maths.h"
+
+    #include "drivers/sdcard.h"
+
+    #include "io/asyncfatfs/asyncfatfs.h"
+    #include "io/asyncfatfs/fat_standard.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define BLOCK_SIZE 512
+
+// A FAT16 volume of 16MB, a supercluster is 256 clusters of 4 sectors
+#define PARTITION_START 64
+#define RESERVED_SECTORS 4
+#define ROOT_ENTRIES 512
+#define ROOT_SECTORS (ROOT_ENTRIES * FAT_DIRECTORY_ENTRY_SIZE / BLOCK_SIZE)
+#define SECTORS_PER_CLUSTER 4
+#define CLUSTER_COUNT 8000
+#define FAT_SECTORS ((CLUSTER_COUNT + 2) * 2 / BLOCK_SIZE + 1)
+#define PARTITION_SECTORS (RESERVED_SECTORS + 2 * FAT_SECTORS + ROOT_SECTORS + CLUSTER_COUNT * SECTORS_PER_CLUSTER)
+#define DISK_BLOCKS (PARTITION_START + PARTITION_SECTORS)
+#define SUPERCLUSTER_SECTORS (BLOCK_SIZE / 2 * SECTORS_PER_CLUSTER)
+
+#define LOG_SIZE (4 * 1024 * 1024)
+#define LOOP_PERIOD_US 125          // the logging task runs at 8kHz
+#define LOOP_LIMIT 2000000
+
+/*
+ * Timing of the card in microseconds, roughly an SPI card at 21MHz. Commands are sent and answered while the
+ * driver spins, so they stall whoever called it, data goes out by DMA while the card keeps itself busy.
+ */
+#define CARD_COMMAND_US 16
+#define CARD_TRANSFER_US 200
+#define CARD_READ_ACCESS_US 150
+#define CARD_SINGLE_WRITE_BUSY_US 600
+#define CARD_MULTI_WRITE_BUSY_US 60
+#define CARD_STOP_BUSY_US 600
+// Now and then the card stops to tidy up its flash, that's what the sector cache has to cover
+#define CARD_STALL_INTERVAL_BLOCKS 1000
+#define CARD_STALL_US 20000
+
+static uint8_t *disk;
+static uint32_t simTime;
+static uint32_t cardBusyUntil;
+
+static bool multiWriteOpen;
+static uint32_t multiWriteNextBlock;
+static uint32_t multiWriteBlocksRemain;
+
+static struct {
+    bool active;
+    sdcardBlockOperation_e operation;
+    uint32_t blockIndex;
+    uint8_t *buffer;
+    sdcard_operationCompleteCallback_c callback;
+    uint32_t callbackData;
+    uint32_t doneTime;
+} pendingOperation;
+
+static int singleWrites;
+static int multiWrites;
+static int stops;
+static int blocksWritten;
+static int blocksRead;
+
+static uint32_t callBlockingUs;
+
+static void cardSpin(uint32_t us)
+{
+    callBlockingUs += us;
+    simTime += us;
+}
+
+static void cardStopMultiWrite(void)
+{
+    multiWriteOpen = false;
+    cardSpin(CARD_COMMAND_US);
+    cardBusyUntil = simTime + CARD_STOP_BUSY_US;
+    stops++;
+}
+
+static void fatSetEntry(uint32_t cluster, uint16_t value)
+{
+    for (int fat = 0; fat < 2; fat++) {
+        uint8_t *entry = disk + (PARTITION_START + RESERVED_SECTORS + fat * FAT_SECTORS) * BLOCK_SIZE + cluster * 2;
+        memcpy(entry, &value, sizeof(value));
+    }
+}
+
+static void formatDisk(void)
+{
+    free(disk);
+    disk = (uint8_t *)calloc(DISK_BLOCKS, BLOCK_SIZE);
+
+    mbrPartitionEntry_t partition = {};
+    partition.type = MBR_PARTITION_TYPE_FAT16_LBA;
+    partition.lbaBegin = PARTITION_START;
+    partition.numSectors = PARTITION_SECTORS;
+    memcpy(disk + 446, &partition, sizeof(partition));
+    disk[510] = 0x55;
+    disk[511] = 0xAA;
+
+    fatVolumeID_t volume = {};
+    volume.jmpBoot[0] = 0xEB;
+    volume.bytesPerSector = BLOCK_SIZE;
+    volume.sectorsPerCluster = SECTORS_PER_CLUSTER;
+    volume.reservedSectorCount = RESERVED_SECTORS;
+    volume.numFATs = 2;
+    volume.rootEntryCount = ROOT_ENTRIES;
+    volume.media = 0xF8;
+    volume.FATSize16 = FAT_SECTORS;
+    volume.totalSectors32 = PARTITION_SECTORS;
+    uint8_t *volumeSector = disk + PARTITION_START * BLOCK_SIZE;
+    memcpy(volumeSector, &volume, sizeof(volume));
+    volumeSector[510] = 0x55;
+    volumeSector[511] = 0xAA;
+
+    fatSetEntry(0, 0xFFF8);
+    fatSetEntry(1, 0xFFFF);
+}
+
+static void resetCard(void)
+{
+    simTime = 0;
+    cardBusyUntil = 0;
+    multiWriteOpen = false;
+    pendingOperation.active = false;
+    singleWrites = multiWrites = stops = blocksWritten = blocksRead = 0;
+}
+
+static uint32_t worstPollBlockingUs;
+static double worstPollSeconds;
+
+static void pollFilesystem(void)
+{
+    simTime += LOOP_PERIOD_US;
+    callBlockingUs = 0;
+
+    const clock_t start = clock();
+    afatfs_poll();
+    const double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    worstPollBlockingUs = MAX(worstPollBlockingUs, callBlockingUs);
+    worstPollSeconds = MAX(worstPollSeconds, seconds);
+}
+
+static afatfsFilePtr_t openedFile;
+static bool fileClosed;
+
+static void fileOpened(afatfsFilePtr_t file)
+{
+    openedFile = file;
+}
+
+static void fileClosedCallback(void)
+{
+    fileClosed = true;
+}
+
+static afatfsFilePtr_t openFile(const char *filename, const char *mode)
+{
+    openedFile = NULL;
+    afatfs_fopen(filename, mode, fileOpened);
+    for (int i = 0; !openedFile && i < LOOP_LIMIT; i++) {
+        pollFilesystem();
+    }
+    return openedFile;
+}
+
+static void closeFile(afatfsFilePtr_t file)
+{
+    fileClosed = false;
+    afatfs_fclose(file, fileClosedCallback);
+    for (int i = 0; !fileClosed && i < LOOP_LIMIT; i++) {
+        pollFilesystem();
+    }
+    // Let the last of the cache reach the disk
+    for (int i = 0; !afatfs_flush() && i < LOOP_LIMIT; i++) {
+        pollFilesystem();
+    }
+}
+
+static uint8_t patternByte(uint32_t offset)
+{
+    return (offset * 7) ^ (offset >> 9);
+}
+
+static void mountFilesystem(void)
+{
+    afatfs_destroy(true);
+    formatDisk();
+    resetCard();
+    afatfs_init();
+    for (int i = 0; afatfs_getFilesystemState() == AFATFS_FILESYSTEM_STATE_INITIALIZATION && i < LOOP_LIMIT; i++) {
+        pollFilesystem();
+    }
+}
+
+static uint32_t writeLog(afatfsFilePtr_t file)
+{
+    uint8_t chunk[BLOCK_SIZE];
+    uint32_t written = 0;
+
+    for (int i = 0; written < LOG_SIZE && i < LOOP_LIMIT; i++) {
+        // Offer as much as the filesystem will take, so the card sets the pace
+        uint32_t length = MIN(sizeof(chunk), LOG_SIZE - written);
+        for (uint32_t j = 0; j < length; j++) {
+            chunk[j] = patternByte(written + j);
+        }
+        written += afatfs_fwrite(file, chunk, length);
+        pollFilesystem();
+    }
+
+    return written;
+}
+
+TEST(AsyncFatfsTest, SustainedAppend)
+{
+    mountFilesystem();
+    ASSERT_EQ(AFATFS_FILESYSTEM_STATE_READY, afatfs_getFilesystemState());
+
+    afatfsFilePtr_t file = openFile("LOG00001.BFL", "as");
+    ASSERT_TRUE(file != NULL);
+
+    resetCard();
+    worstPollBlockingUs = 0;
+    worstPollSeconds = 0;
+
+    EXPECT_EQ((uint32_t)LOG_SIZE, writeLog(file));
+    closeFile(file);
+
+    const int superclusters = LOG_SIZE / (SUPERCLUSTER_SECTORS * BLOCK_SIZE);
+    printf("%d kB appended at %.0f kB/s, %d blocks in %d multi-block and %d single block writes, %d stops\n",
+        LOG_SIZE / 1024, (double)LOG_SIZE / 1024 / (simTime / 1e6), blocksWritten, multiWrites, singleWrites, stops);
+    printf("worst afatfs_poll(), %u us stalled on the card, %.0f us of CPU\n", worstPollBlockingUs, worstPollSeconds * 1e6);
+
+    // The FAT and directory updates may interrupt the stream once per supercluster, nothing else should
+    EXPECT_LE(multiWrites, superclusters + 1);
+    EXPECT_LE(worstPollBlockingUs, 3u * CARD_COMMAND_US);
+    EXPECT_EQ(AFATFS_FILESYSTEM_STATE_READY, afatfs_getFilesystemState());
+}
+
+TEST(AsyncFatfsTest, CacheRidesOutCardStalls)
+{
+    mountFilesystem();
+    afatfsFilePtr_t file = openFile("LOG00001.BFL", "as");
+    ASSERT_TRUE(file != NULL);
+
+    resetCard();
+
+    // 64 bytes every loop is 512kB/s, a card stall holds up 10kB of that
+    uint8_t frame[64];
+    uint32_t offered = 0;
+    uint32_t dropped = 0;
+    for (int i = 0; i < 32000; i++) {
+        for (unsigned j = 0; j < sizeof(frame); j++) {
+            frame[j] = patternByte(offered + j);
+        }
+        offered += sizeof(frame);
+        dropped += sizeof(frame) - afatfs_fwrite(file, frame, sizeof(frame));
+        pollFilesystem();
+    }
+    closeFile(file);
+
+    printf("%d cache sectors, %u of %u bytes dropped over %d card stalls\n",
+        AFATFS_NUM_CACHE_SECTORS, dropped, offered, blocksWritten / CARD_STALL_INTERVAL_BLOCKS);
+    EXPECT_EQ(0u, dropped);
+}
+
+TEST(AsyncFatfsTest, ReadBack)
+{
+    mountFilesystem();
+    afatfsFilePtr_t file = openFile("LOG00001.BFL", "as");
+    ASSERT_TRUE(file != NULL);
+    EXPECT_EQ((uint32_t)LOG_SIZE, writeLog(file));
+    closeFile(file);
+
+    file = openFile("LOG00001.BFL", "r");
+    ASSERT_TRUE(file != NULL);
+
+    resetCard();
+
+    static uint8_t readData[LOG_SIZE];
+    uint32_t readBytes = 0;
+    for (int i = 0; !afatfs_feof(file) && i < LOOP_LIMIT; i++) {
+        readBytes += afatfs_fread(file, readData + readBytes, MIN(256u, LOG_SIZE - readBytes));
+        pollFilesystem();
+    }
+
+    printf("%d kB read at %.0f kB/s in %d block reads\n", LOG_SIZE / 1024, (double)LOG_SIZE / 1024 / (simTime / 1e6), blocksRead);
+
+    ASSERT_EQ((uint32_t)LOG_SIZE, readBytes);
+    bool matches = true;
+    for (uint32_t i = 0; i < LOG_SIZE; i++) {
+        matches = matches && readData[i] == patternByte(i);
+    }
+    EXPECT_TRUE(matches);
+    // Every sector once, and the FAT sector that chains each supercluster
+    EXPECT_EQ(LOG_SIZE / BLOCK_SIZE + LOG_SIZE / (SUPERCLUSTER_SECTORS * BLOCK_SIZE), blocksRead);
+
+    closeFile(file);
+}
+
+// STUBS
+
+extern "C" {
+
+bool sdcard_poll(void)
+{
+    if (pendingOperation.active && simTime >= pendingOperation.doneTime) {
+        pendingOperation.active = false;
+
+        if (pendingOperation.operation == SDCARD_BLOCK_OPERATION_READ) {
+            memcpy(pendingOperation.buffer, disk + pendingOperation.blockIndex * BLOCK_SIZE, BLOCK_SIZE);
+        } else if (multiWriteOpen) {
+            if (multiWriteBlocksRemain > 1) {
+                multiWriteBlocksRemain--;
+                multiWriteNextBlock++;
+            } else {
+                cardStopMultiWrite();
+            }
+        }
+
+        pendingOperation.callback(pendingOperation.operation, pendingOperation.blockIndex, pendingOperation.buffer, pendingOperation.callbackData);
+    }
+
+    return !pendingOperation.active && simTime >= cardBusyUntil;
+}
+
+static bool cardBusy(void)
+{
+    return pendingOperation.active || simTime < cardBusyUntil;
+}
+
+static void cardStartOperation(sdcardBlockOperation_e operation, uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData, uint32_t duration)
+{
+    pendingOperation.active = true;
+    pendingOperation.operation = operation;
+    pendingOperation.blockIndex = blockIndex;
+    pendingOperation.buffer = buffer;
+    pendingOperation.callback = callback;
+    pendingOperation.callbackData = callbackData;
+    pendingOperation.doneTime = simTime + duration;
+}
+
+bool sdcard_readBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    if (cardBusy()) {
+        return false;
+    }
+    if (multiWriteOpen) {
+        cardStopMultiWrite();
+        return false;
+    }
+
+    cardSpin(CARD_COMMAND_US);
+    cardStartOperation(SDCARD_BLOCK_OPERATION_READ, blockIndex, buffer, callback, callbackData, CARD_READ_ACCESS_US + CARD_TRANSFER_US);
+    blocksRead++;
+
+    return true;
+}
+
+sdcardOperationStatus_e sdcard_beginWriteBlocks(uint32_t blockIndex, uint32_t blockCount)
+{
+    if (cardBusy()) {
+        return SDCARD_OPERATION_BUSY;
+    }
+    if (multiWriteOpen) {
+        if (blockIndex == multiWriteNextBlock) {
+            multiWriteBlocksRemain = MAX(multiWriteBlocksRemain, blockCount);
+            return SDCARD_OPERATION_SUCCESS;
+        }
+        cardStopMultiWrite();
+        return SDCARD_OPERATION_BUSY;
+    }
+
+    // ACMD23 then CMD25
+    cardSpin(3 * CARD_COMMAND_US);
+    multiWriteOpen = true;
+    multiWriteNextBlock = blockIndex;
+    multiWriteBlocksRemain = blockCount;
+    multiWrites++;
+
+    return SDCARD_OPERATION_SUCCESS;
+}
+
+sdcardOperationStatus_e sdcard_writeBlock(uint32_t blockIndex, uint8_t *buffer, sdcard_operationCompleteCallback_c callback, uint32_t callbackData)
+{
+    uint32_t duration;
+
+    if (cardBusy()) {
+        return SDCARD_OPERATION_BUSY;
+    }
+    if (multiWriteOpen) {
+        if (blockIndex != multiWriteNextBlock) {
+            cardStopMultiWrite();
+            return SDCARD_OPERATION_BUSY;
+        }
+        duration = CARD_TRANSFER_US + CARD_MULTI_WRITE_BUSY_US;
+    } else {
+        cardSpin(CARD_COMMAND_US);
+        duration = CARD_TRANSFER_US + CARD_SINGLE_WRITE_BUSY_US;
+        singleWrites++;
+    }
+    if (blocksWritten % CARD_STALL_INTERVAL_BLOCKS == CARD_STALL_INTERVAL_BLOCKS - 1) {
+        duration += CARD_STALL_US;
+    }
+
+    EXPECT_LT(blockIndex, (uint32_t)DISK_BLOCKS);
+    memcpy(disk + blockIndex * BLOCK_SIZE, buffer, BLOCK_SIZE);
+    cardStartOperation(SDCARD_BLOCK_OPERATION_WRITE, blockIndex, buffer, callback, callbackData, duration);
+    blocksWritten++;
+
+    return SDCARD_OPERATION_IN_PROGRESS;
+}
+
+void sdcard_setProfilerCallback(sdcard_profilerCallback_c callback)
+{
+    UNUSED(callback);
+}
+
+}
@@ -0,0 +1,179 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "blackbox/blackbox_compress.h"
+    #include "blackbox/blackbox_decompress.h"
+
+    #include "common/maths.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define LOG_SIZE (5 * BLACKBOX_COMPRESSION_BLOCK_SIZE + 300)
+
+static uint8_t raw[LOG_SIZE];
+static uint8_t compressed[BLACKBOX_COMPRESSED_SIZE_MAX(LOG_SIZE) + LOG_SIZE];
+static uint8_t decompressed[BLACKBOX_DECOMPRESSED_SIZE_MAX(sizeof(compressed))];
+static int blockEnds[LOG_SIZE / BLACKBOX_COMPRESSION_BLOCK_SIZE + 2];      // offsets in compressed
+static int blockRawEnds[LOG_SIZE / BLACKBOX_COMPRESSION_BLOCK_SIZE + 2];   // offsets in raw
+static int blockCount;
+
+// Something that looks like P-frames, a frame marker and mostly small signed VB values
+static void makeLog(void)
+{
+    srand(42);
+    for (int i = 0; i < LOG_SIZE; i++) {
+        if (i % 30 == 0) {
+            raw[i] = 'P';
+        } else {
+            const int value = (rand() % 9) - 4;
+            raw[i] = value >= 0 ? value << 1 : ((-value) << 1) - 1;
+        }
+    }
+}
+
+// Compress the log the way blackbox_io hands it over, in frames of varying length
+static int compressLog(void)
+{
+    blackboxCompressor_t compressor;
+    int length = 0;
+
+    blackboxCompressInit(&compressor);
+    blockCount = 0;
+
+    for (int pos = 0; pos < LOG_SIZE; ) {
+        const int frame = MIN(LOG_SIZE - pos, 1 + rand() % 64);
+        const int written = blackboxCompress(&compressor, &compressed[length], &raw[pos], frame);
+        EXPECT_LE(written, (int)BLACKBOX_COMPRESSED_SIZE_MAX(frame));
+        length += written;
+        pos += frame;
+        if (!compressor.blockOpen) {
+            blockRawEnds[blockCount] = pos;
+            blockEnds[blockCount++] = length;
+        }
+    }
+    length += blackboxCompressEndBlock(&compressor, &compressed[length]);
+    blockRawEnds[blockCount] = LOG_SIZE;
+    blockEnds[blockCount++] = length;
+
+    // Ending twice doesn't add anything
+    EXPECT_EQ(0, blackboxCompressEndBlock(&compressor, &compressed[length]));
+
+    return length;
+}
+
+TEST(BlackboxCompressTest, TestRoundTrip)
+{
+    makeLog();
+    const int length = compressLog();
+
+    blackboxDecompressStats_t stats;
+    const int written = blackboxDecompress(decompressed, compressed, length, &stats);
+
+    EXPECT_EQ(LOG_SIZE, written);
+    EXPECT_EQ(0, memcmp(raw, decompressed, LOG_SIZE));
+    EXPECT_EQ(6, blockCount);
+    EXPECT_EQ(6u, stats.blocks);
+    EXPECT_EQ(0u, stats.damagedBlocks);
+    EXPECT_EQ(0u, stats.plainBytes);
+
+    // The table was built for this kind of data
+    EXPECT_LT(length, LOG_SIZE * 2 / 3);
+    printf("%d bytes compressed to %d\n", LOG_SIZE, length);
+}
+
+TEST(BlackboxCompressTest, TestEveryByteValue)
+{
+    blackboxCompressor_t compressor;
+    uint8_t values[256];
+    int length = 0;
+
+    for (int i = 0; i < 256; i++) {
+        values[i] = 255 - i;
+    }
+
+    blackboxCompressInit(&compressor);
+    length += blackboxCompress(&compressor, compressed, values, sizeof(values));
+    length += blackboxCompressEndBlock(&compressor, &compressed[length]);
+    EXPECT_LE(length, (int)BLACKBOX_COMPRESSED_SIZE_MAX(sizeof(values)));
+
+    blackboxDecompressStats_t stats;
+    EXPECT_EQ(256, blackboxDecompress(decompressed, compressed, length, &stats));
+    EXPECT_EQ(0, memcmp(values, decompressed, sizeof(values)));
+    EXPECT_EQ(1u, stats.blocks);
+}
+
+TEST(BlackboxCompressTest, TestPlainLogPassesThrough)
+{
+    makeLog();
+
+    blackboxDecompressStats_t stats;
+    EXPECT_EQ(LOG_SIZE, blackboxDecompress(decompressed, raw, LOG_SIZE, &stats));
+    EXPECT_EQ(0, memcmp(raw, decompressed, LOG_SIZE));
+    EXPECT_EQ(0u, stats.blocks);
+    EXPECT_EQ((uint32_t)LOG_SIZE, stats.plainBytes);
+}
+
+TEST(BlackboxCompressTest, TestTruncatedLog)
+{
+    makeLog();
+    compressLog();
+
+    // Power lost half way through the fourth block, the rest of the flash is still erased
+    const int cut = (blockEnds[2] + blockEnds[3]) / 2;
+    memset(&compressed[cut], 0xFF, 1000);
+
+    blackboxDecompressStats_t stats;
+    const int written = blackboxDecompress(decompressed, compressed, cut + 1000, &stats);
+
+    EXPECT_EQ(3u, stats.blocks);
+    EXPECT_EQ(1u, stats.damagedBlocks);
+
+    // The good blocks are all there and the damaged one is kept as far as it was written
+    const int keptLength = blockRawEnds[2] + (blockRawEnds[3] - blockRawEnds[2]) / 3;
+    EXPECT_GT(written, keptLength);
+    EXPECT_LT(written, blockRawEnds[3]);
+    EXPECT_EQ(0, memcmp(raw, decompressed, keptLength));
+}
+
+TEST(BlackboxCompressTest, TestCorruptedBlockRecovers)
+{
+    makeLog();
+    const int length = compressLog();
+
+    // One bad byte in the second block
+    compressed[(blockEnds[0] + blockEnds[1]) / 2] ^= 0x5A;
+
+    blackboxDecompressStats_t stats;
+    const int written = blackboxDecompress(decompressed, compressed, length, &stats);
+
+    EXPECT_EQ(5u, stats.blocks);
+    EXPECT_EQ(1u, stats.damagedBlocks);
+
+    // Everything after the damaged block is back in step
+    const int tailLength = LOG_SIZE - blockRawEnds[1];
+    ASSERT_GE(written, tailLength);
+    EXPECT_EQ(0, memcmp(&raw[blockRawEnds[1]], &decompressed[written - tailLength], tailLength));
+    EXPECT_EQ(0, memcmp(raw, decompressed, blockRawEnds[0]));
+}
@@ -14,14 +14,19 @@
  * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 extern "C" {
     #include "platform.h"
 
     #include "blackbox/blackbox.h"
     #include "blackbox/blackbox_encoding.h"
+    #include "common/encoding.h"
+    #include "common/maths.h"
     #include "common/utils.h"
 
     #include "pg/pg.h"
@@ -43,6 +48,40 @@ static int serialReadEnd = 0;
 static uint8_t serialReadBuffer[SERIAL_BUFFER_SIZE];
 static uint8_t serialWriteBuffer[SERIAL_BUFFER_SIZE];
 
+// While set, the writes go to a frame buffer that works like the one in blackbox_io.c, so the benchmark measures the
+// encoders rather than the checks of the serial stubs
+static bool benchmarkSink;
+static uint8_t sinkBuffer[SERIAL_BUFFER_SIZE];
+static int sinkLength;
+static uint32_t sinkBytes;
+
+static void sinkReset(void)
+{
+    sinkLength = 0;
+    sinkBytes = 0;
+}
+
+static void sinkWrite(uint8_t value)
+{
+    if (sinkLength == SERIAL_BUFFER_SIZE) {
+        sinkBytes += sinkLength;
+        sinkLength = 0;
+    }
+    sinkBuffer[sinkLength++] = value;
+}
+
+static void sinkWriteWord(uint64_t word, int length)
+{
+    if (sinkLength <= SERIAL_BUFFER_SIZE - (int)sizeof(word)) {
+        memcpy(&sinkBuffer[sinkLength], &word, sizeof(word));
+        sinkLength += length;
+        return;
+    }
+    for (; length > 0; length--, word >>= 8) {
+        sinkWrite(word);
+    }
+}
+
 serialPort_t serialTestInstance;
 
 void serialWrite(serialPort_t *instance, uint8_t ch)
@@ -240,12 +279,572 @@ TEST(BlackboxTest, TestWriteTag2_3SVariable_BITS887)
     EXPECT_EQ(0, buf[3]); // ensure next byte has not been written
     buf += 3;
 }
+
+// The byte at a time encoders blackbox_encoding.c used to have, the new ones must produce exactly the same bytes.
+// They aren't inlined, just like the originals weren't.
+static uint8_t referenceBuffer[SERIAL_BUFFER_SIZE];
+static int referencePos;
+
+__attribute__((noinline)) static void referenceWrite(uint8_t value)
+{
+    if (benchmarkSink) {
+        sinkWrite(value);
+        return;
+    }
+    EXPECT_LT(referencePos, (int)sizeof(referenceBuffer));
+    referenceBuffer[referencePos++] = value;
+}
+
+__attribute__((noinline)) static void referenceWriteUnsignedVB(uint32_t value)
+{
+    while (value > 127) {
+        referenceWrite((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    referenceWrite(value);
+}
+
+__attribute__((noinline)) static void referenceWriteSignedVB(int32_t value)
+{
+    referenceWriteUnsignedVB(zigzagEncode(value));
+}
+
+static void referenceWriteSignedVBArray(int32_t *array, int count)
+{
+    for (int i = 0; i < count; i++) {
+        referenceWriteSignedVB(array[i]);
+    }
+}
+
+__attribute__((noinline)) static void referenceWriteTag2_3S32(int32_t *values)
+{
+    int selector = 0;
+    for (int x = 0; x < 3; x++) {
+        if (values[x] >= 32 || values[x] < -32) {
+            selector = 3;
+            break;
+        }
+        if (values[x] >= 8 || values[x] < -8) {
+            if (selector < 2) {
+                selector = 2;
+            }
+        } else if (values[x] >= 2 || values[x] < -2) {
+            if (selector < 1) {
+                selector = 1;
+            }
+        }
+    }
+
+    switch (selector) {
+    case 0:
+        referenceWrite((selector << 6) | ((values[0] & 0x03) << 4) | ((values[1] & 0x03) << 2) | (values[2] & 0x03));
+        break;
+    case 1:
+        referenceWrite((selector << 6) | (values[0] & 0x0F));
+        referenceWrite((values[1] << 4) | (values[2] & 0x0F));
+        break;
+    case 2:
+        referenceWrite((selector << 6) | (values[0] & 0x3F));
+        referenceWrite((uint8_t)values[1]);
+        referenceWrite((uint8_t)values[2]);
+        break;
+    case 3:
+        {
+            int selector2 = 0;
+            for (int x = 2; x >= 0; x--) {
+                selector2 <<= 2;
+                if (values[x] < 128 && values[x] >= -128) {
+                    selector2 |= 0;
+                } else if (values[x] < 32768 && values[x] >= -32768) {
+                    selector2 |= 1;
+                } else if (values[x] < 8388608 && values[x] >= -8388608) {
+                    selector2 |= 2;
+                } else {
+                    selector2 |= 3;
+                }
+            }
+            referenceWrite((selector << 6) | selector2);
+            for (int x = 0; x < 3; x++, selector2 >>= 2) {
+                for (int byte = 0; byte <= (selector2 & 0x03); byte++) {
+                    referenceWrite(values[x] >> (8 * byte));
+                }
+            }
+        }
+        break;
+    }
+}
+
+__attribute__((noinline)) static void referenceWriteTag8_4S16(int32_t *values)
+{
+    uint8_t selector = 0;
+    for (int x = 3; x >= 0; x--) {
+        selector <<= 2;
+        if (values[x] == 0) {
+            selector |= 0;
+        } else if (values[x] < 8 && values[x] >= -8) {
+            selector |= 1;
+        } else if (values[x] < 128 && values[x] >= -128) {
+            selector |= 2;
+        } else {
+            selector |= 3;
+        }
+    }
+
+    referenceWrite(selector);
+
+    int nibbleIndex = 0;
+    uint8_t buffer = 0;
+    for (int x = 0; x < 4; x++, selector >>= 2) {
+        switch (selector & 0x03) {
+        case 0:
+            break;
+        case 1:
+            if (nibbleIndex == 0) {
+                buffer = values[x] << 4;
+                nibbleIndex = 1;
+            } else {
+                referenceWrite(buffer | (values[x] & 0x0F));
+                nibbleIndex = 0;
+            }
+            break;
+        case 2:
+            if (nibbleIndex == 0) {
+                referenceWrite(values[x]);
+            } else {
+                referenceWrite(buffer | ((values[x] >> 4) & 0x0F));
+                buffer = values[x] << 4;
+            }
+            break;
+        case 3:
+            if (nibbleIndex == 0) {
+                referenceWrite(values[x] >> 8);
+                referenceWrite(values[x]);
+            } else {
+                referenceWrite(buffer | ((values[x] >> 12) & 0x0F));
+                referenceWrite(values[x] >> 4);
+                buffer = values[x] << 4;
+            }
+            break;
+        }
+    }
+    if (nibbleIndex == 1) {
+        referenceWrite(buffer);
+    }
+}
+
+__attribute__((noinline)) static void referenceWriteTag8_8SVB(int32_t *values, int valueCount)
+{
+    if (valueCount == 1) {
+        referenceWriteSignedVB(values[0]);
+    } else if (valueCount > 1) {
+        uint8_t header = 0;
+        for (int i = valueCount - 1; i >= 0; i--) {
+            header <<= 1;
+            if (values[i] != 0) {
+                header |= 0x01;
+            }
+        }
+        referenceWrite(header);
+        for (int i = 0; i < valueCount; i++) {
+            if (values[i] != 0) {
+                referenceWriteSignedVB(values[i]);
+            }
+        }
+    }
+}
+
+// Decoders along the lines of the ones in the log viewers
+static const uint8_t *readPos;
+
+static int32_t signExtend(uint32_t value, int bits)
+{
+    return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+static uint32_t readUnsignedVB(void)
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        const uint8_t byte = *readPos++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (byte < 128) {
+            break;
+        }
+    }
+    return value;
+}
+
+static int32_t readSignedVB(void)
+{
+    const uint32_t value = readUnsignedVB();
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void readTag2_3S32(int32_t *values)
+{
+    uint8_t leadByte = *readPos++;
+    uint8_t byte;
+
+    switch (leadByte >> 6) {
+    case 0:
+        values[0] = signExtend((leadByte >> 4) & 0x03, 2);
+        values[1] = signExtend((leadByte >> 2) & 0x03, 2);
+        values[2] = signExtend(leadByte & 0x03, 2);
+        break;
+    case 1:
+        values[0] = signExtend(leadByte & 0x0F, 4);
+        byte = *readPos++;
+        values[1] = signExtend(byte >> 4, 4);
+        values[2] = signExtend(byte & 0x0F, 4);
+        break;
+    case 2:
+        values[0] = signExtend(leadByte & 0x3F, 6);
+        values[1] = signExtend(*readPos++ & 0x3F, 6);
+        values[2] = signExtend(*readPos++ & 0x3F, 6);
+        break;
+    case 3:
+        for (int i = 0; i < 3; i++, leadByte >>= 2) {
+            const int bytes = (leadByte & 0x03) + 1;
+            uint32_t value = 0;
+            for (int byte = 0; byte < bytes; byte++) {
+                value |= (uint32_t)*readPos++ << (8 * byte);
+            }
+            values[i] = signExtend(value, 8 * bytes);
+        }
+        break;
+    }
+}
+
+static void readTag8_4S16(int32_t *values)
+{
+    uint8_t selector = *readPos++;
+    bool nibbleIndex = false;
+    uint8_t buffer = 0;
+
+    for (int i = 0; i < 4; i++, selector >>= 2) {
+        switch (selector & 0x03) {
+        case 0:
+            values[i] = 0;
+            break;
+        case 1:
+            if (!nibbleIndex) {
+                buffer = *readPos++;
+                values[i] = signExtend(buffer >> 4, 4);
+            } else {
+                values[i] = signExtend(buffer & 0x0F, 4);
+            }
+            nibbleIndex = !nibbleIndex;
+            break;
+        case 2:
+            if (!nibbleIndex) {
+                values[i] = signExtend(*readPos++, 8);
+            } else {
+                const uint8_t high = buffer << 4;
+                buffer = *readPos++;
+                values[i] = signExtend(high | (buffer >> 4), 8);
+            }
+            break;
+        case 3:
+            if (!nibbleIndex) {
+                const uint8_t high = *readPos++;
+                values[i] = signExtend(high << 8 | *readPos++, 16);
+            } else {
+                const uint8_t middle = *readPos++;
+                const uint32_t high = buffer & 0x0F;
+                buffer = *readPos++;
+                values[i] = signExtend(high << 12 | middle << 4 | buffer >> 4, 16);
+            }
+            break;
+        }
+    }
+}
+
+static void readTag8_8SVB(int32_t *values, int valueCount)
+{
+    if (valueCount == 1) {
+        values[0] = readSignedVB();
+    } else {
+        uint8_t header = *readPos++;
+        for (int i = 0; i < valueCount; i++, header >>= 1) {
+            values[i] = (header & 0x01) ? readSignedVB() : 0;
+        }
+    }
+}
+
+static uint32_t randomState = 1;
+
+static uint32_t randomValue(void)
+{
+    randomState = randomState * 1664525 + 1013904223;
+    return randomState;
+}
+
+// Mostly small values with every size up to 32 bits showing up
+static int32_t randomField(void)
+{
+    const int shift = randomValue() % 33;
+    return shift == 32 ? 0 : (int32_t)randomValue() >> shift;
+}
+
+static void expectSameBytes(void)
+{
+    ASSERT_EQ(referencePos, serialWritePos);
+    for (int i = 0; i < referencePos; i++) {
+        EXPECT_EQ(referenceBuffer[i], serialWriteBuffer[i]);
+    }
+}
+
+static void resetEncoders(void)
+{
+    serialTestResetBuffers();
+    referencePos = 0;
+    readPos = serialWriteBuffer;
+}
+
+TEST(BlackboxEncodingTest, TestUnsignedVBRoundTrip)
+{
+    const uint32_t edges[] = { 0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, 0xFFFFFFFF };
+    for (unsigned i = 0; i < ARRAYLEN(edges) + 10000; i++) {
+        const uint32_t value = i < ARRAYLEN(edges) ? edges[i] : (uint32_t)randomField();
+        resetEncoders();
+        blackboxWriteUnsignedVB(value);
+        referenceWriteUnsignedVB(value);
+        expectSameBytes();
+        EXPECT_EQ(value, readUnsignedVB());
+        EXPECT_EQ(serialWritePos, readPos - serialWriteBuffer);
+
+        resetEncoders();
+        blackboxWriteSignedVB(value);
+        referenceWriteSignedVB(value);
+        expectSameBytes();
+        EXPECT_EQ((int32_t)value, readSignedVB());
+    }
+}
+
+TEST(BlackboxEncodingTest, TestTag2_3S32RoundTrip)
+{
+    const int32_t edges[] = { 0, 1, -2, 2, 7, -8, 8, 31, -32, 32, 127, -128, 128, 32767, -32768, 32768, 8388607, -8388608, 8388608, INT32_MAX, INT32_MIN };
+    for (int i = 0; i < 30000; i++) {
+        int32_t values[3];
+        for (int x = 0; x < 3; x++) {
+            values[x] = i < 3 * (int)ARRAYLEN(edges) ? edges[(i + x * 7) % ARRAYLEN(edges)] : randomField();
+        }
+        resetEncoders();
+        blackboxWriteTag2_3S32(values);
+        referenceWriteTag2_3S32(values);
+        expectSameBytes();
+
+        int32_t decoded[3];
+        readTag2_3S32(decoded);
+        EXPECT_EQ(serialWritePos, readPos - serialWriteBuffer);
+        for (int x = 0; x < 3; x++) {
+            EXPECT_EQ(values[x], decoded[x]);
+        }
+    }
+}
+
+TEST(BlackboxEncodingTest, TestTag8_4S16RoundTrip)
+{
+    for (int i = 0; i < 30000; i++) {
+        // the fields are 16 bits at most
+        int32_t values[4];
+        for (int x = 0; x < 4; x++) {
+            values[x] = (int16_t)randomField();
+        }
+        resetEncoders();
+        blackboxWriteTag8_4S16(values);
+        referenceWriteTag8_4S16(values);
+        expectSameBytes();
+
+        int32_t decoded[4];
+        readTag8_4S16(decoded);
+        EXPECT_EQ(serialWritePos, readPos - serialWriteBuffer);
+        for (int x = 0; x < 4; x++) {
+            EXPECT_EQ(values[x], decoded[x]);
+        }
+    }
+}
+
+TEST(BlackboxEncodingTest, TestTag8_8SVBRoundTrip)
+{
+    for (int i = 0; i < 30000; i++) {
+        const int valueCount = 1 + i % 8;
+        int32_t values[8];
+        for (int x = 0; x < valueCount; x++) {
+            values[x] = randomField();
+        }
+        resetEncoders();
+        blackboxWriteTag8_8SVB(values, valueCount);
+        referenceWriteTag8_8SVB(values, valueCount);
+        expectSameBytes();
+
+        int32_t decoded[8];
+        readTag8_8SVB(decoded, valueCount);
+        EXPECT_EQ(serialWritePos, readPos - serialWriteBuffer);
+        for (int x = 0; x < valueCount; x++) {
+            EXPECT_EQ(values[x], decoded[x]);
+        }
+    }
+}
+
+/*
+ * A main state history like the one of a quad in flight at 8kHz: noisy gyro and D, slowly moving P, I, setpoint and
+ * stick inputs and motors following the PID sum. P frames of it are encoded the way writeInterframe() does.
+ */
+#define HISTORY_LENGTH 4096
+
+typedef struct historyState_s {
+    int32_t pidP[3], pidI[3], pidD[3], pidF[3];
+    int32_t rcCommand[4], setpoint[4];
+    int32_t vbat, rssi;
+    int32_t gyro[3], acc[3], debug[4], motor[4];
+} historyState_t;
+
+static historyState_t history[HISTORY_LENGTH];
+
+static void recordHistory(void)
+{
+    for (int i = 0; i < HISTORY_LENGTH; i++) {
+        historyState_t *state = &history[i];
+        const float t = i / 8000.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            const float stick = 300 * sinf(2 * M_PIf * (0.7f + axis * 0.3f) * t);
+            const float noise = (int32_t)(randomValue() % 41) - 20;
+            const float vibration = 25 * sinf(2 * M_PIf * (180 + axis * 13) * t);
+            state->setpoint[axis] = lrintf(stick);
+            state->rcCommand[axis] = lrintf(stick / 2);
+            state->gyro[axis] = lrintf(stick * 0.95f + vibration + noise);
+            state->acc[axis] = lrintf(2048 * (axis == 2) + vibration * 3 + noise);
+            state->pidP[axis] = lrintf((stick - state->gyro[axis]) * 0.4f);
+            state->pidI[axis] = lrintf(20 * sinf(2 * M_PIf * 0.2f * t + axis));
+            state->pidD[axis] = lrintf((vibration + noise) * 1.5f);
+            state->pidF[axis] = lrintf(stick * 0.1f);
+        }
+        state->rcCommand[3] = 1400 + i / 64;
+        state->setpoint[3] = 400 + i / 64;
+        for (int x = 0; x < 4; x++) {
+            state->debug[x] = state->gyro[x % 3] / 2;
+            state->motor[x] = 1200 + state->pidP[x % 3] + state->pidD[(x + 1) % 3] + (i / 64);
+        }
+        state->vbat = 1600 - i / 1024;
+        state->rssi = 900;
+    }
+}
+
+static void deltas(int32_t *delta, const int32_t *current, const int32_t *previous, int count)
+{
+    for (int i = 0; i < count; i++) {
+        delta[i] = current[i] - previous[i];
+    }
+}
+
+static void averagePredictor(int32_t *delta, const int32_t *current, const int32_t *previous, const int32_t *previous2, int count)
+{
+    for (int i = 0; i < count; i++) {
+        delta[i] = current[i] - (previous[i] + previous2[i]) / 2;
+    }
+}
+
+static void writeHistoryFrame(int frame, bool reference)
+{
+    const historyState_t *current = &history[frame % HISTORY_LENGTH];
+    const historyState_t *previous = &history[(frame + HISTORY_LENGTH - 1) % HISTORY_LENGTH];
+    const historyState_t *previous2 = &history[(frame + HISTORY_LENGTH - 2) % HISTORY_LENGTH];
+    int32_t delta[8];
+
+    void (*writeSignedVB)(int32_t) = reference ? referenceWriteSignedVB : blackboxWriteSignedVB;
+    void (*writeSignedVBArray)(int32_t *, int) = reference ? referenceWriteSignedVBArray : blackboxWriteSignedVBArray;
+    void (*writeTag2_3S32)(int32_t *) = reference ? referenceWriteTag2_3S32 : blackboxWriteTag2_3S32;
+    void (*writeTag8_4S16)(int32_t *) = reference ? referenceWriteTag8_4S16 : blackboxWriteTag8_4S16;
+    void (*writeTag8_8SVB)(int32_t *, int) = reference ? referenceWriteTag8_8SVB : blackboxWriteTag8_8SVB;
+
+    writeSignedVB(frame & 1);
+    deltas(delta, current->pidP, previous->pidP, 3);
+    writeSignedVBArray(delta, 3);
+    deltas(delta, current->pidI, previous->pidI, 3);
+    writeTag2_3S32(delta);
+    deltas(delta, current->pidD, previous->pidD, 3);
+    writeTag8_8SVB(delta, 3);
+    deltas(delta, current->pidF, previous->pidF, 3);
+    writeSignedVBArray(delta, 3);
+    deltas(delta, current->rcCommand, previous->rcCommand, 4);
+    writeTag8_4S16(delta);
+    deltas(delta, current->setpoint, previous->setpoint, 4);
+    writeTag8_4S16(delta);
+    delta[0] = current->vbat - previous->vbat;
+    delta[1] = current->rssi - previous->rssi;
+    writeTag8_8SVB(delta, 2);
+    averagePredictor(delta, current->gyro, previous->gyro, previous2->gyro, 3);
+    writeSignedVBArray(delta, 3);
+    averagePredictor(delta, current->acc, previous->acc, previous2->acc, 3);
+    writeSignedVBArray(delta, 3);
+    averagePredictor(delta, current->debug, previous->debug, previous2->debug, 4);
+    writeSignedVBArray(delta, 4);
+    averagePredictor(delta, current->motor, previous->motor, previous2->motor, 4);
+    writeSignedVBArray(delta, 4);
+}
+
+TEST(BlackboxEncodingTest, BenchmarkHistoryReplay)
+{
+    static const int BENCHMARK_FRAMES = 400000;
+
+    recordHistory();
+
+    // both encoders must agree on the whole history before their speed means anything
+    for (int frame = 2; frame < HISTORY_LENGTH; frame++) {
+        resetEncoders();
+        writeHistoryFrame(frame, false);
+        writeHistoryFrame(frame, true);
+        expectSameBytes();
+    }
+
+    benchmarkSink = true;
+    sinkReset();
+    clock_t start = clock();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        writeHistoryFrame(frame, true);
+    }
+    const double referenceTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    const uint32_t referenceBytes = sinkBytes + sinkLength;
+
+    sinkReset();
+    start = clock();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        writeHistoryFrame(frame, false);
+    }
+    const double time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    const uint32_t bytes = sinkBytes + sinkLength;
+    benchmarkSink = false;
+
+    EXPECT_EQ(referenceBytes, bytes);
+    printf("history replay, %.1f bytes per frame\n", (double)bytes / BENCHMARK_FRAMES);
+    printf("  byte at a time encoders: %.1f MB/s\n", referenceBytes / referenceTime / 1e6);
+    printf("  word at a time encoders: %.1f MB/s\n", bytes / time / 1e6);
+}
+
 // STUBS
 extern "C" {
 PG_REGISTER(blackboxConfig_t, blackboxConfig, PG_BLACKBOX_CONFIG, 0);
 int32_t blackboxHeaderBudget;
 void mspSerialAllocatePorts(void) {}
-void blackboxWrite(uint8_t value) {serialWrite(blackboxPort, value);}
+void blackboxWrite(uint8_t value)
+{
+    if (benchmarkSink) {
+        sinkWrite(value);
+        return;
+    }
+    serialWrite(blackboxPort, value);
+}
+void blackboxWriteWord(uint64_t word, int length)
+{
+    if (benchmarkSink) {
+        sinkWriteWord(word, length);
+        return;
+    }
+    for (; length > 0; length--, word >>= 8) {
+        serialWrite(blackboxPort, word);
+    }
+}
 int blackboxWriteString(const char *s)
 {
     const uint8_t *pos = (uint8_t*)s;
@@ -0,0 +1,291 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "blackbox/blackbox_ring.h"
+
+    #include "common/maths.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define RING_SIZE       4096
+#define I_INTERVAL      8       // iterations per I-frame
+#define LOOPTIME_US     1000
+
+// Frames are a type byte, the iteration and some padding, so the reader can tell what it got
+enum {
+    FRAME_I = 'I',
+    FRAME_P = 'P',
+    FRAME_RESUME = 'E'
+};
+
+static int frameLength(uint8_t type)
+{
+    switch (type) {
+    case FRAME_I:
+        return 24;
+    case FRAME_P:
+        return 10;
+    default:
+        return 5;
+    }
+}
+
+class BlackboxRingTest : public ::testing::Test {
+protected:
+    uint8_t buffer[RING_SIZE];
+    blackboxRing_t ring;
+    uint32_t iteration;
+    std::vector<uint8_t> device;
+
+    void SetUp() override
+    {
+        blackboxRingInit(&ring, buffer, sizeof(buffer));
+        iteration = 0;
+        device.clear();
+    }
+
+    timeUs_t timeOf(uint32_t i)
+    {
+        return i * LOOPTIME_US;
+    }
+
+    void writeFrame(uint8_t type)
+    {
+        uint8_t frame[32] = { 0 };
+        frame[0] = type;
+        memcpy(&frame[1], &iteration, sizeof(iteration));
+        blackboxRingWrite(&ring, frame, frameLength(type));
+    }
+
+    // Like blackboxLogIteration()
+    void logIteration(void)
+    {
+        if (iteration % I_INTERVAL == 0) {
+            if (blackboxRingKeyframe(&ring, timeOf(iteration))) {
+                writeFrame(FRAME_RESUME);
+            }
+            writeFrame(FRAME_I);
+        } else {
+            writeFrame(FRAME_P);
+        }
+        iteration++;
+    }
+
+    void drain(uint32_t budget)
+    {
+        const uint8_t *data;
+        uint32_t length;
+        while (budget > 0 && (length = blackboxRingPeek(&ring, &data)) > 0) {
+            length = MIN(length, budget);
+            device.insert(device.end(), data, data + length);
+            blackboxRingConsume(&ring, length);
+            budget -= length;
+        }
+    }
+
+    void run(int iterations, uint32_t drainPerIteration)
+    {
+        for (int i = 0; i < iterations; i++) {
+            logIteration();
+            drain(drainPerIteration);
+        }
+    }
+
+    // The iterations of the main frames the device got, checking that a decoder could follow every one of them
+    std::vector<uint32_t> decode(void)
+    {
+        std::vector<uint32_t> iterations;
+        bool synced = false;
+        bool resumed = false;
+        uint32_t expected = 0;
+
+        for (size_t pos = 0; pos < device.size();) {
+            const uint8_t type = device[pos];
+            uint32_t frameIteration;
+            EXPECT_TRUE(type == FRAME_I || type == FRAME_P || type == FRAME_RESUME) << "at " << pos;
+            EXPECT_LE(pos + frameLength(type), device.size());
+            memcpy(&frameIteration, &device[pos + 1], sizeof(frameIteration));
+            pos += frameLength(type);
+
+            if (type == FRAME_RESUME) {
+                resumed = true;
+                expected = frameIteration;
+                continue;
+            }
+            if (resumed) {
+                EXPECT_EQ(FRAME_I, type);
+                synced = true;
+                resumed = false;
+            }
+            EXPECT_TRUE(synced);
+            EXPECT_EQ(expected, frameIteration);
+            expected = frameIteration + 1;
+            iterations.push_back(frameIteration);
+        }
+        return iterations;
+    }
+};
+
+TEST_F(BlackboxRingTest, NothingIsReadUntilCommitted)
+{
+    run(1000, RING_SIZE);
+
+    EXPECT_EQ(0u, blackboxRingPending(&ring));
+    EXPECT_TRUE(device.empty());
+}
+
+TEST_F(BlackboxRingTest, CaptureStartsAtTheFirstIFrameOfTheWindow)
+{
+    run(1000, RING_SIZE);
+
+    // Plenty of history is held, the capture starts at the I-frame of iteration 968
+    blackboxRingCommit(&ring, timeOf(iteration - 35));
+    EXPECT_TRUE(blackboxRingIsLive(&ring));
+    run(100, RING_SIZE);
+    blackboxRingRelease(&ring);
+    run(100, RING_SIZE);
+
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_FALSE(iterations.empty());
+    EXPECT_EQ(968u, iterations.front());
+    EXPECT_EQ(1099u, iterations.back());
+    EXPECT_EQ(0u, blackboxRingPending(&ring));
+    EXPECT_EQ(0u, ring.droppedBytes);
+}
+
+TEST_F(BlackboxRingTest, WindowLongerThanTheRingStartsAtTheOldestHeldIFrame)
+{
+    run(1000, RING_SIZE);
+
+    blackboxRingCommit(&ring, 0);
+    run(10, RING_SIZE);
+    blackboxRingRelease(&ring);
+    drain(RING_SIZE);
+
+    // An I-frame every 8 iterations takes 24 + 5 + 7 * 10 bytes, the ring holds about 41 of them
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_FALSE(iterations.empty());
+    EXPECT_EQ(0u, iterations.front() % I_INTERVAL);
+    EXPECT_GE(iterations.front(), 1000u - RING_SIZE / 99 * I_INTERVAL);
+    EXPECT_EQ(1009u, iterations.back());
+}
+
+TEST_F(BlackboxRingTest, CaptureWithoutHistoryStartsAtTheNextIFrame)
+{
+    run(1003, RING_SIZE);
+
+    blackboxRingCommit(&ring, timeOf(iteration) + 1);
+    run(20, RING_SIZE);
+
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_FALSE(iterations.empty());
+    EXPECT_EQ(1008u, iterations.front());
+    EXPECT_EQ(1022u, iterations.back());
+}
+
+TEST_F(BlackboxRingTest, SlowDeviceDropsUpToTheNextIFrame)
+{
+    run(1000, RING_SIZE);
+
+    // Takes less than the frames need, committed history is never overwritten so new frames get dropped
+    blackboxRingCommit(&ring, 0);
+    run(2000, 8);
+    blackboxRingRelease(&ring);
+    while (blackboxRingPending(&ring)) {
+        drain(8);
+    }
+
+    EXPECT_GT(ring.droppedBytes, 0u);
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_FALSE(iterations.empty());
+    EXPECT_GT(iterations.back(), 1000u);
+    EXPECT_LT(iterations.size(), 3000u - iterations.front());
+}
+
+TEST_F(BlackboxRingTest, WriteAfterADropCanStillGetThrough)
+{
+    run(1000, RING_SIZE);
+
+    // The device took nothing for a while, the ring is full and drops frames
+    blackboxRingCommit(&ring, 0);
+    run(100, 0);
+    drain(RING_SIZE);
+    EXPECT_GT(ring.droppedBytes, 0u);
+
+    // Like the end of the log
+    blackboxRingStopDropping(&ring);
+    writeFrame(FRAME_RESUME);
+    blackboxRingRelease(&ring);
+    drain(RING_SIZE);
+
+    ASSERT_GE(device.size(), (size_t)frameLength(FRAME_RESUME));
+    EXPECT_EQ(FRAME_RESUME, device[device.size() - frameLength(FRAME_RESUME)]);
+}
+
+TEST_F(BlackboxRingTest, TriggersCloseTogetherMakeOneCapture)
+{
+    run(1000, RING_SIZE);
+
+    blackboxRingCommit(&ring, timeOf(iteration - 20));
+    run(30, 0);
+    blackboxRingRelease(&ring);
+    run(50, 4);
+    // Part of the last capture is still in the ring
+    EXPECT_GT(blackboxRingPending(&ring), 0u);
+    blackboxRingCommit(&ring, timeOf(iteration - 20));
+    run(30, RING_SIZE);
+    blackboxRingRelease(&ring);
+    run(10, RING_SIZE);
+
+    // Nothing in between was left out, and nothing got dropped
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_FALSE(iterations.empty());
+    EXPECT_EQ(984u, iterations.front());
+    EXPECT_EQ(1109u, iterations.back());
+    EXPECT_EQ(1109u - 984u + 1, iterations.size());
+    EXPECT_EQ(0u, ring.droppedBytes);
+}
+
+TEST_F(BlackboxRingTest, TriggersFarApartMakeTwoCaptures)
+{
+    run(1000, RING_SIZE);
+
+    blackboxRingCommit(&ring, timeOf(iteration - 10));
+    run(20, RING_SIZE);
+    blackboxRingRelease(&ring);
+    run(1000, RING_SIZE);
+    blackboxRingCommit(&ring, timeOf(iteration - 10));
+    run(20, RING_SIZE);
+    blackboxRingRelease(&ring);
+
+    // The decoder is told about the jump from the first capture to the second
+    const std::vector<uint32_t> iterations = decode();
+    ASSERT_EQ(28u + 24u, iterations.size());
+    EXPECT_EQ(992u, iterations[0]);
+    EXPECT_EQ(1019u, iterations[27]);
+    EXPECT_EQ(2016u, iterations[28]);
+    EXPECT_EQ(2039u, iterations.back());
+}
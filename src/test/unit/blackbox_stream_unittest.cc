@@ -0,0 +1,189 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "blackbox/blackbox_stream.h"
+
+    #include "common/maths.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+static bool transportConnected;
+static uint32_t transportFree;
+static int refuseChunk;     // sequence number the transport won't take, -1 for none
+static uint32_t currentTimeMs;
+
+static std::vector<blackboxStreamHeader_t> chunks;
+static std::vector<uint8_t> received;
+
+static void resetTransport(void)
+{
+    transportConnected = true;
+    transportFree = 1024 * 1024;
+    refuseChunk = -1;
+    chunks.clear();
+    received.clear();
+}
+
+static std::vector<uint8_t> makeLog(int length)
+{
+    std::vector<uint8_t> log(length);
+    for (int i = 0; i < length; i++) {
+        log[i] = i * 7 + (i >> 8);
+    }
+    return log;
+}
+
+// Written in frames of varying length, like blackbox_io does
+static void writeLog(const std::vector<uint8_t> &log)
+{
+    for (int pos = 0, frame = 1; pos < (int)log.size(); frame = frame % 97 + 13) {
+        const int length = MIN(frame, (int)log.size() - pos);
+        blackboxStreamWrite(&log[pos], length);
+        pos += length;
+    }
+}
+
+TEST(BlackboxStreamTest, ChunksReassembleToTheLog)
+{
+    resetTransport();
+    const std::vector<uint8_t> log = makeLog(2 * BLACKBOX_STREAM_CHUNK_SIZE + 1000);
+
+    EXPECT_TRUE(blackboxStreamOpen());
+    blackboxStreamBeginLog();
+    writeLog(log);
+    blackboxStreamEndLog();
+
+    ASSERT_EQ(3u, chunks.size());
+    for (unsigned i = 0; i < chunks.size(); i++) {
+        EXPECT_EQ((uint32_t)BLACKBOX_STREAM_MAGIC, chunks[i].magic);
+        EXPECT_EQ(i, chunks[i].sequence);
+        EXPECT_EQ(0u, chunks[i].droppedBytes);
+    }
+    EXPECT_EQ(BLACKBOX_STREAM_CHUNK_SIZE, chunks[0].length);
+    EXPECT_EQ(BLACKBOX_STREAM_FLAG_LOG_START, chunks[0].flags);
+    EXPECT_EQ(0, chunks[1].flags);
+    EXPECT_EQ(1000, chunks[2].length);
+    EXPECT_EQ(BLACKBOX_STREAM_FLAG_LOG_END, chunks[2].flags);
+    EXPECT_TRUE(received == log);
+}
+
+TEST(BlackboxStreamTest, DroppedChunkIsAccountedFor)
+{
+    resetTransport();
+    refuseChunk = 1;
+    const std::vector<uint8_t> log = makeLog(3 * BLACKBOX_STREAM_CHUNK_SIZE);
+
+    blackboxStreamOpen();
+    blackboxStreamBeginLog();
+    writeLog(log);
+    blackboxStreamEndLog();
+
+    // The reader sees the hole in the sequence and how many bytes went missing
+    ASSERT_EQ(3u, chunks.size());
+    EXPECT_EQ(0u, chunks[0].sequence);
+    EXPECT_EQ(2u, chunks[1].sequence);
+    EXPECT_EQ((uint32_t)BLACKBOX_STREAM_CHUNK_SIZE, chunks[1].droppedBytes);
+    EXPECT_EQ(3u, chunks[2].sequence);
+    EXPECT_EQ(0, chunks[2].length);
+    EXPECT_EQ((uint32_t)BLACKBOX_STREAM_CHUNK_SIZE, blackboxStreamDroppedBytes());
+
+    // A new stream starts counting over
+    blackboxStreamOpen();
+    EXPECT_EQ(0u, blackboxStreamDroppedBytes());
+}
+
+TEST(BlackboxStreamTest, PartialChunkWaitsForLatency)
+{
+    resetTransport();
+    const std::vector<uint8_t> log = makeLog(100);
+
+    blackboxStreamOpen();
+    currentTimeMs = 1000;
+    blackboxStreamWrite(&log[0], log.size());
+
+    currentTimeMs += BLACKBOX_STREAM_MAX_LATENCY_MS - 1;
+    blackboxStreamFlush(false);
+    EXPECT_EQ(0u, chunks.size());
+
+    currentTimeMs += 1;
+    blackboxStreamFlush(false);
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_EQ(100, chunks[0].length);
+
+    // Nothing to send
+    blackboxStreamFlush(true);
+    EXPECT_EQ(1u, chunks.size());
+}
+
+TEST(BlackboxStreamTest, NoRoomWhileTheTransportIsBehind)
+{
+    resetTransport();
+    const std::vector<uint8_t> log = makeLog(100);
+
+    blackboxStreamOpen();
+    blackboxStreamWrite(&log[0], log.size());
+    EXPECT_EQ((int32_t)(transportFree - sizeof(blackboxStreamHeader_t) - 100), blackboxStreamTxBytesFree());
+
+    transportFree = sizeof(blackboxStreamHeader_t) + BLACKBOX_STREAM_CHUNK_SIZE - 1;
+    EXPECT_EQ(0, blackboxStreamTxBytesFree());
+
+    transportConnected = false;
+    EXPECT_FALSE(blackboxStreamOpen());
+}
+
+// STUBS
+
+extern "C" {
+
+uint32_t millis(void) { return currentTimeMs; }
+
+void blackboxStreamTransportInit(void) {}
+
+bool blackboxStreamTransportIsConnected(void)
+{
+    return transportConnected;
+}
+
+uint32_t blackboxStreamTransportTxBytesFree(void)
+{
+    return transportFree;
+}
+
+bool blackboxStreamTransportSend(const uint8_t *data, int length)
+{
+    blackboxStreamHeader_t header;
+    memcpy(&header, data, sizeof(header));
+    EXPECT_EQ((int)(sizeof(header) + header.length), length);
+
+    if ((int)header.sequence == refuseChunk) {
+        return false;
+    }
+    chunks.push_back(header);
+    received.insert(received.end(), data + sizeof(header), data + length);
+    return true;
+}
+
+}
@@ -15,12 +15,18 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 extern "C" {
     #include "platform.h"
 
     #include "blackbox/blackbox.h"
+    #include "blackbox/blackbox_compress.h"
+    #include "blackbox/blackbox_encoding.h"
+    #include "blackbox/blackbox_fielddefs.h"
+    #include "blackbox/blackbox_io.h"
     #include "common/utils.h"
 
     #include "pg/pg.h"
@@ -39,6 +45,7 @@ extern "C" {
     #include "fc/rc_controls.h"
     #include "fc/rc_modes.h"
 
+    #include "io/beeper.h"
     #include "io/gps.h"
     #include "io/serial.h"
 
@@ -49,6 +56,9 @@ extern "C" {
 
     extern int16_t blackboxIInterval;
     extern int16_t blackboxPInterval;
+
+    FlightLogFieldGroup blackboxMainFieldGroup(int fieldIndex);
+    bool blackboxShouldLogFieldGroupFrame(FlightLogFieldGroup group, bool intraframe);
 }
 
 #include "unittest_macros.h"
@@ -347,6 +357,223 @@ TEST(BlackboxTest, Test_CalculateRates)
 
 }
 
+TEST(BlackboxTest, TestPredictorConfig)
+{
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2, blackboxFieldPredictor(BLACKBOX_PREDICTOR_AVERAGE));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE, blackboxFieldPredictor(BLACKBOX_PREDICTOR_STRAIGHT_LINE));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_SECOND_ORDER, blackboxFieldPredictor(BLACKBOX_PREDICTOR_SECOND_ORDER));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0, blackboxFieldPredictor(BLACKBOX_PREDICTOR_MOTOR_0));
+
+    // the gyro can't be predicted from motor[0]
+    blackboxConfigMutable()->gyro_predictor = BLACKBOX_PREDICTOR_MOTOR_0;
+    blackboxConfigMutable()->motor_predictor = BLACKBOX_PREDICTOR_MOTOR_0;
+    blackboxValidateConfig();
+    EXPECT_EQ(BLACKBOX_PREDICTOR_AVERAGE, blackboxConfig()->gyro_predictor);
+    EXPECT_EQ(BLACKBOX_PREDICTOR_MOTOR_0, blackboxConfig()->motor_predictor);
+
+    blackboxConfigMutable()->gyro_predictor = BLACKBOX_PREDICTOR_SECOND_ORDER;
+    blackboxConfigMutable()->motor_predictor = BLACKBOX_PREDICTOR_COUNT;
+    blackboxValidateConfig();
+    EXPECT_EQ(BLACKBOX_PREDICTOR_SECOND_ORDER, blackboxConfig()->gyro_predictor);
+    EXPECT_EQ(BLACKBOX_PREDICTOR_AVERAGE, blackboxConfig()->motor_predictor);
+
+    // fields outside of the configurable groups keep the predictor of the field table, loopIteration and time come first
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_INC, blackboxMainFieldPPredictor(0));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE, blackboxMainFieldPPredictor(1));
+
+    blackboxConfigMutable()->gyro_predictor = BLACKBOX_PREDICTOR_AVERAGE;
+    blackboxConfigMutable()->motor_predictor = BLACKBOX_PREDICTOR_AVERAGE;
+}
+
+TEST(BlackboxTest, TestFieldGroups)
+{
+    blackboxConfigMutable()->p_ratio = 32;
+    blackboxConfigMutable()->pid_ratio = 4;
+    blackboxConfigMutable()->rc_ratio = 1;
+
+    // loopIteration, time, axisP[0], ... rcCommand[0] is the 15th field
+    EXPECT_EQ(FLIGHT_LOG_FIELD_GROUP_MAIN, blackboxMainFieldGroup(1));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_GROUP_PID, blackboxMainFieldGroup(2));
+    EXPECT_EQ(FLIGHT_LOG_FIELD_GROUP_MAIN, blackboxMainFieldGroup(14));
+
+    // A group frame with every I-frame and every 4th P-frame after it
+    EXPECT_TRUE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, true));
+    for (int frame = 1; frame <= 12; frame++) {
+        EXPECT_EQ(frame % 4 == 0, blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, false));
+    }
+    EXPECT_FALSE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, false));
+    EXPECT_TRUE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, true));
+    EXPECT_FALSE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, false));
+
+    // Groups in the main frames have none of their own
+    EXPECT_FALSE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_RC, true));
+    EXPECT_FALSE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_RC, false));
+
+    // Nor when only I-frames are logged
+    blackboxConfigMutable()->p_ratio = 0;
+    EXPECT_EQ(FLIGHT_LOG_FIELD_GROUP_MAIN, blackboxMainFieldGroup(2));
+    EXPECT_FALSE(blackboxShouldLogFieldGroupFrame(FLIGHT_LOG_FIELD_GROUP_PID, true));
+
+    blackboxConfigMutable()->pid_ratio = 0;
+    blackboxValidateConfig();
+    EXPECT_EQ(1, blackboxConfig()->pid_ratio);
+
+    blackboxConfigMutable()->p_ratio = 32;
+}
+
+static uint8_t serialBuffer[4096];
+static int serialBufferLength;
+static int serialWriteCount;
+
+static void resetSerialBuffer(void)
+{
+    serialBufferLength = 0;
+    serialWriteCount = 0;
+}
+
+static void openSerialDevice(void)
+{
+    blackboxConfigMutable()->device = BLACKBOX_DEVICE_SERIAL;
+    targetPidLooptime = 125;
+    EXPECT_TRUE(blackboxDeviceOpen());
+    resetSerialBuffer();
+}
+
+TEST(BlackboxTest, TestFrameWrittenInOnePiece)
+{
+    openSerialDevice();
+
+    blackboxFrameBegin();
+    blackboxWrite('P');
+    blackboxWriteUnsignedVB(300);
+    blackboxWriteString("ab");
+    EXPECT_EQ(0, serialWriteCount);
+    blackboxFrameEnd();
+
+    EXPECT_EQ(1, serialWriteCount);
+    ASSERT_EQ(5, serialBufferLength);
+    EXPECT_EQ('P', serialBuffer[0]);
+    EXPECT_EQ(0xac, serialBuffer[1]);
+    EXPECT_EQ(0x02, serialBuffer[2]);
+    EXPECT_EQ('a', serialBuffer[3]);
+    EXPECT_EQ('b', serialBuffer[4]);
+
+    // outside of a frame bytes go straight to the device
+    resetSerialBuffer();
+    blackboxWrite('E');
+    EXPECT_EQ(1, serialWriteCount);
+    EXPECT_EQ(1, serialBufferLength);
+}
+
+TEST(BlackboxTest, TestFrameLargerThanBuffer)
+{
+    openSerialDevice();
+
+    blackboxFrameBegin();
+    for (int i = 0; i < BLACKBOX_FRAME_BUFFER_SIZE * 2 + 10; i++) {
+        blackboxWrite(i);
+    }
+    blackboxFrameEnd();
+
+    EXPECT_EQ(3, serialWriteCount);
+    ASSERT_EQ(BLACKBOX_FRAME_BUFFER_SIZE * 2 + 10, serialBufferLength);
+    for (int i = 0; i < serialBufferLength; i++) {
+        EXPECT_EQ(i & 0xff, serialBuffer[i]);
+    }
+}
+
+#define FLASH_WRITE_BUFFER_SIZE 256
+
+static int flashBuffered;
+static int flashBytesWritten;
+static int flashBytesDropped;
+
+TEST(BlackboxTest, TestHeaderBudgetLeavesRoomForCompression)
+{
+    blackboxConfigMutable()->device = BLACKBOX_DEVICE_FLASH;
+    blackboxConfigMutable()->compression = BLACKBOX_COMPRESSION_HUFFMAN;
+    targetPidLooptime = 125;
+    EXPECT_TRUE(blackboxDeviceOpen());
+    flashBuffered = flashBytesWritten = flashBytesDropped = 0;
+    blackboxHeaderBudget = 0;
+
+    // Header bytes with the longest code there is, written as fast as the budget allows while the flash takes a
+    // little at a time
+    int headerBytes = 0;
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        blackboxReplenishHeaderBudget();
+        while (blackboxDeviceReserveBufferSpace(1) == BLACKBOX_RESERVE_SUCCESS) {
+            blackboxWrite(0xF9);
+            blackboxHeaderBudget--;
+            headerBytes++;
+        }
+        flashBuffered -= MIN(flashBuffered, 32);
+    }
+
+    EXPECT_GT(headerBytes, 10000);
+    EXPECT_GT(flashBytesWritten, headerBytes);
+    EXPECT_EQ(0, flashBytesDropped);
+
+    blackboxConfigMutable()->compression = BLACKBOX_COMPRESSION_NONE;
+}
+
+// Roughly the fields of a P frame at 8kHz: small deltas with the occasional larger one
+static void writeBenchmarkFrame(int frame)
+{
+    int32_t values[8];
+    for (int i = 0; i < 8; i++) {
+        values[i] = ((frame * 7 + i * 13) % 41) - 20;
+    }
+
+    blackboxWrite('P');
+    blackboxWriteSignedVB(frame & 1 ? 3 : -2);
+    blackboxWriteSignedVBArray(values, 3);
+    blackboxWriteSignedVBArray(values + 3, 3);
+    blackboxWriteTag8_8SVB(values, 8);
+    blackboxWriteTag2_3S32(values);
+    blackboxWriteTag8_4S16(values + 4);
+    blackboxWriteSignedVBArray(values, 8);
+    blackboxWriteSignedVB(frame % 1000 - 500);
+}
+
+TEST(BlackboxTest, BenchmarkEncoder)
+{
+    static const int BENCHMARK_FRAMES = 200000;
+
+    openSerialDevice();
+
+    // the stub device is only a memcpy, so this is the cost of the encoder itself, on the target every
+    // device write additionally costs a driver call
+    int bytes = 0;
+    int writes = 0;
+    clock_t start = clock();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        writeBenchmarkFrame(frame);
+        bytes += serialBufferLength;
+        writes += serialWriteCount;
+        resetSerialBuffer();
+    }
+    const double byteTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    int frameBytes = 0;
+    int frameWrites = 0;
+    start = clock();
+    for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        blackboxFrameBegin();
+        writeBenchmarkFrame(frame);
+        blackboxFrameEnd();
+        frameBytes += serialBufferLength;
+        frameWrites += serialWriteCount;
+        resetSerialBuffer();
+    }
+    const double frameTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    EXPECT_EQ(bytes, frameBytes);
+    EXPECT_EQ(BENCHMARK_FRAMES, frameWrites);
+    printf("encoder, %.1f bytes per frame\n", (double)bytes / BENCHMARK_FRAMES);
+    printf("  unbuffered: %.1f MB/s, %.1f device writes per frame\n", bytes / byteTime / 1e6, (double)writes / BENCHMARK_FRAMES);
+    printf("  buffered:   %.1f MB/s, %.1f device writes per frame\n", frameBytes / frameTime / 1e6, (double)frameWrites / BENCHMARK_FRAMES);
+}
 
 // STUBS
 extern "C" {
@@ -386,18 +613,54 @@ bool IS_RC_MODE_ACTIVE(boxId_e) {return false;}
 bool isModeActivationConditionPresent(boxId_e) {return false;}
 uint32_t millis(void) {return 0;}
 bool sensors(uint32_t) {return false;}
-void serialWrite(serialPort_t *, uint8_t) {}
+void serialWrite(serialPort_t *, uint8_t ch)
+{
+    if (serialBufferLength < (int)sizeof(serialBuffer)) {
+        serialBuffer[serialBufferLength++] = ch;
+    }
+    serialWriteCount++;
+}
+void serialWriteBuf(serialPort_t *, const uint8_t *data, int count)
+{
+    for (int i = 0; i < count && serialBufferLength < (int)sizeof(serialBuffer); i++) {
+        serialBuffer[serialBufferLength++] = data[i];
+    }
+    serialWriteCount++;
+}
 uint32_t serialTxBytesFree(const serialPort_t *) {return 0;}
 bool isSerialTransmitBufferEmpty(const serialPort_t *) {return false;}
 bool featureIsEnabled(uint32_t) {return false;}
 void mspSerialReleasePortIfAllocated(serialPort_t *) {}
-serialPortConfig_t *findSerialPortConfig(serialPortFunction_e ) {return NULL;}
+static serialPortConfig_t blackboxPortConfig = { .functionMask = FUNCTION_BLACKBOX, .identifier = SERIAL_PORT_USART1, .msp_baudrateIndex = BAUD_115200, .gps_baudrateIndex = BAUD_115200, .blackbox_baudrateIndex = BAUD_115200, .telemetry_baudrateIndex = BAUD_115200 };
+static serialPort_t blackboxSerialPort;
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e ) {return &blackboxPortConfig;}
 serialPort_t *findSharedSerialPort(uint16_t , serialPortFunction_e ) {return NULL;}
-serialPort_t *openSerialPort(serialPortIdentifier_e, serialPortFunction_e, serialReceiveCallbackPtr, void *, uint32_t, portMode_e, portOptions_e) {return NULL;}
+serialPort_t *openSerialPort(serialPortIdentifier_e, serialPortFunction_e, serialReceiveCallbackPtr, void *, uint32_t, portMode_e, portOptions_e) {return &blackboxSerialPort;}
 void closeSerialPort(serialPort_t *) {}
 portSharing_e determinePortSharing(const serialPortConfig_t *, serialPortFunction_e ) {return PORTSHARING_UNUSED;}
 failsafePhase_e failsafePhase(void) {return FAILSAFE_IDLE;}
 bool rxAreFlightChannelsValid(void) {return false;}
+void flashfsWrite(const uint8_t *, unsigned int len, bool)
+{
+    // Like flashfs, what doesn't fit is thrown away
+    if (flashBuffered + (int)len > FLASH_WRITE_BUFFER_SIZE) {
+        flashBytesDropped += len;
+        return;
+    }
+    flashBuffered += len;
+    flashBytesWritten += len;
+}
+void flashfsWriteByte(uint8_t byte) {flashfsWrite(&byte, 1, false);}
+uint32_t flashfsGetWriteBufferFreeSpace(void) {return FLASH_WRITE_BUFFER_SIZE - flashBuffered;}
+uint32_t flashfsGetWriteBufferSize(void) {return FLASH_WRITE_BUFFER_SIZE;}
+bool flashfsFlushAsync(bool) {return flashBuffered == 0;}
+bool flashfsIsSupported(void) {return true;}
+bool flashfsIsReady(void) {return true;}
+bool flashfsIsEOF(void) {return false;}
+void flashfsEraseCompletely(void) {}
+void flashfsClose(void) {}
+bool flashfsBeginLog(void) {return true;}
+void beeper(beeperMode_e) {}
 bool rxIsReceivingSignal(void) {return false;}
 bool isRssiConfigured(void) {return false;}
 
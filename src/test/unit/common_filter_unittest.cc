@@ -23,6 +23,7 @@
 #include <math.h>
 
 extern "C" {
+    #include "common/axis.h"
     #include "common/filter.h"
 }
 
@@ -114,3 +115,100 @@ TEST(FilterUnittest, TestSlewFilter)
     slewFilterApply(&filter, 200.0f);
     EXPECT_EQ(200, filter.state);
 }
+
+static const int FILTER_TEST_SAMPLES = 1000;
+
+// a different signal on each axis
+static float filterTestSample(int i, int axis)
+{
+    return 500.0f * sinf(0.05f * i * (axis + 1)) + 100.0f * sinf(0.7f * i + axis) + ((i * 7919 + axis * 104729) % 101 - 50);
+}
+
+TEST(FilterUnittest, TestPt1FilterApply3)
+{
+    pt1Filter_t filters[XYZ_AXIS_COUNT];
+    pt1Filter3_t filter3;
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        pt1FilterInit(&filters[axis], pt1FilterGain(100.0f, 0.000125f));
+    }
+    pt1Filter3Init(&filter3, pt1FilterGain(100.0f, 0.000125f));
+
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        if (i == FILTER_TEST_SAMPLES / 2) {
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                pt1FilterUpdateCutoff(&filters[axis], pt1FilterGain(250.0f, 0.000125f));
+            }
+            pt1Filter3UpdateCutoff(&filter3, pt1FilterGain(250.0f, 0.000125f));
+        }
+        float values[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            values[axis] = filterTestSample(i, axis);
+        }
+        pt1FilterApply3(&filter3, values);
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            ASSERT_FLOAT_EQ(pt1FilterApply(&filters[axis], filterTestSample(i, axis)), values[axis]) << "sample " << i << " axis " << axis;
+        }
+    }
+}
+
+TEST(FilterUnittest, TestBiquadFilterApply3)
+{
+    biquadFilter_t filters[XYZ_AXIS_COUNT];
+    biquadFilter3_t filter3;
+    biquadFilter3Init(&filter3, 200.0f, 125, filterGetNotchQ(200.0f, 150.0f), FILTER_NOTCH);
+    // per axis coefficients
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        const float notchHz = 150.0f + 50.0f * axis;
+        biquadFilterInit(&filters[axis], notchHz, 125, filterGetNotchQ(notchHz, 100.0f), FILTER_NOTCH);
+        biquadFilter3UpdateAxis(&filter3, axis, notchHz, 125, filterGetNotchQ(notchHz, 100.0f), FILTER_NOTCH);
+    }
+
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        float values[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            values[axis] = filterTestSample(i, axis);
+        }
+        biquadFilterApply3(&filter3, values);
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            ASSERT_FLOAT_EQ(biquadFilterApply(&filters[axis], filterTestSample(i, axis)), values[axis]) << "sample " << i << " axis " << axis;
+        }
+    }
+}
+
+TEST(FilterUnittest, TestBiquadFilterApply3DF1)
+{
+    biquadFilter_t filters[XYZ_AXIS_COUNT];
+    biquadFilter3_t filter3;
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        biquadFilterInitLPF(&filters[axis], 100.0f, 125);
+    }
+    biquadFilter3InitLPF(&filter3, 100.0f, 125);
+
+    for (int i = 0; i < FILTER_TEST_SAMPLES; i++) {
+        // the coefficients change while running, as with the dynamic lowpass
+        if (i % 100 == 0) {
+            const float cutoffHz = 100.0f + i / 4;
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                biquadFilterUpdateLPF(&filters[axis], cutoffHz, 125);
+            }
+            biquadFilter3UpdateLPF(&filter3, cutoffHz, 125);
+        }
+        float values[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            values[axis] = filterTestSample(i, axis);
+        }
+        biquadFilterApply3DF1(&filter3, values);
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            ASSERT_FLOAT_EQ(biquadFilterApplyDF1(&filters[axis], filterTestSample(i, axis)), values[axis]) << "sample " << i << " axis " << axis;
+        }
+    }
+}
+
+TEST(FilterUnittest, TestNullFilterApply3)
+{
+    float values[XYZ_AXIS_COUNT] = { 1.0f, -2.0f, 3.0f };
+    nullFilterApply3(NULL, values);
+    EXPECT_EQ(1.0f, values[X]);
+    EXPECT_EQ(-2.0f, values[Y]);
+    EXPECT_EQ(3.0f, values[Z]);
+}
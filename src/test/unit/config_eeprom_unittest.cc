@@ -0,0 +1,220 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "config/config_eeprom.h"
+    #include "config/config_streamer.h"
+
+    #include "drivers/system.h"
+
+    #include "pg/pg.h"
+
+typedef struct smallConfig_s {
+    uint32_t value;
+} smallConfig_t;
+
+typedef struct largeConfig_s {
+    uint8_t values[200];
+} largeConfig_t;
+
+PG_DECLARE(smallConfig_t, smallConfig);
+PG_DECLARE(largeConfig_t, largeConfig);
+PG_DECLARE(smallConfig_t, otherConfig);
+
+PG_REGISTER_WITH_RESET_TEMPLATE(smallConfig_t, smallConfig, 1000, 0);
+PG_RESET_TEMPLATE(smallConfig_t, smallConfig,
+    .value = 7,
+);
+
+PG_REGISTER(largeConfig_t, largeConfig, 1001, 0);
+
+PG_REGISTER_WITH_RESET_TEMPLATE(smallConfig_t, otherConfig, 1002, 0);
+PG_RESET_TEMPLATE(smallConfig_t, otherConfig,
+    .value = 11,
+);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// The appended record of a small group: header, value and CRC, padded to the streamer word
+#define SMALL_RECORD_SIZE   ((6 + 4 + 2 + CONFIG_STREAMER_BUFFER_SIZE - 1) & ~(CONFIG_STREAMER_BUFFER_SIZE - 1))
+
+static int failures;
+
+class ConfigEepromTest : public ::testing::Test {
+protected:
+    uint8_t before[EEPROM_SIZE];
+
+    void SetUp() override
+    {
+        failures = 0;
+        memset(eepromData, 0, sizeof(eepromData));
+        pgResetAll();
+        // Nothing valid is stored, this compacts
+        writeConfigToEEPROM();
+        ASSERT_TRUE(isEEPROMStructureValid());
+    }
+
+    void TearDown() override
+    {
+        EXPECT_EQ(0, failures);
+    }
+
+    void save(void)
+    {
+        memcpy(before, eepromData, sizeof(before));
+        writeConfigToEEPROM();
+    }
+
+    // What a reboot would see
+    void reload(void)
+    {
+        smallConfigMutable()->value = 0;
+        memset(largeConfigMutable(), 0, sizeof(largeConfig_t));
+        otherConfigMutable()->value = 0;
+        ASSERT_TRUE(isEEPROMVersionValid());
+        ASSERT_TRUE(isEEPROMStructureValid());
+        EXPECT_TRUE(loadEEPROM());
+    }
+};
+
+TEST_F(ConfigEepromTest, SaveAppendsOnlyTheGroupsThatChanged)
+{
+    const uint16_t size = getEEPROMConfigSize();
+
+    smallConfigMutable()->value = 42;
+    save();
+
+    // What was there is left alone, one record is added
+    EXPECT_EQ(size + SMALL_RECORD_SIZE, getEEPROMConfigSize());
+    EXPECT_EQ(0, memcmp(before, eepromData, size));
+
+    reload();
+    EXPECT_EQ(42u, smallConfig()->value);
+    EXPECT_EQ(11u, otherConfig()->value);
+}
+
+TEST_F(ConfigEepromTest, SaveWithoutChangesWritesNothing)
+{
+    save();
+
+    EXPECT_EQ(0, memcmp(before, eepromData, sizeof(before)));
+}
+
+TEST_F(ConfigEepromTest, LastRecordOfAGroupCounts)
+{
+    for (uint32_t value = 100; value < 110; value++) {
+        smallConfigMutable()->value = value;
+        save();
+    }
+    otherConfigMutable()->value = 12;
+    save();
+
+    reload();
+    EXPECT_EQ(109u, smallConfig()->value);
+    EXPECT_EQ(12u, otherConfig()->value);
+}
+
+TEST_F(ConfigEepromTest, TornRecordIsIgnored)
+{
+    smallConfigMutable()->value = 1;
+    save();
+    smallConfigMutable()->value = 2;
+    save();
+
+    // Power was lost before the last record was complete
+    eepromData[getEEPROMConfigSize() - SMALL_RECORD_SIZE + 6] ^= 0xFF;
+
+    reload();
+    EXPECT_EQ(1u, smallConfig()->value);
+
+    // The next save carries on from the last record that checks out
+    smallConfigMutable()->value = 3;
+    save();
+    reload();
+    EXPECT_EQ(3u, smallConfig()->value);
+}
+
+TEST_F(ConfigEepromTest, CompactsWhenTheLogIsFull)
+{
+    const uint16_t compactedSize = getEEPROMConfigSize();
+    uint16_t previousSize = compactedSize;
+    int compactions = 0;
+
+    for (int i = 1; i < 60; i++) {
+        memset(largeConfigMutable(), i, sizeof(largeConfig_t));
+        smallConfigMutable()->value = i;
+        save();
+
+        if (getEEPROMConfigSize() < previousSize) {
+            // All of it was written again, with the values of this save
+            EXPECT_EQ(compactedSize, getEEPROMConfigSize());
+            compactions++;
+        }
+        previousSize = getEEPROMConfigSize();
+
+        reload();
+        EXPECT_EQ((uint32_t)i, smallConfig()->value);
+        EXPECT_EQ(i, largeConfig()->values[199]);
+        EXPECT_EQ(11u, otherConfig()->value);
+    }
+
+    EXPECT_GT(compactions, 0);
+}
+
+TEST_F(ConfigEepromTest, RecordsOfAnEarlierGenerationAreIgnored)
+{
+    smallConfigMutable()->value = 99;
+    save();
+    uint8_t stale[SMALL_RECORD_SIZE];
+    memcpy(stale, &eepromData[getEEPROMConfigSize() - SMALL_RECORD_SIZE], sizeof(stale));
+
+    // Fill the log up so that it gets compacted
+    smallConfigMutable()->value = 5;
+    uint16_t previousSize;
+    int i = 0;
+    do {
+        previousSize = getEEPROMConfigSize();
+        memset(largeConfigMutable(), ++i, sizeof(largeConfig_t));
+        save();
+    } while (getEEPROMConfigSize() > previousSize);
+
+    // What the last generation left behind is found past the end of the log
+    memcpy(&eepromData[getEEPROMConfigSize()], stale, sizeof(stale));
+
+    reload();
+    EXPECT_EQ(5u, smallConfig()->value);
+}
+
+// STUBS
+
+extern "C" {
+
+void failureMode(failureMode_e mode)
+{
+    UNUSED(mode);
+    failures++;
+}
+
+}
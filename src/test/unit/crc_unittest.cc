@@ -0,0 +1,197 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/crc.h"
+    #include "common/streambuf.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+// The bit at a time versions the tables are checked against
+
+static uint16_t referenceCrc16Ccitt(uint16_t crc, uint8_t a)
+{
+    crc ^= (uint16_t)a << 8;
+    for (int ii = 0; ii < 8; ++ii) {
+        if (crc & 0x8000) {
+            crc = (crc << 1) ^ 0x1021;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t referenceCrc8DvbS2(uint8_t crc, uint8_t a)
+{
+    crc ^= a;
+    for (int ii = 0; ii < 8; ++ii) {
+        if (crc & 0x80) {
+            crc = (crc << 1) ^ 0xD5;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+#define TEST_BUFFER_SIZE 80
+#define MAX_ALIGNMENT 8
+
+static uint8_t testData[TEST_BUFFER_SIZE + MAX_ALIGNMENT];
+
+static void fillTestData(unsigned seed)
+{
+    srand(seed);
+    for (unsigned i = 0; i < sizeof(testData); i++) {
+        testData[i] = rand();
+    }
+}
+
+TEST(CrcTest, Crc16CcittEveryCrcAndByte)
+{
+    for (uint32_t crc = 0; crc <= 0xFFFF; crc++) {
+        for (uint32_t a = 0; a <= 0xFF; a++) {
+            if (crc16_ccitt(crc, a) != referenceCrc16Ccitt(crc, a)) {
+                FAIL() << "crc " << crc << " byte " << a;
+            }
+        }
+    }
+}
+
+TEST(CrcTest, Crc8DvbS2EveryCrcAndByte)
+{
+    for (uint32_t crc = 0; crc <= 0xFF; crc++) {
+        for (uint32_t a = 0; a <= 0xFF; a++) {
+            EXPECT_EQ(referenceCrc8DvbS2(crc, a), crc8_dvb_s2(crc, a)) << "crc " << crc << " byte " << a;
+        }
+    }
+}
+
+TEST(CrcTest, UpdateEveryLengthAndAlignment)
+{
+    for (unsigned seed = 0; seed < 20; seed++) {
+        fillTestData(seed);
+
+        for (int alignment = 0; alignment < MAX_ALIGNMENT; alignment++) {
+            for (int length = 0; length <= TEST_BUFFER_SIZE; length++) {
+                const uint8_t *data = &testData[alignment];
+                uint16_t crc16 = seed * 0x1234;
+                uint8_t crc8 = seed * 0x35;
+                uint8_t xorSum = seed;
+                for (int i = 0; i < length; i++) {
+                    crc16 = referenceCrc16Ccitt(crc16, data[i]);
+                    crc8 = referenceCrc8DvbS2(crc8, data[i]);
+                    xorSum ^= data[i];
+                }
+
+                EXPECT_EQ(crc16, crc16_ccitt_update(seed * 0x1234, data, length)) << "length " << length << " alignment " << alignment;
+                EXPECT_EQ(crc8, crc8_dvb_s2_update(seed * 0x35, data, length)) << "length " << length << " alignment " << alignment;
+                EXPECT_EQ(xorSum, crc8_xor_update(seed, data, length)) << "length " << length << " alignment " << alignment;
+            }
+        }
+    }
+}
+
+TEST(CrcTest, KnownValues)
+{
+    const char *check = "123456789";
+
+    // CRC-16/XMODEM and CRC-8/DVB-S2 check values
+    EXPECT_EQ(0x31C3, crc16_ccitt_update(0, check, 9));
+    EXPECT_EQ(0xBC, crc8_dvb_s2_update(0, check, 9));
+    EXPECT_EQ(0x31, crc8_xor_update(0, check, 9));
+}
+
+TEST(CrcTest, SbufAppend)
+{
+    uint8_t buffer[16];
+    sbuf_t sbuf = { buffer, buffer + sizeof(buffer) };
+    sbuf_t *dst = &sbuf;
+
+    sbufWriteData(dst, "123456789", 9);
+    crc8_dvb_s2_sbuf_append(dst, buffer);
+    EXPECT_EQ(0xBC, buffer[9]);
+
+    dst->ptr = buffer + 9;
+    crc16_ccitt_sbuf_append(dst, buffer);
+    EXPECT_EQ(0x31C3, buffer[9] | (buffer[10] << 8));
+
+    dst->ptr = buffer + 9;
+    crc8_xor_sbuf_append(dst, buffer);
+    EXPECT_EQ(0x31, buffer[9]);
+}
+
+TEST(CrcTest, BenchmarkThroughput)
+{
+    static const int BENCHMARK_BYTES = 8 * 1024 * 1024;
+    static uint8_t data[4096];
+
+    fillTestData(1);
+    for (unsigned i = 0; i < sizeof(data); i++) {
+        data[i] = testData[i % TEST_BUFFER_SIZE] ^ i;
+    }
+
+    uint32_t sum = 0;
+    clock_t start = clock();
+    for (int n = 0; n < BENCHMARK_BYTES; n += sizeof(data)) {
+        uint16_t crc = n;
+        for (unsigned i = 0; i < sizeof(data); i++) {
+            crc = referenceCrc16Ccitt(crc, data[i]);
+        }
+        sum += crc;
+    }
+    const double bitwiseCrc16MBs = BENCHMARK_BYTES / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int n = 0; n < BENCHMARK_BYTES; n += sizeof(data)) {
+        sum += crc16_ccitt_update(n, data, sizeof(data));
+    }
+    const double crc16MBs = BENCHMARK_BYTES / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int n = 0; n < BENCHMARK_BYTES; n += sizeof(data)) {
+        uint8_t crc = n;
+        for (unsigned i = 0; i < sizeof(data); i++) {
+            crc = referenceCrc8DvbS2(crc, data[i]);
+        }
+        sum += crc;
+    }
+    const double bitwiseCrc8MBs = BENCHMARK_BYTES / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int n = 0; n < BENCHMARK_BYTES; n += sizeof(data)) {
+        sum += crc8_dvb_s2_update(n, data, sizeof(data));
+    }
+    const double crc8MBs = BENCHMARK_BYTES / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int n = 0; n < BENCHMARK_BYTES; n += sizeof(data)) {
+        sum += crc8_xor_update(n, data, sizeof(data));
+    }
+    const double xorMBs = BENCHMARK_BYTES / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+    printf("crc16_ccitt %.0fMB/s (bitwise %.0fMB/s), crc8_dvb_s2 %.0fMB/s (bitwise %.0fMB/s), crc8_xor %.0fMB/s [%u]\n",
+        crc16MBs, bitwiseCrc16MBs, crc8MBs, bitwiseCrc8MBs, xorMBs, sum & 1);
+}
@@ -0,0 +1,506 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/maths.h"
+
+    #include "drivers/flash.h"
+
+    #include "io/flashfs.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define SECTOR_SIZE 4096
+#define SECTOR_COUNT 16
+#define PAGE_SIZE 256
+
+// The last sector holds the log index, 8 byte records on NOR
+#define INDEX_ADDRESS ((SECTOR_COUNT - 1) * SECTOR_SIZE)
+#define INDEX_RECORD_SIZE 8
+
+// A NOR flash that stays busy for a number of polls after every program
+static uint8_t flashMemory[SECTOR_COUNT * SECTOR_SIZE];
+static int programBusyPolls;
+static int busyPolls;
+static uint32_t programAddress;
+static int programLength;
+static int programCount;
+static bool programCrossedPage;
+static int readCount;
+
+static flashGeometry_t geometry = {
+    .sectors = SECTOR_COUNT,
+    .pageSize = PAGE_SIZE,
+    .sectorSize = SECTOR_SIZE,
+    .totalSize = SECTOR_COUNT * SECTOR_SIZE,
+    .pagesPerSector = SECTOR_SIZE / PAGE_SIZE,
+    .flashType = FLASH_TYPE_NOR
+};
+
+static flashPartition_t partition = { FLASH_PARTITION_TYPE_FLASHFS, 0, SECTOR_COUNT - 1 };
+
+static void resetFlash(int busyPollsAfterProgram)
+{
+    // Get rid of anything the previous test left in the buffers
+    flashfsInit();
+    flashfsEraseCompletely();
+
+    geometry.flashType = FLASH_TYPE_NOR;
+    programBusyPolls = busyPollsAfterProgram;
+    busyPolls = 0;
+    programCount = 0;
+    programCrossedPage = false;
+    flashfsInit();
+}
+
+static void writePattern(uint32_t start, int length, int chunk)
+{
+    uint8_t data[64];
+
+    for (int pos = 0; pos < length; pos += chunk) {
+        const int count = MIN(chunk, length - pos);
+        for (int i = 0; i < count; i++) {
+            data[i] = (start + pos + i) * 7;
+        }
+        flashfsWrite(data, count, false);
+    }
+}
+
+static bool checkPattern(uint32_t start, int length)
+{
+    for (int i = 0; i < length; i++) {
+        if (flashMemory[start + i] != (uint8_t)((start + i) * 7)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Boot again without any of the RAM state, whatever was still buffered is lost
+static void powerCycle(void)
+{
+    busyPolls = 0;
+    readCount = 0;
+    flashfsInit();
+}
+
+// A program that was cut short, only the first bytes of the record made it
+static void tearIndexRecord(int slot, int slotSize)
+{
+    memset(&flashMemory[INDEX_ADDRESS + slot * slotSize + 3], 0xFF, INDEX_RECORD_SIZE - 3);
+}
+
+static void writeLog(int length)
+{
+    while (!flashfsBeginLog()) {
+        busyPolls = 0;
+    }
+    writePattern(flashfsGetOffset(), length, 30);
+    flashfsFlushSync();
+    flashfsClose();
+}
+
+static void expectLog(int index, uint32_t start, uint32_t end)
+{
+    uint32_t logStart;
+    uint32_t logEnd;
+
+    ASSERT_TRUE(flashfsGetLog(index, &logStart, &logEnd));
+    EXPECT_EQ(start, logStart) << "log " << index;
+    EXPECT_EQ(end, logEnd) << "log " << index;
+}
+
+TEST(FlashfsTest, TestWholePagePrograms)
+{
+    resetFlash(0);
+
+    writePattern(0, 10 * PAGE_SIZE + 100, 37);
+
+    // Only complete pages went out, the rest waits for more data
+    const flashfsWriteStats_t *stats = flashfsGetWriteStats();
+    EXPECT_EQ(10u, stats->pagePrograms);
+    EXPECT_EQ(0u, stats->partialPrograms);
+    EXPECT_EQ(0u, stats->stalls);
+    EXPECT_FALSE(programCrossedPage);
+    EXPECT_EQ((uint32_t)(10 * PAGE_SIZE + 100), flashfsGetOffset());
+    EXPECT_FALSE(flashfsFlushAsync(false));
+
+    EXPECT_TRUE(flashfsFlushAsync(true));
+    EXPECT_EQ(11u, stats->pagePrograms);
+    EXPECT_EQ(1u, stats->partialPrograms);
+    EXPECT_TRUE(checkPattern(0, 10 * PAGE_SIZE + 100));
+}
+
+TEST(FlashfsTest, TestUnalignedStart)
+{
+    resetFlash(0);
+
+    flashfsSeekAbs(PAGE_SIZE + 200);
+    writePattern(PAGE_SIZE + 200, 3 * PAGE_SIZE, 50);
+    flashfsFlushSync();
+
+    // The first program fills up its page, the ones after it are aligned
+    const flashfsWriteStats_t *stats = flashfsGetWriteStats();
+    EXPECT_EQ(4u, stats->pagePrograms);
+    EXPECT_EQ(1u, stats->partialPrograms);
+    EXPECT_FALSE(programCrossedPage);
+    EXPECT_TRUE(checkPattern(PAGE_SIZE + 200, 3 * PAGE_SIZE));
+}
+
+TEST(FlashfsTest, TestBackPressure)
+{
+    resetFlash(1000);
+
+    EXPECT_EQ((uint32_t)(2 * PAGE_SIZE), flashfsGetWriteBufferFreeSpace());
+
+    // The first page is programmed, the second one waits for it, the third fills up and the fourth has nowhere to go
+    writePattern(0, 4 * PAGE_SIZE, 64);
+
+    const flashfsWriteStats_t *stats = flashfsGetWriteStats();
+    EXPECT_EQ(1u, stats->pagePrograms);
+    EXPECT_EQ(4u, stats->stalls);   // every write of the fourth page
+    EXPECT_EQ((uint32_t)PAGE_SIZE, stats->bytesDropped);
+    EXPECT_EQ(0u, flashfsGetWriteBufferFreeSpace());
+
+    // Once the flash is done with the first page, the second one follows and makes room
+    busyPolls = 0;
+    EXPECT_FALSE(flashfsFlushAsync(false));
+    EXPECT_EQ(2u, stats->pagePrograms);
+    EXPECT_EQ((uint32_t)PAGE_SIZE, flashfsGetWriteBufferFreeSpace());
+    EXPECT_TRUE(checkPattern(0, 2 * PAGE_SIZE));
+}
+
+TEST(FlashfsTest, BenchmarkProgramCount)
+{
+    // 8k logging writes frames of about 30 bytes, count the program operations for 64k of them
+    resetFlash(0);
+    writePattern(0, 15 * SECTOR_SIZE, 30);
+    flashfsFlushSync();
+
+    printf("%d bytes in %d page programs, %d bytes per program\n",
+        15 * SECTOR_SIZE, programCount, 15 * SECTOR_SIZE / programCount);
+    EXPECT_EQ(15 * SECTOR_SIZE / PAGE_SIZE, programCount);
+    EXPECT_TRUE(checkPattern(0, 15 * SECTOR_SIZE));
+}
+
+TEST(FlashfsTest, TestIndexRecordsLogs)
+{
+    resetFlash(0);
+    EXPECT_EQ((uint32_t)INDEX_ADDRESS, flashfsGetSize());
+    EXPECT_EQ(0, flashfsGetLogCount());
+
+    writeLog(1000);
+    writeLog(500);
+    EXPECT_EQ(2, flashfsGetLogCount());
+
+    // The head is read from the last END, a handful of small reads whatever the size of the chip
+    powerCycle();
+    EXPECT_EQ(1500u, flashfsGetOffset());
+    EXPECT_LE(readCount, 12);
+    EXPECT_EQ(2, flashfsGetLogCount());
+    expectLog(0, 0, 1000);
+    expectLog(1, 1000, 1500);
+    EXPECT_FALSE(flashfsGetLog(2, NULL, NULL));
+
+    // The next log follows on directly and shows up while it is written
+    writeLog(100);
+    while (!flashfsBeginLog()) {
+        busyPolls = 0;
+    }
+    writePattern(1600, 40, 40);
+    EXPECT_EQ(4, flashfsGetLogCount());
+    expectLog(2, 1500, 1600);
+    expectLog(3, 1600, 1640);
+    EXPECT_TRUE(checkPattern(0, 1600));
+}
+
+TEST(FlashfsTest, TestBeginLogWaitsForFlash)
+{
+    resetFlash(1000);
+
+    writePattern(0, 100, 50);
+    EXPECT_FALSE(flashfsBeginLog());
+    EXPECT_EQ(0, flashfsGetLogCount());
+
+    busyPolls = 0;
+    while (!flashfsBeginLog()) {
+        busyPolls = 0;
+    }
+    EXPECT_EQ(1, flashfsGetLogCount());
+    expectLog(0, 100, 100);
+}
+
+TEST(FlashfsTest, TestPowerLossWhileLogging)
+{
+    resetFlash(0);
+
+    writeLog(1000);
+    while (!flashfsBeginLog()) {
+        busyPolls = 0;
+    }
+    writePattern(1000, 3000, 30);
+
+    // The last log is closed at the free space behind its start, and stays closed
+    powerCycle();
+    EXPECT_EQ(4096u, flashfsGetOffset());
+    EXPECT_EQ(2, flashfsGetLogCount());
+    expectLog(0, 0, 1000);
+    expectLog(1, 1000, 4096);
+
+    powerCycle();
+    EXPECT_EQ(4096u, flashfsGetOffset());
+    EXPECT_LE(readCount, 12);
+    expectLog(1, 1000, 4096);
+
+    writeLog(200);
+    expectLog(2, 4096, 4296);
+    EXPECT_TRUE(checkPattern(4096, 200));
+}
+
+TEST(FlashfsTest, TestTornEndRecord)
+{
+    resetFlash(0);
+
+    writeLog(1000);
+    writeLog(500);
+    tearIndexRecord(3, INDEX_RECORD_SIZE);
+
+    // The torn END doesn't count, the log runs up to the free space
+    powerCycle();
+    EXPECT_EQ(2048u, flashfsGetOffset());
+    EXPECT_EQ(2, flashfsGetLogCount());
+    expectLog(0, 0, 1000);
+    expectLog(1, 1000, 2048);
+
+    // The next log takes the place of the END
+    writeLog(100);
+    EXPECT_EQ(3, flashfsGetLogCount());
+    expectLog(1, 1000, 2048);
+    expectLog(2, 2048, 2148);
+}
+
+TEST(FlashfsTest, TestTornStartRecord)
+{
+    resetFlash(0);
+
+    writeLog(1000);
+    while (!flashfsBeginLog()) {
+        busyPolls = 0;
+    }
+    tearIndexRecord(2, INDEX_RECORD_SIZE);
+
+    // Power went before any of the log was written, it comes back empty
+    powerCycle();
+    EXPECT_EQ(2048u, flashfsGetOffset());
+    EXPECT_EQ(2, flashfsGetLogCount());
+    expectLog(0, 0, 1000);
+    expectLog(1, 2048, 2048);
+
+    writeLog(100);
+    expectLog(2, 2048, 2148);
+}
+
+TEST(FlashfsTest, TestLogsWithoutIndexAreAdopted)
+{
+    resetFlash(0);
+
+    // Written by firmware that didn't keep an index
+    writePattern(0, 5000, 50);
+    flashfsFlushSync();
+
+    powerCycle();
+    EXPECT_EQ(6144u, flashfsGetOffset());
+    EXPECT_EQ(1, flashfsGetLogCount());
+    expectLog(0, 0, 6144);
+}
+
+TEST(FlashfsTest, TestForeignDataInIndexSector)
+{
+    resetFlash(0);
+
+    // Logs that ran all the way to the end of the chip before there was an index
+    memset(flashMemory, 0x55, sizeof(flashMemory));
+
+    powerCycle();
+    EXPECT_EQ((uint32_t)(SECTOR_COUNT * SECTOR_SIZE), flashfsGetSize());
+    EXPECT_EQ(flashfsGetSize(), flashfsGetOffset());
+    EXPECT_EQ(0, flashfsGetLogCount());
+    EXPECT_TRUE(flashfsBeginLog());
+
+    // The index is back after an erase
+    flashfsEraseCompletely();
+    EXPECT_EQ((uint32_t)INDEX_ADDRESS, flashfsGetSize());
+    writeLog(100);
+    EXPECT_EQ(1, flashfsGetLogCount());
+    expectLog(0, 0, 100);
+}
+
+TEST(FlashfsTest, TestForeignDataInFirstIndexSlot)
+{
+    resetFlash(0);
+
+    // A log from before there was an index that ended just inside the index sector
+    memset(flashMemory, 0x55, INDEX_ADDRESS + INDEX_RECORD_SIZE);
+
+    powerCycle();
+    EXPECT_EQ((uint32_t)(SECTOR_COUNT * SECTOR_SIZE), flashfsGetSize());
+    EXPECT_GE(flashfsGetOffset(), (uint32_t)(INDEX_ADDRESS + INDEX_RECORD_SIZE));
+
+    // Nothing is programmed over it
+    writeLog(100);
+    for (int i = 0; i < INDEX_RECORD_SIZE; i++) {
+        EXPECT_EQ(0x55, flashMemory[INDEX_ADDRESS + i]);
+    }
+}
+
+TEST(FlashfsTest, TestFullIndex)
+{
+    resetFlash(0);
+
+    const int indexedLogs = SECTOR_SIZE / INDEX_RECORD_SIZE / 2;
+    for (int i = 0; i < indexedLogs; i++) {
+        writeLog(10);
+    }
+    EXPECT_EQ(indexedLogs, flashfsGetLogCount());
+
+    // Logs are still written once the index is full, they show up as one
+    writeLog(10);
+    writeLog(10);
+    EXPECT_EQ(indexedLogs + 1, flashfsGetLogCount());
+    expectLog(indexedLogs - 1, (indexedLogs - 1) * 10, indexedLogs * 10);
+    expectLog(indexedLogs, indexedLogs * 10, indexedLogs * 10 + 20);
+
+    // The head is found behind the last END
+    powerCycle();
+    EXPECT_EQ(4096u, flashfsGetOffset());
+    EXPECT_EQ(indexedLogs + 1, flashfsGetLogCount());
+    expectLog(indexedLogs, indexedLogs * 10, 4096);
+}
+
+TEST(FlashfsTest, TestNandLogsStartOnPages)
+{
+    resetFlash(0);
+    geometry.flashType = FLASH_TYPE_NAND;
+    flashfsEraseCompletely();
+
+    writeLog(1000);
+    writeLog(300);
+
+    // One record per page, the log after the first starts on the next page
+    expectLog(0, 0, 1000);
+    expectLog(1, 1024, 1324);
+    EXPECT_NE(0xFF, flashMemory[INDEX_ADDRESS + 3 * PAGE_SIZE]);
+
+    powerCycle();
+    EXPECT_EQ(1536u, flashfsGetOffset());
+    EXPECT_EQ(2, flashfsGetLogCount());
+
+    // A torn END on NAND, the log runs up to the free space
+    writeLog(100);
+    tearIndexRecord(5, PAGE_SIZE);
+    powerCycle();
+    EXPECT_EQ(2048u, flashfsGetOffset());
+    expectLog(2, 1536, 2048);
+
+    geometry.flashType = FLASH_TYPE_NOR;
+}
+
+// STUBS
+
+extern "C" {
+
+flashPartition_t *flashPartitionFindByType(flashPartitionType_e type)
+{
+    return type == FLASH_PARTITION_TYPE_FLASHFS ? &partition : NULL;
+}
+
+int flashPartitionCount(void)
+{
+    return 1;
+}
+
+const flashGeometry_t *flashGetGeometry(void)
+{
+    return &geometry;
+}
+
+bool flashIsReady(void)
+{
+    if (busyPolls > 0) {
+        busyPolls--;
+        return false;
+    }
+    return true;
+}
+
+bool flashWaitForReady(void)
+{
+    busyPolls = 0;
+    return true;
+}
+
+void flashEraseSector(uint32_t address)
+{
+    memset(&flashMemory[address], 0xFF, SECTOR_SIZE);
+}
+
+void flashEraseCompletely(void)
+{
+    memset(flashMemory, 0xFF, sizeof(flashMemory));
+}
+
+void flashPageProgramBegin(uint32_t address)
+{
+    flashWaitForReady();
+    programAddress = address;
+    programLength = 0;
+}
+
+void flashPageProgramContinue(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        flashMemory[programAddress + programLength + i] &= data[i];
+    }
+    programLength += length;
+}
+
+void flashPageProgramFinish(void)
+{
+    if (programAddress / PAGE_SIZE != (programAddress + programLength - 1) / PAGE_SIZE) {
+        programCrossedPage = true;
+    }
+    programCount++;
+    busyPolls = programBusyPolls;
+}
+
+int flashReadBytes(uint32_t address, uint8_t *buffer, int length)
+{
+    readCount++;
+    memcpy(buffer, &flashMemory[address], length);
+    return length;
+}
+
+void flashFlush(void) {}
+
+}
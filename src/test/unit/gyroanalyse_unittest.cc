@@ -0,0 +1,229 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+    #include <platform.h>
+
+    #include "arm_math.h"
+    #include "build/debug.h"
+    #include "common/axis.h"
+    #include "common/filter.h"
+    #include "common/maths.h"
+    #include "common/utils.h"
+    #include "flight/gyroanalyse.h"
+    #include "pg/pg.h"
+    #include "pg/pg_ids.h"
+    #include "sensors/gyro.h"
+
+    PG_REGISTER(gyroConfig_t, gyroConfig, PG_GYRO_CONFIG, 0);
+
+    uint8_t debugMode;
+    int16_t debug[DEBUG16_VALUE_COUNT];
+    gyro_t gyro;
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_LOOPTIME       125     // 8kHz gyro loop
+#define TEST_LOOPS          16000   // 2 seconds
+#define TEST_SETTLED_LOOPS  8000    // errors are measured over the last second
+
+// two tones per axis, the taller one first, on a little deterministic noise
+static const float toneHz[XYZ_AXIS_COUNT][2] = {
+    { 232.0f, 447.0f },
+    { 318.0f, 181.0f },
+    { 405.0f, 271.0f },
+};
+static const float toneAmplitude[2] = { 100.0f, 60.0f };
+
+static uint32_t noiseSeed;
+
+static float gyroSample(int loop, int axis)
+{
+    const float t = loop * TEST_LOOPTIME * 1e-6f;
+    noiseSeed = noiseSeed * 1664525 + 1013904223;
+    const float noise = ((noiseSeed >> 16) / 65536.0f - 0.5f) * 10.0f;
+    return toneAmplitude[0] * sinf(2.0f * M_PIf * toneHz[axis][0] * t)
+        + toneAmplitude[1] * sinf(2.0f * M_PIf * toneHz[axis][1] * t + axis)
+        + noise;
+}
+
+typedef struct detectionResult_s {
+    float peakError;        // mean absolute error of the tallest peak, Hz
+    float secondPeakError;  // mean absolute error of the second peak, Hz
+    double nsPerLoop;
+} detectionResult_t;
+
+static detectionResult_t runAnalyser(uint8_t engine, bool peakTrack)
+{
+    pgResetAll();
+    gyroConfigMutable()->dyn_notch_range = DYN_NOTCH_RANGE_MEDIUM;
+    gyroConfigMutable()->dyn_notch_min_hz = 150;
+    gyroConfigMutable()->dyn_notch_width_percent = 8;
+    gyroConfigMutable()->dyn_notch_engine = engine;
+    gyroConfigMutable()->dyn_notch_peak_track = peakTrack;
+    gyro.targetLooptime = TEST_LOOPTIME;
+
+    static gyroAnalyseState_t state;
+    memset(&state, 0, sizeof(state));
+    gyroDataAnalyseStateInit(&state, TEST_LOOPTIME);
+
+    biquadFilter3_t notchFilterDyn;
+    biquadFilter3_t notchFilterDyn2;
+    biquadFilter3Init(&notchFilterDyn, 200, TEST_LOOPTIME, 1.2f, FILTER_NOTCH);
+    biquadFilter3Init(&notchFilterDyn2, 200, TEST_LOOPTIME, 1.2f, FILTER_NOTCH);
+
+    noiseSeed = 1;
+    detectionResult_t result = { 0, 0, 0 };
+    clock_t elapsed = 0;
+    for (int loop = 0; loop < TEST_LOOPS; loop++) {
+        float samples[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            samples[axis] = gyroSample(loop, axis);
+        }
+
+        const clock_t start = clock();
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            gyroDataAnalysePush(&state, axis, samples[axis]);
+        }
+        gyroDataAnalyse(&state, &notchFilterDyn, &notchFilterDyn2);
+        elapsed += clock() - start;
+
+        if (loop >= TEST_LOOPS - TEST_SETTLED_LOOPS) {
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                // tracks follow the peak they started on rather than its height, with peak tracking
+                // the tallest tone may sit on either notch
+                const bool swapped = peakTrack
+                    && fabsf(state.centerFreq[axis] - toneHz[axis][1]) + fabsf(state.centerFreq2[axis] - toneHz[axis][0])
+                    < fabsf(state.centerFreq[axis] - toneHz[axis][0]) + fabsf(state.centerFreq2[axis] - toneHz[axis][1]);
+                result.peakError += fabsf((swapped ? state.centerFreq2[axis] : state.centerFreq[axis]) - toneHz[axis][0]);
+                result.secondPeakError += fabsf((swapped ? state.centerFreq[axis] : state.centerFreq2[axis]) - toneHz[axis][1]);
+            }
+        }
+    }
+    result.peakError /= TEST_SETTLED_LOOPS * XYZ_AXIS_COUNT;
+    result.secondPeakError /= TEST_SETTLED_LOOPS * XYZ_AXIS_COUNT;
+    result.nsPerLoop = 1e9 * elapsed / CLOCKS_PER_SEC / TEST_LOOPS;
+    return result;
+}
+
+TEST(GyroAnalyseUnittest, WeightedMeanFft)
+{
+    const detectionResult_t result = runAnalyser(DYN_NOTCH_ENGINE_FFT, false);
+    printf("FFT,  weighted mean (window %d): peak error %.1fHz, %.0fns per gyro loop (reference DFT)\n",
+        FFT_WINDOW_SIZE, result.peakError, result.nsPerLoop);
+
+    // the cubed mean is pulled towards the second tone, but stays within a bin
+    EXPECT_LT(result.peakError, 1333.0f / FFT_WINDOW_SIZE);
+}
+
+TEST(GyroAnalyseUnittest, PeakTrackFft)
+{
+    const detectionResult_t result = runAnalyser(DYN_NOTCH_ENGINE_FFT, true);
+    printf("FFT,  peak track    (window %d): peak error %.1fHz, second peak error %.1fHz, %.0fns per gyro loop (reference DFT)\n",
+        FFT_WINDOW_SIZE, result.peakError, result.secondPeakError, result.nsPerLoop);
+
+    EXPECT_LT(result.peakError, 10.0f);
+    EXPECT_LT(result.secondPeakError, 15.0f);
+}
+
+TEST(GyroAnalyseUnittest, WeightedMeanSdft)
+{
+    const detectionResult_t result = runAnalyser(DYN_NOTCH_ENGINE_SDFT, false);
+    printf("SDFT, weighted mean (window %d): peak error %.1fHz, %.0fns per gyro loop\n",
+        FFT_WINDOW_SIZE, result.peakError, result.nsPerLoop);
+
+    EXPECT_LT(result.peakError, 1333.0f / FFT_WINDOW_SIZE);
+}
+
+TEST(GyroAnalyseUnittest, PeakTrackSdft)
+{
+    const detectionResult_t result = runAnalyser(DYN_NOTCH_ENGINE_SDFT, true);
+    printf("SDFT, peak track    (window %d): peak error %.1fHz, second peak error %.1fHz, %.0fns per gyro loop\n",
+        FFT_WINDOW_SIZE, result.peakError, result.secondPeakError, result.nsPerLoop);
+
+    EXPECT_LT(result.peakError, 10.0f);
+    EXPECT_LT(result.secondPeakError, 15.0f);
+}
+
+// STUBS
+
+extern "C" {
+
+uint32_t micros(void) { return 0; }
+uint8_t calculateThrottlePercentAbs(void) { return 0; }
+
+// the FFT steps are replaced by a plain real DFT in the CMSIS output layout: bin 0 and the
+// Nyquist bin packed into the first pair, then the real and imaginary part of each bin
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, uint16_t fftLen)
+{
+    memset(S, 0, sizeof(*S));
+    S->fftLenRFFT = fftLen;
+    S->Sint.fftLen = fftLen / 2;
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_cfft_radix8by2_f32(arm_cfft_instance_f32 *, float32_t *) {}
+void arm_cfft_radix8by4_f32(arm_cfft_instance_f32 *, float32_t *) {}
+void arm_radix8_butterfly_f32(float32_t *, uint16_t, const float32_t *, uint16_t) {}
+void arm_bitreversal_32(uint32_t *, const uint16_t, const uint16_t *) {}
+
+void stage_rfft_f32(arm_rfft_fast_instance_f32 *S, float32_t *p, float32_t *pOut)
+{
+    const int n = S->fftLenRFFT;
+    for (int bin = 0; bin <= n / 2; bin++) {
+        double re = 0;
+        double im = 0;
+        for (int i = 0; i < n; i++) {
+            re += p[i] * cos(2 * M_PI * bin * i / n);
+            im -= p[i] * sin(2 * M_PI * bin * i / n);
+        }
+        if (bin == 0) {
+            pOut[0] = re;
+        } else if (bin == n / 2) {
+            pOut[1] = re;
+        } else {
+            pOut[2 * bin] = re;
+            pOut[2 * bin + 1] = im;
+        }
+    }
+}
+
+void arm_mult_f32(float32_t *pSrcA, float32_t *pSrcB, float32_t *pDst, uint32_t blockSize)
+{
+    for (uint32_t i = 0; i < blockSize; i++) {
+        pDst[i] = pSrcA[i] * pSrcB[i];
+    }
+}
+
+void arm_cmplx_mag_f32(float32_t *pSrc, float32_t *pDst, uint32_t numSamples)
+{
+    for (uint32_t i = 0; i < numSamples; i++) {
+        pDst[i] = sqrtf(pSrc[2 * i] * pSrc[2 * i] + pSrc[2 * i + 1] * pSrc[2 * i + 1]);
+    }
+}
+
+}
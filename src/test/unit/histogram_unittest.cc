@@ -0,0 +1,103 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+extern "C" {
+    #include "common/histogram.h"
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+TEST(HistogramUnittest, TestBucketIndex)
+{
+    EXPECT_EQ(0, logHistogramBucketIndex(0));
+    EXPECT_EQ(1, logHistogramBucketIndex(1));
+    EXPECT_EQ(2, logHistogramBucketIndex(2));
+    EXPECT_EQ(3, logHistogramBucketIndex(3));
+    EXPECT_EQ(4, logHistogramBucketIndex(4));
+    EXPECT_EQ(4, logHistogramBucketIndex(5));
+    EXPECT_EQ(5, logHistogramBucketIndex(6));
+    EXPECT_EQ(5, logHistogramBucketIndex(7));
+    EXPECT_EQ(6, logHistogramBucketIndex(8));
+    EXPECT_EQ(LOG_HISTOGRAM_BUCKET_COUNT - 1, logHistogramBucketIndex(65535));
+    EXPECT_EQ(LOG_HISTOGRAM_BUCKET_COUNT - 1, logHistogramBucketIndex(65536));
+    EXPECT_EQ(LOG_HISTOGRAM_BUCKET_COUNT - 1, logHistogramBucketIndex(UINT32_MAX));
+}
+
+TEST(HistogramUnittest, TestBucketBounds)
+{
+    // every value falls in the bucket whose upper bound is the first one not below it
+    uint32_t lowerBound = 0;
+    for (int bucketIndex = 0; bucketIndex < LOG_HISTOGRAM_BUCKET_COUNT; bucketIndex++) {
+        const uint32_t upperBound = logHistogramBucketUpperBound(bucketIndex);
+        EXPECT_EQ(bucketIndex, logHistogramBucketIndex(lowerBound));
+        EXPECT_EQ(bucketIndex, logHistogramBucketIndex(upperBound));
+        // buckets never span more than half of their lower bound
+        EXPECT_LE(upperBound - lowerBound, lowerBound / 2);
+        lowerBound = upperBound + 1;
+    }
+    EXPECT_EQ(65536u, lowerBound);
+}
+
+TEST(HistogramUnittest, TestPercentile)
+{
+    logHistogram_t histogram;
+    logHistogramReset(&histogram);
+
+    EXPECT_EQ(0u, logHistogramPercentile(&histogram, 5000));
+
+    // 1000 samples, 989 of 10us, 10 of 100us, 1 of 1000us
+    for (int i = 0; i < 989; i++) {
+        logHistogramAdd(&histogram, 10);
+    }
+    for (int i = 0; i < 10; i++) {
+        logHistogramAdd(&histogram, 100);
+    }
+    logHistogramAdd(&histogram, 1000);
+    EXPECT_EQ(1000u, histogram.count);
+
+    EXPECT_EQ(logHistogramBucketUpperBound(logHistogramBucketIndex(10)), logHistogramPercentile(&histogram, 5000));
+    EXPECT_EQ(logHistogramBucketUpperBound(logHistogramBucketIndex(10)), logHistogramPercentile(&histogram, 9890));
+    EXPECT_EQ(logHistogramBucketUpperBound(logHistogramBucketIndex(100)), logHistogramPercentile(&histogram, 9900));
+    EXPECT_EQ(logHistogramBucketUpperBound(logHistogramBucketIndex(100)), logHistogramPercentile(&histogram, 9990));
+    EXPECT_EQ(logHistogramBucketUpperBound(logHistogramBucketIndex(1000)), logHistogramPercentile(&histogram, 10000));
+
+    // the reported percentile is never below the real one, and less than 50% above it
+    EXPECT_GE(logHistogramPercentile(&histogram, 9990), 100u);
+    EXPECT_LT(logHistogramPercentile(&histogram, 9990), 150u);
+}
+
+TEST(HistogramUnittest, TestSaturation)
+{
+    logHistogram_t histogram;
+    logHistogramReset(&histogram);
+
+    for (int i = 0; i < UINT16_MAX; i++) {
+        logHistogramAdd(&histogram, 10);
+    }
+    logHistogramAdd(&histogram, 20);
+    EXPECT_EQ(UINT16_MAX, histogram.bucket[logHistogramBucketIndex(10)]);
+    EXPECT_EQ((uint32_t)UINT16_MAX + 1, histogram.count);
+
+    // the next sample for a full bucket halves all of the counts
+    logHistogramAdd(&histogram, 10);
+    EXPECT_EQ(UINT16_MAX / 2 + 1, histogram.bucket[logHistogramBucketIndex(10)]);
+    EXPECT_EQ(0, histogram.bucket[logHistogramBucketIndex(20)]);
+    EXPECT_EQ((uint32_t)UINT16_MAX / 2 + 1, histogram.count);
+}
@@ -0,0 +1,580 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+extern "C" {
+    #include "platform.h"
+
+    #include "common/crc.h"
+    #include "common/maths.h"
+    #include "common/streambuf.h"
+
+    #include "drivers/serial.h"
+    #include "drivers/system.h"
+
+    #include "io/serial.h"
+
+    #include "msp/msp.h"
+    #include "msp/msp_serial.h"
+
+    #include "pg/pg.h"
+    #include "pg/pg_ids.h"
+
+    PG_REGISTER(serialConfig_t, serialConfig, PG_SERIAL_CONFIG, 0);
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+typedef std::vector<uint8_t> bytes_t;
+
+// A port that receives what the test hands it and keeps what was sent
+typedef struct fakePort_s {
+    serialPort_t port;
+    bytes_t rx;
+    size_t rxPos;
+    size_t rxLimit;         // bytes that have arrived so far
+    bytes_t tx;
+    uint32_t txSize;
+    uint32_t txQueued;      // bytes of tx still in the transmit buffer
+} fakePort_t;
+
+static fakePort_t fakePorts[2];
+static fakePort_t &fake = fakePorts[0];
+static int fakePortCount;
+
+static fakePort_t *fakeOf(const serialPort_t *instance)
+{
+    return (fakePort_t *)instance;
+}
+
+static uint32_t fakeRxWaiting(const serialPort_t *instance)
+{
+    return fakeOf(instance)->rxLimit - fakeOf(instance)->rxPos;
+}
+
+static uint8_t fakeRead(serialPort_t *instance)
+{
+    fakePort_t *f = fakeOf(instance);
+    return f->rx[f->rxPos++];
+}
+
+static uint32_t fakeReadBuf(serialPort_t *instance, uint8_t *data, uint32_t count)
+{
+    fakePort_t *f = fakeOf(instance);
+    count = MIN(count, fakeRxWaiting(instance));
+    memcpy(data, &f->rx[f->rxPos], count);
+    f->rxPos += count;
+    return count;
+}
+
+static void fakeWrite(serialPort_t *instance, uint8_t ch)
+{
+    fakeOf(instance)->tx.push_back(ch);
+    fakeOf(instance)->txQueued++;
+}
+
+static uint32_t fakeTxFree(const serialPort_t *instance)
+{
+    fakePort_t *f = fakeOf(instance);
+    if (f->txQueued >= f->txSize) {
+        // Whoever waits for room gets it once the link has sent a byte
+        f->txQueued--;
+        return 0;
+    }
+    return f->txSize - f->txQueued;
+}
+
+static bool fakeTxEmpty(const serialPort_t *instance)
+{
+    return fakeOf(instance)->txQueued == 0;
+}
+
+static struct serialPortVTable fakeVTable = {
+    .serialWrite = fakeWrite,
+    .serialTotalRxWaiting = fakeRxWaiting,
+    .serialTotalTxFree = fakeTxFree,
+    .serialRead = fakeRead,
+    .serialSetBaudRate = NULL,
+    .isSerialTransmitBufferEmpty = fakeTxEmpty,
+    .setMode = NULL,
+    .setCtrlLineStateCb = NULL,
+    .setBaudRateCb = NULL,
+    .writeBuf = NULL,
+    .beginWrite = NULL,
+    .endWrite = NULL,
+    .readBuf = fakeReadBuf,
+};
+
+static int commandCount;
+static int16_t lastCommand;
+static bytes_t lastPayload;
+
+// Echoes the payload back
+static mspResult_e echoCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostProcessFnPtr *mspPostProcessFn)
+{
+    UNUSED(mspPostProcessFn);
+
+    commandCount++;
+    lastCommand = cmd->cmd;
+    lastPayload.assign(cmd->buf.ptr, cmd->buf.end);
+
+    reply->cmd = cmd->cmd;
+    reply->result = MSP_RESULT_ACK;
+    sbufWriteData(&reply->buf, cmd->buf.ptr, sbufBytesRemaining(&cmd->buf));
+    return MSP_RESULT_ACK;
+}
+
+// Echoes the payload back, twice if the command asks for it
+static mspResult_e echoTwiceCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostProcessFnPtr *mspPostProcessFn)
+{
+    echoCommand(cmd, reply, mspPostProcessFn);
+    if (cmd->cmd == 2) {
+        sbufWriteData(&reply->buf, cmd->buf.ptr, sbufBytesRemaining(&cmd->buf));
+    }
+    return MSP_RESULT_ACK;
+}
+
+static mspResult_e countCommand(mspPacket_t *cmd, mspPacket_t *reply, mspPostProcessFnPtr *mspPostProcessFn)
+{
+    UNUSED(cmd);
+    UNUSED(reply);
+    UNUSED(mspPostProcessFn);
+
+    commandCount++;
+    return MSP_RESULT_NO_REPLY;
+}
+
+static bytes_t frameV1(uint8_t direction, uint8_t cmd, const bytes_t &payload)
+{
+    bytes_t frame = { '$', 'M', direction, (uint8_t)payload.size(), cmd };
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    frame.push_back(crc8_xor_update(0, &frame[3], frame.size() - 3));
+    return frame;
+}
+
+static bytes_t headerV2(uint16_t cmd, const bytes_t &payload)
+{
+    bytes_t header = { 0, (uint8_t)cmd, (uint8_t)(cmd >> 8), (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8) };
+    header.insert(header.end(), payload.begin(), payload.end());
+    header.push_back(crc8_dvb_s2_update(0, header.data(), header.size()));
+    return header;
+}
+
+static bytes_t frameV2(uint8_t direction, uint16_t cmd, const bytes_t &payload)
+{
+    bytes_t frame = { '$', 'X', direction };
+    const bytes_t v2 = headerV2(cmd, payload);
+    frame.insert(frame.end(), v2.begin(), v2.end());
+    return frame;
+}
+
+static bytes_t frameV2OverV1(uint8_t direction, uint16_t cmd, const bytes_t &payload)
+{
+    return frameV1(direction, MSP_V2_FRAME_ID, headerV2(cmd, payload));
+}
+
+static bytes_t testPayload(size_t size, uint8_t seed)
+{
+    bytes_t payload(size);
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = seed + i * 7;
+    }
+    return payload;
+}
+
+class MspSerialTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        for (fakePort_t &f : fakePorts) {
+            memset(&f.port, 0, sizeof(f.port));
+            f.port.vTable = &fakeVTable;
+            f.rx.clear();
+            f.rxPos = f.rxLimit = 0;
+            f.tx.clear();
+            f.txSize = 1024;
+            f.txQueued = 0;
+        }
+        fakePortCount = 1;
+        fakeVTable.readBuf = fakeReadBuf;
+        commandCount = 0;
+        lastPayload.clear();
+
+        mspSerialInit();
+    }
+
+    void receive(const bytes_t &data)
+    {
+        fake.rx.insert(fake.rx.end(), data.begin(), data.end());
+    }
+
+    // Let `count` more bytes arrive and process all of them, over a link that sends whatever is written right away
+    void arrive(size_t count, mspProcessCommandFnPtr mspProcessCommandFn = echoCommand)
+    {
+        fake.rxLimit += MIN(count, fake.rx.size() - fake.rxLimit);
+        while (fakeRxWaiting(&fake.port)) {
+            fake.txQueued = 0;
+            mspSerialProcess(MSP_SKIP_NON_MSP_DATA, mspProcessCommandFn, NULL);
+        }
+    }
+
+    // Process everything that was received over a link that sends `txPerCall` bytes in between calls, returns the calls it took
+    int pipeline(uint32_t txPerCall, mspProcessCommandFnPtr mspProcessCommandFn = echoCommand)
+    {
+        fake.rxLimit = fake.rx.size();
+        int calls = 0;
+        while (fakeRxWaiting(&fake.port) || fake.txQueued) {
+            fake.txQueued -= MIN(txPerCall, fake.txQueued);
+            mspSerialProcess(MSP_SKIP_NON_MSP_DATA, mspProcessCommandFn, NULL);
+            calls++;
+        }
+        // Anything held back goes out on the next call
+        mspSerialProcess(MSP_SKIP_NON_MSP_DATA, mspProcessCommandFn, NULL);
+        return calls;
+    }
+};
+
+TEST_F(MspSerialTest, CommandsOfEveryVersionAreAnswered)
+{
+    const bytes_t payload = testPayload(150, 3);
+
+    receive(frameV1('<', 100, payload));
+    arrive(SIZE_MAX);
+    EXPECT_EQ(1, commandCount);
+    EXPECT_EQ(100, lastCommand);
+    EXPECT_EQ(payload, lastPayload);
+    EXPECT_EQ(frameV1('>', 100, payload), fake.tx);
+
+    fake.tx.clear();
+    receive(frameV2('<', 0x3003, payload));
+    arrive(SIZE_MAX);
+    EXPECT_EQ(2, commandCount);
+    EXPECT_EQ(0x3003, lastCommand);
+    EXPECT_EQ(payload, lastPayload);
+    EXPECT_EQ(frameV2('>', 0x3003, payload), fake.tx);
+
+    fake.tx.clear();
+    receive(frameV2OverV1('<', 0x3004, payload));
+    arrive(SIZE_MAX);
+    EXPECT_EQ(3, commandCount);
+    EXPECT_EQ(0x3004, lastCommand);
+    EXPECT_EQ(payload, lastPayload);
+    EXPECT_EQ(frameV2OverV1('>', 0x3004, payload), fake.tx);
+}
+
+TEST_F(MspSerialTest, PayloadArrivingInPiecesIsPutTogether)
+{
+    // The MSPv1 frame carries the MSPv2 header and checksum too
+    const bytes_t payload = testPayload(MSP_PORT_INBUF_SIZE, 9);
+    const bytes_t payloadOverV1 = testPayload(MSP_PORT_INBUF_SIZE - 6, 9);
+
+    for (size_t piece = 1; piece < 40; piece += 3) {
+        commandCount = 0;
+        receive(frameV2OverV1('<', 0x1234, payloadOverV1));
+        receive(frameV2('<', 0x1235, payload));
+        receive(frameV1('<', 7, bytes_t()));
+        while (fake.rxLimit < fake.rx.size()) {
+            arrive(piece);
+        }
+
+        EXPECT_EQ(3, commandCount) << "in pieces of " << piece;
+        EXPECT_EQ(7, lastCommand);
+        EXPECT_TRUE(lastPayload.empty());
+    }
+}
+
+TEST_F(MspSerialTest, WrongChecksumIsDropped)
+{
+    bytes_t frame = frameV1('<', 100, testPayload(20, 1));
+    frame[10] ^= 1;
+    receive(frame);
+    frame = frameV2('<', 101, testPayload(20, 1));
+    frame[10] ^= 1;
+    receive(frame);
+    // The parser is back in sync for what follows
+    receive(frameV2('<', 102, testPayload(20, 1)));
+    arrive(SIZE_MAX);
+
+    EXPECT_EQ(1, commandCount);
+    EXPECT_EQ(102, lastCommand);
+}
+
+TEST_F(MspSerialTest, PayloadTooBigForTheBufferIsDropped)
+{
+    receive(frameV2('<', 101, testPayload(MSP_PORT_INBUF_SIZE + 1, 1)));
+    receive(frameV2OverV1('<', 102, testPayload(MSP_PORT_INBUF_SIZE - 5, 1)));
+    receive(frameV2('<', 103, testPayload(MSP_PORT_INBUF_SIZE, 1)));
+    arrive(SIZE_MAX);
+
+    EXPECT_EQ(1, commandCount);
+    EXPECT_EQ(103, lastCommand);
+}
+
+TEST_F(MspSerialTest, DriversWithoutBulkReadsGetTheSameResult)
+{
+    fakeVTable.readBuf = NULL;
+
+    const bytes_t payload = testPayload(100, 5);
+    receive(frameV2('<', 0x2000, payload));
+    arrive(SIZE_MAX);
+
+    EXPECT_EQ(1, commandCount);
+    EXPECT_EQ(payload, lastPayload);
+    EXPECT_EQ(frameV2('>', 0x2000, payload), fake.tx);
+}
+
+TEST_F(MspSerialTest, PipelinedRequestsAreAllAnsweredInOrder)
+{
+    bytes_t expected;
+    for (int i = 0; i < 40; i++) {
+        const bytes_t payload = testPayload(i, i);
+        receive(frameV1('<', i, payload));
+        const bytes_t reply = frameV1('>', i, payload);
+        expected.insert(expected.end(), reply.begin(), reply.end());
+    }
+
+    // Room for a few replies at a time, and the link sends some of them between calls
+    fake.txSize = 128;
+    const int calls = pipeline(64);
+
+    EXPECT_EQ(40, commandCount);
+    EXPECT_EQ(expected, fake.tx);
+    // More than one request is answered per call
+    EXPECT_LT(calls, 40);
+}
+
+TEST_F(MspSerialTest, ReplyBiggerThanTheTransmitBufferWaitsForItToEmpty)
+{
+    receive(frameV2('<', 1, testPayload(10, 1)));
+    receive(frameV2('<', 2, testPayload(150, 2)));
+    receive(frameV2('<', 3, testPayload(10, 3)));
+
+    fake.txSize = 64;
+    pipeline(16);
+
+    bytes_t expected = frameV2('>', 1, testPayload(10, 1));
+    for (int i = 2; i <= 3; i++) {
+        const bytes_t reply = frameV2('>', i, testPayload(i == 2 ? 150 : 10, i));
+        expected.insert(expected.end(), reply.begin(), reply.end());
+    }
+    EXPECT_EQ(3, commandCount);
+    EXPECT_EQ(expected, fake.tx);
+}
+
+TEST_F(MspSerialTest, RequestsWaitWhileAReplyIsHeldBack)
+{
+    receive(frameV1('<', 1, testPayload(100, 1)));
+    receive(frameV1('<', 2, testPayload(100, 2)));
+    fake.rxLimit = fake.rx.size();
+
+    // Nothing is sent while the link is stalled
+    fake.txSize = 150;
+    for (int i = 0; i < 5; i++) {
+        mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+    }
+
+    EXPECT_EQ(2, commandCount);
+    EXPECT_EQ(frameV1('>', 1, testPayload(100, 1)), fake.tx);
+
+    // The second request is answered once there is room for it
+    fake.txQueued = 0;
+    mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+    EXPECT_EQ(2 * frameV1('>', 1, testPayload(100, 1)).size(), fake.tx.size());
+}
+
+TEST_F(MspSerialTest, ReplyTooBigToHoldBackIsDropped)
+{
+    receive(frameV2('<', 1, testPayload(10, 1)));
+    receive(frameV2('<', 2, testPayload(MSP_PORT_INBUF_SIZE / 2 + 1, 2)));
+    receive(frameV2('<', 3, testPayload(10, 3)));
+
+    // The reply to the second request is bigger than what is held back, and the first one is still being sent
+    fake.txSize = 64;
+    pipeline(16, echoTwiceCommand);
+
+    bytes_t expected = frameV2('>', 1, testPayload(10, 1));
+    const bytes_t reply = frameV2('>', 3, testPayload(10, 3));
+    expected.insert(expected.end(), reply.begin(), reply.end());
+    EXPECT_EQ(3, commandCount);
+    EXPECT_EQ(expected, fake.tx);
+}
+
+TEST_F(MspSerialTest, StalledPortDoesNotHoldUpTheOthers)
+{
+    fakePortCount = 2;
+    mspSerialInit();
+    fakePort_t &other = fakePorts[1];
+
+    // The host on the first port stops reading once its transmit buffer is full
+    fake.txSize = 150;
+    for (int i = 0; i < 3; i++) {
+        receive(frameV1('<', i, testPayload(100, i)));
+    }
+    fake.rxLimit = fake.rx.size();
+
+    for (int i = 0; i < 10; i++) {
+        other.rx = frameV1('<', 10 + i, testPayload(100, i));
+        other.rxPos = 0;
+        other.rxLimit = other.rx.size();
+        other.tx.clear();
+        other.txQueued = 0;
+        mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+
+        EXPECT_EQ(frameV1('>', 10 + i, testPayload(100, i)), other.tx);
+    }
+
+    // The first port got one reply out, holds the second and leaves the third request alone
+    EXPECT_EQ(12, commandCount);
+    EXPECT_EQ(frameV1('>', 0, testPayload(100, 0)), fake.tx);
+    EXPECT_GT(fakeRxWaiting(&fake.port), 0u);
+
+    // It carries on from there once its host reads again
+    fake.txQueued = 0;
+    mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+    fake.txQueued = 0;
+    mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+    mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+    bytes_t expected;
+    for (int i = 0; i < 3; i++) {
+        const bytes_t reply = frameV1('>', i, testPayload(100, i));
+        expected.insert(expected.end(), reply.begin(), reply.end());
+    }
+    EXPECT_EQ(expected, fake.tx);
+}
+
+TEST_F(MspSerialTest, RequestFlagsAreEchoedAsASequenceTag)
+{
+    for (uint8_t tag = 0xF0; tag < 0xF4; tag++) {
+        bytes_t frame = frameV2('<', 0x100, testPayload(4, tag));
+        frame[3] = tag;
+        frame.back() = crc8_dvb_s2_update(0, &frame[3], frame.size() - 4);
+        receive(frame);
+    }
+    fake.rxLimit = fake.rx.size();
+    mspSerialProcess(MSP_SKIP_NON_MSP_DATA, echoCommand, NULL);
+
+    // Every reply is 3 bytes of header, flags, 4 bytes of v2 header, 4 of payload and a checksum
+    ASSERT_EQ(4u * 13, fake.tx.size());
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(0xF0 + i, fake.tx[i * 13 + 3]);
+    }
+}
+
+TEST_F(MspSerialTest, BenchmarkParserThroughput)
+{
+    static const int BENCHMARK_FRAMES = 20000;
+
+    bytes_t frames;
+    for (int i = 0; i < 100; i++) {
+        const bytes_t frame = frameV2('<', 0x3000 + i, testPayload(MSP_PORT_INBUF_SIZE, i));
+        frames.insert(frames.end(), frame.begin(), frame.end());
+    }
+
+    double mbs[2];
+    for (int bulk = 0; bulk < 2; bulk++) {
+        fakeVTable.readBuf = bulk ? fakeReadBuf : NULL;
+        commandCount = 0;
+
+        const clock_t start = clock();
+        for (int n = 0; n < BENCHMARK_FRAMES; n += 100) {
+            fake.rx = frames;
+            fake.rxPos = fake.rxLimit = 0;
+            arrive(SIZE_MAX, countCommand);
+        }
+        mbs[bulk] = (double)BENCHMARK_FRAMES * frames.size() / 100 / 1e6 / ((double)(clock() - start) / CLOCKS_PER_SEC);
+
+        EXPECT_EQ(BENCHMARK_FRAMES, commandCount);
+    }
+
+    printf("MSP parser %.1fMB/s reading spans, %.1fMB/s reading byte by byte\n", mbs[1], mbs[0]);
+}
+
+// STUBS
+
+extern "C" {
+
+const uint32_t baudRates[] = { 0, 9600, 19200, 38400, 57600, 115200 };
+
+static serialPortConfig_t portConfigs[2] = { { .identifier = SERIAL_PORT_USART1 }, { .identifier = SERIAL_PORT_USART2 } };
+static int portConfigIndex;
+
+serialPortConfig_t *findSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+    portConfigIndex = 0;
+    return &portConfigs[0];
+}
+
+serialPortConfig_t *findNextSerialPortConfig(serialPortFunction_e function)
+{
+    UNUSED(function);
+    return ++portConfigIndex < fakePortCount ? &portConfigs[portConfigIndex] : NULL;
+}
+
+serialPort_t *openSerialPort(serialPortIdentifier_e identifier, serialPortFunction_e function, serialReceiveCallbackPtr rxCallback,
+    void *rxCallbackData, uint32_t baudrate, portMode_e mode, portOptions_e options)
+{
+    UNUSED(function);
+    UNUSED(rxCallback);
+    UNUSED(rxCallbackData);
+    UNUSED(baudrate);
+    UNUSED(mode);
+    UNUSED(options);
+    return &fakePorts[identifier == SERIAL_PORT_USART1 ? 0 : 1].port;
+}
+
+bool isSerialPortShared(const serialPortConfig_t *portConfig, uint16_t functionMask, serialPortFunction_e sharedWithFunction)
+{
+    UNUSED(portConfig);
+    UNUSED(functionMask);
+    UNUSED(sharedWithFunction);
+    return false;
+}
+
+void closeSerialPort(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void waitForSerialPortToFinishTransmitting(serialPort_t *serialPort)
+{
+    fakeOf(serialPort)->txQueued = 0;
+}
+
+timeMs_t millis(void)
+{
+    return 0;
+}
+
+void cliEnter(serialPort_t *serialPort)
+{
+    UNUSED(serialPort);
+}
+
+void systemResetToBootloader(bootloaderRequestType_e requestType)
+{
+    UNUSED(requestType);
+}
+
+}
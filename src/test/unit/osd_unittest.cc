@@ -66,6 +66,8 @@ extern "C" {
     void osdFormatTime(char * buff, osd_timer_precision_e precision, timeUs_t time);
     int osdConvertTemperatureToSelectedUnit(int tempInDegreesCelcius);
 
+    extern const osdElementDrawFn osdElementDrawFunction[OSD_ITEM_COUNT];
+
     uint16_t rssi;
     attitudeEulerAngles_t attitude;
     pidProfile_t *currentPidProfile;
@@ -1062,6 +1064,55 @@ TEST(OsdTest, TestConvertTemperatureUnits)
     EXPECT_EQ(osdConvertTemperatureToSelectedUnit(41), 106);
 }
 
+/*
+ * Tests that the screen is still pushed while a frame with many elements is drawn over several updates.
+ */
+TEST(OsdTest, TestScreenPushedWithManyElements)
+{
+    // given
+    // 40 active elements, drawn in 5 steps
+    uint16_t item_pos[OSD_ITEM_COUNT];
+    memcpy(item_pos, osdConfig()->item_pos, sizeof(item_pos));
+    int activeCount = 0;
+    for (int i = 0; i < OSD_ITEM_COUNT; i++) {
+        osdConfigMutable()->item_pos[i] = OSD_POS(10, 7);
+        if (osdElementDrawFunction[i] && activeCount < 40) {
+            osdConfigMutable()->item_pos[i] |= OSD_PROFILE_1_FLAG;
+            activeCount++;
+        }
+    }
+    ASSERT_EQ(40, activeCount);
+    osdAnalyzeActiveElements();
+
+    // and
+    // a PID profile for the PID elements
+    pidProfile_t pidProfile;
+    memset(&pidProfile, 0, sizeof(pidProfile));
+    currentPidProfile = &pidProfile;
+
+    // and
+    // craft is armed
+    ENABLE_ARMING_FLAG(ARMED);
+    simulationTime += 1e6;
+
+    // when
+    // the OSD is updated over several refreshes
+    displayPortTestDrawScreenCount = 0;
+    for (int i = 0; i < 100; i++) {
+        simulationTime += 1e4;
+        osdUpdate(simulationTime);
+    }
+
+    // then
+    // the screen is pushed in the calls between the drawing steps
+    EXPECT_GE(displayPortTestDrawScreenCount, 40);
+
+    DISABLE_ARMING_FLAG(ARMED);
+    memcpy(osdConfigMutable()->item_pos, item_pos, sizeof(item_pos));
+    osdAnalyzeActiveElements();
+    currentPidProfile = NULL;
+}
+
 // STUBS
 extern "C" {
     bool featureIsEnabled(uint32_t f) { return simulationFeatureFlags & f; }
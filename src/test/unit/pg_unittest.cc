@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include <limits.h>
+#include <time.h>
 
 extern "C" {
     #include <platform.h>
@@ -35,11 +36,31 @@ extern "C" {
 PG_REGISTER_WITH_RESET_TEMPLATE(motorConfig_t, motorConfig, PG_MOTOR_CONFIG, 1);
 
 PG_RESET_TEMPLATE(motorConfig_t, motorConfig,
+    .dev = {.motorPwmRate = 400},
     .minthrottle = 1150,
     .maxthrottle = 1850,
     .mincommand = 1000,
-    .dev = {.motorPwmRate = 400}
 );
+
+// Enough groups to look like a full build, registered out of PGN order
+typedef struct testConfig_s {
+    uint32_t value;
+} testConfig_t;
+
+#define TEST_PGN(n) (1000 + ((n) * 37) % 128)
+#define TEST_PG(n) PG_REGISTER(testConfig_t, testConfig ## n, TEST_PGN(n), 0)
+#define TEST_PG10(n) TEST_PG(n ## 0); TEST_PG(n ## 1); TEST_PG(n ## 2); TEST_PG(n ## 3); TEST_PG(n ## 4); \
+    TEST_PG(n ## 5); TEST_PG(n ## 6); TEST_PG(n ## 7); TEST_PG(n ## 8); TEST_PG(n ## 9)
+
+TEST_PG10(1);
+TEST_PG10(2);
+TEST_PG10(3);
+TEST_PG10(4);
+TEST_PG10(5);
+TEST_PG10(6);
+TEST_PG10(7);
+TEST_PG10(8);
+TEST_PG10(9);
 }
 
 
@@ -84,6 +105,91 @@ TEST(ParameterGroupsfTest, Test_pgFind)
     EXPECT_EQ(400, motorConfig3.dev.motorPwmRate);
 }
 
+TEST(ParameterGroupsfTest, Test_pgFindEveryGroup)
+{
+    EXPECT_EQ(91, PG_REGISTRY_SIZE);
+
+    PG_FOREACH(reg) {
+        EXPECT_EQ(reg, pgFind(pgN(reg)));
+    }
+    EXPECT_EQ(NULL, pgFind(0));
+    EXPECT_EQ(NULL, pgFind(TEST_PGN(10) + 128));
+    EXPECT_EQ(NULL, pgFind(PG_RESERVED_FOR_TESTING_1));
+}
+
+// A stored config the way config_eeprom.c lays it out, a record for every group in registry order
+typedef struct {
+    uint16_t size;
+    pgn_t pgn;
+    uint8_t version;
+    uint8_t flags;
+} PG_PACKED testRecord_t;
+
+static uint8_t testConfigImage[PG_REGISTRY_MAX * (sizeof(testRecord_t) + sizeof(motorConfig_t))];
+
+static void buildConfigImage(void)
+{
+    uint8_t *p = testConfigImage;
+
+    PG_FOREACH(reg) {
+        const testRecord_t record = { (uint16_t)(sizeof(testRecord_t) + pgSize(reg)), pgN(reg), pgVersion(reg), 0 };
+        memcpy(p, &record, sizeof(record));
+        p += record.size;
+    }
+    memset(p, 0, sizeof(uint16_t));
+}
+
+static const testRecord_t *nextRecord(const uint8_t **p)
+{
+    const testRecord_t *record = (const testRecord_t *)*p;
+    if (record->size == 0) {
+        return NULL;
+    }
+    *p += record->size;
+    return record;
+}
+
+TEST(ParameterGroupsfTest, BenchmarkConfigLoad)
+{
+    static const int BENCHMARK_LOOPS = 20000;
+
+    buildConfigImage();
+
+    // the previous loadEEPROM(): a scan of the stored records for every group
+    const testRecord_t *previousRecords[PG_REGISTRY_MAX];
+    clock_t start = clock();
+    for (int loop = 0; loop < BENCHMARK_LOOPS; loop++) {
+        PG_FOREACH(reg) {
+            const uint8_t *p = testConfigImage;
+            const testRecord_t *record;
+            while ((record = nextRecord(&p)) && record->pgn != pgN(reg));
+            previousRecords[pgRegistryIndex(reg)] = record;
+        }
+    }
+    const double previousUs = 1e6 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_LOOPS;
+
+    // one pass over the records, looking each group up by PGN
+    const testRecord_t *indexedRecords[PG_REGISTRY_MAX];
+    start = clock();
+    for (int loop = 0; loop < BENCHMARK_LOOPS; loop++) {
+        memset(indexedRecords, 0, sizeof(indexedRecords));
+        const uint8_t *p = testConfigImage;
+        const testRecord_t *record;
+        while ((record = nextRecord(&p))) {
+            const pgRegistry_t *reg = pgFind(record->pgn);
+            indexedRecords[pgRegistryIndex(reg)] = record;
+        }
+    }
+    const double indexedUs = 1e6 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_LOOPS;
+
+    printf("config load for %d groups: scan per group %.2fus, single pass %.2fus\n", (int)PG_REGISTRY_SIZE, previousUs, indexedUs);
+
+    PG_FOREACH(reg) {
+        ASSERT_NE(nullptr, indexedRecords[pgRegistryIndex(reg)]);
+        EXPECT_EQ(previousRecords[pgRegistryIndex(reg)], indexedRecords[pgRegistryIndex(reg)]);
+    }
+}
+
 // STUBS
 
 extern "C" {
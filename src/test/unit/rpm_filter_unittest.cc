@@ -0,0 +1,239 @@
+/*
+ * This file is part of Cleanflight.
+ *
+ * Cleanflight is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Cleanflight is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Cleanflight.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+extern "C" {
+    #include <platform.h>
+
+    #include "build/debug.h"
+    #include "common/axis.h"
+    #include "common/filter.h"
+    #include "common/maths.h"
+    #include "drivers/dshot.h"
+    #include "flight/mixer.h"
+    #include "flight/pid.h"
+    #include "flight/rpm_filter.h"
+    #include "pg/motor.h"
+    #include "pg/pg.h"
+    #include "pg/pg_ids.h"
+    #include "sensors/gyro.h"
+
+    PG_REGISTER(motorConfig_t, motorConfig, PG_MOTOR_CONFIG, 0);
+    PG_REGISTER(pidConfig_t, pidConfig, PG_PID_CONFIG, 0);
+
+    uint8_t debugMode;
+    int16_t debug[DEBUG16_VALUE_COUNT];
+    gyro_t gyro;
+}
+
+#include "unittest_macros.h"
+#include "gtest/gtest.h"
+
+#define TEST_MOTOR_COUNT     4
+#define TEST_HARMONICS       3
+#define TEST_NOTCHES         (TEST_MOTOR_COUNT * TEST_HARMONICS)
+#define TEST_LOOPTIME        125
+#define TEST_POLE_COUNT      14
+#define TEST_RPM_LPF         150
+#define TEST_NOTCH_MIN       100
+#define TEST_NOTCH_Q         500
+
+static uint16_t motorErpm[TEST_MOTOR_COUNT];
+
+static void setRpmFilterConfig(uint8_t dtermHarmonics)
+{
+    pgResetAll();
+    gyro.targetLooptime = TEST_LOOPTIME;
+    pidConfigMutable()->pid_process_denom = 1;
+    motorConfigMutable()->dev.useDshotTelemetry = true;
+    motorConfigMutable()->motorPoleCount = TEST_POLE_COUNT;
+
+    rpmFilterConfig_t *config = rpmFilterConfigMutable();
+    config->gyro_rpm_notch_harmonics = TEST_HARMONICS;
+    config->gyro_rpm_notch_min = TEST_NOTCH_MIN;
+    config->gyro_rpm_notch_q = TEST_NOTCH_Q;
+    config->dterm_rpm_notch_harmonics = dtermHarmonics;
+    config->dterm_rpm_notch_min = TEST_NOTCH_MIN;
+    config->dterm_rpm_notch_q = TEST_NOTCH_Q;
+    config->rpm_lpf = TEST_RPM_LPF;
+
+    memset(motorErpm, 0, sizeof(motorErpm));
+    rpmFilterInit(rpmFilterConfig());
+}
+
+// a throttle punch from idle to full speed and back, the motors slightly apart
+static void setMotorErpm(int loop)
+{
+    const uint16_t erpm = (loop >= 200 && loop < 600) ? 1500 : 300;
+    for (int motor = 0; motor < TEST_MOTOR_COUNT; motor++) {
+        motorErpm[motor] = erpm + 20 * motor;
+    }
+}
+
+static float testSignal(int loop, int axis)
+{
+    const float t = loop * TEST_LOOPTIME * 1e-6f;
+    return 100.0f * sinf(2.0f * M_PIf * 350.0f * t + axis) + 20.0f * sinf(2.0f * M_PIf * 1100.0f * t) + 5.0f * axis;
+}
+
+TEST(RpmFilter, FollowsMotorsEveryLoop)
+{
+    setRpmFilterConfig(0);
+
+    // a separately calculated scalar notch per motor, harmonic and axis, all recalculated every loop
+    const float erpmToHz = 100.0f / 60.0f / (TEST_POLE_COUNT / 2.0f);
+    const float maxHz = 0.48f / (TEST_LOOPTIME * 1e-6f);
+    pt1Filter_t referenceErpm[TEST_MOTOR_COUNT];
+    biquadFilter_t reference[TEST_NOTCHES][XYZ_AXIS_COUNT];
+    for (int motor = 0; motor < TEST_MOTOR_COUNT; motor++) {
+        pt1FilterInit(&referenceErpm[motor], pt1FilterGain(TEST_RPM_LPF, TEST_LOOPTIME * 1e-6f));
+    }
+    for (int notch = 0; notch < TEST_NOTCHES; notch++) {
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            biquadFilterInit(&reference[notch][axis], TEST_NOTCH_MIN, TEST_LOOPTIME, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+        }
+    }
+
+    float maxError = 0.0f;
+    for (int loop = 0; loop < 1000; loop++) {
+        setMotorErpm(loop);
+
+        rpmFilterUpdate();
+        for (int motor = 0; motor < TEST_MOTOR_COUNT; motor++) {
+            const float motorHz = erpmToHz * pt1FilterApply(&referenceErpm[motor], motorErpm[motor]);
+            for (int harmonic = 0; harmonic < TEST_HARMONICS; harmonic++) {
+                const float notchHz = constrainf((harmonic + 1) * motorHz, TEST_NOTCH_MIN, maxHz);
+                for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                    biquadFilterUpdate(&reference[motor * TEST_HARMONICS + harmonic][axis], notchHz, TEST_LOOPTIME, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+                }
+            }
+        }
+
+        float values[XYZ_AXIS_COUNT];
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            values[axis] = testSignal(loop, axis);
+        }
+        rpmFilterGyro(values);
+
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            float expected = testSignal(loop, axis);
+            for (int notch = 0; notch < TEST_NOTCHES; notch++) {
+                expected = biquadFilterApplyDF1(&reference[notch][axis], expected);
+            }
+            EXPECT_NEAR(expected, values[axis], 5e-2f) << "loop " << loop << " axis " << axis;
+            maxError = fmaxf(maxError, fabsf(expected - values[axis]));
+        }
+    }
+    printf("rpm filter bank, largest deviation from per-loop biquadFilterUpdate: %g\n", maxError);
+}
+
+TEST(RpmFilter, Disabled)
+{
+    setRpmFilterConfig(0);
+    rpmFilterConfigMutable()->gyro_rpm_notch_harmonics = 0;
+    rpmFilterInit(rpmFilterConfig());
+    EXPECT_FALSE(isRpmFilterEnabled());
+
+    setMotorErpm(0);
+    rpmFilterUpdate();
+    float values[XYZ_AXIS_COUNT] = { 1.0f, 2.0f, 3.0f };
+    rpmFilterGyro(values);
+    rpmFilterDterm(values);
+    EXPECT_FLOAT_EQ(1.0f, values[X]);
+    EXPECT_FLOAT_EQ(2.0f, values[Y]);
+    EXPECT_FLOAT_EQ(3.0f, values[Z]);
+}
+
+TEST(RpmFilter, BenchmarkPidLoop)
+{
+    static const int BENCHMARK_LOOPS = 200000;
+
+    // gyro and D-term filters with three harmonics each, gyro and PID loop at 8kHz
+    setRpmFilterConfig(TEST_HARMONICS);
+
+    // the previous implementation: one three-axis notch per motor and harmonic, spreading the
+    // coefficient updates so that every notch is recalculated once per millisecond
+    const int previousUpdatesPerLoop = 3;
+    static biquadFilter3_t previousGyro[TEST_NOTCHES];
+    static biquadFilter3_t previousDterm[TEST_NOTCHES];
+    pt1Filter_t previousErpm[TEST_MOTOR_COUNT];
+    for (int notch = 0; notch < TEST_NOTCHES; notch++) {
+        biquadFilter3Init(&previousGyro[notch], TEST_NOTCH_MIN, TEST_LOOPTIME, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+        biquadFilter3Init(&previousDterm[notch], TEST_NOTCH_MIN, TEST_LOOPTIME, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+    }
+    for (int motor = 0; motor < TEST_MOTOR_COUNT; motor++) {
+        pt1FilterInit(&previousErpm[motor], pt1FilterGain(TEST_RPM_LPF, TEST_LOOPTIME * 1e-6f));
+    }
+    const float erpmToHz = 100.0f / 60.0f / (TEST_POLE_COUNT / 2.0f);
+
+    float sum = 0;
+    int currentNotch = 0;
+    clock_t start = clock();
+    for (int loop = 0; loop < BENCHMARK_LOOPS; loop++) {
+        setMotorErpm(loop % 1000);
+        float motorHz[TEST_MOTOR_COUNT];
+        for (int motor = 0; motor < TEST_MOTOR_COUNT; motor++) {
+            motorHz[motor] = erpmToHz * pt1FilterApply(&previousErpm[motor], motorErpm[motor]);
+        }
+        for (int i = 0; i < previousUpdatesPerLoop; i++) {
+            const int notch = currentNotch % TEST_NOTCHES;
+            const float notchHz = constrainf((notch % TEST_HARMONICS + 1) * motorHz[notch / TEST_HARMONICS], TEST_NOTCH_MIN, 3840.0f);
+            biquadFilter3Update(currentNotch < TEST_NOTCHES ? &previousGyro[notch] : &previousDterm[notch], notchHz, TEST_LOOPTIME, TEST_NOTCH_Q / 100.0f, FILTER_NOTCH);
+            currentNotch = (currentNotch + 1) % (2 * TEST_NOTCHES);
+        }
+        float gyroValues[XYZ_AXIS_COUNT] = { testSignal(loop, X), testSignal(loop, Y), testSignal(loop, Z) };
+        float dtermValues[XYZ_AXIS_COUNT] = { gyroValues[X], gyroValues[Y], gyroValues[Z] };
+        for (int notch = 0; notch < TEST_NOTCHES; notch++) {
+            biquadFilterApply3DF1(&previousGyro[notch], gyroValues);
+        }
+        for (int notch = 0; notch < TEST_NOTCHES; notch++) {
+            biquadFilterApply3DF1(&previousDterm[notch], dtermValues);
+        }
+        sum += gyroValues[X] + dtermValues[X];
+    }
+    const double previousNs = 1e9 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_LOOPS;
+
+    start = clock();
+    for (int loop = 0; loop < BENCHMARK_LOOPS; loop++) {
+        setMotorErpm(loop % 1000);
+        rpmFilterUpdate();
+        float gyroValues[XYZ_AXIS_COUNT] = { testSignal(loop, X), testSignal(loop, Y), testSignal(loop, Z) };
+        float dtermValues[XYZ_AXIS_COUNT] = { gyroValues[X], gyroValues[Y], gyroValues[Z] };
+        rpmFilterGyro(gyroValues);
+        rpmFilterDterm(dtermValues);
+        sum += gyroValues[X] + dtermValues[X];
+    }
+    const double bankNs = 1e9 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_LOOPS;
+
+    printf("rpm filter per PID loop, %d notches on gyro and D-term: staggered updates (every %d loops) %.1fns, notch bank (every loop) %.1fns (%f)\n",
+        TEST_NOTCHES, 2 * TEST_NOTCHES / previousUpdatesPerLoop, previousNs, bankNs, sum);
+}
+
+// STUBS
+
+extern "C" {
+
+uint8_t getMotorCount(void) { return TEST_MOTOR_COUNT; }
+uint16_t getDshotTelemetry(uint8_t index) { return motorErpm[index]; }
+
+}
@@ -16,6 +16,7 @@
  */
 
 #include <stdint.h>
+#include <time.h>
 
 extern "C" {
     #include "platform.h"
@@ -33,6 +34,15 @@ const int TEST_UPDATE_RX_CHECK_TIME = 34;
 const int TEST_UPDATE_RX_MAIN_TIME = 1;
 const int TEST_IMU_UPDATE_TIME = 5;
 const int TEST_DISPATCH_TIME = 1;
+const int TEST_UPDATE_BATTERY_CURRENT_TIME = 2;
+const int TEST_BATTERY_ALERTS_TIME = 3;
+const int TEST_BEEPER_TIME = 1;
+const int TEST_GPS_TIME = 40;
+const int TEST_COMPASS_TIME = 25;
+const int TEST_BARO_TIME = 20;
+const int TEST_ALTITUDE_TIME = 15;
+const int TEST_TELEMETRY_TIME = 60;
+const int TEST_LEDSTRIP_TIME = 80;
 
 #define TASK_COUNT_UNITTEST (TASK_BATTERY_VOLTAGE + 1)
 #define TASK_PERIOD_HZ(hz) (1000000 / (hz))
@@ -55,6 +65,15 @@ extern "C" {
     void taskUpdateRxMain(timeUs_t) { simulatedTime += TEST_UPDATE_RX_MAIN_TIME; }
     void imuUpdateAttitude(timeUs_t) { simulatedTime += TEST_IMU_UPDATE_TIME; }
     void dispatchProcess(timeUs_t) { simulatedTime += TEST_DISPATCH_TIME; }
+    void taskUpdateBatteryCurrent(timeUs_t) { simulatedTime += TEST_UPDATE_BATTERY_CURRENT_TIME; }
+    void taskBatteryAlerts(timeUs_t) { simulatedTime += TEST_BATTERY_ALERTS_TIME; }
+    void beeperUpdate(timeUs_t) { simulatedTime += TEST_BEEPER_TIME; }
+    void gpsUpdate(timeUs_t) { simulatedTime += TEST_GPS_TIME; }
+    void compassUpdate(timeUs_t) { simulatedTime += TEST_COMPASS_TIME; }
+    void taskUpdateBaro(timeUs_t) { simulatedTime += TEST_BARO_TIME; }
+    void taskCalculateAltitude(timeUs_t) { simulatedTime += TEST_ALTITUDE_TIME; }
+    void taskTelemetry(timeUs_t) { simulatedTime += TEST_TELEMETRY_TIME; }
+    void ledStripUpdate(timeUs_t) { simulatedTime += TEST_LEDSTRIP_TIME; }
 
     extern int taskQueueSize;
     extern cfTask_t* taskQueueArray[];
@@ -66,6 +85,9 @@ extern "C" {
     extern cfTask_t *queueFirst(void);
     extern cfTask_t *queueNext(void);
 
+    extern int deadlineQueueSize;
+    extern cfTask_t* deadlineQueueArray[];
+
     cfTask_t cfTasks[TASK_COUNT] = {
         [TASK_SYSTEM] = {
             .taskName = "SYSTEM",
@@ -116,6 +138,60 @@ extern "C" {
             .taskFunc = taskUpdateBatteryVoltage,
             .desiredPeriod = TASK_PERIOD_HZ(50),
             .staticPriority = TASK_PRIORITY_MEDIUM,
+        },
+        [TASK_BATTERY_CURRENT] = {
+            .taskName = "BATTERY_CURRENT",
+            .taskFunc = taskUpdateBatteryCurrent,
+            .desiredPeriod = TASK_PERIOD_HZ(50),
+            .staticPriority = TASK_PRIORITY_MEDIUM,
+        },
+        [TASK_BATTERY_ALERTS] = {
+            .taskName = "BATTERY_ALERTS",
+            .taskFunc = taskBatteryAlerts,
+            .desiredPeriod = TASK_PERIOD_HZ(5),
+            .staticPriority = TASK_PRIORITY_MEDIUM,
+        },
+        [TASK_BEEPER] = {
+            .taskName = "BEEPER",
+            .taskFunc = beeperUpdate,
+            .desiredPeriod = TASK_PERIOD_HZ(100),
+            .staticPriority = TASK_PRIORITY_LOW,
+        },
+        [TASK_GPS] = {
+            .taskName = "GPS",
+            .taskFunc = gpsUpdate,
+            .desiredPeriod = TASK_PERIOD_HZ(100),
+            .staticPriority = TASK_PRIORITY_MEDIUM,
+        },
+        [TASK_COMPASS] = {
+            .taskName = "COMPASS",
+            .taskFunc = compassUpdate,
+            .desiredPeriod = TASK_PERIOD_HZ(10),
+            .staticPriority = TASK_PRIORITY_LOW,
+        },
+        [TASK_BARO] = {
+            .taskName = "BARO",
+            .taskFunc = taskUpdateBaro,
+            .desiredPeriod = TASK_PERIOD_HZ(20),
+            .staticPriority = TASK_PRIORITY_LOW,
+        },
+        [TASK_ALTITUDE] = {
+            .taskName = "ALTITUDE",
+            .taskFunc = taskCalculateAltitude,
+            .desiredPeriod = TASK_PERIOD_HZ(40),
+            .staticPriority = TASK_PRIORITY_LOW,
+        },
+        [TASK_TELEMETRY] = {
+            .taskName = "TELEMETRY",
+            .taskFunc = taskTelemetry,
+            .desiredPeriod = TASK_PERIOD_HZ(250),
+            .staticPriority = TASK_PRIORITY_LOW,
+        },
+        [TASK_LEDSTRIP] = {
+            .taskName = "LEDSTRIP",
+            .taskFunc = ledStripUpdate,
+            .desiredPeriod = TASK_PERIOD_HZ(100),
+            .staticPriority = TASK_PRIORITY_LOW,
         }
     };
 }
@@ -393,3 +469,234 @@ TEST(SchedulerUnittest, TestTwoTasks)
     scheduler();
     EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
 }
+
+static void setUpAllTasks(void)
+{
+    schedulerInit();
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        cfTasks[taskId].lastExecutedAt = 0;
+        cfTasks[taskId].lastDesiredAt = 0;
+        cfTasks[taskId].lastSignaledAt = 0;
+        cfTasks[taskId].dynamicPriority = 0;
+        cfTasks[taskId].taskAgeCycles = 0;
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), cfTasks[taskId].taskFunc != NULL);
+    }
+    simulatedTime = 0;
+}
+
+TEST(SchedulerUnittest, TestDeadlineQueue)
+{
+    setUpAllTasks();
+    schedulerUseDeadlineQueue(true);
+
+    // only time-driven tasks are held in the deadline queue, and its root is the task that is due first
+    int timeDrivenTasks = 0;
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        if (cfTasks[taskId].taskFunc && !cfTasks[taskId].checkFunc) {
+            timeDrivenTasks++;
+        }
+    }
+    EXPECT_EQ(timeDrivenTasks, deadlineQueueSize);
+    EXPECT_EQ(1000, deadlineQueueArray[0]->lastExecutedAt + deadlineQueueArray[0]->desiredPeriod);
+    for (int pos = 1; pos < deadlineQueueSize; ++pos) {
+        const cfTask_t *parent = deadlineQueueArray[(pos - 1) / 2];
+        EXPECT_LE(parent->lastExecutedAt + parent->desiredPeriod, deadlineQueueArray[pos]->lastExecutedAt + deadlineQueueArray[pos]->desiredPeriod);
+    }
+
+    // nothing is due yet
+    simulatedTime = 50;
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+    EXPECT_EQ(0, unittest_scheduler_waitingTasks);
+
+    // TASK_DISPATCH is due after 1000us, TASK_GYROPID is due at the same time and takes precedence
+    simulatedTime = 1000;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+    EXPECT_EQ(2, unittest_scheduler_waitingTasks);
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_DISPATCH], unittest_scheduler_selectedTask);
+
+    // rescheduling a task moves it within the deadline queue
+    rescheduleTask(TASK_SERIAL, 100);
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], deadlineQueueArray[0]);
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_SERIAL], unittest_scheduler_selectedTask);
+    rescheduleTask(TASK_SERIAL, TASK_PERIOD_HZ(100));
+
+    // disabled tasks are removed from the deadline queue
+    setTaskEnabled(TASK_GYROPID, false);
+    EXPECT_EQ(timeDrivenTasks - 1, deadlineQueueSize);
+    setTaskEnabled(TASK_RX, false);
+    EXPECT_EQ(timeDrivenTasks - 1, deadlineQueueSize);
+
+    schedulerUseDeadlineQueue(false);
+}
+
+static const int SCHEDULER_SIMULATION_PASSES = 20000;
+
+static void simulateScheduler(bool useDeadlineQueue, cfTask_t **selectedTasks)
+{
+    setUpAllTasks();
+    schedulerUseDeadlineQueue(useDeadlineQueue);
+
+    for (int ii = 0; ii < SCHEDULER_SIMULATION_PASSES; ++ii) {
+        scheduler();
+        selectedTasks[ii] = unittest_scheduler_selectedTask;
+        if (!unittest_scheduler_selectedTask) {
+            // idle pass, let some time go by
+            simulatedTime += 7;
+        }
+    }
+
+    schedulerUseDeadlineQueue(false);
+}
+
+TEST(SchedulerUnittest, TestDeadlineQueueMatchesQueueScan)
+{
+    // the deadline queue must select exactly the same tasks, in the same order, as walking the whole queue
+    static cfTask_t *queueScanSelections[SCHEDULER_SIMULATION_PASSES];
+    static cfTask_t *deadlineQueueSelections[SCHEDULER_SIMULATION_PASSES];
+
+    for (int optimizeRate = 0; optimizeRate <= 1; ++optimizeRate) {
+        schedulerOptimizeRate(optimizeRate);
+        simulateScheduler(false, queueScanSelections);
+        simulateScheduler(true, deadlineQueueSelections);
+
+        int executedTasks = 0;
+        for (int ii = 0; ii < SCHEDULER_SIMULATION_PASSES; ++ii) {
+            ASSERT_EQ(queueScanSelections[ii], deadlineQueueSelections[ii]) << "pass " << ii;
+            if (queueScanSelections[ii]) {
+                executedTasks++;
+            }
+        }
+        EXPECT_GT(executedTasks, 0);
+        EXPECT_LT(executedTasks, SCHEDULER_SIMULATION_PASSES);
+    }
+    schedulerOptimizeRate(false);
+}
+
+static double benchmarkScheduler(bool useDeadlineQueue, bool idleOnly)
+{
+    static const int BENCHMARK_PASSES = 1000000;
+
+    setUpAllTasks();
+    schedulerUseDeadlineQueue(useDeadlineQueue);
+
+    const clock_t start = clock();
+    for (int ii = 0; ii < BENCHMARK_PASSES; ++ii) {
+        if (idleOnly) {
+            // keep every task from becoming due
+            simulatedTime = 1;
+        }
+        scheduler();
+    }
+    const clock_t end = clock();
+
+    schedulerUseDeadlineQueue(false);
+
+    return 1e9 * (end - start) / CLOCKS_PER_SEC / BENCHMARK_PASSES;
+}
+
+TEST(SchedulerUnittest, BenchmarkDeadlineQueue)
+{
+    const double queueScanIdle = benchmarkScheduler(false, true);
+    const double deadlineQueueIdle = benchmarkScheduler(true, true);
+    const double queueScanLoaded = benchmarkScheduler(false, false);
+    const double deadlineQueueLoaded = benchmarkScheduler(true, false);
+
+    printf("scheduler pass, %d tasks, idle:   queue scan %.1fns, deadline queue %.1fns\n", taskQueueSize, queueScanIdle, deadlineQueueIdle);
+    printf("scheduler pass, %d tasks, loaded: queue scan %.1fns, deadline queue %.1fns\n", taskQueueSize, queueScanLoaded, deadlineQueueLoaded);
+}
+
+TEST(SchedulerUnittest, TestTaskHistograms)
+{
+    schedulerInit();
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    schedulerResetTaskStatistics(TASK_GYROPID);
+
+    cfTasks[TASK_GYROPID].lastExecutedAt = 0;
+    simulatedTime = 0;
+    // run TASK_GYROPID on time 100 times, then 1 time 300us late
+    for (int ii = 0; ii < 100; ++ii) {
+        simulatedTime = cfTasks[TASK_GYROPID].lastExecutedAt + cfTasks[TASK_GYROPID].desiredPeriod;
+        scheduler();
+        EXPECT_EQ(&cfTasks[TASK_GYROPID], unittest_scheduler_selectedTask);
+    }
+    simulatedTime = cfTasks[TASK_GYROPID].lastExecutedAt + cfTasks[TASK_GYROPID].desiredPeriod + 300;
+    scheduler();
+
+    cfTaskHistogramInfo_t histogramInfo;
+    getTaskHistogramInfo(TASK_GYROPID, &histogramInfo);
+    EXPECT_EQ(101, histogramInfo.sampleCount);
+    // percentiles are reported as the upper bound of their histogram bucket
+    EXPECT_LE(TEST_PID_LOOP_TIME, histogramInfo.executionTime[TASK_PERCENTILE_50]);
+    EXPECT_GT(TEST_PID_LOOP_TIME * 3 / 2, histogramInfo.executionTime[TASK_PERCENTILE_99_9]);
+    EXPECT_EQ(0, histogramInfo.lateness[TASK_PERCENTILE_50]);
+    EXPECT_EQ(0, histogramInfo.lateness[TASK_PERCENTILE_99]);
+    EXPECT_LE(300, histogramInfo.lateness[TASK_PERCENTILE_99_9]);
+    EXPECT_GT(450, histogramInfo.lateness[TASK_PERCENTILE_99_9]);
+
+    schedulerResetTaskStatistics(TASK_GYROPID);
+    getTaskHistogramInfo(TASK_GYROPID, &histogramInfo);
+    EXPECT_EQ(0, histogramInfo.sampleCount);
+    EXPECT_EQ(0, histogramInfo.executionTime[TASK_PERCENTILE_99_9]);
+}
+
+TEST(SchedulerUnittest, TestDeadlineGuard)
+{
+    schedulerInit();
+    for (int taskId = 0; taskId < TASK_COUNT; ++taskId) {
+        setTaskEnabled(static_cast<cfTaskId_e>(taskId), false);
+    }
+    setTaskEnabled(TASK_GYROPID, true);
+    setTaskEnabled(TASK_ACCEL, true);
+    schedulerUseDeadlineGuard(true);
+
+    // TASK_GYROPID is next due at 11000
+    cfTasks[TASK_GYROPID].lastExecutedAt = 10000;
+    cfTasks[TASK_ACCEL].lastExecutedAt = 0;
+    cfTasks[TASK_ACCEL].anticipatedExecutionTime = 0;
+
+    // TASK_ACCEL has not been run yet, so it is expected to fit and learns its execution time when it runs
+    simulatedTime = 10000;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
+    EXPECT_EQ(10000 + TEST_UPDATE_ACCEL_TIME, simulatedTime);
+
+    // TASK_ACCEL would not finish before TASK_GYROPID is due, so nothing runs
+    cfTasks[TASK_ACCEL].lastExecutedAt = 10850 - cfTasks[TASK_ACCEL].desiredPeriod;
+    simulatedTime = 10850;
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+
+    // with enough time left before TASK_GYROPID is due TASK_ACCEL runs
+    simulatedTime = 11000 - TEST_UPDATE_ACCEL_TIME;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
+
+    // a task that never fits is run once it has aged enough
+    cfTasks[TASK_ACCEL].anticipatedExecutionTime = 5000 << 7;
+    cfTasks[TASK_ACCEL].lastExecutedAt = 10000 - 3 * cfTasks[TASK_ACCEL].desiredPeriod;
+    simulatedTime = 10000;
+    scheduler();
+    EXPECT_EQ(static_cast<cfTask_t*>(0), unittest_scheduler_selectedTask);
+    cfTasks[TASK_ACCEL].lastExecutedAt = 10000 - 4 * cfTasks[TASK_ACCEL].desiredPeriod;
+    simulatedTime = 10000;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
+
+    // the anticipated execution time decays towards the measured execution time
+    EXPECT_GT(5000u << 7, cfTasks[TASK_ACCEL].anticipatedExecutionTime);
+    EXPECT_LT((uint32_t)TEST_UPDATE_ACCEL_TIME << 7, cfTasks[TASK_ACCEL].anticipatedExecutionTime);
+
+    // without the guard the task runs regardless of its anticipated execution time
+    schedulerUseDeadlineGuard(false);
+    cfTasks[TASK_ACCEL].lastExecutedAt = 10850 - cfTasks[TASK_ACCEL].desiredPeriod;
+    simulatedTime = 10850;
+    scheduler();
+    EXPECT_EQ(&cfTasks[TASK_ACCEL], unittest_scheduler_selectedTask);
+}
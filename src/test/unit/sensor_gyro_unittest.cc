@@ -19,6 +19,9 @@
 #include <stdbool.h>
 
 #include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
 #include <algorithm>
 
 extern "C" {
@@ -149,6 +152,153 @@ TEST(SensorGyro, Update)
     EXPECT_NEAR(90 * gyroDevPtr->scale, gyro.gyroADCf[Z], 1e-3);
 }
 
+static const int GYRO_TRACE_LENGTH = 8000;
+static float gyroTrace[GYRO_TRACE_LENGTH][XYZ_AXIS_COUNT];
+
+// synthetic stand-in for a recorded gyro trace: stick inputs, motor noise and its harmonic, and broadband noise
+static void generateGyroTrace(void)
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < GYRO_TRACE_LENGTH; i++) {
+        const float t = i / 8000.0f;
+        for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+            seed = seed * 1664525 + 1013904223;
+            const float noise = ((int32_t)(seed >> 16) - 32768) / 32768.0f;
+            gyroTrace[i][axis] = 200 * sinf(2 * M_PIf * 2 * t + axis)
+                + 30 * sinf(2 * M_PIf * (180 + 20 * axis) * t)
+                + 10 * sinf(2 * M_PIf * (360 + 40 * axis) * t)
+                + 5 * noise;
+        }
+    }
+}
+
+static void setFilterConfig(bool enableFilters)
+{
+    pgResetAll();
+    gyroConfigMutable()->gyro_soft_notch_hz_1 = enableFilters ? 300 : 0;
+    gyroConfigMutable()->gyro_soft_notch_cutoff_1 = 200;
+    gyroConfigMutable()->gyro_soft_notch_hz_2 = enableFilters ? 200 : 0;
+    gyroConfigMutable()->gyro_soft_notch_cutoff_2 = 100;
+    gyroConfigMutable()->gyro_lowpass_type = FILTER_PT1;
+    gyroConfigMutable()->gyro_lowpass_hz = enableFilters ? 150 : 0;
+    gyroConfigMutable()->gyro_lowpass2_type = FILTER_BIQUAD;
+    gyroConfigMutable()->gyro_lowpass2_hz = enableFilters ? 250 : 0;
+    gyroInit();
+}
+
+// the per-axis function pointer chain the filter pipeline replaced, one call per stage and axis
+typedef struct referenceFilters_s {
+    filterApplyFnPtr applyFn[4];
+    biquadFilter_t notchFilter1[XYZ_AXIS_COUNT];
+    biquadFilter_t notchFilter2[XYZ_AXIS_COUNT];
+    pt1Filter_t lowpassFilter[XYZ_AXIS_COUNT];
+    biquadFilter_t lowpass2Filter[XYZ_AXIS_COUNT];
+} referenceFilters_t;
+
+static void referenceBiquadInit(biquadFilter_t *filter, const biquadFilter3_t *lanes, int axis)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->b0 = lanes->b0[axis];
+    filter->b1 = lanes->b1[axis];
+    filter->b2 = lanes->b2[axis];
+    filter->a1 = lanes->a1[axis];
+    filter->a2 = lanes->a2[axis];
+}
+
+static void referenceFiltersInit(referenceFilters_t *reference, bool enableFilters)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        referenceBiquadInit(&reference->notchFilter1[axis], &gyro.notchFilter1, axis);
+        referenceBiquadInit(&reference->notchFilter2[axis], &gyro.notchFilter2, axis);
+        pt1FilterInit(&reference->lowpassFilter[axis], gyro.lowpassFilter.pt1FilterState.k[axis]);
+        referenceBiquadInit(&reference->lowpass2Filter[axis], &gyro.lowpass2Filter.biquadFilterState, axis);
+    }
+    reference->applyFn[0] = enableFilters ? (filterApplyFnPtr)biquadFilterApply : nullFilterApply;
+    reference->applyFn[1] = enableFilters ? (filterApplyFnPtr)biquadFilterApply : nullFilterApply;
+    reference->applyFn[2] = enableFilters ? (filterApplyFnPtr)pt1FilterApply : nullFilterApply;
+#ifdef USE_DYN_LPF
+    reference->applyFn[3] = enableFilters ? (filterApplyFnPtr)biquadFilterApplyDF1 : nullFilterApply;
+#else
+    reference->applyFn[3] = enableFilters ? (filterApplyFnPtr)biquadFilterApply : nullFilterApply;
+#endif
+}
+
+static void referenceFiltersApply(referenceFilters_t *reference, float *gyroADCf)
+{
+    for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+        gyroADCf[axis] = reference->applyFn[0]((filter_t *)&reference->notchFilter1[axis], gyroADCf[axis]);
+        gyroADCf[axis] = reference->applyFn[1]((filter_t *)&reference->notchFilter2[axis], gyroADCf[axis]);
+        gyroADCf[axis] = reference->applyFn[2]((filter_t *)&reference->lowpassFilter[axis], gyroADCf[axis]);
+        gyroADCf[axis] = reference->applyFn[3]((filter_t *)&reference->lowpass2Filter[axis], gyroADCf[axis]);
+    }
+}
+
+TEST(SensorGyro, FilterPipeline)
+{
+    generateGyroTrace();
+
+    for (int enableFilters = 0; enableFilters <= 1; enableFilters++) {
+        setFilterConfig(enableFilters);
+        EXPECT_EQ(enableFilters ? 2 : 0, gyro.staticNotchCount);
+        EXPECT_EQ(enableFilters ? GYRO_LOWPASS_STAGE_PT1 : GYRO_LOWPASS_STAGE_NONE, gyro.lowpassStage);
+        EXPECT_EQ(enableFilters ? GYRO_LOWPASS_STAGE_BIQUAD : GYRO_LOWPASS_STAGE_NONE, gyro.lowpass2Stage);
+
+        static referenceFilters_t reference;
+        referenceFiltersInit(&reference, enableFilters);
+
+        // the pipeline must produce exactly the output of the function pointer chain
+        for (int i = 0; i < GYRO_TRACE_LENGTH; i++) {
+            float pipelineADCf[XYZ_AXIS_COUNT];
+            float referenceADCf[XYZ_AXIS_COUNT];
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                pipelineADCf[axis] = referenceADCf[axis] = gyroTrace[i][axis];
+            }
+            gyro.filterPipelineApplyFn(pipelineADCf);
+            referenceFiltersApply(&reference, referenceADCf);
+            for (int axis = 0; axis < XYZ_AXIS_COUNT; axis++) {
+                ASSERT_EQ(referenceADCf[axis], pipelineADCf[axis]) << "sample " << i << " axis " << axis;
+            }
+        }
+    }
+}
+
+TEST(SensorGyro, BenchmarkFilterPipeline)
+{
+    static const int BENCHMARK_REPLAYS = 50;
+
+    generateGyroTrace();
+
+    for (int enableFilters = 0; enableFilters <= 1; enableFilters++) {
+        setFilterConfig(enableFilters);
+        static referenceFilters_t reference;
+        referenceFiltersInit(&reference, enableFilters);
+
+        float sum = 0;
+        clock_t start = clock();
+        for (int replay = 0; replay < BENCHMARK_REPLAYS; replay++) {
+            for (int i = 0; i < GYRO_TRACE_LENGTH; i++) {
+                float gyroADCf[XYZ_AXIS_COUNT] = { gyroTrace[i][X], gyroTrace[i][Y], gyroTrace[i][Z] };
+                referenceFiltersApply(&reference, gyroADCf);
+                sum += gyroADCf[X];
+            }
+        }
+        const double referenceNs = 1e9 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_REPLAYS / GYRO_TRACE_LENGTH;
+
+        start = clock();
+        for (int replay = 0; replay < BENCHMARK_REPLAYS; replay++) {
+            for (int i = 0; i < GYRO_TRACE_LENGTH; i++) {
+                float gyroADCf[XYZ_AXIS_COUNT] = { gyroTrace[i][X], gyroTrace[i][Y], gyroTrace[i][Z] };
+                gyro.filterPipelineApplyFn(gyroADCf);
+                sum += gyroADCf[X];
+            }
+        }
+        const double pipelineNs = 1e9 * (clock() - start) / CLOCKS_PER_SEC / BENCHMARK_REPLAYS / GYRO_TRACE_LENGTH;
+
+        printf("gyro filters per sample, filters %s: function pointer chain %.1fns, pipeline %.1fns (%f)\n",
+            enableFilters ? "on" : "off", referenceNs, pipelineNs, sum);
+    }
+}
+
 // STUBS
 
 extern "C" {
@@ -55,9 +55,12 @@ static int displayPortTestClearScreen(displayPort_t *displayPort)
     return 0;
 }
 
+static int displayPortTestDrawScreenCount = 0;
+
 static int displayPortTestDrawScreen(displayPort_t *displayPort)
 {
     UNUSED(displayPort);
+    displayPortTestDrawScreenCount++;
     return 0;
 }
 
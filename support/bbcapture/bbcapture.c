@@ -0,0 +1,193 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Records the live blackbox stream of a SITL (blackbox_device = STREAM) into a plain .bbl file.
+ *
+ *     bbcapture [-h host] [-p port] [-n logs] LOG00001.BBL
+ *
+ * Stops when the firmware goes away, after `logs` complete logs or on ctrl-c. A summary of what arrived is printed at
+ * the end, the exit code is 2 when chunks were lost on the way so scripted runs can tell a log with holes.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "blackbox/blackbox_stream.h"
+
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT "5770"
+
+static volatile sig_atomic_t stopRequested;
+
+static void onSignal(int signal)
+{
+    (void)signal;
+    stopRequested = 1;
+}
+
+static int connectTo(const char *host, const char *port)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addresses;
+    if (getaddrinfo(host, port, &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    return fd;
+}
+
+// Returns false at the end of the stream
+static bool readFully(int fd, void *data, size_t length)
+{
+    uint8_t *p = data;
+    while (length > 0) {
+        const ssize_t count = recv(fd, p, length, 0);
+        if (count <= 0) {
+            return false;
+        }
+        p += count;
+        length -= count;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *host = DEFAULT_HOST;
+    const char *port = DEFAULT_PORT;
+    long logLimit = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "h:p:n:")) != -1) {
+        switch (option) {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = optarg;
+            break;
+        case 'n':
+            logLimit = strtol(optarg, NULL, 10);
+            break;
+        default:
+            optind = argc;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-n logs] <output>\n", argv[0]);
+        return 1;
+    }
+
+    const int fd = connectTo(host, port);
+    if (fd < 0) {
+        fprintf(stderr, "can't connect to %s:%s\n", host, port);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[optind], "wb");
+    if (!file) {
+        fprintf(stderr, "can't write %s\n", argv[optind]);
+        return 1;
+    }
+
+    // No SA_RESTART, ctrl-c has to get us out of recv()
+    struct sigaction action = { .sa_handler = onSignal };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    static uint8_t payload[BLACKBOX_STREAM_CHUNK_SIZE];
+    uint32_t expectedSequence = 0;
+    uint32_t lastDropped = 0;
+    unsigned long chunks = 0;
+    unsigned long missingChunks = 0;
+    unsigned long droppedBytes = 0;
+    unsigned long long bytes = 0;
+    long logs = 0;
+    bool writeFailed = false;
+
+    while (!stopRequested && (logLimit == 0 || logs < logLimit)) {
+        blackboxStreamHeader_t header;
+        if (!readFully(fd, &header, sizeof(header))) {
+            break;
+        }
+        if (header.magic != BLACKBOX_STREAM_MAGIC || header.length > BLACKBOX_STREAM_CHUNK_SIZE) {
+            fprintf(stderr, "not a blackbox stream, giving up after %lu chunks\n", chunks);
+            break;
+        }
+        if (!readFully(fd, payload, header.length)) {
+            break;
+        }
+
+        if (header.sequence == 0) {
+            // The firmware opened the log device again, counters start over
+            lastDropped = 0;
+        } else if (header.sequence != expectedSequence) {
+            missingChunks += header.sequence - expectedSequence;
+        }
+        droppedBytes += header.droppedBytes - lastDropped;
+        lastDropped = header.droppedBytes;
+        expectedSequence = header.sequence + 1;
+
+        if (header.flags & BLACKBOX_STREAM_FLAG_LOG_START) {
+            fprintf(stderr, "log %ld started\n", logs + 1);
+        }
+        if (header.length && fwrite(payload, 1, header.length, file) != header.length) {
+            writeFailed = true;
+            break;
+        }
+        chunks++;
+        bytes += header.length;
+        if (header.flags & BLACKBOX_STREAM_FLAG_LOG_END) {
+            logs++;
+            fprintf(stderr, "log %ld complete\n", logs);
+        }
+    }
+
+    close(fd);
+    if (fclose(file) != 0 || writeFailed) {
+        fprintf(stderr, "can't write %s\n", argv[optind]);
+        return 1;
+    }
+
+    fprintf(stderr, "%llu bytes in %lu chunks, %ld complete logs, %lu chunks (%lu bytes) lost\n",
+        bytes, chunks, logs, missingChunks, droppedBytes);
+
+    return missingChunks ? 2 : 0;
+}
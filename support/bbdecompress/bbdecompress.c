@@ -0,0 +1,91 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Turns a blackbox log written with blackbox_compression = HUFFMAN back into a plain log for the usual tools.
+ *
+ *     bbdecompress LOG00001.BFL plain.bfl
+ *
+ * Damaged blocks, e.g. the last one of a log cut short by a power loss, are kept as far as they decode.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "blackbox/blackbox_decompress.h"
+
+static uint8_t *readFile(const char *path, long *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    uint8_t *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (*length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = malloc(*length + 1);
+        if (data && fread(data, 1, *length, file) != (size_t)*length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <compressed log> <output>\n", argv[0]);
+        return 1;
+    }
+
+    long length;
+    uint8_t *data = readFile(argv[1], &length);
+    if (!data) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    uint8_t *out = malloc(BLACKBOX_DECOMPRESSED_SIZE_MAX(length) + 1);
+    if (!out) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    blackboxDecompressStats_t stats;
+    const int written = blackboxDecompress(out, data, length, &stats);
+
+    FILE *file = fopen(argv[2], "wb");
+    if (!file || fwrite(out, 1, written, file) != (size_t)written || fclose(file) != 0) {
+        fprintf(stderr, "can't write %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("%ld bytes in, %d bytes out, %u blocks, %u damaged, %u plain bytes\n",
+        length, written, stats.blocks, stats.damagedBlocks, stats.plainBytes);
+
+    free(out);
+    free(data);
+
+    return stats.damagedBlocks ? 2 : 0;
+}
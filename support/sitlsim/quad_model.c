@@ -0,0 +1,177 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "quad_model.h"
+
+#define GRAVITY 9.80665
+
+// motor positions in units of armLength, FRD, and the sign of their yaw torque
+// (counter clockwise seen from above pushes the body clockwise, which is positive yaw)
+static const double motorX[QUAD_MOTOR_COUNT] = {  1, -1,  1, -1 };
+static const double motorY[QUAD_MOTOR_COUNT] = {  1, -1, -1,  1 };
+static const double motorYaw[QUAD_MOTOR_COUNT] = {  1,  1, -1, -1 };
+
+// a 5" quad with 2306 motors
+void quadDefaultParams(quadParams_t *params)
+{
+    params->mass = 0.6;
+    params->armLength = 0.08;
+    params->inertia[0] = 0.0025;
+    params->inertia[1] = 0.0025;
+    params->inertia[2] = 0.0045;
+    params->maxThrust = 8.0;
+    params->torqueCoefficient = 0.016;
+    params->rotorMomentum = 0.01;
+    params->motorTimeConstant = 0.015;
+    params->linearDrag = 0.3;
+    params->angularDrag = 0.0005;
+    params->gyroNoise = 0.01;
+}
+
+void quadInit(quadState_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->attitude[0] = 1.0;
+    state->specificForce[2] = -GRAVITY;
+    state->onGround = true;
+    state->noiseSeed = 1;
+}
+
+// v_earth = R(q) v_body
+static void bodyToEarth(const double q[4], const double v[3], double out[3])
+{
+    const double w = q[0], x = q[1], y = q[2], z = q[3];
+    out[0] = (1 - 2 * (y * y + z * z)) * v[0] + 2 * (x * y - w * z) * v[1] + 2 * (x * z + w * y) * v[2];
+    out[1] = 2 * (x * y + w * z) * v[0] + (1 - 2 * (x * x + z * z)) * v[1] + 2 * (y * z - w * x) * v[2];
+    out[2] = 2 * (x * z - w * y) * v[0] + 2 * (y * z + w * x) * v[1] + (1 - 2 * (x * x + y * y)) * v[2];
+}
+
+static void earthToBody(const double q[4], const double v[3], double out[3])
+{
+    const double conjugate[4] = { q[0], -q[1], -q[2], -q[3] };
+    bodyToEarth(conjugate, v, out);
+}
+
+double quadHoverCommand(const quadParams_t *params)
+{
+    return sqrt(params->mass * GRAVITY / (QUAD_MOTOR_COUNT * params->maxThrust));
+}
+
+void quadStep(quadState_t *state, const quadParams_t *params, const float motorCommand[QUAD_MOTOR_COUNT], double dt)
+{
+    // motors, thrust goes with the square of the speed. Spinning a rotor up pushes the body
+    // the same way as its drag, which is most of the yaw authority while the speed changes
+    const double motorGain = 1 - exp(-dt / params->motorTimeConstant);
+    double thrust = 0;
+    double torque[3] = { 0, 0, 0 };
+    for (int i = 0; i < QUAD_MOTOR_COUNT; i++) {
+        const double command = fmin(fmax(motorCommand[i], 0), 1);
+        const double speedChange = (command - state->motorSpeed[i]) * motorGain;
+        state->motorSpeed[i] += speedChange;
+        const double motorThrust = params->maxThrust * state->motorSpeed[i] * state->motorSpeed[i];
+        thrust += motorThrust;
+        torque[0] -= motorY[i] * params->armLength * motorThrust;
+        torque[1] += motorX[i] * params->armLength * motorThrust;
+        torque[2] += motorYaw[i] * (params->torqueCoefficient * motorThrust + params->rotorMomentum * speedChange / dt);
+    }
+
+    // rotation, Euler's equations
+    double *w = state->rate;
+    const double *I = params->inertia;
+    double rateDot[3];
+    rateDot[0] = (torque[0] - params->angularDrag * w[0] - (I[2] - I[1]) * w[1] * w[2]) / I[0];
+    rateDot[1] = (torque[1] - params->angularDrag * w[1] - (I[0] - I[2]) * w[2] * w[0]) / I[1];
+    rateDot[2] = (torque[2] - params->angularDrag * w[2] - (I[1] - I[0]) * w[0] * w[1]) / I[2];
+    for (int axis = 0; axis < 3; axis++) {
+        w[axis] += rateDot[axis] * dt;
+    }
+
+    double *q = state->attitude;
+    const double qDot[4] = {
+        0.5 * (-q[1] * w[0] - q[2] * w[1] - q[3] * w[2]),
+        0.5 * ( q[0] * w[0] + q[2] * w[2] - q[3] * w[1]),
+        0.5 * ( q[0] * w[1] - q[1] * w[2] + q[3] * w[0]),
+        0.5 * ( q[0] * w[2] + q[1] * w[1] - q[2] * w[0]),
+    };
+    double norm = 0;
+    for (int i = 0; i < 4; i++) {
+        q[i] += qDot[i] * dt;
+        norm += q[i] * q[i];
+    }
+    norm = sqrt(norm);
+    for (int i = 0; i < 4; i++) {
+        q[i] /= norm;
+    }
+
+    // translation
+    const double thrustBody[3] = { 0, 0, -thrust };
+    double force[3];
+    bodyToEarth(q, thrustBody, force);
+    double acceleration[3];
+    for (int axis = 0; axis < 3; axis++) {
+        acceleration[axis] = (force[axis] - params->linearDrag * state->velocity[axis]) / params->mass;
+    }
+    acceleration[2] += GRAVITY;
+
+    const double previousVelocity[3] = { state->velocity[0], state->velocity[1], state->velocity[2] };
+    for (int axis = 0; axis < 3; axis++) {
+        state->velocity[axis] += acceleration[axis] * dt;
+        state->position[axis] += state->velocity[axis] * dt;
+    }
+
+    // the ground holds the quad until the thrust lifts it, it does not tip over
+    state->onGround = state->position[2] >= 0;
+    if (state->onGround) {
+        state->position[2] = 0;
+        memset(state->velocity, 0, sizeof(state->velocity));
+        memset(state->rate, 0, sizeof(state->rate));
+    }
+
+    // an accelerometer measures the acceleration minus gravity
+    double specificForceEarth[3];
+    for (int axis = 0; axis < 3; axis++) {
+        specificForceEarth[axis] = (state->velocity[axis] - previousVelocity[axis]) / dt;
+    }
+    specificForceEarth[2] -= GRAVITY;
+    earthToBody(q, specificForceEarth, state->specificForce);
+}
+
+static double gyroNoise(quadState_t *state, double amplitude)
+{
+    state->noiseSeed = state->noiseSeed * 1664525 + 1013904223;
+    return ((state->noiseSeed >> 8) / 8388608.0 - 1.0) * amplitude;
+}
+
+void quadToFdmPacket(quadState_t *state, const quadParams_t *params, double timestamp, fdm_packet *pkt)
+{
+    pkt->timestamp = timestamp;
+    for (int axis = 0; axis < 3; axis++) {
+        pkt->imu_angular_velocity_rpy[axis] = state->rate[axis] + gyroNoise(state, params->gyroNoise);
+        pkt->imu_linear_acceleration_xyz[axis] = state->specificForce[axis];
+        pkt->velocity_xyz[axis] = state->velocity[axis];
+        pkt->position_xyz[axis] = state->position[axis];
+    }
+    for (int i = 0; i < 4; i++) {
+        pkt->imu_orientation_quat[i] = state->attitude[i];
+    }
+}
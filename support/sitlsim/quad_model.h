@@ -0,0 +1,60 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "udplink.h"
+
+#define QUAD_MOTOR_COUNT 4
+
+// Rigid body quad X with first order motors. Body frame is FRD, earth frame NED,
+// motors are in the order of servo_packet (front right, rear left, front left, rear right).
+typedef struct quadParams_s {
+    double mass;                // kg
+    double armLength;           // m, distance from the centre along x and along y
+    double inertia[3];          // kg m^2, principal axes
+    double maxThrust;           // N per motor at full command
+    double torqueCoefficient;   // m, yaw torque per N of thrust
+    double rotorMomentum;       // Nms, angular momentum of a rotor at full speed
+    double motorTimeConstant;   // s
+    double linearDrag;          // N per m/s
+    double angularDrag;         // Nm per rad/s
+    double gyroNoise;           // rad/s, peak of the uniform noise added to the gyro
+} quadParams_t;
+
+typedef struct quadState_s {
+    double position[3];         // m, NED
+    double velocity[3];         // m/s, NED
+    double attitude[4];         // body to earth quaternion, w x y z
+    double rate[3];             // rad/s, body
+    double specificForce[3];    // m/s^2, body, what an accelerometer measures
+    double motorSpeed[QUAD_MOTOR_COUNT];    // normalised 0..1
+    bool onGround;
+    uint32_t noiseSeed;
+} quadState_t;
+
+void quadDefaultParams(quadParams_t *params);
+void quadInit(quadState_t *state);
+void quadStep(quadState_t *state, const quadParams_t *params, const float motorCommand[QUAD_MOTOR_COUNT], double dt);
+void quadToFdmPacket(quadState_t *state, const quadParams_t *params, double timestamp, fdm_packet *pkt);
+double quadHoverCommand(const quadParams_t *params);
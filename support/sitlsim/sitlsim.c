@@ -0,0 +1,566 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Headless closed loop flight benchmark for the SITL target built with SIMULATOR_LOCKSTEP.
+ *
+ * Plays a stick script into the firmware, flies the quad model with its motor outputs and
+ * reports the step response of every measured stick step and the time the firmware took
+ * per PID loop. Optionally writes a CSV flight log.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "quad_model.h"
+#include "stick_script.h"
+#include "shmlink.h"
+#include "udplink.h"
+
+#define FDM_PORT                9003
+#define SERVO_PORT              9002
+#define RC_PORT                 9004
+#define MSP_PORT                5761    // UART1, MSP by default
+
+#define SETUP_STEP_TIME         0.001   // s, until the looptime is known
+#define DEFAULT_LOOPS_PER_STEP  8       // SIMULATOR_LOCKSTEP_LOOPS of the firmware
+#define GYRO_SAMPLE_PERIOD      125e-6  // s, the fake gyro samples at 8kHz
+#define MAX_PHYSICS_STEP        250e-6  // s
+#define REPLY_TIMEOUT_MS        2000
+#define MSP_REPLY_STEPS         2000    // fdm_packets to wait for an MSP reply
+
+#define HOVER_ALTITUDE          2.0     // m
+
+#define MSP_ADVANCED_CONFIG     90
+#define MSP_STATUS              101
+#define MSP_SET_MODE_RANGE      35
+#define MSP_BOX_ARM             0       // permanent id
+#define RAD2DEG                 (180.0 / M_PI)
+#define MIN(a, b)               ((a) < (b) ? (a) : (b))
+#define MAX(a, b)               ((a) > (b) ? (a) : (b))
+
+static const char *stickName[] = { "roll", "pitch", "yaw" };
+
+typedef struct stepResult_s {
+    int segment;
+    int axis;
+    double from;        // deg/s
+    double to;          // deg/s
+    double rise;        // s, 10% to 90%
+    double overshoot;   // fraction of the step
+    double settle;      // s, until the rate stays within 5% of the step
+    double error;       // s, integral of the normalised error to an ideal step
+} stepResult_t;
+
+// UDP like gazebo, or the shared memory rings of a firmware started with SITL_SHM
+typedef struct simLink_s {
+    udpLink_t udp;
+    shmLink_t shm;
+} simLink_t;
+
+static bool shmTransport;
+static simLink_t fdmLink, servoLink, rcLink;
+static int mspFd = -1;
+
+static uint64_t nanosNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int simLinkSend(simLink_t *link, const void *data, size_t size)
+{
+    return shmTransport ? shmSend(&link->shm, data, size) : udpSend(&link->udp, data, size);
+}
+
+static int simLinkRecv(simLink_t *link, void *data, size_t size, uint32_t timeout_ms)
+{
+    return shmTransport ? shmRecv(&link->shm, data, size, timeout_ms) : udpRecv(&link->udp, data, size, timeout_ms);
+}
+
+static bool shmAttach(simLink_t *link, const char *prefix, const char *name)
+{
+    char ringName[SHM_LINK_NAME_SIZE];
+    snprintf(ringName, sizeof(ringName), "%s_%s", prefix, name);
+    if (shmInit(&link->shm, ringName, false) != 0) {
+        fprintf(stderr, "can't attach to the shared memory ring %s\n", ringName);
+        return false;
+    }
+    return true;
+}
+
+static int compareU32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// MSP v1 over the TCP serial port of the firmware
+
+static bool mspConnect(void)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MSP_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    for (int retry = 0; retry < 50; retry++) {
+        mspFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(mspFd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            const int one = 1;
+            setsockopt(mspFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(mspFd, F_SETFL, fcntl(mspFd, F_GETFL, 0) | O_NONBLOCK);
+            return true;
+        }
+        close(mspFd);
+        usleep(100000);
+    }
+    mspFd = -1;
+    return false;
+}
+
+static void mspSend(uint8_t cmd, const uint8_t *payload, uint8_t size)
+{
+    uint8_t frame[6 + 255];
+    frame[0] = '$';
+    frame[1] = 'M';
+    frame[2] = '<';
+    frame[3] = size;
+    frame[4] = cmd;
+    uint8_t checksum = size ^ cmd;
+    for (int i = 0; i < size; i++) {
+        frame[5 + i] = payload[i];
+        checksum ^= payload[i];
+    }
+    frame[5 + size] = checksum;
+    if (write(mspFd, frame, 6 + size) != 6 + size) {
+        fprintf(stderr, "MSP write failed: %s\n", strerror(errno));
+    }
+}
+
+// returns the payload size of the reply to cmd once it has arrived, -1 before
+static int mspPoll(uint8_t cmd, uint8_t *payload, int maxSize)
+{
+    static uint8_t buffer[1024];
+    static int length;
+
+    const int n = read(mspFd, buffer + length, sizeof(buffer) - length);
+    if (n > 0) {
+        length += n;
+    }
+    while (length >= 6) {
+        if (buffer[0] != '$' || buffer[1] != 'M' || (buffer[2] != '>' && buffer[2] != '!')) {
+            memmove(buffer, buffer + 1, --length);
+            continue;
+        }
+        const int size = buffer[3];
+        if (length < 6 + size) {
+            break;
+        }
+        const bool match = buffer[4] == cmd && buffer[2] == '>';
+        if (match && payload) {
+            memcpy(payload, buffer + 5, MIN(size, maxSize));
+        }
+        length -= 6 + size;
+        memmove(buffer, buffer + 6 + size, length);
+        if (match) {
+            return size;
+        }
+    }
+    return -1;
+}
+
+// one fdm_packet out, one servo_packet back
+
+typedef struct simulation_s {
+    quadParams_t params;
+    quadState_t quad;
+    double time;
+    double stepTime;
+    int loopsPerStep;
+    uint64_t stepCount;
+    uint32_t *stepNanos;
+    uint64_t stepNanosCount;
+    float motors[QUAD_MOTOR_COUNT];
+    FILE *log;
+} simulation_t;
+
+static bool simulationStep(simulation_t *sim, const uint16_t sticks[STICK_COUNT])
+{
+    const double timestamp = sim->time;
+
+    // AETR channel order, AUX2 onwards low
+    rc_packet rcPkt;
+    rcPkt.timestamp = timestamp;
+    rcPkt.channels[0] = sticks[STICK_ROLL];
+    rcPkt.channels[1] = sticks[STICK_PITCH];
+    rcPkt.channels[2] = sticks[STICK_THROTTLE];
+    rcPkt.channels[3] = sticks[STICK_YAW];
+    rcPkt.channels[4] = sticks[STICK_AUX1];
+    for (int i = 5; i < SIMULATOR_MAX_RC_CHANNELS; i++) {
+        rcPkt.channels[i] = 1000;
+    }
+    simLinkSend(&rcLink, &rcPkt, sizeof(rcPkt));
+
+    fdm_packet fdmPkt;
+    quadToFdmPacket(&sim->quad, &sim->params, timestamp, &fdmPkt);
+
+    const uint64_t start = nanosNow();
+    simLinkSend(&fdmLink, &fdmPkt, sizeof(fdmPkt));
+    servo_packet servoPkt;
+    if (simLinkRecv(&servoLink, &servoPkt, sizeof(servoPkt), REPLY_TIMEOUT_MS) != sizeof(servoPkt)) {
+        fprintf(stderr, "no servo_packet from the firmware, is SITL running and built with SIMULATOR_LOCKSTEP?\n");
+        return false;
+    }
+    const uint64_t elapsed = nanosNow() - start;
+    sim->stepNanos[sim->stepNanosCount++] = MIN(elapsed, UINT32_MAX);
+
+    for (int i = 0; i < QUAD_MOTOR_COUNT; i++) {
+        sim->motors[i] = servoPkt.motor_speed[i];
+    }
+    const int substeps = ceil(sim->stepTime / MAX_PHYSICS_STEP);
+    for (int i = 0; i < substeps; i++) {
+        quadStep(&sim->quad, &sim->params, sim->motors, sim->stepTime / substeps);
+    }
+
+    if (sim->log) {
+        // motors in the firmware order: rear right, front right, rear left, front left
+        fprintf(sim->log, "%llu,%llu,%u,%u,%u,%u,%u,%.2f,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%llu\n",
+            (unsigned long long)sim->stepCount, (unsigned long long)llround(timestamp * 1e6),
+            sticks[STICK_ROLL], sticks[STICK_PITCH], sticks[STICK_YAW], sticks[STICK_THROTTLE], sticks[STICK_AUX1],
+            sim->quad.rate[0] * RAD2DEG, sim->quad.rate[1] * RAD2DEG, sim->quad.rate[2] * RAD2DEG,
+            sim->motors[3], sim->motors[0], sim->motors[1], sim->motors[2],
+            -sim->quad.position[2], sim->quad.position[0], sim->quad.position[1],
+            (unsigned long long)elapsed);
+    }
+
+    sim->stepCount++;
+    sim->time += sim->stepTime;
+    return true;
+}
+
+// sends an MSP request and keeps stepping with the given sticks until the reply arrives, the
+// TCP side of the firmware runs in wall time so a reply takes some steps
+static int mspRequest(simulation_t *sim, const uint16_t sticks[STICK_COUNT], uint8_t cmd,
+    const uint8_t *payload, uint8_t size, uint8_t *reply, int maxSize)
+{
+    mspSend(cmd, payload, size);
+    for (int i = 0; i < MSP_REPLY_STEPS; i++) {
+        if (!simulationStep(sim, sticks)) {
+            return -1;
+        }
+        const int replySize = mspPoll(cmd, reply, maxSize);
+        if (replySize >= 0) {
+            return replySize;
+        }
+        usleep(1000);
+    }
+    fprintf(stderr, "no answer to MSP command %d from the firmware\n", cmd);
+    return -1;
+}
+
+// on the ground and disarmed until the firmware took the arm switch and reported its PID
+// looptime, every fdm_packet then covers the time of the PID loops it runs
+static bool simulationSetup(simulation_t *sim, bool stepTimeGiven)
+{
+    const uint16_t sticks[STICK_COUNT] = { 1500, 1500, 1500, 1000, 1000 };
+    const double stepTime = sim->stepTime;
+    sim->stepTime = SETUP_STEP_TIME;
+
+    // ARM on AUX1 1700 - 2100, kept in RAM only
+    const uint8_t armRange[] = { 0, MSP_BOX_ARM, 0, (1700 - 900) / 25, (2100 - 900) / 25 };
+    uint8_t config[16];
+    if (mspRequest(sim, sticks, MSP_SET_MODE_RANGE, armRange, sizeof(armRange), NULL, 0) < 0
+        || mspRequest(sim, sticks, MSP_ADVANCED_CONFIG, NULL, 0, config, sizeof(config)) < 2) {
+        return false;
+    }
+
+    const double pidLooptime = GYRO_SAMPLE_PERIOD * config[0] * config[1];
+    sim->stepTime = stepTimeGiven ? stepTime : sim->loopsPerStep * pidLooptime;
+    printf("PID looptime %.0fus, %d PID loops per fdm_packet of %.3fms\n",
+        pidLooptime * 1e6, sim->loopsPerStep, sim->stepTime * 1000);
+    return true;
+}
+
+// the built in pilot holds HOVER_ALTITUDE with the throttle stick, climbing at up to 1m/s
+static uint16_t hoverThrottle(const simulation_t *sim, double *integral)
+{
+    const double altitude = -sim->quad.position[2];
+    const double climbRate = -sim->quad.velocity[2];
+    const double targetClimbRate = fmin(fmax(HOVER_ALTITUDE - altitude, -1), 1);
+    const double error = targetClimbRate - climbRate;
+    *integral = fmin(fmax(*integral + 0.2 * error * sim->stepTime, -0.2), 0.2);
+    const double command = quadHoverCommand(&sim->params) + *integral + 0.1 * error;
+    return 1000 + lrint(1000 * fmin(fmax(command, 0), 0.8));
+}
+
+static void reportArmingFailure(simulation_t *sim, const uint16_t sticks[STICK_COUNT])
+{
+    uint8_t status[64];
+    const int size = mspRequest(sim, sticks, MSP_STATUS, NULL, 0, status, sizeof(status));
+    if (size < 0) {
+        return;
+    }
+    // cycle time, i2c errors, sensors, flight mode flags, profile, load, gyro cycle time,
+    // extra flight mode flag bytes, arming disable flag count, arming disable flags
+    const int extraFlags = size > 15 ? status[15] : 0;
+    uint32_t armingDisableFlags = 0;
+    if (size >= 16 + extraFlags + 5) {
+        memcpy(&armingDisableFlags, status + 16 + extraFlags + 1, sizeof(armingDisableFlags));
+    }
+    fprintf(stderr, "the firmware did not arm, arming disable flags 0x%08x (see armingDisableFlagNames_e)\n", armingDisableFlags);
+}
+
+static void measureStep(stepResult_t *result, const double *rates, int count, double initial, double dt)
+{
+    int tail = count / 4;
+    double final = 0;
+    for (int i = count - tail; i < count; i++) {
+        final += rates[i];
+    }
+    final /= tail;
+    const double delta = final - initial;
+    result->from = initial;
+    result->to = final;
+
+    double t10 = -1;
+    double t90 = -1;
+    double peak = 0;
+    int lastOutside = -1;
+    double error = 0;
+    for (int i = 0; i < count; i++) {
+        const double y = fabs(delta) > 1 ? (rates[i] - initial) / delta : 1;
+        if (t10 < 0 && y >= 0.1) {
+            t10 = (i + 1) * dt;
+        }
+        if (t90 < 0 && y >= 0.9) {
+            t90 = (i + 1) * dt;
+        }
+        peak = fmax(peak, y);
+        if (fabs(y - 1) > 0.05) {
+            lastOutside = i;
+        }
+        error += fabs(1 - y) * dt;
+    }
+    result->rise = (t10 >= 0 && t90 >= 0) ? t90 - t10 : NAN;
+    result->overshoot = fmax(peak - 1, 0);
+    result->settle = (lastOutside + 1) * dt;
+    result->error = error;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-s script] [-l log.csv] [-t step_ms] [-n loops_per_step] [-m shm_prefix]\n"
+        "  -s  stick script, see stick_script.h, default: steps on every axis\n"
+        "  -l  write a CSV flight log\n"
+        "  -t  simulation step, one fdm_packet, default: the time of the PID loops it runs\n"
+        "  -n  PID loops the firmware runs per fdm_packet (SIMULATOR_LOCKSTEP_LOOPS), default %d\n"
+        "  -m  use the shared memory rings of a firmware started with SITL_SHM=shm_prefix instead of UDP\n",
+        name, DEFAULT_LOOPS_PER_STEP);
+}
+
+int main(int argc, char **argv)
+{
+    static simulation_t sim;
+    static stickScript_t script;
+    const char *scriptFile = NULL;
+    const char *logFile = NULL;
+    const char *shmPrefix = NULL;
+
+    sim.stepTime = 0;
+    sim.loopsPerStep = DEFAULT_LOOPS_PER_STEP;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:l:t:n:m:h")) != -1) {
+        switch (option) {
+        case 's':
+            scriptFile = optarg;
+            break;
+        case 'l':
+            logFile = optarg;
+            break;
+        case 't':
+            sim.stepTime = atof(optarg) / 1000;
+            break;
+        case 'n':
+            sim.loopsPerStep = atoi(optarg);
+            break;
+        case 'm':
+            shmPrefix = optarg;
+            shmTransport = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (sim.stepTime < 0 || sim.loopsPerStep <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (scriptFile ? !stickScriptLoad(&script, scriptFile) : !stickScriptParse(&script, stickScriptStepResponse)) {
+        return 1;
+    }
+
+    int measuredSteps = 0;
+    double duration = 0;
+    for (int i = 0; i < script.segmentCount; i++) {
+        measuredSteps += script.segments[i].measure;
+        duration += script.segments[i].duration;
+    }
+    stepResult_t *results = calloc(MAX(measuredSteps, 1), sizeof(stepResult_t));
+    int resultCount = 0;
+
+    if (!shmTransport && (udpInit(&servoLink.udp, NULL, SERVO_PORT, true) != 0
+        || udpInit(&fdmLink.udp, "127.0.0.1", FDM_PORT, false) != 0
+        || udpInit(&rcLink.udp, "127.0.0.1", RC_PORT, false) != 0)) {
+        fprintf(stderr, "UDP setup failed\n");
+        return 1;
+    }
+    if (!mspConnect()) {
+        fprintf(stderr, "can't connect to the firmware on tcp://127.0.0.1:%d\n", MSP_PORT);
+        return 1;
+    }
+    // the firmware made its rings before it opened the MSP port
+    if (shmTransport && (!shmAttach(&servoLink, shmPrefix, "servo")
+        || !shmAttach(&fdmLink, shmPrefix, "fdm")
+        || !shmAttach(&rcLink, shmPrefix, "rc"))) {
+        return 1;
+    }
+
+    quadDefaultParams(&sim.params);
+    quadInit(&sim.quad);
+
+    sim.stepNanos = calloc(3 * MSP_REPLY_STEPS, sizeof(uint32_t));
+
+    if (logFile) {
+        sim.log = fopen(logFile, "w");
+        if (!sim.log) {
+            perror(logFile);
+            return 1;
+        }
+        fprintf(sim.log, "loopIteration,time (us),rcRoll,rcPitch,rcYaw,rcThrottle,rcAux1,gyroRoll (deg/s),gyroPitch (deg/s),gyroYaw (deg/s),"
+            "motor[0],motor[1],motor[2],motor[3],altitude (m),north (m),east (m),step (ns)\n");
+    }
+
+    if (!simulationSetup(&sim, sim.stepTime > 0)) {
+        return 1;
+    }
+    // the firmware timing is measured during the script only
+    free(sim.stepNanos);
+    sim.stepNanos = calloc(duration / sim.stepTime + script.segmentCount + MSP_REPLY_STEPS, sizeof(uint32_t));
+    sim.stepNanosCount = 0;
+
+    double altitudeIntegral = 0;
+    bool armed = false;
+    for (int segmentIndex = 0; segmentIndex < script.segmentCount; segmentIndex++) {
+        const stickSegment_t *segment = &script.segments[segmentIndex];
+        const int steps = lrint(segment->duration / sim.stepTime);
+        double *rates = segment->measure ? calloc(steps, sizeof(double)) : NULL;
+        const double initialRate = segment->measure ? sim.quad.rate[segment->measureAxis] * RAD2DEG : 0;
+
+        uint16_t sticks[STICK_COUNT];
+        memcpy(sticks, segment->sticks, sizeof(sticks));
+        bool motorsRunning = false;
+        for (int step = 0; step < steps; step++) {
+            if (segment->holdAltitude) {
+                sticks[STICK_THROTTLE] = hoverThrottle(&sim, &altitudeIntegral);
+            }
+            if (!simulationStep(&sim, sticks)) {
+                return 1;
+            }
+            if (rates) {
+                rates[step] = sim.quad.rate[segment->measureAxis] * RAD2DEG;
+            }
+            for (int i = 0; i < QUAD_MOTOR_COUNT; i++) {
+                motorsRunning |= sim.motors[i] > 0.01f;
+            }
+        }
+
+        // after the arm switch went on the motors idle, otherwise ask why not
+        const bool armSwitch = sticks[STICK_AUX1] >= 1700;
+        if (armSwitch && !armed) {
+            if (!motorsRunning) {
+                reportArmingFailure(&sim, sticks);
+                return 1;
+            }
+            armed = true;
+        }
+        armed &= armSwitch;
+
+        if (rates) {
+            stepResult_t *result = &results[resultCount++];
+            result->segment = segmentIndex;
+            result->axis = segment->measureAxis;
+            measureStep(result, rates, steps, initialRate, sim.stepTime);
+            free(rates);
+        }
+    }
+
+    if (sim.log) {
+        fclose(sim.log);
+    }
+
+    printf("%-4s %-6s %17s %9s %10s %10s %9s\n", "seg", "axis", "rate deg/s", "rise ms", "overshoot", "settle ms", "error ms");
+    double errorSum = 0;
+    double overshootSum = 0;
+    double settleMax = 0;
+    for (int i = 0; i < resultCount; i++) {
+        const stepResult_t *result = &results[i];
+        printf("%-4d %-6s %7.1f -> %7.1f %9.1f %9.1f%% %10.1f %9.1f\n", result->segment + 1, stickName[result->axis],
+            result->from, result->to, result->rise * 1000, result->overshoot * 100, result->settle * 1000, result->error * 1000);
+        errorSum += result->error;
+        overshootSum += result->overshoot;
+        settleMax = fmax(settleMax, result->settle);
+    }
+    if (resultCount) {
+        printf("step response: mean error %.1fms, mean overshoot %.1f%%, slowest settling %.1fms\n",
+            errorSum / resultCount * 1000, overshootSum / resultCount * 100, settleMax * 1000);
+    }
+
+    // every fdm_packet runs loopsPerStep PID loops, the round trip over UDP is included
+    qsort(sim.stepNanos, sim.stepNanosCount, sizeof(uint32_t), compareU32);
+    double nanosSum = 0;
+    for (uint64_t i = 0; i < sim.stepNanosCount; i++) {
+        nanosSum += sim.stepNanos[i];
+    }
+    const double loopMean = nanosSum / sim.stepNanosCount / sim.loopsPerStep;
+    const double loopP99 = (double)sim.stepNanos[sim.stepNanosCount * 99 / 100] / sim.loopsPerStep;
+    const double looptime = sim.stepTime / sim.loopsPerStep * 1e9;
+    printf("PID loop: mean %.2fus, 99th percentile %.2fus, %.1fx realtime, %.1f%% headroom at a %.0fus looptime\n",
+        loopMean / 1000, loopP99 / 1000, looptime / loopMean, 100 * (1 - loopMean / looptime), looptime / 1000);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stick_script.h"
+
+// the script used when none is given: take off, then steps on every axis, both directions
+const char stickScriptStepResponse[] =
+    "# seconds  roll  pitch  yaw   throttle  aux1  [step]\n"
+    "2.0        1500  1500   1500  1000      1000        # on the ground, gyro calibration\n"
+    "1.0        1500  1500   1500  1000      1800        # arm\n"
+    "3.0        1500  1500   1500  hover     1800        # climb and hold the altitude\n"
+    "0.5        1750  1500   1500  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "0.5        1250  1500   1500  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "0.5        1500  1750   1500  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "0.5        1500  1250   1500  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "0.5        1500  1500   1750  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "0.5        1500  1500   1250  hover     1800  step\n"
+    "0.5        1500  1500   1500  hover     1800  step\n"
+    "1.0        1500  1500   1500  1000      1000        # disarm\n";
+
+static bool parseLine(stickSegment_t *segment, char *line, int lineNumber)
+{
+    char *comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    char *tokens[STICK_COUNT + 2];
+    int tokenCount = 0;
+    for (char *token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        if (tokenCount == STICK_COUNT + 2) {
+            fprintf(stderr, "line %d: too many columns\n", lineNumber);
+            return false;
+        }
+        tokens[tokenCount++] = token;
+    }
+    if (tokenCount == 0) {
+        return true;
+    }
+    if (tokenCount < STICK_COUNT + 1) {
+        fprintf(stderr, "line %d: expected seconds, roll, pitch, yaw, throttle and aux1\n", lineNumber);
+        return false;
+    }
+
+    memset(segment, 0, sizeof(*segment));
+    segment->duration = atof(tokens[0]);
+    for (int stick = 0; stick < STICK_COUNT; stick++) {
+        const char *value = tokens[stick + 1];
+        if (stick == STICK_THROTTLE && strcmp(value, "hover") == 0) {
+            segment->holdAltitude = true;
+            segment->sticks[stick] = 1000;
+        } else {
+            segment->sticks[stick] = atoi(value);
+            if (segment->sticks[stick] < 900 || segment->sticks[stick] > 2100) {
+                fprintf(stderr, "line %d: stick value %s out of range\n", lineNumber, value);
+                return false;
+            }
+        }
+    }
+    if (tokenCount == STICK_COUNT + 2) {
+        if (strcmp(tokens[STICK_COUNT + 1], "step") != 0) {
+            fprintf(stderr, "line %d: unknown option %s\n", lineNumber, tokens[STICK_COUNT + 1]);
+            return false;
+        }
+        segment->measure = true;
+    }
+    if (segment->duration <= 0) {
+        fprintf(stderr, "line %d: duration must be positive\n", lineNumber);
+        return false;
+    }
+    segment->measureAxis = -1;
+
+    return true;
+}
+
+bool stickScriptParse(stickScript_t *script, const char *text)
+{
+    script->segmentCount = 0;
+
+    char line[256];
+    int lineNumber = 0;
+    while (*text) {
+        const size_t length = strcspn(text, "\n");
+        if (length >= sizeof(line)) {
+            fprintf(stderr, "line %d: too long\n", lineNumber + 1);
+            return false;
+        }
+        memcpy(line, text, length);
+        line[length] = '\0';
+        text += length + (text[length] == '\n');
+        lineNumber++;
+
+        if (script->segmentCount == STICK_SCRIPT_MAX_SEGMENTS) {
+            fprintf(stderr, "line %d: more than %d segments\n", lineNumber, STICK_SCRIPT_MAX_SEGMENTS);
+            return false;
+        }
+        stickSegment_t *segment = &script->segments[script->segmentCount];
+        segment->duration = 0;
+        if (!parseLine(segment, line, lineNumber)) {
+            return false;
+        }
+        if (segment->duration == 0) {
+            continue;
+        }
+
+        // the axis to measure is the attitude stick that moved
+        if (segment->measure && script->segmentCount > 0) {
+            const stickSegment_t *previous = &script->segments[script->segmentCount - 1];
+            for (int axis = STICK_ROLL; axis <= STICK_YAW; axis++) {
+                if (segment->sticks[axis] != previous->sticks[axis]) {
+                    segment->measureAxis = axis;
+                    break;
+                }
+            }
+        }
+        if (segment->measure && segment->measureAxis < 0) {
+            fprintf(stderr, "line %d: step without a roll, pitch or yaw stick change\n", lineNumber);
+            return false;
+        }
+        script->segmentCount++;
+    }
+
+    return script->segmentCount > 0;
+}
+
+bool stickScriptLoad(stickScript_t *script, const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror(filename);
+        return false;
+    }
+    static char text[64 * 1024];
+    const size_t length = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    text[length] = '\0';
+
+    return stickScriptParse(script, text);
+}
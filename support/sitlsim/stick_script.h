@@ -0,0 +1,62 @@
+/*
+ * This file is part of Cleanflight and Chickenflight.
+ *
+ * Cleanflight and Chickenflight are free software. You can redistribute
+ * this software and/or modify this software under the terms of the
+ * GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Cleanflight and Chickenflight are distributed in the hope that they
+ * will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.
+ *
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STICK_SCRIPT_MAX_SEGMENTS 256
+
+typedef enum {
+    STICK_ROLL = 0,
+    STICK_PITCH,
+    STICK_YAW,
+    STICK_THROTTLE,
+    STICK_AUX1,
+    STICK_COUNT
+} stickIndex_e;
+
+// A script is a list of segments, each holding the sticks for a duration:
+//
+//   # seconds  roll  pitch  yaw   throttle  aux1  [step]
+//   2.0        1500  1500   1500  1000      1000
+//   2.0        1500  1500   1500  hover     1800
+//   0.5        1800  1500   1500  hover     1800  step
+//
+// "hover" lets the built in pilot hold the altitude with the throttle, "step" asks for the
+// step response of the stick that changed from the previous segment to be measured.
+typedef struct stickSegment_s {
+    double duration;            // s
+    uint16_t sticks[STICK_COUNT];
+    bool holdAltitude;
+    bool measure;
+    int measureAxis;            // stickIndex_e that changed, -1 if none
+} stickSegment_t;
+
+typedef struct stickScript_s {
+    stickSegment_t segments[STICK_SCRIPT_MAX_SEGMENTS];
+    int segmentCount;
+} stickScript_t;
+
+extern const char stickScriptStepResponse[];
+
+bool stickScriptParse(stickScript_t *script, const char *text);
+bool stickScriptLoad(stickScript_t *script, const char *filename);